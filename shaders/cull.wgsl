@@ -0,0 +1,93 @@
+// Frustum and hierarchical-Z occlusion culling of scene objects. Only the
+// candidates the CPU found in the view through the BVH are tested.
+//
+// Phase 0 tests every object against the pyramid of the previous frame and
+// records which ones it drew. Phase 1 runs after the pyramid was rebuilt from
+// phase 0 depth and re-tests only the rejected objects, drawing those that
+// turned out to be disoccluded.
+
+struct SceneObject {
+    offset: vec2f,
+    scale: f32,
+    depth: f32,
+}
+
+struct DrawCommand {
+    vertex_count: u32,
+    instance_count: u32,
+    first_vertex: u32,
+    first_instance: u32,
+}
+
+struct CullParams {
+    mesh_min: vec2f,
+    mesh_max: vec2f,
+    camera_center: vec2f,
+    camera_zoom: f32,
+    candidate_count: u32,
+    phase: u32,
+    pyramid_levels: u32,
+    pyramid_size: vec2u,
+    test_occlusion: u32,
+    vertex_count: u32,
+}
+
+@group(0) @binding(0) var<storage, read> objects: array<SceneObject>;
+@group(0) @binding(1) var<storage, read> candidates: array<u32>;
+@group(0) @binding(2) var<storage, read_write> visibility: array<u32>;
+@group(0) @binding(3) var<storage, read_write> draws: array<DrawCommand>;
+@group(0) @binding(4) var<storage, read_write> draw_count: atomic<u32>;
+@group(0) @binding(5) var pyramid: texture_2d<f32>;
+
+var<push_constant> params: CullParams;
+
+fn visible(object: SceneObject) -> bool {
+    let ndc_min = (object.offset + params.mesh_min * object.scale - params.camera_center) * params.camera_zoom;
+    let ndc_max = (object.offset + params.mesh_max * object.scale - params.camera_center) * params.camera_zoom;
+
+    if any(ndc_max < vec2f(-1.0)) || any(ndc_min > vec2f(1.0)) {
+        return false;
+    }
+    if params.test_occlusion == 0u {
+        return true;
+    }
+
+    let uv_min = clamp(ndc_min * 0.5 + 0.5, vec2f(0.0), vec2f(1.0));
+    let uv_max = clamp(ndc_max * 0.5 + 0.5, vec2f(0.0), vec2f(1.0));
+
+    // Pick the level where the bounds cover at most 2x2 texels
+    let size = (uv_max - uv_min) * vec2f(params.pyramid_size);
+    let level = min(u32(ceil(log2(max(max(size.x, size.y), 1.0)))), params.pyramid_levels - 1u);
+
+    let dims = textureDimensions(pyramid, level);
+    let p0 = min(vec2u(uv_min * vec2f(dims)), dims - 1u);
+    let p1 = min(vec2u(uv_max * vec2f(dims)), dims - 1u);
+
+    let farthest = max(
+        max(textureLoad(pyramid, p0, level).r, textureLoad(pyramid, vec2u(p1.x, p0.y), level).r),
+        max(textureLoad(pyramid, vec2u(p0.x, p1.y), level).r, textureLoad(pyramid, p1, level).r),
+    );
+
+    return object.depth <= farthest;
+}
+
+@compute @workgroup_size(64)
+fn cull_main(@builtin(global_invocation_id) id: vec3u) {
+    if id.x >= params.candidate_count {
+        return;
+    }
+    let idx = candidates[id.x];
+    if params.phase == 1u && visibility[idx] != 0u {
+        return;
+    }
+
+    let is_visible = visible(objects[idx]);
+    if params.phase == 0u {
+        visibility[idx] = select(0u, 1u, is_visible);
+    }
+
+    if is_visible {
+        let slot = atomicAdd(&draw_count, 1u);
+        draws[slot] = DrawCommand(params.vertex_count, 1u, 0u, idx);
+    }
+}
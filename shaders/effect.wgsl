@@ -0,0 +1,50 @@
+// The lab effect of lab.wgsl as a screen-space pass. base_main draws plain
+// vertex colors, effect_main then darkens them by noise and stripes.
+
+struct VertexOutput {
+    @builtin(position) position: vec4<f32>,
+    @location(0) color: vec3<f32>,
+}
+
+@fragment
+fn base_main(input: VertexOutput) -> @location(0) vec4f {
+    return vec4f(input.color, 1.0);
+}
+
+struct EffectParams {
+    size: vec2u,
+}
+
+@group(0) @binding(0) var base: texture_2d<f32>;
+@group(0) @binding(1) var output: texture_storage_2d<rgba8unorm, write>;
+
+var<push_constant> params: EffectParams;
+
+fn rng(p: vec2f) -> f32 {
+    let K1 = vec2f(23.14069263277926, 2.665144142690225);
+    let number = fract(cos(dot(p, K1)) * 12345.6789);
+    return (number + 1) / 2;
+}
+
+// Each invocation reads only its own texel, so it is loaded straight from
+// the base image without staging a tile in workgroup memory
+@compute @workgroup_size(8, 8)
+fn effect_main(@builtin(global_invocation_id) id: vec3u) {
+    if any(id.xy >= params.size) {
+        return;
+    }
+
+    // Same as fragment_main in lab.wgsl, at the pixel center it would shade
+    let position = vec2f(id.xy) + 0.5;
+    var color = textureLoad(base, id.xy, 0);
+    let lightness = dot(color.rgb, vec3f(1, 1, 1)) / 3;
+
+    color = vec4f(color.rgb - 0.5 * rng(position) * lightness, color.w);
+    color = pow(color, vec4f(0.8));
+
+    if id.x % 5 == 0 {
+        color = vec4f(color.rgb / 1.5, 1.0);
+    }
+
+    textureStore(output, id.xy, color);
+}
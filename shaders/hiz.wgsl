@@ -0,0 +1,34 @@
+// One level of the hierarchical depth pyramid. Every texel keeps the farthest
+// depth of its footprint in the level below, level 0 reads the depth buffer.
+
+struct ReduceParams {
+    src_size: vec2u,
+    dst_size: vec2u,
+}
+
+@group(0) @binding(0) var src: texture_2d<f32>;
+@group(0) @binding(1) var dst: texture_storage_2d<r32float, write>;
+
+var<push_constant> params: ReduceParams;
+
+@compute @workgroup_size(8, 8)
+fn reduce_main(@builtin(global_invocation_id) id: vec3u) {
+    if any(id.xy >= params.dst_size) {
+        return;
+    }
+
+    // Level 0 is the depth buffer rounded down to a power of two, so a
+    // footprint may span up to three texels per axis
+    let ratio = vec2f(params.src_size) / vec2f(params.dst_size);
+    let begin = min(vec2u(floor(vec2f(id.xy) * ratio)), params.src_size - 1u);
+    let end = max(min(vec2u(ceil(vec2f(id.xy + 1u) * ratio)), params.src_size), begin + 1u);
+
+    var farthest = 0.0;
+    for (var y = begin.y; y < end.y; y++) {
+        for (var x = begin.x; x < end.x; x++) {
+            farthest = max(farthest, textureLoad(src, vec2u(x, y), 0).r);
+        }
+    }
+
+    textureStore(dst, id.xy, vec4f(farthest, 0.0, 0.0, 1.0));
+}
@@ -0,0 +1,39 @@
+// Scene vertices for the multiview pass. Every view renders into its own
+// layer, the view index picks the transform of the view.
+
+struct FrameUniforms {
+    resolution: vec2f,
+    time: f32,
+    frame: u32,
+    camera_center: vec2f,
+    camera_zoom: f32,
+}
+
+// Per view: world offset in xy, clip space scale in zw
+struct ViewTransforms {
+    views: array<vec4f, 4>,
+}
+
+struct VertexOutput {
+    @builtin(position) position: vec4<f32>,
+    @location(0) color: vec3<f32>,
+}
+
+@group(0) @binding(0) var<uniform> uniforms: FrameUniforms;
+
+var<push_constant> transforms: ViewTransforms;
+
+@vertex
+fn vertex_main(
+    @location(0) pos: vec2f,
+    @location(1) color: vec3f,
+    @builtin(view_index) view: i32,
+) -> VertexOutput {
+    let transform = transforms.views[view];
+    let camera = (pos + transform.xy - uniforms.camera_center) * uniforms.camera_zoom;
+
+    var result: VertexOutput;
+    result.position = vec4f(camera * transform.zw, 0.0, 1.0);
+    result.color = color;
+    return result;
+}
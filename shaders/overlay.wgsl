@@ -0,0 +1,73 @@
+// 2D overlay in pixels from the top left. Paths arrive as tessellated
+// triangles with a color per vertex. Quads are instanced rectangles reading
+// a signed distance atlas: glyphs cover where the distance is over 0.5,
+// solid rectangles point at a region that is inside everywhere.
+
+struct OverlayParams {
+    screen_size: vec2f,
+}
+
+@group(0) @binding(0) var atlas: texture_2d<f32>;
+@group(0) @binding(1) var atlas_sampler: sampler;
+
+var<push_constant> params: OverlayParams;
+
+fn toClip(pixel: vec2f) -> vec4f {
+    return vec4f(pixel / params.screen_size * 2.0 - 1.0, 0.0, 1.0);
+}
+
+struct PathOutput {
+    @builtin(position) position: vec4<f32>,
+    @location(0) color: vec4<f32>,
+}
+
+@vertex
+fn path_vertex_main(@location(0) pos: vec2f, @location(1) color: vec4f) -> PathOutput {
+    var result: PathOutput;
+    result.position = toClip(pos);
+    result.color = color;
+    return result;
+}
+
+@fragment
+fn path_fragment_main(input: PathOutput) -> @location(0) vec4f {
+    return input.color;
+}
+
+struct QuadOutput {
+    @builtin(position) position: vec4<f32>,
+    @location(0) uv: vec2<f32>,
+    @location(1) color: vec4<f32>,
+}
+
+// Corners of the quad drawn per instance
+const CORNERS = array<vec2f, 6>(
+    vec2f(0.0, 0.0), vec2f(1.0, 0.0), vec2f(1.0, 1.0),
+    vec2f(0.0, 0.0), vec2f(1.0, 1.0), vec2f(0.0, 1.0),
+);
+
+@vertex
+fn quad_vertex_main(
+    @location(0) rect: vec4f,
+    @location(1) uv: vec4f,
+    @location(2) color: vec4f,
+    @builtin(vertex_index) vertex: u32,
+) -> QuadOutput {
+    var corners = CORNERS;
+    let corner = corners[vertex];
+
+    var result: QuadOutput;
+    result.position = toClip(rect.xy + corner * rect.zw);
+    result.uv = uv.xy + corner * uv.zw;
+    result.color = color;
+    return result;
+}
+
+@fragment
+fn quad_fragment_main(input: QuadOutput) -> @location(0) vec4f {
+    let distance = textureSample(atlas, atlas_sampler, input.uv).r;
+    // Anti-aliased over about one pixel, whatever the glyph's scale
+    let width = max(fwidth(distance), 1e-4) * 0.5;
+    let coverage = smoothstep(0.5 - width, 0.5 + width, distance);
+    return vec4f(input.color.rgb, input.color.a * coverage);
+}
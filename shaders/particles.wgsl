@@ -0,0 +1,232 @@
+// GPU particles. State is kept per attribute (structure of arrays) and only
+// touched by these passes, in this order every frame:
+//
+//   prepare_main   clamps emission to the free slots, sizes the dispatches
+//   emit_main      takes free slots off the dead list, appends them as alive
+//   simulate_main  integrates, bounces off scene segments and compacts the
+//                  survivors into the next alive list and the instance buffer
+//   finalize_main  writes the indirect draw of the survivors
+//
+// init_main fills the dead list once. Alive lists alternate between frames,
+// `parity` names the one holding the current particles.
+
+struct ParticleParams {
+    emitter_position: vec2f,
+    emitter_direction: vec2f,
+    emitter_color: vec3f,
+    emitter_spread: f32,
+    emitter_speed: f32,
+    lifetime: f32,
+    delta_time: f32,
+    restitution: f32,
+    gravity: vec2f,
+    emit_count: u32,
+    capacity: u32,
+    segment_count: u32,
+    seed: u32,
+    parity: u32,
+    size: f32,
+}
+
+struct Counters {
+    alive: array<atomic<u32>, 2>,
+    dead: atomic<u32>,
+    emit: u32,
+}
+
+@group(0) @binding(0) var<storage, read_write> positions: array<vec2f>;
+@group(0) @binding(1) var<storage, read_write> velocities: array<vec2f>;
+// Age and lifetime in seconds
+@group(0) @binding(2) var<storage, read_write> ages: array<vec2f>;
+// RGBA8, packed
+@group(0) @binding(3) var<storage, read_write> colors: array<u32>;
+// Two lists of `capacity` particle indices
+@group(0) @binding(4) var<storage, read_write> alive: array<u32>;
+@group(0) @binding(5) var<storage, read_write> dead: array<u32>;
+@group(0) @binding(6) var<storage, read_write> counters: Counters;
+// Emit dispatch, simulate dispatch, draw
+@group(0) @binding(7) var<storage, read_write> args: array<u32>;
+// One `Vertex` (position, color) per surviving particle, read as instance
+// attributes
+@group(0) @binding(8) var<storage, read_write> instances: array<f32>;
+// Scene triangle edges, endpoints in xy and zw
+@group(0) @binding(9) var<storage, read> segments: array<vec4f>;
+
+var<push_constant> params: ParticleParams;
+
+const GROUP_SIZE = 256u;
+const VERTEX_FLOATS = 5u;
+
+fn groupCount(items: u32) -> u32 {
+    return (items + GROUP_SIZE - 1u) / GROUP_SIZE;
+}
+
+fn hash(value: u32) -> u32 {
+    let state = value * 747796405u + 2891336453u;
+    let word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+fn random(value: u32) -> f32 {
+    return f32(hash(value)) / 4294967295.0;
+}
+
+@compute @workgroup_size(256)
+fn init_main(@builtin(global_invocation_id) id: vec3u) {
+    if id.x >= params.capacity {
+        return;
+    }
+
+    dead[id.x] = id.x;
+    if id.x == 0u {
+        atomicStore(&counters.alive[0], 0u);
+        atomicStore(&counters.alive[1], 0u);
+        atomicStore(&counters.dead, params.capacity);
+    }
+}
+
+@compute @workgroup_size(1)
+fn prepare_main() {
+    let emit = min(params.emit_count, atomicLoad(&counters.dead));
+    let current = atomicLoad(&counters.alive[params.parity]);
+    counters.emit = emit;
+    atomicStore(&counters.alive[1u - params.parity], 0u);
+
+    args[0] = groupCount(emit);
+    args[1] = 1u;
+    args[2] = 1u;
+    args[3] = groupCount(current + emit);
+    args[4] = 1u;
+    args[5] = 1u;
+}
+
+@compute @workgroup_size(256)
+fn emit_main(@builtin(global_invocation_id) id: vec3u) {
+    if id.x >= counters.emit {
+        return;
+    }
+
+    let index = dead[atomicSub(&counters.dead, 1u) - 1u];
+
+    let seed = hash(params.seed ^ (id.x * 3u));
+    let angle = (random(seed) - 0.5) * params.emitter_spread;
+    let speed = params.emitter_speed * (0.5 + random(seed + 1u));
+    let rotation = mat2x2f(cos(angle), sin(angle), -sin(angle), cos(angle));
+
+    positions[index] = params.emitter_position;
+    velocities[index] = rotation * params.emitter_direction * speed;
+    ages[index] = vec2f(0.0, params.lifetime * (0.5 + random(seed + 2u)));
+    colors[index] = pack4x8unorm(vec4f(params.emitter_color * (0.6 + 0.4 * random(seed + 3u)), 1.0));
+
+    let slot = atomicAdd(&counters.alive[params.parity], 1u);
+    alive[params.parity * params.capacity + slot] = index;
+}
+
+fn cross2(a: vec2f, b: vec2f) -> f32 {
+    return a.x * b.y - a.y * b.x;
+}
+
+@compute @workgroup_size(256)
+fn simulate_main(@builtin(global_invocation_id) id: vec3u) {
+    if id.x >= atomicLoad(&counters.alive[params.parity]) {
+        return;
+    }
+
+    let index = alive[params.parity * params.capacity + id.x];
+
+    var age = ages[index];
+    age.x += params.delta_time;
+    if age.x >= age.y {
+        dead[atomicAdd(&counters.dead, 1u)] = index;
+        return;
+    }
+
+    var velocity = velocities[index] + params.gravity * params.delta_time;
+    let start = positions[index];
+    var end = start + velocity * params.delta_time;
+
+    // Bounce off the first segment crossed by this step
+    let step = end - start;
+    var nearest = 1.0;
+    var normal = vec2f(0.0);
+    for (var i = 0u; i < params.segment_count; i++) {
+        let a = segments[i].xy;
+        let edge = segments[i].zw - a;
+        let denom = cross2(step, edge);
+        if abs(denom) < 1e-12 {
+            continue;
+        }
+
+        let t = cross2(a - start, edge) / denom;
+        let u = cross2(a - start, step) / denom;
+        if t >= 0.0 && t < nearest && u >= 0.0 && u <= 1.0 {
+            nearest = t;
+            normal = normalize(vec2f(-edge.y, edge.x));
+        }
+    }
+    if nearest < 1.0 {
+        if dot(normal, step) > 0.0 {
+            normal = -normal;
+        }
+        velocity = reflect(velocity, normal) * params.restitution;
+        end = start + step * nearest + normal * 1e-4;
+    }
+
+    // Particles leaving the screen are dropped early
+    if any(abs(end) > vec2f(1.5)) {
+        dead[atomicAdd(&counters.dead, 1u)] = index;
+        return;
+    }
+
+    positions[index] = end;
+    velocities[index] = velocity;
+    ages[index] = age;
+
+    let slot = atomicAdd(&counters.alive[1u - params.parity], 1u);
+    alive[(1u - params.parity) * params.capacity + slot] = index;
+
+    let color = unpack4x8unorm(colors[index]).rgb * (1.0 - 0.5 * age.x / age.y);
+    let base = slot * VERTEX_FLOATS;
+    instances[base + 0u] = end.x;
+    instances[base + 1u] = end.y;
+    instances[base + 2u] = color.r;
+    instances[base + 3u] = color.g;
+    instances[base + 4u] = color.b;
+}
+
+@compute @workgroup_size(1)
+fn finalize_main() {
+    args[6] = 6u;
+    args[7] = atomicLoad(&counters.alive[1u - params.parity]);
+    args[8] = 0u;
+    args[9] = 0u;
+}
+
+struct VertexOutput {
+    @builtin(position) position: vec4<f32>,
+    @location(0) color: vec3<f32>,
+}
+
+// Corners of the quad drawn per particle
+const CORNERS = array<vec2f, 6>(
+    vec2f(-1.0, -1.0), vec2f(1.0, -1.0), vec2f(1.0, 1.0),
+    vec2f(-1.0, -1.0), vec2f(1.0, 1.0), vec2f(-1.0, 1.0),
+);
+
+@vertex
+fn particle_vertex_main(
+    @location(0) pos: vec2f,
+    @location(1) color: vec3f,
+    @builtin(vertex_index) vertex: u32,
+) -> VertexOutput {
+    var corners = CORNERS;
+    var result: VertexOutput;
+    result.position = vec4f(pos + corners[vertex] * params.size, 0.0, 1.0);
+    result.color = color;
+    return result;
+}
+
+@fragment
+fn particle_fragment_main(input: VertexOutput) -> @location(0) vec4f {
+    return vec4f(input.color, 1.0);
+}
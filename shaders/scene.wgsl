@@ -0,0 +1,39 @@
+// Instanced copies of the vertex mesh, one instance per scene object.
+// Objects come from the culling pass through firstInstance.
+
+struct FrameUniforms {
+    resolution: vec2f,
+    time: f32,
+    frame: u32,
+    camera_center: vec2f,
+    camera_zoom: f32,
+}
+
+struct SceneObject {
+    offset: vec2f,
+    scale: f32,
+    depth: f32,
+}
+
+struct VertexOutput {
+    @builtin(position) position: vec4<f32>,
+    @location(0) color: vec3<f32>,
+}
+
+@group(0) @binding(0) var<uniform> uniforms: FrameUniforms;
+@group(1) @binding(0) var<storage, read> objects: array<SceneObject>;
+
+@vertex
+fn vertex_main(
+    @location(0) pos: vec2f,
+    @location(1) color: vec3f,
+    @builtin(instance_index) instance: u32,
+) -> VertexOutput {
+    let object = objects[instance];
+    let world = object.offset + pos * object.scale;
+
+    var result: VertexOutput;
+    result.position = vec4f((world - uniforms.camera_center) * uniforms.camera_zoom, object.depth, 1.0);
+    result.color = color;
+    return result;
+}
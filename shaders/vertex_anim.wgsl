@@ -0,0 +1,46 @@
+// Vertex animation pre-pass. Every vertex is blended from its base position
+// and up to four morph targets, displaced by a travelling wave and written
+// as a `Vertex` (position, color) for the vertex input stage.
+
+struct AnimationParams {
+    time: f32,
+    wave_amplitude: f32,
+    wave_frequency: f32,
+    wave_speed: f32,
+    weights: vec4f,
+    vertex_count: u32,
+    target_count: u32,
+}
+
+// `Vertex` records of five floats each
+@group(0) @binding(0) var<storage, read> base: array<f32>;
+// Position deltas, `vertex_count` per target
+@group(0) @binding(1) var<storage, read> targets: array<vec2f>;
+@group(0) @binding(2) var<storage, read_write> output: array<f32>;
+
+var<push_constant> params: AnimationParams;
+
+const VERTEX_FLOATS = 5u;
+
+@compute @workgroup_size(64)
+fn animate_main(@builtin(global_invocation_id) id: vec3u) {
+    if id.x >= params.vertex_count {
+        return;
+    }
+
+    let offset = id.x * VERTEX_FLOATS;
+    var pos = vec2f(base[offset], base[offset + 1u]);
+
+    for (var i = 0u; i < params.target_count; i++) {
+        pos += params.weights[i] * targets[i * params.vertex_count + id.x];
+    }
+
+    pos.y += params.wave_amplitude *
+        sin(params.wave_frequency * pos.x + params.wave_speed * params.time);
+
+    output[offset] = pos.x;
+    output[offset + 1u] = pos.y;
+    output[offset + 2u] = base[offset + 2u];
+    output[offset + 3u] = base[offset + 3u];
+    output[offset + 4u] = base[offset + 4u];
+}
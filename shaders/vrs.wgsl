@@ -0,0 +1,55 @@
+// Shading rate analysis. Every rate texel looks at the contrast of its tile in
+// the rendered frame and picks how coarsely the next frame may shade it.
+
+struct ShadingRateParams {
+    image_size: vec2u,
+    texel_size: vec2u,
+    max_rate_log2: u32,
+}
+
+@group(0) @binding(0) var color: texture_2d<f32>;
+@group(0) @binding(1) var rates: texture_storage_2d<r8uint, write>;
+
+var<push_constant> params: ShadingRateParams;
+
+// Largest luminance step to a neighbour below which a tile shades 4x4 or 2x2
+const COARSE_THRESHOLD = 0.02;
+const MEDIUM_THRESHOLD = 0.08;
+
+fn luminance(texel: vec2u) -> f32 {
+    return dot(textureLoad(color, texel, 0).rgb, vec3f(0.2126, 0.7152, 0.0722));
+}
+
+@compute @workgroup_size(8, 8)
+fn analyze_main(@builtin(global_invocation_id) id: vec3u) {
+    if any(id.xy >= params.image_size) {
+        return;
+    }
+
+    let color_size = textureDimensions(color);
+    let begin = id.xy * params.texel_size;
+    let end = min(begin + params.texel_size, color_size);
+
+    var contrast = 0.0;
+    for (var y = begin.y; y < end.y; y++) {
+        for (var x = begin.x; x < end.x; x++) {
+            let center = luminance(vec2u(x, y));
+            let right = luminance(vec2u(min(x + 1u, color_size.x - 1u), y));
+            let below = luminance(vec2u(x, min(y + 1u, color_size.y - 1u)));
+            contrast = max(contrast, max(abs(right - center), abs(below - center)));
+        }
+    }
+
+    var rate_log2 = 0u;
+    if contrast < COARSE_THRESHOLD {
+        rate_log2 = 2u;
+    } else if contrast < MEDIUM_THRESHOLD {
+        rate_log2 = 1u;
+    }
+    rate_log2 = min(rate_log2, params.max_rate_log2);
+
+    // Fragment size encoding of VK_KHR_fragment_shading_rate: log2 of the
+    // width in bits 2-3, log2 of the height in bits 0-1
+    let rate = (rate_log2 << 2u) | rate_log2;
+    textureStore(rates, id.xy, vec4u(rate, 0u, 0u, 0u));
+}
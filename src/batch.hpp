@@ -0,0 +1,615 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// @brief Hands out the frames of a batch to render devices and merges their
+/// output back into frame order.
+///
+/// Devices pull a frame whenever they have a free slot, so each gets work in
+/// proportion to its throughput. Frame times are measured per device: near
+/// the end of the batch a device declines when the faster devices would
+/// finish the rest before it finished one frame, so the slowest device does
+/// not hold up the last write. Frames are handed out at most `window` ahead
+/// of the next frame to write, bounding the output held for reordering.
+class FrameScheduler {
+   public:
+    FrameScheduler(uint32_t frame_count, uint32_t device_count,
+                   uint32_t window)
+        : frame_count(frame_count),
+          window(window),
+          frame_ms(device_count, 0.0),
+          frames_done(device_count, 0),
+          active(device_count, true) {}
+
+    FrameScheduler(const FrameScheduler&) = delete;
+    FrameScheduler& operator=(const FrameScheduler&) = delete;
+
+    /// @brief Next frame for `device`. A device with frames in flight gets
+    /// nothing while the window is full and should collect them first, an
+    /// `idle` one waits for the writer. Nothing for an idle device means
+    /// it is done.
+    std::optional<uint32_t> next(uint32_t device, bool idle) {
+        std::unique_lock lock(mutex);
+        while (true) {
+            if (error || next_frame >= frame_count || !worthTaking(device)) {
+                return std::nullopt;
+            }
+            if (next_frame < next_write + window) {
+                return next_frame++;
+            }
+            if (!idle) {
+                return std::nullopt;
+            }
+            progress.wait(lock);
+        }
+    }
+
+    /// @brief Queues the pixels of `frame` for writing, `ms` is the time
+    /// `device` spent on it
+    void complete(uint32_t device, uint32_t frame, double ms,
+                  std::vector<uint8_t> pixels) {
+        std::lock_guard lock(mutex);
+        frame_ms[device] = frame_ms[device] == 0.0
+                               ? ms
+                               : frame_ms[device] * (1.0 - SMOOTHING) +
+                                     ms * SMOOTHING;
+        frames_done[device]++;
+        finished.emplace(frame, std::move(pixels));
+        ready.notify_all();
+    }
+
+    /// @brief Marks `device` as done, it takes no further frames
+    void stop(uint32_t device) {
+        std::lock_guard lock(mutex);
+        active[device] = false;
+        ready.notify_all();
+    }
+
+    /// @brief Aborts the batch with the error of a device
+    void fail(std::exception_ptr device_error) {
+        std::lock_guard lock(mutex);
+        if (!error) {
+            error = device_error;
+        }
+        ready.notify_all();
+        progress.notify_all();
+    }
+
+    /// @brief Passes every frame, in order, to `write(frame, pixels)` as
+    /// soon as it and all frames before it are done. Rethrows the error of
+    /// a failed device.
+    template <typename Write>
+    void drain(Write write) {
+        std::unique_lock lock(mutex);
+        while (next_write < frame_count) {
+            ready.wait(lock, [&] {
+                return error || finished.count(next_write) != 0 ||
+                       std::none_of(active.begin(), active.end(),
+                                    [](bool a) { return a; });
+            });
+            if (error) {
+                std::rethrow_exception(error);
+            }
+
+            auto it = finished.find(next_write);
+            if (it == finished.end()) {
+                throw std::runtime_error(
+                    "batch: devices stopped before frame " +
+                    std::to_string(next_write));
+            }
+            auto pixels = std::move(it->second);
+            finished.erase(it);
+
+            lock.unlock();
+            write(next_write, pixels);
+            lock.lock();
+
+            next_write++;
+            progress.notify_all();
+        }
+    }
+
+    uint32_t framesDone(uint32_t device) const { return frames_done[device]; }
+
+    double frameTime(uint32_t device) const { return frame_ms[device]; }
+
+   private:
+    // Weight of the latest frame time in the per-device average
+    static constexpr double SMOOTHING = 0.2;
+
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::condition_variable progress;
+
+    uint32_t frame_count;
+    uint32_t window;
+    uint32_t next_frame = 0;
+    uint32_t next_write = 0;
+    std::vector<double> frame_ms;
+    std::vector<uint32_t> frames_done;
+    std::vector<bool> active;
+    std::map<uint32_t, std::vector<uint8_t>> finished;
+    std::exception_ptr error;
+
+    /// @brief Whether `device` finishes another frame before the faster
+    /// devices would be through the rest of the batch. The fastest device
+    /// always takes frames.
+    bool worthTaking(uint32_t device) const {
+        double own_ms = frame_ms[device];
+        if (own_ms == 0.0) {
+            return true;
+        }
+
+        double faster_rate = 0.0;
+        double slowest_faster_ms = 0.0;
+        for (size_t d = 0; d < frame_ms.size(); d++) {
+            if (d != device && active[d] && frame_ms[d] > 0.0 &&
+                frame_ms[d] < own_ms) {
+                faster_rate += 1.0 / frame_ms[d];
+                slowest_faster_ms = std::max(slowest_faster_ms, frame_ms[d]);
+            }
+        }
+        if (faster_rate == 0.0) {
+            return true;
+        }
+
+        double remaining = frame_count - next_frame;
+        return remaining / faster_rate + slowest_faster_ms > own_ms;
+    }
+};
+
+/// @brief Headless renderer of the scene on one logical device, drawing
+/// frames into images read back to host memory.
+///
+/// A few frames are in flight per device so that the GPU is kept busy
+/// while the previous frame is read back. Nothing is shared between
+/// devices but the scheduler.
+class BatchDevice {
+   public:
+    // sRGB like the window's swapchain, so that batch frames match what the
+    // window shows
+    static constexpr vk::Format FORMAT = vk::Format::eR8G8B8A8Srgb;
+    static constexpr uint32_t FRAMES_IN_FLIGHT = 2;
+
+    BatchDevice(vk::raii::PhysicalDevice& phys_dev, uint32_t queue_family_idx,
+                const std::vector<Vertex>& vertices, vk::Extent2D extent,
+                float time_step)
+        : phys_dev(phys_dev),
+          vertex_count(static_cast<uint32_t>(vertices.size())),
+          extent(extent),
+          time_step(time_step) {
+        float queue_priority = 1.0f;
+        vk::DeviceQueueCreateInfo queue_info({}, queue_family_idx, 1,
+                                             &queue_priority);
+        device = phys_dev.createDevice(vk::DeviceCreateInfo({}, queue_info),
+                                       hostCallbacks());
+        queue = device.getQueue(queue_family_idx, 0);
+
+        cmd_pool = device.createCommandPool(
+            vk::CommandPoolCreateInfo(
+                vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+                queue_family_idx),
+            hostCallbacks());
+        cmd_buffers.emplace(device, vk::CommandBufferAllocateInfo(
+                                        *cmd_pool,
+                                        vk::CommandBufferLevel::ePrimary,
+                                        FRAMES_IN_FLIGHT));
+
+        auto size = sizeof(Vertex) * vertices.size();
+        vertex_buffer.emplace(phys_dev, device, size,
+                              vk::BufferUsageFlagBits::eVertexBuffer,
+                              vk::MemoryPropertyFlagBits::eHostVisible |
+                                  vk::MemoryPropertyFlagBits::eHostCoherent);
+        std::memcpy(vertex_buffer->mapped, vertices.data(), size);
+
+        createRenderPass();
+        createPipeline();
+        createSlots();
+    }
+
+    BatchDevice(const BatchDevice&) = delete;
+    BatchDevice& operator=(const BatchDevice&) = delete;
+
+    std::string name() const {
+        return static_cast<const char*>(phys_dev.getProperties().deviceName);
+    }
+
+    /// @brief Renders frames from `scheduler` until it has none left for
+    /// this device, `device_idx` identifies the device to it
+    void run(FrameScheduler& scheduler, uint32_t device_idx) {
+        std::array<std::optional<uint32_t>, FRAMES_IN_FLIGHT> in_flight{};
+        auto last_done = std::chrono::steady_clock::now();
+
+        uint32_t slot = 0;
+        while (true) {
+            if (in_flight[slot].has_value()) {
+                auto pixels = collect(slot);
+                auto done = std::chrono::steady_clock::now();
+                // Completions are apart by the frame time once the
+                // device is busy, submissions may have waited in the queue
+                auto since = std::max(last_done, slots[slot].submitted);
+                double ms =
+                    std::chrono::duration<double, std::milli>(done - since)
+                        .count();
+                last_done = done;
+                scheduler.complete(device_idx, in_flight[slot].value(), ms,
+                                   std::move(pixels));
+                in_flight[slot].reset();
+            }
+
+            bool idle = std::none_of(
+                in_flight.begin(), in_flight.end(),
+                [](const std::optional<uint32_t>& f) { return f.has_value(); });
+            auto frame = scheduler.next(device_idx, idle);
+            if (frame.has_value()) {
+                submit(slot, frame.value());
+                in_flight[slot] = frame;
+            } else if (idle) {
+                break;
+            }
+            slot = (slot + 1) % FRAMES_IN_FLIGHT;
+        }
+
+        scheduler.stop(device_idx);
+    }
+
+   private:
+    /// @brief Target, readback and uniforms of one frame in flight
+    struct Slot {
+        std::optional<AllocatedImage> image;
+        std::optional<vk::raii::ImageView> view;
+        vk::raii::Framebuffer framebuffer{nullptr};
+        std::optional<AllocatedBuffer> readback;
+        std::optional<AllocatedBuffer> uniforms;
+        vk::raii::DescriptorSet set{nullptr};
+        vk::raii::Fence fence{nullptr};
+        std::chrono::steady_clock::time_point submitted;
+    };
+
+    vk::raii::PhysicalDevice& phys_dev;
+    uint32_t vertex_count;
+    vk::Extent2D extent;
+    float time_step;
+
+    vk::raii::Device device{nullptr};
+    vk::raii::Queue queue{nullptr};
+    vk::raii::CommandPool cmd_pool{nullptr};
+    std::optional<vk::raii::CommandBuffers> cmd_buffers;
+    std::optional<AllocatedBuffer> vertex_buffer;
+    vk::raii::RenderPass render_pass{nullptr};
+    vk::raii::DescriptorSetLayout set_layout{nullptr};
+    vk::raii::PipelineLayout layout{nullptr};
+    vk::raii::Pipeline pipeline{nullptr};
+    vk::raii::DescriptorPool descriptor_pool{nullptr};
+    std::array<Slot, FRAMES_IN_FLIGHT> slots;
+
+    vk::DeviceSize imageBytes() const {
+        return static_cast<vk::DeviceSize>(extent.width) * extent.height * 4;
+    }
+
+    void createRenderPass() {
+        vk::AttachmentDescription attach_desc{};
+        attach_desc.setFormat(FORMAT);
+        attach_desc.setLoadOp(vk::AttachmentLoadOp::eClear);
+        attach_desc.setStencilLoadOp(vk::AttachmentLoadOp::eDontCare);
+        attach_desc.setStencilStoreOp(vk::AttachmentStoreOp::eDontCare);
+        attach_desc.setFinalLayout(vk::ImageLayout::eTransferSrcOptimal);
+
+        vk::AttachmentReference attach_ref(
+            0, vk::ImageLayout::eColorAttachmentOptimal);
+
+        vk::SubpassDescription sp_desc{};
+        sp_desc.setColorAttachments(attach_ref);
+
+        // The image is copied to the readback buffer right after the pass
+        vk::SubpassDependency dependency(
+            0, VK_SUBPASS_EXTERNAL,
+            vk::PipelineStageFlagBits::eColorAttachmentOutput,
+            vk::PipelineStageFlagBits::eTransfer,
+            vk::AccessFlagBits::eColorAttachmentWrite,
+            vk::AccessFlagBits::eTransferRead);
+
+        vk::RenderPassCreateInfo rp_info{};
+        rp_info.setAttachments(attach_desc);
+        rp_info.setSubpasses(sp_desc);
+        rp_info.setDependencies(dependency);
+
+        render_pass = device.createRenderPass(rp_info, hostCallbacks());
+    }
+
+    void createPipeline() {
+        vk::DescriptorSetLayoutBinding frame_binding(
+            0, vk::DescriptorType::eUniformBuffer, 1,
+            vk::ShaderStageFlagBits::eVertex |
+                vk::ShaderStageFlagBits::eFragment);
+        set_layout = device.createDescriptorSetLayout(
+            vk::DescriptorSetLayoutCreateInfo({}, frame_binding),
+            hostCallbacks());
+        layout = device.createPipelineLayout(
+            vk::PipelineLayoutCreateInfo({}, *set_layout), hostCallbacks());
+
+        auto desc = GraphicsPipelineDesc::forVertex(*layout, *render_pass);
+        GraphicsPipelineState state(device, desc);
+        pipeline = device.createGraphicsPipeline(nullptr, state.createInfo(),
+                                                 hostCallbacks());
+    }
+
+    void createSlots() {
+        vk::DescriptorPoolSize pool_size(vk::DescriptorType::eUniformBuffer,
+                                         FRAMES_IN_FLIGHT);
+        descriptor_pool = device.createDescriptorPool(
+            vk::DescriptorPoolCreateInfo(
+                vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
+                FRAMES_IN_FLIGHT, pool_size),
+            hostCallbacks());
+
+        auto host = vk::MemoryPropertyFlagBits::eHostVisible |
+                    vk::MemoryPropertyFlagBits::eHostCoherent;
+        for (auto& slot : slots) {
+            slot.image.emplace(phys_dev, device,
+                               AllocatedImage::info2D(
+                                   FORMAT, extent,
+                                   vk::ImageUsageFlagBits::eColorAttachment |
+                                       vk::ImageUsageFlagBits::eTransferSrc));
+            slot.view =
+                slot.image->createView(device, vk::ImageAspectFlagBits::eColor);
+
+            vk::ImageView attachment = *slot.view.value();
+            slot.framebuffer = device.createFramebuffer(
+                vk::FramebufferCreateInfo({}, *render_pass, attachment,
+                                          extent.width, extent.height, 1),
+                hostCallbacks());
+
+            slot.readback.emplace(phys_dev, device, imageBytes(),
+                                  vk::BufferUsageFlagBits::eTransferDst, host);
+            slot.uniforms.emplace(phys_dev, device, sizeof(FrameUniforms),
+                                  vk::BufferUsageFlagBits::eUniformBuffer,
+                                  host);
+
+            vk::raii::DescriptorSets sets(
+                device, vk::DescriptorSetAllocateInfo(*descriptor_pool,
+                                                      *set_layout));
+            slot.set = std::move(sets.front());
+
+            vk::DescriptorBufferInfo buffer_info(*slot.uniforms->buffer, 0,
+                                                 sizeof(FrameUniforms));
+            vk::WriteDescriptorSet write(*slot.set, 0, 0, 1,
+                                         vk::DescriptorType::eUniformBuffer,
+                                         nullptr, &buffer_info);
+            device.updateDescriptorSets(write, nullptr);
+
+            slot.fence = device.createFence({}, hostCallbacks());
+        }
+    }
+
+    /// @brief Records and submits `frame` in `slot`, its pixels end up in
+    /// the readback buffer of the slot
+    void submit(uint32_t slot_idx, uint32_t frame) {
+        auto& slot = slots[slot_idx];
+        auto& cmd_buf = cmd_buffers.value()[slot_idx];
+
+        Camera2D camera{};
+        FrameUniforms uniforms{
+            {static_cast<float>(extent.width),
+             static_cast<float>(extent.height)},
+            static_cast<float>(frame) * time_step,
+            frame,
+            camera.center,
+            camera.zoom};
+        std::memcpy(slot.uniforms->mapped, &uniforms, sizeof(uniforms));
+
+        vk::Rect2D rect({0, 0}, extent);
+        vk::ClearColorValue clear_color({0.0f, 0.0f, 0.0f, 1.0f});
+        vk::ClearValue clear_value(clear_color);
+        vk::Viewport viewport(0, 0, extent.width, extent.height, 0, 1);
+
+        cmd_buf.reset();
+        cmd_buf.begin(vk::CommandBufferBeginInfo(
+            vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+        cmd_buf.beginRenderPass(
+            vk::RenderPassBeginInfo(*render_pass, *slot.framebuffer, rect,
+                                    clear_value),
+            vk::SubpassContents::eInline);
+        cmd_buf.bindPipeline(vk::PipelineBindPoint::eGraphics, *pipeline);
+        cmd_buf.setViewport(0, viewport);
+        cmd_buf.setScissor(0, rect);
+        cmd_buf.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, *layout,
+                                   0, *slot.set, nullptr);
+        cmd_buf.bindVertexBuffers(0, *vertex_buffer->buffer, {0});
+        cmd_buf.draw(vertex_count, 1, 0, 0);
+        cmd_buf.endRenderPass();
+
+        vk::BufferImageCopy region(
+            0, 0, 0,
+            vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0,
+                                       1),
+            {0, 0, 0}, {extent.width, extent.height, 1});
+        cmd_buf.copyImageToBuffer(*slot.image->image,
+                                  vk::ImageLayout::eTransferSrcOptimal,
+                                  *slot.readback->buffer, region);
+
+        vk::BufferMemoryBarrier to_host(
+            vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead,
+            VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+            *slot.readback->buffer, 0, VK_WHOLE_SIZE);
+        cmd_buf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                vk::PipelineStageFlagBits::eHost, {}, nullptr,
+                                to_host, nullptr);
+        cmd_buf.end();
+
+        vk::SubmitInfo submit_info{};
+        submit_info.setCommandBuffers(*cmd_buf);
+        queue.submit(submit_info, *slot.fence);
+        slot.submitted = std::chrono::steady_clock::now();
+        StatsRegistry::global().add(Counter::QueueSubmits);
+    }
+
+    /// @brief Waits for the frame in `slot` and copies out its pixels
+    std::vector<uint8_t> collect(uint32_t slot_idx) {
+        auto& slot = slots[slot_idx];
+        if (device.waitForFences(*slot.fence, true, UINT64_MAX) !=
+            vk::Result::eSuccess) {
+            throw std::runtime_error("failed to wait for batch frame");
+        }
+        device.resetFences(*slot.fence);
+
+        auto bytes = static_cast<const uint8_t*>(slot.readback->mapped);
+        return std::vector<uint8_t>(bytes, bytes + imageBytes());
+    }
+};
+
+/// @brief Renders `frame_count` frames of the scene without a window, spread
+/// over every physical device with a graphics queue. With a single physical
+/// device, `devices_per_gpu` logical devices are created on it instead, which
+/// lets software rasterizers such as lavapipe render frames in parallel.
+///
+/// Frames are written in order as binary PPM files named after `prefix`,
+/// nothing is written when the prefix is empty.
+class BatchRenderer {
+   public:
+    static constexpr vk::Extent2D EXTENT{800, 600};
+
+    BatchRenderer(uint32_t frame_count, uint32_t devices_per_gpu,
+                  std::string prefix)
+        : frame_count(frame_count),
+          devices_per_gpu(devices_per_gpu),
+          prefix(std::move(prefix)) {
+        vk::ApplicationInfo app_info{"App", 1, "Engine", 1, vk::ApiVersion13};
+        instance = context.createInstance(
+            vk::InstanceCreateInfo({}, &app_info), hostCallbacks());
+    }
+
+    BatchRenderer(const BatchRenderer&) = delete;
+    BatchRenderer& operator=(const BatchRenderer&) = delete;
+
+    void run(const std::vector<Vertex>& vertices, float time_step) {
+        std::vector<uint32_t> queue_families{};
+        for (auto& phys_dev : instance.enumeratePhysicalDevices()) {
+            auto family = graphicsFamily(phys_dev);
+            if (family.has_value()) {
+                physical_devices.push_back(phys_dev);
+                queue_families.push_back(family.value());
+            }
+        }
+        if (physical_devices.empty()) {
+            throw std::runtime_error("batch: no device with a graphics queue");
+        }
+
+        uint32_t per_device = physical_devices.size() == 1 ? devices_per_gpu
+                                                           : 1;
+        for (size_t i = 0; i < physical_devices.size(); i++) {
+            for (uint32_t j = 0; j < per_device; j++) {
+                devices.push_back(std::make_unique<BatchDevice>(
+                    physical_devices[i], queue_families[i], vertices, EXTENT,
+                    time_step));
+            }
+        }
+
+        auto device_count = static_cast<uint32_t>(devices.size());
+        FrameScheduler scheduler(
+            frame_count, device_count,
+            2 * BatchDevice::FRAMES_IN_FLIGHT * device_count);
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers{};
+        for (uint32_t i = 0; i < device_count; i++) {
+            workers.emplace_back([&, i] {
+                try {
+                    devices[i]->run(scheduler, i);
+                } catch (...) {
+                    scheduler.fail(std::current_exception());
+                }
+            });
+        }
+
+        try {
+            scheduler.drain([&](uint32_t frame,
+                                const std::vector<uint8_t>& pixels) {
+                if (!prefix.empty()) {
+                    writeFrame(frame, pixels);
+                }
+            });
+        } catch (...) {
+            scheduler.fail(std::current_exception());
+            for (auto& worker : workers) {
+                worker.join();
+            }
+            throw;
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        double total_ms = millisecondsSince(start);
+        std::cout << "batch: " << frame_count << " frames in " << total_ms
+                  << " ms (" << frame_count * 1000.0 / total_ms << " fps)"
+                  << std::endl;
+        for (uint32_t i = 0; i < device_count; i++) {
+            std::cout << "batch: device " << i << " (" << devices[i]->name()
+                      << "): " << scheduler.framesDone(i) << " frames, "
+                      << scheduler.frameTime(i) << " ms per frame"
+                      << std::endl;
+        }
+    }
+
+   private:
+    vk::raii::Context context{};
+    vk::raii::Instance instance{nullptr};
+    uint32_t frame_count;
+    uint32_t devices_per_gpu;
+    std::string prefix;
+
+    // Referred to by the devices, declared first to outlive them
+    std::vector<vk::raii::PhysicalDevice> physical_devices;
+    std::vector<std::unique_ptr<BatchDevice>> devices;
+
+    static std::optional<uint32_t> graphicsFamily(
+        vk::raii::PhysicalDevice& phys_dev) {
+        auto families = phys_dev.getQueueFamilyProperties();
+        for (uint32_t i = 0; i < families.size(); i++) {
+            if (families[i].queueFlags & vk::QueueFlagBits::eGraphics) {
+                return i;
+            }
+        }
+        return std::nullopt;
+    }
+
+    void writeFrame(uint32_t frame, const std::vector<uint8_t>& pixels) {
+        std::ostringstream path;
+        path << prefix << "_" << std::setw(5) << std::setfill('0') << frame
+             << ".ppm";
+
+        std::ofstream file(path.str(), std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::runtime_error("batch: failed to write " + path.str());
+        }
+        file << "P6\n" << EXTENT.width << " " << EXTENT.height << "\n255\n";
+
+        std::vector<char> row(EXTENT.width * 3);
+        for (uint32_t y = 0; y < EXTENT.height; y++) {
+            auto src = pixels.data() + y * EXTENT.width * 4;
+            for (uint32_t x = 0; x < EXTENT.width; x++) {
+                row[x * 3 + 0] = static_cast<char>(src[x * 4 + 0]);
+                row[x * 3 + 1] = static_cast<char>(src[x * 4 + 1]);
+                row[x * 3 + 2] = static_cast<char>(src[x * 4 + 2]);
+            }
+            file.write(row.data(), row.size());
+        }
+    }
+};
@@ -0,0 +1,736 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define BVH_SSE 1
+#else
+#define BVH_SSE 0
+#endif
+
+/// @brief Axis-aligned box, empty when default constructed
+struct Aabb {
+    glm::vec3 min{std::numeric_limits<float>::infinity()};
+    glm::vec3 max{-std::numeric_limits<float>::infinity()};
+
+    void extend(const Aabb& other) {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    void extend(glm::vec3 point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+
+    float surfaceArea() const {
+        auto d = glm::max(max - min, glm::vec3(0.0f));
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    bool overlaps(const Aabb& other) const {
+        return glm::all(glm::lessThanEqual(min, other.max)) &&
+               glm::all(glm::greaterThanEqual(max, other.min));
+    }
+
+    /// @brief Squared distance from `point` to the box, 0 inside
+    float distance2(glm::vec3 point) const {
+        auto d = glm::max(glm::max(min - point, point - max), glm::vec3(0.0f));
+        return glm::dot(d, d);
+    }
+};
+
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction;
+};
+
+struct RayHit {
+    uint32_t object;
+    float t;
+};
+
+/// @brief Convex volume bounded by planes, a point p is inside when
+/// dot(plane.xyz, p) + plane.w >= 0 for every plane
+struct Frustum {
+    std::array<glm::vec4, 6> planes;
+
+    /// @brief Orthographic view volume, which is a box
+    static Frustum fromBox(const Aabb& box) {
+        return {{glm::vec4(1, 0, 0, -box.min.x), glm::vec4(-1, 0, 0, box.max.x),
+                 glm::vec4(0, 1, 0, -box.min.y), glm::vec4(0, -1, 0, box.max.y),
+                 glm::vec4(0, 0, 1, -box.min.z),
+                 glm::vec4(0, 0, -1, box.max.z)}};
+    }
+};
+
+/// @brief Bounding volume hierarchy with four children per node.
+///
+/// Built as a binary tree with binned SAH splits, then collapsed so that each
+/// node tests all of its children at once with 4-wide SIMD. `refit` updates
+/// bounds of moved objects in place and keeps the topology, so the tree
+/// degrades as objects travel far from where it was built; rebuild then.
+class Bvh {
+   public:
+    static constexpr uint32_t WIDTH = 4;
+
+    void build(const std::vector<Aabb>& bounds) {
+        prim_bounds = bounds;
+        prim_indices.resize(bounds.size());
+        for (uint32_t i = 0; i < bounds.size(); i++) {
+            prim_indices[i] = i;
+        }
+
+        nodes.clear();
+        if (bounds.empty()) {
+            return;
+        }
+
+        std::vector<BuildNode> build_nodes{};
+        build_nodes.reserve(bounds.size() * 2);
+        buildBinary(build_nodes, 0, static_cast<uint32_t>(bounds.size()));
+
+        nodes.reserve(build_nodes.size() / 2 + 1);
+        collapse(build_nodes, 0);
+    }
+
+    /// @brief Updates bounds after objects moved, `bounds` must hold as many
+    /// objects as the tree was built with
+    void refit(const std::vector<Aabb>& bounds) {
+        prim_bounds = bounds;
+
+        // Children always come after their parent
+        for (size_t n = nodes.size(); n-- > 0;) {
+            auto& node = nodes[n];
+            for (uint32_t slot = 0; slot < WIDTH; slot++) {
+                if (!(node.slot_mask & (1u << slot))) {
+                    continue;
+                }
+
+                Aabb box{};
+                if (node.count[slot] > 0) {
+                    for (uint32_t i = 0; i < node.count[slot]; i++) {
+                        box.extend(
+                            prim_bounds[prim_indices[node.child[slot] + i]]);
+                    }
+                } else {
+                    box = nodeBounds(nodes[node.child[slot]]);
+                }
+                setSlotBounds(node, slot, box);
+            }
+        }
+    }
+
+    /// @brief Appends objects whose bounds intersect `frustum`
+    void queryFrustum(const Frustum& frustum,
+                      std::vector<uint32_t>& result) const {
+        traverse([&](const Node& node) { return frustumMask(node, frustum); },
+                 [&](uint32_t object) {
+                     if (insideFrustum(prim_bounds[object], frustum)) {
+                         result.push_back(object);
+                     }
+                 });
+    }
+
+    /// @brief Appends objects whose bounds overlap `box`
+    void queryBox(const Aabb& box, std::vector<uint32_t>& result) const {
+        traverse([&](const Node& node) { return overlapMask(node, box); },
+                 [&](uint32_t object) {
+                     if (prim_bounds[object].overlaps(box)) {
+                         result.push_back(object);
+                     }
+                 });
+    }
+
+    /// @brief Appends objects whose bounds come within `radius` of `center`
+    void queryRadius(glm::vec3 center, float radius,
+                     std::vector<uint32_t>& result) const {
+        Aabb box{center - glm::vec3(radius), center + glm::vec3(radius)};
+        traverse([&](const Node& node) { return overlapMask(node, box); },
+                 [&](uint32_t object) {
+                     if (prim_bounds[object].distance2(center) <=
+                         radius * radius) {
+                         result.push_back(object);
+                     }
+                 });
+    }
+
+    /// @brief Nearest object whose bounds the ray enters
+    std::optional<RayHit> raycast(const Ray& ray) const {
+        std::optional<RayHit> hit{};
+        auto inv_dir = 1.0f / ray.direction;
+        float best_t = std::numeric_limits<float>::infinity();
+
+        traverse(
+            [&](const Node& node) {
+                return rayMask(node, ray.origin, inv_dir, best_t);
+            },
+            [&](uint32_t object) {
+                auto t = rayBox(prim_bounds[object], ray.origin, inv_dir);
+                if (t.has_value() && t.value() < best_t) {
+                    best_t = t.value();
+                    hit = RayHit{object, best_t};
+                }
+            });
+
+        return hit;
+    }
+
+    size_t size() const { return prim_bounds.size(); }
+    size_t nodeCount() const { return nodes.size(); }
+
+   private:
+    static constexpr uint32_t BIN_COUNT = 16;
+    static constexpr uint32_t MAX_LEAF_SIZE = 4;
+
+    /// @brief Children bounds in SoA form for SIMD tests. A slot with
+    /// count > 0 is a leaf of `count` objects starting at `child` in
+    /// prim_indices, otherwise `child` is a node index.
+    struct alignas(16) Node {
+        float min_x[WIDTH];
+        float min_y[WIDTH];
+        float min_z[WIDTH];
+        float max_x[WIDTH];
+        float max_y[WIDTH];
+        float max_z[WIDTH];
+        uint32_t child[WIDTH];
+        uint32_t count[WIDTH];
+        uint32_t slot_mask;
+    };
+
+    struct BuildNode {
+        Aabb bounds;
+        uint32_t left = 0;
+        uint32_t right = 0;
+        uint32_t first = 0;
+        uint32_t count = 0;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> prim_indices;
+    std::vector<Aabb> prim_bounds;
+
+    uint32_t buildBinary(std::vector<BuildNode>& build_nodes, uint32_t first,
+                         uint32_t count) {
+        uint32_t idx = static_cast<uint32_t>(build_nodes.size());
+        build_nodes.emplace_back();
+
+        Aabb bounds{}, centroids{};
+        for (uint32_t i = first; i < first + count; i++) {
+            bounds.extend(prim_bounds[prim_indices[i]]);
+            centroids.extend(prim_bounds[prim_indices[i]].center());
+        }
+        build_nodes[idx].bounds = bounds;
+
+        uint32_t split = 0;
+        if (count > 1) {
+            split = findSplit(first, count, bounds, centroids);
+        }
+
+        if (split == 0) {
+            build_nodes[idx].first = first;
+            build_nodes[idx].count = count;
+            return idx;
+        }
+
+        uint32_t left = buildBinary(build_nodes, first, split);
+        uint32_t right = buildBinary(build_nodes, first + split, count - split);
+        build_nodes[idx].left = left;
+        build_nodes[idx].right = right;
+        return idx;
+    }
+
+    /// @brief Partitions the range along the cheapest binned SAH split
+    /// @return Objects on the left side, 0 to keep the range as a leaf
+    uint32_t findSplit(uint32_t first, uint32_t count, const Aabb& bounds,
+                       const Aabb& centroids) {
+        auto extent = centroids.max - centroids.min;
+
+        float best_cost = std::numeric_limits<float>::infinity();
+        int best_axis = -1;
+        uint32_t best_bin = 0;
+
+        for (int axis = 0; axis < 3; axis++) {
+            if (extent[axis] <= 0.0f) {
+                continue;
+            }
+
+            std::array<Aabb, BIN_COUNT> bins{};
+            std::array<uint32_t, BIN_COUNT> bin_counts{};
+            for (uint32_t i = first; i < first + count; i++) {
+                auto& box = prim_bounds[prim_indices[i]];
+                auto bin = binOf(box.center()[axis], centroids.min[axis],
+                                 extent[axis]);
+                bins[bin].extend(box);
+                bin_counts[bin]++;
+            }
+
+            // Sweep from the right, then evaluate every plane from the left
+            std::array<float, BIN_COUNT> right_area{};
+            std::array<uint32_t, BIN_COUNT> right_count{};
+            Aabb right{};
+            uint32_t right_n = 0;
+            for (uint32_t b = BIN_COUNT - 1; b > 0; b--) {
+                right.extend(bins[b]);
+                right_n += bin_counts[b];
+                right_area[b] = right.surfaceArea();
+                right_count[b] = right_n;
+            }
+
+            Aabb left{};
+            uint32_t left_n = 0;
+            for (uint32_t b = 1; b < BIN_COUNT; b++) {
+                left.extend(bins[b - 1]);
+                left_n += bin_counts[b - 1];
+                if (left_n == 0 || right_count[b] == 0) {
+                    continue;
+                }
+
+                float cost = left.surfaceArea() * left_n +
+                             right_area[b] * right_count[b];
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_bin = b;
+                }
+            }
+        }
+
+        float leaf_cost = bounds.surfaceArea() * count;
+        if (best_axis < 0 || (count <= MAX_LEAF_SIZE && leaf_cost <= best_cost)) {
+            if (count <= MAX_LEAF_SIZE) {
+                return 0;
+            }
+            // Objects share a centroid, no plane separates them
+            return count / 2;
+        }
+
+        auto begin = prim_indices.begin() + first;
+        auto middle = std::partition(begin, begin + count, [&](uint32_t prim) {
+            return binOf(prim_bounds[prim].center()[best_axis],
+                         centroids.min[best_axis],
+                         extent[best_axis]) < best_bin;
+        });
+        return static_cast<uint32_t>(middle - begin);
+    }
+
+    static uint32_t binOf(float value, float min, float extent) {
+        auto bin = static_cast<uint32_t>((value - min) / extent * BIN_COUNT);
+        return std::min(bin, BIN_COUNT - 1);
+    }
+
+    /// @brief Turns binary node `idx` into a 4-wide node, opening the largest
+    /// inner children until four slots are filled
+    uint32_t collapse(const std::vector<BuildNode>& build_nodes, uint32_t idx) {
+        std::vector<uint32_t> slots{};
+        if (build_nodes[idx].count > 0) {
+            slots.push_back(idx);
+        } else {
+            slots = {build_nodes[idx].left, build_nodes[idx].right};
+        }
+
+        while (slots.size() < WIDTH) {
+            int largest = -1;
+            for (size_t i = 0; i < slots.size(); i++) {
+                auto& candidate = build_nodes[slots[i]];
+                if (candidate.count == 0 &&
+                    (largest < 0 ||
+                     candidate.bounds.surfaceArea() >
+                         build_nodes[slots[largest]].bounds.surfaceArea())) {
+                    largest = static_cast<int>(i);
+                }
+            }
+            if (largest < 0) {
+                break;
+            }
+
+            auto opened = build_nodes[slots[largest]];
+            slots[largest] = opened.left;
+            slots.push_back(opened.right);
+        }
+
+        uint32_t node_idx = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(emptyNode());
+
+        for (uint32_t slot = 0; slot < slots.size(); slot++) {
+            auto& build_node = build_nodes[slots[slot]];
+
+            uint32_t child = build_node.first;
+            if (build_node.count == 0) {
+                child = collapse(build_nodes, slots[slot]);
+            }
+
+            // `nodes` may have grown, index again
+            auto& node = nodes[node_idx];
+            node.child[slot] = child;
+            node.count[slot] = build_node.count;
+            node.slot_mask |= 1u << slot;
+            setSlotBounds(node, slot, build_node.bounds);
+        }
+
+        return node_idx;
+    }
+
+    static Node emptyNode() {
+        Node node{};
+        for (uint32_t slot = 0; slot < WIDTH; slot++) {
+            setSlotBounds(node, slot, Aabb{});
+        }
+        return node;
+    }
+
+    static void setSlotBounds(Node& node, uint32_t slot, const Aabb& box) {
+        node.min_x[slot] = box.min.x;
+        node.min_y[slot] = box.min.y;
+        node.min_z[slot] = box.min.z;
+        node.max_x[slot] = box.max.x;
+        node.max_y[slot] = box.max.y;
+        node.max_z[slot] = box.max.z;
+    }
+
+    static Aabb nodeBounds(const Node& node) {
+        Aabb box{};
+        for (uint32_t slot = 0; slot < WIDTH; slot++) {
+            if (node.slot_mask & (1u << slot)) {
+                box.extend(Aabb{{node.min_x[slot], node.min_y[slot],
+                                 node.min_z[slot]},
+                                {node.max_x[slot], node.max_y[slot],
+                                 node.max_z[slot]}});
+            }
+        }
+        return box;
+    }
+
+    /// @brief Depth-first walk descending into the slots `test` returns as
+    /// a bit mask, `visit` is called for every object of a reached leaf
+    template <typename Test, typename Visit>
+    void traverse(Test&& test, Visit&& visit) const {
+        if (nodes.empty()) {
+            return;
+        }
+
+        std::vector<uint32_t> stack{};
+        stack.reserve(64);
+        stack.push_back(0);
+
+        while (!stack.empty()) {
+            auto& node = nodes[stack.back()];
+            stack.pop_back();
+            uint32_t mask = test(node) & node.slot_mask;
+
+            for (uint32_t slot = 0; slot < WIDTH; slot++) {
+                if (!(mask & (1u << slot))) {
+                    continue;
+                }
+
+                if (node.count[slot] > 0) {
+                    for (uint32_t i = 0; i < node.count[slot]; i++) {
+                        visit(prim_indices[node.child[slot] + i]);
+                    }
+                } else {
+                    stack.push_back(node.child[slot]);
+                }
+            }
+        }
+    }
+
+#if BVH_SSE
+    static uint32_t overlapMask(const Node& node, const Aabb& box) {
+        __m128 hit = _mm_and_ps(
+            _mm_cmple_ps(_mm_load_ps(node.min_x), _mm_set1_ps(box.max.x)),
+            _mm_cmpge_ps(_mm_load_ps(node.max_x), _mm_set1_ps(box.min.x)));
+        hit = _mm_and_ps(
+            hit, _mm_cmple_ps(_mm_load_ps(node.min_y), _mm_set1_ps(box.max.y)));
+        hit = _mm_and_ps(
+            hit, _mm_cmpge_ps(_mm_load_ps(node.max_y), _mm_set1_ps(box.min.y)));
+        hit = _mm_and_ps(
+            hit, _mm_cmple_ps(_mm_load_ps(node.min_z), _mm_set1_ps(box.max.z)));
+        hit = _mm_and_ps(
+            hit, _mm_cmpge_ps(_mm_load_ps(node.max_z), _mm_set1_ps(box.min.z)));
+        return static_cast<uint32_t>(_mm_movemask_ps(hit));
+    }
+
+    static uint32_t frustumMask(const Node& node, const Frustum& frustum) {
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (auto& plane : frustum.planes) {
+            // Corner farthest along the plane normal
+            __m128 px = _mm_load_ps(plane.x >= 0 ? node.max_x : node.min_x);
+            __m128 py = _mm_load_ps(plane.y >= 0 ? node.max_y : node.min_y);
+            __m128 pz = _mm_load_ps(plane.z >= 0 ? node.max_z : node.min_z);
+
+            __m128 dist = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(plane.x)),
+                           _mm_mul_ps(py, _mm_set1_ps(plane.y))),
+                _mm_add_ps(_mm_mul_ps(pz, _mm_set1_ps(plane.z)),
+                           _mm_set1_ps(plane.w)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, _mm_setzero_ps()));
+        }
+        return static_cast<uint32_t>(_mm_movemask_ps(inside));
+    }
+
+    static uint32_t rayMask(const Node& node, glm::vec3 origin,
+                            glm::vec3 inv_dir, float max_t) {
+        __m128 t_near = _mm_setzero_ps();
+        __m128 t_far = _mm_set1_ps(max_t);
+
+        const float* mins[3] = {node.min_x, node.min_y, node.min_z};
+        const float* maxs[3] = {node.max_x, node.max_y, node.max_z};
+        for (int axis = 0; axis < 3; axis++) {
+            __m128 o = _mm_set1_ps(origin[axis]);
+            __m128 inv = _mm_set1_ps(inv_dir[axis]);
+            __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(mins[axis]), o), inv);
+            __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(maxs[axis]), o), inv);
+            t_near = _mm_max_ps(t_near, _mm_min_ps(t0, t1));
+            t_far = _mm_min_ps(t_far, _mm_max_ps(t0, t1));
+        }
+        return static_cast<uint32_t>(
+            _mm_movemask_ps(_mm_cmple_ps(t_near, t_far)));
+    }
+#else
+    static uint32_t overlapMask(const Node& node, const Aabb& box) {
+        uint32_t mask = 0;
+        for (uint32_t slot = 0; slot < WIDTH; slot++) {
+            if (slotBounds(node, slot).overlaps(box)) {
+                mask |= 1u << slot;
+            }
+        }
+        return mask;
+    }
+
+    static uint32_t frustumMask(const Node& node, const Frustum& frustum) {
+        uint32_t mask = 0;
+        for (uint32_t slot = 0; slot < WIDTH; slot++) {
+            if (insideFrustum(slotBounds(node, slot), frustum)) {
+                mask |= 1u << slot;
+            }
+        }
+        return mask;
+    }
+
+    static uint32_t rayMask(const Node& node, glm::vec3 origin,
+                            glm::vec3 inv_dir, float max_t) {
+        uint32_t mask = 0;
+        for (uint32_t slot = 0; slot < WIDTH; slot++) {
+            auto t = rayBox(slotBounds(node, slot), origin, inv_dir);
+            if (t.has_value() && t.value() <= max_t) {
+                mask |= 1u << slot;
+            }
+        }
+        return mask;
+    }
+
+    static Aabb slotBounds(const Node& node, uint32_t slot) {
+        return {{node.min_x[slot], node.min_y[slot], node.min_z[slot]},
+                {node.max_x[slot], node.max_y[slot], node.max_z[slot]}};
+    }
+#endif
+
+    static bool insideFrustum(const Aabb& box, const Frustum& frustum) {
+        for (auto& plane : frustum.planes) {
+            glm::vec3 corner(plane.x >= 0 ? box.max.x : box.min.x,
+                             plane.y >= 0 ? box.max.y : box.min.y,
+                             plane.z >= 0 ? box.max.z : box.min.z);
+            if (glm::dot(glm::vec3(plane), corner) + plane.w < 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static std::optional<float> rayBox(const Aabb& box, glm::vec3 origin,
+                                       glm::vec3 inv_dir) {
+        auto t0 = (box.min - origin) * inv_dir;
+        auto t1 = (box.max - origin) * inv_dir;
+        auto t_near = glm::min(t0, t1);
+        auto t_far = glm::max(t0, t1);
+
+        float enter = std::max({t_near.x, t_near.y, t_near.z, 0.0f});
+        float exit = std::min({t_far.x, t_far.y, t_far.z});
+        if (enter > exit) {
+            return std::nullopt;
+        }
+        return enter;
+    }
+};
+
+/// @brief Two BVH copies so that queries never wait for a refit.
+///
+/// One writer thread builds or refits the back copy and publishes it with an
+/// atomic swap, any number of threads query the front copy through a
+/// `Snapshot`. The writer waits for readers that still hold the back copy
+/// from before the previous swap.
+class SpatialIndex {
+   public:
+    /// @brief Pins the front copy for queries until destroyed
+    class Snapshot {
+       public:
+        explicit Snapshot(const SpatialIndex& index) : index(index) {
+            // Sequentially consistent so the writer can't miss a reader that
+            // registered just before a swap
+            while (true) {
+                slot = index.front.load();
+                index.slots[slot].readers.fetch_add(1);
+                if (index.front.load() == slot) {
+                    break;
+                }
+                index.slots[slot].readers.fetch_sub(1);
+            }
+        }
+
+        ~Snapshot() { index.slots[slot].readers.fetch_sub(1); }
+
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+
+        const Bvh& operator*() const { return index.slots[slot].tree; }
+        const Bvh* operator->() const { return &index.slots[slot].tree; }
+
+       private:
+        const SpatialIndex& index;
+        uint32_t slot = 0;
+    };
+
+    /// @brief Rebuilds the tree, writer thread only
+    void build(const std::vector<Aabb>& bounds) {
+        auto& back = acquireBack();
+        back.tree.build(bounds);
+        back.version = ++version;
+        publish();
+    }
+
+    /// @brief Refits the tree to moved objects, writer thread only
+    void refit(const std::vector<Aabb>& bounds) {
+        auto& front_slot = slots[front.load()];
+        auto& back = acquireBack();
+
+        // The back copy lags behind a rebuild, take over the new topology
+        if (back.version != front_slot.version) {
+            back.tree = front_slot.tree;
+            back.version = front_slot.version;
+        }
+
+        back.tree.refit(bounds);
+        publish();
+    }
+
+    Snapshot snapshot() const { return Snapshot(*this); }
+
+   private:
+    struct Slot {
+        Bvh tree;
+        uint64_t version = 0;
+        mutable std::atomic<uint32_t> readers{0};
+    };
+
+    std::array<Slot, 2> slots;
+    std::atomic<uint32_t> front{0};
+    uint64_t version = 0;
+
+    Slot& acquireBack() {
+        auto& back = slots[1 - front.load()];
+        while (back.readers.load() != 0) {
+            std::this_thread::yield();
+        }
+        return back;
+    }
+
+    void publish() {
+        front.store(1 - front.load());
+    }
+};
+
+/// @brief Writer thread of a `SpatialIndex`, started once and kept for as
+/// long as the index.
+///
+/// `refit` hands the next refit over through a condition variable and
+/// returns at once, `wait` blocks until it is published. One refit is
+/// queued or running at a time.
+class SpatialIndexWorker {
+   public:
+    // Computes the bounds to refit to, called on the worker
+    using BoundsSource = std::function<std::vector<Aabb>()>;
+
+    explicit SpatialIndexWorker(SpatialIndex& index)
+        : index(index), thread([this]() { run(); }) {}
+
+    SpatialIndexWorker(const SpatialIndexWorker&) = delete;
+    SpatialIndexWorker& operator=(const SpatialIndexWorker&) = delete;
+
+    /// @brief Finishes the running refit, a queued one is dropped
+    ~SpatialIndexWorker() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        thread.join();
+    }
+
+    /// @brief Queues a refit to the bounds from `source`, once the previous
+    /// one is done
+    void refit(BoundsSource source) {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this]() { return !job; });
+        job = std::move(source);
+        wake.notify_one();
+    }
+
+    /// @brief Blocks until no refit is queued or running, rethrowing what
+    /// the last one threw
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this]() { return !job; });
+        if (error) {
+            std::rethrow_exception(std::exchange(error, nullptr));
+        }
+    }
+
+   private:
+    SpatialIndex& index;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    // Set while a refit is queued or running
+    BoundsSource job;
+    std::exception_ptr error;
+    bool stopping = false;
+    // Started last, once everything it touches is constructed
+    std::thread thread;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this]() { return stopping || job; });
+            if (stopping) {
+                return;
+            }
+
+            // The job is left alone until cleared below
+            lock.unlock();
+            std::exception_ptr failure;
+            try {
+                index.refit(job());
+            } catch (...) {
+                failure = std::current_exception();
+            }
+            lock.lock();
+            error = failure;
+            job = nullptr;
+            done.notify_all();
+        }
+    }
+};
@@ -0,0 +1,194 @@
+#pragma once
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+const std::vector<const char*> MEMORY_BUDGET_DEVICE_EXTENSIONS = {
+    VK_EXT_MEMORY_BUDGET_EXTENSION_NAME};
+const std::vector<const char*> PRESENT_WAIT_DEVICE_EXTENSIONS = {
+    VK_KHR_PRESENT_ID_EXTENSION_NAME, VK_KHR_PRESENT_WAIT_EXTENSION_NAME};
+const std::vector<const char*> INCREMENTAL_PRESENT_DEVICE_EXTENSIONS = {
+    VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME};
+
+/// @brief Optional device features worth having whenever the hardware offers
+/// them, queried through the PhysicalDeviceFeatures2 chain and all enabled
+/// at device creation. Subsystems read the flags to pick their fastest
+/// path, instead of negotiating features of their own.
+///
+/// Core features are enabled through the Vulkan 1.1, 1.2 and 1.3 structs,
+/// which may not be chained along with the structs they subsume, so other
+/// code asking for a core feature reads it from here.
+struct DeviceCapabilities {
+    uint32_t api_version = VK_API_VERSION_1_0;
+
+    // Vulkan 1.1
+    bool shader_draw_parameters = false;
+    // Several views rendered by one draw into layers, by view index
+    bool multiview = false;
+    // Vulkan 1.2: runtime sized, partially bound and non-uniformly indexed
+    // sampled image arrays
+    bool descriptor_indexing = false;
+    bool timeline_semaphore = false;
+    bool buffer_device_address = false;
+    bool draw_indirect_count = false;
+    // Queries reset from the host instead of by a command
+    bool host_query_reset = false;
+    // Vulkan 1.3
+    bool synchronization2 = false;
+    bool dynamic_rendering = false;
+    bool maintenance4 = false;
+    // Pipeline creation reports whether it hit the pipeline cache
+    bool pipeline_creation_feedback = false;
+    // Extensions
+    bool memory_budget = false;
+    bool present_wait = false;
+    // Presents may list the regions that changed since the previous one
+    bool incremental_present = false;
+
+    // Extensions to enable, core features need none
+    std::vector<const char*> extensions;
+
+    vk::PhysicalDeviceVulkan11Features vk11_features{};
+    vk::PhysicalDeviceVulkan12Features vk12_features{};
+    vk::PhysicalDeviceVulkan13Features vk13_features{};
+    vk::PhysicalDevicePresentIdFeaturesKHR present_id_features{};
+    vk::PhysicalDevicePresentWaitFeaturesKHR present_wait_features{};
+
+    static DeviceCapabilities query(
+        vk::raii::PhysicalDevice& device,
+        const std::unordered_set<std::string>& extension_set) {
+        DeviceCapabilities caps{};
+        caps.api_version = device.getProperties().apiVersion;
+
+        // The 1.1 and 1.2 structs exist from Vulkan 1.2 on
+        if (caps.api_version >= VK_API_VERSION_1_2) {
+            auto features = device.getFeatures2<
+                vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan11Features,
+                vk::PhysicalDeviceVulkan12Features>();
+            auto& vk11 = features.get<vk::PhysicalDeviceVulkan11Features>();
+            auto& vk12 = features.get<vk::PhysicalDeviceVulkan12Features>();
+
+            caps.shader_draw_parameters = vk11.shaderDrawParameters;
+            caps.multiview = vk11.multiview;
+            caps.descriptor_indexing =
+                vk12.runtimeDescriptorArray &&
+                vk12.descriptorBindingPartiallyBound &&
+                vk12.shaderSampledImageArrayNonUniformIndexing;
+            caps.timeline_semaphore = vk12.timelineSemaphore;
+            caps.buffer_device_address = vk12.bufferDeviceAddress;
+            caps.draw_indirect_count = vk12.drawIndirectCount;
+            caps.host_query_reset = vk12.hostQueryReset;
+        }
+
+        if (caps.api_version >= VK_API_VERSION_1_3) {
+            auto features =
+                device.getFeatures2<vk::PhysicalDeviceFeatures2,
+                                    vk::PhysicalDeviceVulkan13Features>();
+            auto& vk13 = features.get<vk::PhysicalDeviceVulkan13Features>();
+
+            caps.synchronization2 = vk13.synchronization2;
+            caps.dynamic_rendering = vk13.dynamicRendering;
+            caps.maintenance4 = vk13.maintenance4;
+            caps.pipeline_creation_feedback = true;
+        }
+
+        if (caps.api_version >= VK_API_VERSION_1_1 &&
+            hasExtensions(extension_set, MEMORY_BUDGET_DEVICE_EXTENSIONS)) {
+            caps.memory_budget = true;
+            caps.extensions.insert(caps.extensions.end(),
+                                   MEMORY_BUDGET_DEVICE_EXTENSIONS.begin(),
+                                   MEMORY_BUDGET_DEVICE_EXTENSIONS.end());
+        }
+
+        if (hasExtensions(extension_set, PRESENT_WAIT_DEVICE_EXTENSIONS)) {
+            auto features = device.getFeatures2<
+                vk::PhysicalDeviceFeatures2,
+                vk::PhysicalDevicePresentIdFeaturesKHR,
+                vk::PhysicalDevicePresentWaitFeaturesKHR>();
+            caps.present_wait =
+                features.get<vk::PhysicalDevicePresentIdFeaturesKHR>()
+                    .presentId &&
+                features.get<vk::PhysicalDevicePresentWaitFeaturesKHR>()
+                    .presentWait;
+            if (caps.present_wait) {
+                caps.extensions.insert(caps.extensions.end(),
+                                       PRESENT_WAIT_DEVICE_EXTENSIONS.begin(),
+                                       PRESENT_WAIT_DEVICE_EXTENSIONS.end());
+            }
+        }
+
+        if (hasExtensions(extension_set,
+                          INCREMENTAL_PRESENT_DEVICE_EXTENSIONS)) {
+            caps.incremental_present = true;
+            caps.extensions.insert(
+                caps.extensions.end(),
+                INCREMENTAL_PRESENT_DEVICE_EXTENSIONS.begin(),
+                INCREMENTAL_PRESENT_DEVICE_EXTENSIONS.end());
+        }
+
+        return caps;
+    }
+
+    /// @brief Prepends the feature structs enabling every supported feature
+    /// to a device creation pNext chain
+    void chainFeatures(void*& feature_chain) {
+        if (api_version >= VK_API_VERSION_1_2) {
+            vk11_features.setShaderDrawParameters(shader_draw_parameters);
+            vk11_features.setMultiview(multiview);
+            vk11_features.setPNext(feature_chain);
+
+            vk12_features.setRuntimeDescriptorArray(descriptor_indexing);
+            vk12_features.setDescriptorBindingPartiallyBound(
+                descriptor_indexing);
+            vk12_features.setShaderSampledImageArrayNonUniformIndexing(
+                descriptor_indexing);
+            vk12_features.setTimelineSemaphore(timeline_semaphore);
+            vk12_features.setBufferDeviceAddress(buffer_device_address);
+            vk12_features.setDrawIndirectCount(draw_indirect_count);
+            vk12_features.setHostQueryReset(host_query_reset);
+            vk12_features.setPNext(&vk11_features);
+            feature_chain = &vk12_features;
+        }
+
+        if (api_version >= VK_API_VERSION_1_3) {
+            vk13_features.setSynchronization2(synchronization2);
+            vk13_features.setDynamicRendering(dynamic_rendering);
+            vk13_features.setMaintenance4(maintenance4);
+            vk13_features.setPNext(feature_chain);
+            feature_chain = &vk13_features;
+        }
+
+        if (present_wait) {
+            present_id_features.setPresentId(true);
+            present_id_features.setPNext(feature_chain);
+            present_wait_features.setPresentWait(true);
+            present_wait_features.setPNext(&present_id_features);
+            feature_chain = &present_wait_features;
+        }
+    }
+
+    /// @brief Names of the enabled features, for logs
+    std::string describe() const {
+        std::string out;
+        auto add = [&](bool enabled, const char* name) {
+            if (enabled) {
+                out += out.empty() ? name : std::string(" ") + name;
+            }
+        };
+        add(shader_draw_parameters, "shader-draw-parameters");
+        add(multiview, "multiview");
+        add(descriptor_indexing, "descriptor-indexing");
+        add(timeline_semaphore, "timeline-semaphore");
+        add(buffer_device_address, "buffer-device-address");
+        add(draw_indirect_count, "draw-indirect-count");
+        add(host_query_reset, "host-query-reset");
+        add(synchronization2, "synchronization2");
+        add(dynamic_rendering, "dynamic-rendering");
+        add(maintenance4, "maintenance4");
+        add(pipeline_creation_feedback, "pipeline-creation-feedback");
+        add(memory_budget, "memory-budget");
+        add(present_wait, "present-wait");
+        add(incremental_present, "incremental-present");
+        return out.empty() ? "none" : out;
+    }
+};
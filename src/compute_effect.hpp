@@ -0,0 +1,261 @@
+#pragma once
+#include <array>
+#include <optional>
+
+/// @brief Push constants of effect.wgsl
+struct EffectParams {
+    glm::uvec2 size;
+};
+
+/// @brief The lab effect as a screen-space compute pass.
+///
+/// The scene is drawn with plain vertex colors into a base image through
+/// `basePass`, `apply` then darkens it in effect.wgsl into a storage image
+/// and blits that onto the swapchain image. Both images are shared by all
+/// frames in flight, the passes are ordered by barriers.
+class ComputeEffect {
+   public:
+    static constexpr vk::Format FORMAT = vk::Format::eR8G8B8A8Unorm;
+
+    ComputeEffect(vk::raii::PhysicalDevice& phys_dev, vk::raii::Device& device,
+                  vk::Optional<const vk::raii::PipelineCache> cache,
+                  DescriptorAllocator& descriptor_allocator)
+        : phys_dev(phys_dev), device(device), descriptors(descriptor_allocator) {
+        createBasePass();
+        createLayouts();
+        effect_pipeline = createComputePipeline(
+            device, cache, "shaders/effect.spv", "effect_main", *effect_layout);
+    }
+
+    ComputeEffect(const ComputeEffect&) = delete;
+    ComputeEffect& operator=(const ComputeEffect&) = delete;
+
+    /// @brief Whether the images can be rendered, stored and blitted and the
+    /// swapchain accepts blits
+    static bool supported(vk::raii::PhysicalDevice& phys_dev,
+                          const SurfaceInfo& surface_info) {
+        auto needed = vk::FormatFeatureFlagBits::eColorAttachment |
+                      vk::FormatFeatureFlagBits::eSampledImage |
+                      vk::FormatFeatureFlagBits::eStorageImage |
+                      vk::FormatFeatureFlagBits::eBlitSrc;
+        auto features =
+            phys_dev.getFormatProperties(FORMAT).optimalTilingFeatures;
+        auto target_features =
+            phys_dev.getFormatProperties(surface_info.color_format)
+                .optimalTilingFeatures;
+
+        return (features & needed) == needed &&
+               (target_features & vk::FormatFeatureFlagBits::eBlitDst) &&
+               (surface_info.supported_usage &
+                vk::ImageUsageFlagBits::eTransferDst);
+    }
+
+    /// @brief Pass drawing base colors, pipelines used in it must write
+    /// `FORMAT`
+    vk::RenderPass basePass() const { return *base_pass; }
+
+    vk::Framebuffer baseFramebuffer() const { return *base_framebuffer; }
+
+    /// @brief Recreates both images for a new swapchain size
+    void resize(vk::Extent2D extent) {
+        base_framebuffer = nullptr;
+        base_view.reset();
+        output_view.reset();
+        base.reset();
+        output.reset();
+
+        base.emplace(phys_dev, device,
+                     AllocatedImage::info2D(
+                         FORMAT, extent,
+                         vk::ImageUsageFlagBits::eColorAttachment |
+                             vk::ImageUsageFlagBits::eSampled));
+        base_view = base->createView(device, vk::ImageAspectFlagBits::eColor);
+
+        output.emplace(phys_dev, device,
+                       AllocatedImage::info2D(
+                           FORMAT, extent,
+                           vk::ImageUsageFlagBits::eStorage |
+                               vk::ImageUsageFlagBits::eTransferSrc));
+        output_view =
+            output->createView(device, vk::ImageAspectFlagBits::eColor);
+
+        vk::ImageView attachment = *base_view.value();
+        vk::FramebufferCreateInfo fb_info({}, *base_pass, attachment,
+                                          extent.width, extent.height, 1);
+        base_framebuffer = device.createFramebuffer(fb_info, hostCallbacks());
+
+        output_initialized = false;
+    }
+
+    /// @brief Records the effect over the base image left by `basePass` and
+    /// its blit onto `target`, which is left in ePresentSrcKHR
+    void apply(const vk::raii::CommandBuffer& cmd_buf, uint32_t frame_idx,
+               vk::Image target) {
+        auto range = colorRange();
+        auto extent = output->extent;
+
+        auto set = descriptors.allocate(frame_idx, *effect_set_layout);
+        writeSet(set);
+
+        // The blit of the previous frame still reads the output
+        vk::ImageMemoryBarrier to_general(
+            vk::AccessFlagBits::eTransferRead, vk::AccessFlagBits::eShaderWrite,
+            output_initialized ? vk::ImageLayout::eTransferSrcOptimal
+                               : vk::ImageLayout::eUndefined,
+            vk::ImageLayout::eGeneral, VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED, *output->image, range);
+        cmd_buf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                vk::PipelineStageFlagBits::eComputeShader, {},
+                                nullptr, nullptr, to_general);
+        output_initialized = true;
+
+        EffectParams params{{extent.width, extent.height}};
+        cmd_buf.bindPipeline(vk::PipelineBindPoint::eCompute,
+                             *effect_pipeline);
+        cmd_buf.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                   *effect_layout, 0, set, nullptr);
+        cmd_buf.pushConstants<EffectParams>(
+            *effect_layout, vk::ShaderStageFlagBits::eCompute, 0, params);
+        cmd_buf.dispatch(groupCount(extent.width, GROUP_SIZE),
+                         groupCount(extent.height, GROUP_SIZE), 1);
+
+        // The swapchain image is only written once the acquire semaphore,
+        // waited for at color attachment output, has signalled
+        std::array<vk::ImageMemoryBarrier, 2> to_transfer = {
+            vk::ImageMemoryBarrier(
+                vk::AccessFlagBits::eShaderWrite,
+                vk::AccessFlagBits::eTransferRead, vk::ImageLayout::eGeneral,
+                vk::ImageLayout::eTransferSrcOptimal, VK_QUEUE_FAMILY_IGNORED,
+                VK_QUEUE_FAMILY_IGNORED, *output->image, range),
+            vk::ImageMemoryBarrier(
+                {}, vk::AccessFlagBits::eTransferWrite,
+                vk::ImageLayout::eUndefined,
+                vk::ImageLayout::eTransferDstOptimal, VK_QUEUE_FAMILY_IGNORED,
+                VK_QUEUE_FAMILY_IGNORED, target, range)};
+        cmd_buf.pipelineBarrier(
+            vk::PipelineStageFlagBits::eComputeShader |
+                vk::PipelineStageFlagBits::eColorAttachmentOutput,
+            vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr,
+            to_transfer);
+
+        vk::ImageSubresourceLayers layers(vk::ImageAspectFlagBits::eColor, 0,
+                                          0, 1);
+        std::array<vk::Offset3D, 2> bounds = {
+            vk::Offset3D(0, 0, 0),
+            vk::Offset3D(static_cast<int32_t>(extent.width),
+                         static_cast<int32_t>(extent.height), 1)};
+        vk::ImageBlit region(layers, bounds, layers, bounds);
+        cmd_buf.blitImage(*output->image, vk::ImageLayout::eTransferSrcOptimal,
+                          target, vk::ImageLayout::eTransferDstOptimal, region,
+                          vk::Filter::eNearest);
+
+        vk::ImageMemoryBarrier to_present(
+            vk::AccessFlagBits::eTransferWrite, {},
+            vk::ImageLayout::eTransferDstOptimal,
+            vk::ImageLayout::ePresentSrcKHR, VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED, target, range);
+        cmd_buf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                vk::PipelineStageFlagBits::eBottomOfPipe, {},
+                                nullptr, nullptr, to_present);
+    }
+
+   private:
+    static constexpr uint32_t GROUP_SIZE = 8;
+
+    vk::raii::PhysicalDevice& phys_dev;
+    vk::raii::Device& device;
+    DescriptorAllocator& descriptors;
+
+    vk::raii::RenderPass base_pass{nullptr};
+    std::optional<AllocatedImage> base;
+    std::optional<vk::raii::ImageView> base_view;
+    vk::raii::Framebuffer base_framebuffer{nullptr};
+    std::optional<AllocatedImage> output;
+    std::optional<vk::raii::ImageView> output_view;
+    bool output_initialized = false;
+
+    vk::raii::DescriptorSetLayout effect_set_layout{nullptr};
+    vk::raii::PipelineLayout effect_layout{nullptr};
+    vk::raii::Pipeline effect_pipeline{nullptr};
+
+    static uint32_t groupCount(uint32_t items, uint32_t group_size) {
+        return (items + group_size - 1) / group_size;
+    }
+
+    static vk::ImageSubresourceRange colorRange() {
+        return vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1,
+                                         0, 1);
+    }
+
+    void createBasePass() {
+        vk::AttachmentDescription attach_desc{};
+        attach_desc.setFormat(FORMAT);
+        attach_desc.setLoadOp(vk::AttachmentLoadOp::eClear);
+        attach_desc.setStencilLoadOp(vk::AttachmentLoadOp::eDontCare);
+        attach_desc.setStencilStoreOp(vk::AttachmentStoreOp::eDontCare);
+        attach_desc.setFinalLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+
+        vk::AttachmentReference attach_ref(
+            0, vk::ImageLayout::eColorAttachmentOptimal);
+
+        vk::SubpassDescription sp_desc{};
+        sp_desc.setColorAttachments(attach_ref);
+
+        // The base image is overwritten after the previous effect read it,
+        // and read by the effect once drawn
+        std::array<vk::SubpassDependency, 2> dependencies = {
+            vk::SubpassDependency(
+                VK_SUBPASS_EXTERNAL, 0,
+                vk::PipelineStageFlagBits::eComputeShader,
+                vk::PipelineStageFlagBits::eColorAttachmentOutput, {},
+                vk::AccessFlagBits::eColorAttachmentWrite),
+            vk::SubpassDependency(
+                0, VK_SUBPASS_EXTERNAL,
+                vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                vk::PipelineStageFlagBits::eComputeShader,
+                vk::AccessFlagBits::eColorAttachmentWrite,
+                vk::AccessFlagBits::eShaderRead)};
+
+        vk::RenderPassCreateInfo rp_info{};
+        rp_info.setAttachments(attach_desc);
+        rp_info.setSubpasses(sp_desc);
+        rp_info.setDependencies(dependencies);
+
+        base_pass = device.createRenderPass(rp_info, hostCallbacks());
+    }
+
+    void createLayouts() {
+        auto compute = vk::ShaderStageFlagBits::eCompute;
+
+        std::vector<vk::DescriptorSetLayoutBinding> bindings = {
+            {0, vk::DescriptorType::eSampledImage, 1, compute},
+            {1, vk::DescriptorType::eStorageImage, 1, compute},
+        };
+        effect_set_layout = device.createDescriptorSetLayout(
+            vk::DescriptorSetLayoutCreateInfo({}, bindings), hostCallbacks());
+
+        vk::PushConstantRange range(compute, 0, sizeof(EffectParams));
+        effect_layout = device.createPipelineLayout(
+            vk::PipelineLayoutCreateInfo({}, *effect_set_layout, range),
+            hostCallbacks());
+    }
+
+    /// @brief Points a transient set at the current images
+    void writeSet(vk::DescriptorSet set) {
+        std::array<vk::DescriptorImageInfo, 2> image_infos = {
+            vk::DescriptorImageInfo(nullptr, *base_view.value(),
+                                    vk::ImageLayout::eShaderReadOnlyOptimal),
+            vk::DescriptorImageInfo(nullptr, *output_view.value(),
+                                    vk::ImageLayout::eGeneral)};
+
+        std::array<vk::WriteDescriptorSet, 2> writes = {
+            vk::WriteDescriptorSet(set, 0, 0, 1,
+                                   vk::DescriptorType::eSampledImage,
+                                   &image_infos[0]),
+            vk::WriteDescriptorSet(set, 1, 0, 1,
+                                   vk::DescriptorType::eStorageImage,
+                                   &image_infos[1])};
+
+        device.updateDescriptorSets(writes, nullptr);
+    }
+};
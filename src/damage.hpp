@@ -0,0 +1,129 @@
+#pragma once
+#include <algorithm>
+#include <optional>
+#include <vector>
+
+/// @brief Screen regions changed each frame, and the region each swapchain
+/// image repaints to catch up with them.
+///
+/// Images are drawn in turns, so an image still holds the frame it was last
+/// drawn in and repaints the damage of every frame since. An image never
+/// drawn, or whose damage no longer fits in MAX_RECTS, repaints in full.
+class DamageTracker {
+   public:
+    static constexpr size_t MAX_RECTS = 8;
+
+    /// @brief Starts over for a new swapchain, all of whose images repaint
+    /// in full
+    void reset(uint32_t image_count, vk::Extent2D swapchain_extent) {
+        extent = swapchain_extent;
+        pending.assign(image_count, {fullRect()});
+        frame.clear();
+    }
+
+    /// @brief Marks `rect` changed this frame, clipped to the swapchain
+    void add(vk::Rect2D rect) {
+        auto clipped = clip(rect);
+        if (clipped.has_value()) {
+            append(frame, clipped.value());
+        }
+    }
+
+    void addFull() { frame.assign(1, fullRect()); }
+
+    /// @brief Rectangles changed this frame, what the compositor has to
+    /// update from the previous present
+    const std::vector<vk::Rect2D>& frameRects() const { return frame; }
+
+    bool isFull(const vk::Rect2D& rect) const {
+        return rect.offset.x == 0 && rect.offset.y == 0 &&
+               rect.extent == extent;
+    }
+
+    /// @brief Bounds of what `image` repaints this frame, the damage of this
+    /// frame and of the frames it missed, nothing when it is up to date
+    std::optional<vk::Rect2D> repaintBounds(uint32_t image) const {
+        std::optional<vk::Rect2D> bounds;
+        for (auto* rects : {&pending[image], &frame}) {
+            for (auto& rect : *rects) {
+                bounds = bounds.has_value() ? unite(bounds.value(), rect)
+                                            : rect;
+            }
+        }
+        return bounds;
+    }
+
+    /// @brief Ends the frame drawn into `image`, which is now up to date
+    /// while the other images still miss this frame's damage
+    void drawn(uint32_t image) {
+        for (uint32_t i = 0; i < pending.size(); i++) {
+            if (i == image) {
+                pending[i].clear();
+                continue;
+            }
+            for (auto& rect : frame) {
+                append(pending[i], rect);
+            }
+        }
+        frame.clear();
+    }
+
+   private:
+    vk::Extent2D extent{};
+    std::vector<vk::Rect2D> frame;
+    std::vector<std::vector<vk::Rect2D>> pending;
+
+    vk::Rect2D fullRect() const { return vk::Rect2D({0, 0}, extent); }
+
+    static int32_t right(const vk::Rect2D& rect) {
+        return rect.offset.x + static_cast<int32_t>(rect.extent.width);
+    }
+
+    static int32_t bottom(const vk::Rect2D& rect) {
+        return rect.offset.y + static_cast<int32_t>(rect.extent.height);
+    }
+
+    static vk::Rect2D fromEdges(int32_t x0, int32_t y0, int32_t x1,
+                                int32_t y1) {
+        return vk::Rect2D({x0, y0}, {static_cast<uint32_t>(x1 - x0),
+                                     static_cast<uint32_t>(y1 - y0)});
+    }
+
+    std::optional<vk::Rect2D> clip(const vk::Rect2D& rect) const {
+        auto full = fullRect();
+        int32_t x0 = std::max(rect.offset.x, 0);
+        int32_t y0 = std::max(rect.offset.y, 0);
+        int32_t x1 = std::min(right(rect), right(full));
+        int32_t y1 = std::min(bottom(rect), bottom(full));
+        if (x1 <= x0 || y1 <= y0) {
+            return std::nullopt;
+        }
+        return fromEdges(x0, y0, x1, y1);
+    }
+
+    static vk::Rect2D unite(const vk::Rect2D& a, const vk::Rect2D& b) {
+        return fromEdges(std::min(a.offset.x, b.offset.x),
+                         std::min(a.offset.y, b.offset.y),
+                         std::max(right(a), right(b)),
+                         std::max(bottom(a), bottom(b)));
+    }
+
+    static bool contains(const vk::Rect2D& outer, const vk::Rect2D& inner) {
+        return inner.offset.x >= outer.offset.x &&
+               inner.offset.y >= outer.offset.y &&
+               right(inner) <= right(outer) && bottom(inner) <= bottom(outer);
+    }
+
+    /// @brief Adds `rect` unless already covered, falling back to the full
+    /// swapchain once there are too many rectangles to track
+    void append(std::vector<vk::Rect2D>& rects, const vk::Rect2D& rect) {
+        auto covers = [&](const vk::Rect2D& r) { return contains(r, rect); };
+        if (std::any_of(rects.begin(), rects.end(), covers)) {
+            return;
+        }
+        rects.push_back(rect);
+        if (rects.size() > MAX_RECTS) {
+            rects.assign(1, fullRect());
+        }
+    }
+};
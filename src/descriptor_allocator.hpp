@@ -0,0 +1,290 @@
+#pragma once
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+/// @brief Descriptors of one type a pool reserves per set it can hold
+struct PoolSizeRatio {
+    vk::DescriptorType type;
+    float ratio;
+};
+
+const std::vector<PoolSizeRatio> DEFAULT_POOL_RATIOS = {
+    {vk::DescriptorType::eUniformBuffer, 2.0f},
+    {vk::DescriptorType::eStorageBuffer, 4.0f},
+    {vk::DescriptorType::eCombinedImageSampler, 2.0f},
+    {vk::DescriptorType::eSampledImage, 2.0f},
+    {vk::DescriptorType::eSampler, 1.0f},
+    {vk::DescriptorType::eStorageImage, 2.0f},
+};
+
+/// @brief Growable list of descriptor pools.
+///
+/// Sets come from the newest pool with room left. When it runs out
+/// (eErrorOutOfPoolMemory or eErrorFragmentedPool) another pool is taken,
+/// created larger than the last one if no spare pool is left. Sets are never
+/// freed one by one, `reset` recycles all pools at once.
+class DescriptorPoolChain {
+   public:
+    DescriptorPoolChain(vk::raii::Device& device, uint32_t initial_sets,
+                        std::vector<PoolSizeRatio> pool_ratios)
+        : device(device),
+          ratios(std::move(pool_ratios)),
+          next_pool_sets(initial_sets) {}
+
+    vk::DescriptorSet allocate(vk::DescriptorSetLayout layout) {
+        if (active_pools.empty()) {
+            active_pools.push_back(takePool());
+        }
+
+        vk::DescriptorSetAllocateInfo alloc_info(*active_pools.back(), layout);
+        VkDescriptorSet set = VK_NULL_HANDLE;
+        auto result = tryAllocate(alloc_info, set);
+
+        if (result == vk::Result::eErrorOutOfPoolMemory ||
+            result == vk::Result::eErrorFragmentedPool) {
+            active_pools.push_back(takePool());
+            alloc_info.setDescriptorPool(*active_pools.back());
+            result = tryAllocate(alloc_info, set);
+        }
+
+        if (result != vk::Result::eSuccess) {
+            throw vk::SystemError(vk::make_error_code(result),
+                                  "vkAllocateDescriptorSets");
+        }
+
+        return set;
+    }
+
+    /// @brief Returns every set to its pool, pools are kept for reuse
+    void reset() {
+        for (auto& pool : active_pools) {
+            pool.reset();
+            spare_pools.push_back(std::move(pool));
+        }
+        active_pools.clear();
+    }
+
+    size_t poolCount() const { return active_pools.size() + spare_pools.size(); }
+
+   private:
+    static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+    vk::raii::Device& device;
+    std::vector<PoolSizeRatio> ratios;
+    uint32_t next_pool_sets;
+
+    std::vector<vk::raii::DescriptorPool> active_pools;
+    std::vector<vk::raii::DescriptorPool> spare_pools;
+
+    vk::Result tryAllocate(const vk::DescriptorSetAllocateInfo& alloc_info,
+                           VkDescriptorSet& set) {
+        return static_cast<vk::Result>(
+            device.getDispatcher()->vkAllocateDescriptorSets(
+                static_cast<VkDevice>(*device),
+                reinterpret_cast<const VkDescriptorSetAllocateInfo*>(
+                    &alloc_info),
+                &set));
+    }
+
+    vk::raii::DescriptorPool takePool() {
+        if (!spare_pools.empty()) {
+            auto pool = std::move(spare_pools.back());
+            spare_pools.pop_back();
+            return pool;
+        }
+
+        std::vector<vk::DescriptorPoolSize> pool_sizes{};
+        for (auto& ratio : ratios) {
+            pool_sizes.emplace_back(
+                ratio.type, static_cast<uint32_t>(ratio.ratio * next_pool_sets));
+        }
+
+        vk::DescriptorPoolCreateInfo pool_info({}, next_pool_sets, pool_sizes);
+        auto pool = device.createDescriptorPool(pool_info, hostCallbacks());
+
+        next_pool_sets = std::min(next_pool_sets * 2, MAX_SETS_PER_POOL);
+        return pool;
+    }
+};
+
+/// @brief Transient descriptor sets, one pool chain per frame in flight.
+///
+/// Sets live until the frame slot comes around again; `resetFrame` recycles
+/// the slot's pools wholesale once its fence has signalled.
+class DescriptorAllocator {
+   public:
+    DescriptorAllocator(vk::raii::Device& device, uint32_t frame_count,
+                        uint32_t initial_sets = 64,
+                        const std::vector<PoolSizeRatio>& ratios =
+                            DEFAULT_POOL_RATIOS) {
+        for (uint32_t i = 0; i < frame_count; i++) {
+            frames.emplace_back(device, initial_sets, ratios);
+        }
+    }
+
+    vk::DescriptorSet allocate(uint32_t frame_idx,
+                               vk::DescriptorSetLayout layout) {
+        return frames[frame_idx].allocate(layout);
+    }
+
+    /// @brief Frees all sets of a frame slot, its fence must have signalled
+    void resetFrame(uint32_t frame_idx) { frames[frame_idx].reset(); }
+
+   private:
+    std::vector<DescriptorPoolChain> frames;
+};
+
+/// @brief What one binding of a set points at
+struct DescriptorBinding {
+    uint32_t binding;
+    vk::DescriptorType type;
+
+    vk::Buffer buffer;
+    vk::DeviceSize offset = 0;
+    vk::DeviceSize range = 0;
+
+    vk::ImageView image_view;
+    vk::Sampler sampler;
+    vk::ImageLayout image_layout = vk::ImageLayout::eUndefined;
+
+    static DescriptorBinding ofBuffer(uint32_t binding,
+                                      vk::DescriptorType type,
+                                      vk::Buffer buffer, vk::DeviceSize offset,
+                                      vk::DeviceSize range) {
+        DescriptorBinding desc{binding, type};
+        desc.buffer = buffer;
+        desc.offset = offset;
+        desc.range = range;
+        return desc;
+    }
+
+    static DescriptorBinding ofImage(uint32_t binding,
+                                     vk::DescriptorType type,
+                                     vk::ImageView image_view,
+                                     vk::ImageLayout image_layout,
+                                     vk::Sampler sampler = nullptr) {
+        DescriptorBinding desc{binding, type};
+        desc.image_view = image_view;
+        desc.image_layout = image_layout;
+        desc.sampler = sampler;
+        return desc;
+    }
+
+    bool operator==(const DescriptorBinding& other) const {
+        return binding == other.binding && type == other.type &&
+               buffer == other.buffer && offset == other.offset &&
+               range == other.range && image_view == other.image_view &&
+               sampler == other.sampler && image_layout == other.image_layout;
+    }
+};
+
+/// @brief Long-lived descriptor sets, reused whenever a set with the same
+/// layout and binding contents is requested again.
+///
+/// Entries refer to resources by handle, call `clear` when bound resources
+/// are destroyed so that no stale set is handed out for a recycled handle.
+class DescriptorSetCache {
+   public:
+    explicit DescriptorSetCache(vk::raii::Device& device,
+                                uint32_t initial_sets = 16)
+        : device(device), pools(device, initial_sets, DEFAULT_POOL_RATIOS) {}
+
+    vk::DescriptorSet get(vk::DescriptorSetLayout layout,
+                          const std::vector<DescriptorBinding>& bindings) {
+        auto key = hash(layout, bindings);
+
+        auto& bucket = entries[key];
+        for (auto& entry : bucket) {
+            if (entry.layout == layout && entry.bindings == bindings) {
+                hits++;
+                return entry.set;
+            }
+        }
+
+        misses++;
+        auto set = pools.allocate(layout);
+        write(set, bindings);
+        bucket.push_back({layout, bindings, set});
+        return set;
+    }
+
+    /// @brief Drops every cached set
+    void clear() {
+        entries.clear();
+        pools.reset();
+    }
+
+    uint64_t hitCount() const { return hits; }
+    uint64_t missCount() const { return misses; }
+
+   private:
+    struct Entry {
+        vk::DescriptorSetLayout layout;
+        std::vector<DescriptorBinding> bindings;
+        vk::DescriptorSet set;
+    };
+
+    vk::raii::Device& device;
+    DescriptorPoolChain pools;
+    std::unordered_map<size_t, std::vector<Entry>> entries;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+
+    static void combine(size_t& seed, uint64_t value) {
+        seed ^= std::hash<uint64_t>{}(value) + 0x9e3779b97f4a7c15ULL +
+                (seed << 6) + (seed >> 2);
+    }
+
+    static size_t hash(vk::DescriptorSetLayout layout,
+                       const std::vector<DescriptorBinding>& bindings) {
+        size_t seed = 0;
+        combine(seed, reinterpret_cast<uint64_t>(
+                          static_cast<VkDescriptorSetLayout>(layout)));
+        for (auto& b : bindings) {
+            combine(seed, b.binding);
+            combine(seed, static_cast<uint64_t>(b.type));
+            combine(seed, reinterpret_cast<uint64_t>(
+                              static_cast<VkBuffer>(b.buffer)));
+            combine(seed, b.offset);
+            combine(seed, b.range);
+            combine(seed, reinterpret_cast<uint64_t>(
+                              static_cast<VkImageView>(b.image_view)));
+            combine(seed, reinterpret_cast<uint64_t>(
+                              static_cast<VkSampler>(b.sampler)));
+            combine(seed, static_cast<uint64_t>(b.image_layout));
+        }
+        return seed;
+    }
+
+    void write(vk::DescriptorSet set,
+               const std::vector<DescriptorBinding>& bindings) {
+        std::vector<vk::DescriptorBufferInfo> buffer_infos{};
+        std::vector<vk::DescriptorImageInfo> image_infos{};
+        buffer_infos.reserve(bindings.size());
+        image_infos.reserve(bindings.size());
+
+        std::vector<vk::WriteDescriptorSet> writes{};
+        for (auto& b : bindings) {
+            vk::WriteDescriptorSet write{};
+            write.setDstSet(set);
+            write.setDstBinding(b.binding);
+            write.setDescriptorType(b.type);
+            write.setDescriptorCount(1);
+
+            if (b.buffer) {
+                buffer_infos.emplace_back(b.buffer, b.offset, b.range);
+                write.setPBufferInfo(&buffer_infos.back());
+            } else {
+                image_infos.emplace_back(b.sampler, b.image_view,
+                                         b.image_layout);
+                write.setPImageInfo(&image_infos.back());
+            }
+
+            writes.push_back(write);
+        }
+
+        device.updateDescriptorSets(writes, nullptr);
+    }
+};
@@ -0,0 +1,97 @@
+#pragma once
+#include <vector>
+
+const std::vector<const char*> DESCRIPTOR_BUFFER_DEVICE_EXTENSIONS = {
+    VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME};
+
+/// @brief Descriptor sets stored in a plain host-visible buffer
+/// (VK_EXT_descriptor_buffer).
+///
+/// Every set of one layout gets its own aligned slice. Descriptors are
+/// written by the CPU with getDescriptorEXT straight into mapped memory and
+/// sets are bound by offset, with no pool or set objects involved.
+class DescriptorBuffer {
+   public:
+    DescriptorBuffer(vk::raii::PhysicalDevice& phys_dev,
+                     vk::raii::Device& device,
+                     const vk::raii::DescriptorSetLayout& layout,
+                     uint32_t set_count)
+        : device(device),
+          props(phys_dev
+                    .getProperties2<
+                        vk::PhysicalDeviceProperties2,
+                        vk::PhysicalDeviceDescriptorBufferPropertiesEXT>()
+                    .get<vk::PhysicalDeviceDescriptorBufferPropertiesEXT>()),
+          set_layout(layout),
+          set_stride(alignUp(layout.getSizeEXT(),
+                             props.descriptorBufferOffsetAlignment)),
+          storage(phys_dev, device, set_stride * set_count,
+                  vk::BufferUsageFlagBits::eResourceDescriptorBufferEXT |
+                      vk::BufferUsageFlagBits::eShaderDeviceAddress,
+                  vk::MemoryPropertyFlagBits::eHostVisible |
+                      vk::MemoryPropertyFlagBits::eHostCoherent),
+          storage_address(storage.address(device)) {}
+
+    DescriptorBuffer(const DescriptorBuffer&) = delete;
+    DescriptorBuffer& operator=(const DescriptorBuffer&) = delete;
+
+    /// @brief Writes a uniform buffer descriptor of set `set_idx`
+    void writeUniformBuffer(uint32_t set_idx, uint32_t binding,
+                            vk::DeviceAddress address, vk::DeviceSize range) {
+        vk::DescriptorAddressInfoEXT addr_info(address, range);
+        vk::DescriptorDataEXT data{};
+        data.setPUniformBuffer(&addr_info);
+
+        device.getDescriptorEXT(
+            vk::DescriptorGetInfoEXT(vk::DescriptorType::eUniformBuffer, data),
+            props.uniformBufferDescriptorSize, slot(set_idx, binding));
+    }
+
+    /// @brief Writes a storage buffer descriptor of set `set_idx`
+    void writeStorageBuffer(uint32_t set_idx, uint32_t binding,
+                            vk::DeviceAddress address, vk::DeviceSize range) {
+        vk::DescriptorAddressInfoEXT addr_info(address, range);
+        vk::DescriptorDataEXT data{};
+        data.setPStorageBuffer(&addr_info);
+
+        device.getDescriptorEXT(
+            vk::DescriptorGetInfoEXT(vk::DescriptorType::eStorageBuffer, data),
+            props.storageBufferDescriptorSize, slot(set_idx, binding));
+    }
+
+    /// @brief Binds the buffer and points set `first_set` of `pipeline_layout`
+    /// at the slice of set `set_idx`
+    void bind(const vk::raii::CommandBuffer& cmd_buf,
+              vk::PipelineBindPoint bind_point,
+              vk::PipelineLayout pipeline_layout, uint32_t first_set,
+              uint32_t set_idx) const {
+        vk::DescriptorBufferBindingInfoEXT binding_info(
+            storage_address,
+            vk::BufferUsageFlagBits::eResourceDescriptorBufferEXT);
+        cmd_buf.bindDescriptorBuffersEXT(binding_info);
+
+        uint32_t buffer_idx = 0;
+        vk::DeviceSize offset = set_stride * set_idx;
+        cmd_buf.setDescriptorBufferOffsetsEXT(bind_point, pipeline_layout,
+                                              first_set, buffer_idx, offset);
+    }
+
+   private:
+    vk::raii::Device& device;
+    vk::PhysicalDeviceDescriptorBufferPropertiesEXT props;
+    const vk::raii::DescriptorSetLayout& set_layout;
+    vk::DeviceSize set_stride;
+    AllocatedBuffer storage;
+    vk::DeviceAddress storage_address;
+
+    static vk::DeviceSize alignUp(vk::DeviceSize size,
+                                  vk::DeviceSize alignment) {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    void* slot(uint32_t set_idx, uint32_t binding) {
+        auto offset =
+            set_stride * set_idx + set_layout.getBindingOffsetEXT(binding);
+        return static_cast<char*>(storage.mapped) + offset;
+    }
+};
@@ -0,0 +1,144 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+const std::vector<const char*> CHECKPOINT_DEVICE_EXTENSIONS = {
+    VK_NV_DEVICE_DIAGNOSTIC_CHECKPOINTS_EXTENSION_NAME};
+const std::vector<const char*> BUFFER_MARKER_DEVICE_EXTENSIONS = {
+    VK_AMD_BUFFER_MARKER_EXTENSION_NAME};
+
+/// @brief How command buffers are tagged for the report after a device loss
+enum class CrashMarkerKind {
+    // VK_NV_device_diagnostic_checkpoints, the driver keeps the last
+    // checkpoint each pipeline stage passed
+    Checkpoints,
+    // VK_AMD_buffer_marker, markers are written to host-visible memory as
+    // the top and the bottom of the pipe pass them
+    BufferMarkers,
+};
+
+/// @brief Labelled points in the recorded frames, read back after the device
+/// was lost to tell which commands the GPU had finished, was running and
+/// never reached.
+///
+/// Every frame in flight keeps up to `MAX_MARKERS` labels, cleared by
+/// `begin` once the slot's fence has signalled. Labels must be string
+/// literals, checkpoints hand the pointers themselves to the driver.
+class CrashMarkers {
+   public:
+    static constexpr uint32_t MAX_MARKERS = 32;
+
+    CrashMarkers(vk::raii::PhysicalDevice& phys_dev, vk::raii::Device& device,
+                 CrashMarkerKind kind, uint32_t frame_count)
+        : kind(kind), slots(frame_count) {
+        if (kind == CrashMarkerKind::BufferMarkers) {
+            values.emplace(phys_dev, device,
+                           frame_count * MAX_MARKERS * 2 * sizeof(uint32_t),
+                           vk::BufferUsageFlagBits::eTransferDst,
+                           vk::MemoryPropertyFlagBits::eHostVisible |
+                               vk::MemoryPropertyFlagBits::eHostCoherent);
+            std::memset(values->mapped, 0, values->size);
+        }
+    }
+
+    CrashMarkers(const CrashMarkers&) = delete;
+    CrashMarkers& operator=(const CrashMarkers&) = delete;
+
+    /// @brief Forgets the markers of the slot's previous frame
+    void begin(uint32_t frame_idx, uint64_t frame_number) {
+        auto& slot = slots[frame_idx];
+        slot.frame_number = frame_number;
+        slot.labels.clear();
+        if (values.has_value()) {
+            std::memset(slotValues(frame_idx), 0,
+                        MAX_MARKERS * 2 * sizeof(uint32_t));
+        }
+    }
+
+    /// @brief Records a marker after the commands recorded so far, outside
+    /// of any render pass. Markers beyond `MAX_MARKERS` are dropped.
+    void mark(const vk::raii::CommandBuffer& cmd_buf, uint32_t frame_idx,
+              const char* label) {
+        auto& slot = slots[frame_idx];
+        if (slot.labels.size() == MAX_MARKERS) {
+            return;
+        }
+
+        auto idx = static_cast<uint32_t>(slot.labels.size());
+        slot.labels.push_back(label);
+
+        if (kind == CrashMarkerKind::Checkpoints) {
+            cmd_buf.setCheckpointNV(label);
+            return;
+        }
+
+        // Nonzero so that cleared values read as not reached
+        vk::DeviceSize offset =
+            (frame_idx * MAX_MARKERS + idx) * 2 * sizeof(uint32_t);
+        cmd_buf.writeBufferMarkerAMD(vk::PipelineStageFlagBits::eTopOfPipe,
+                                     *values->buffer, offset, idx + 1);
+        cmd_buf.writeBufferMarkerAMD(vk::PipelineStageFlagBits::eBottomOfPipe,
+                                     *values->buffer,
+                                     offset + sizeof(uint32_t), idx + 1);
+    }
+
+    /// @brief Describes how far the GPU got in every frame in flight. Only
+    /// meaningful once the device was lost or is idle.
+    std::string report(const vk::raii::Queue& queue) const {
+        std::ostringstream out;
+
+        if (kind == CrashMarkerKind::Checkpoints) {
+            out << "last checkpoints:\n";
+            for (auto& data : queue.getCheckpointDataNV()) {
+                out << "  " << vk::to_string(data.stage) << ": "
+                    << static_cast<const char*>(data.pCheckpointMarker)
+                    << "\n";
+            }
+        }
+
+        for (uint32_t i = 0; i < slots.size(); i++) {
+            auto& slot = slots[i];
+            if (slot.labels.empty()) {
+                continue;
+            }
+
+            out << "frame " << slot.frame_number << ":\n";
+            for (uint32_t m = 0; m < slot.labels.size(); m++) {
+                out << "  " << slot.labels[m];
+                if (values.has_value()) {
+                    auto top = slotValues(i)[2 * m];
+                    auto bottom = slotValues(i)[2 * m + 1];
+                    if (bottom == m + 1) {
+                        out << " - done";
+                    } else if (top == m + 1) {
+                        out << " - in flight";
+                    } else {
+                        out << " - not reached";
+                    }
+                }
+                out << "\n";
+            }
+        }
+
+        return out.str();
+    }
+
+   private:
+    struct Slot {
+        uint64_t frame_number = 0;
+        std::vector<const char*> labels;
+    };
+
+    CrashMarkerKind kind;
+    std::vector<Slot> slots;
+    std::optional<AllocatedBuffer> values;
+
+    uint32_t* slotValues(uint32_t frame_idx) const {
+        return static_cast<uint32_t*>(values->mapped) +
+               frame_idx * MAX_MARKERS * 2;
+    }
+};
@@ -0,0 +1,88 @@
+#pragma once
+#include <stdexcept>
+#include <string>
+
+/// @brief Flat table of the device-level entry points recorded and submitted
+/// every frame, loaded with vkGetDeviceProcAddr.
+///
+/// Usable as the `Dispatch` argument of the vk:: handle methods. The
+/// dispatcher of vk::raii holds every command of the device and is reached
+/// through each wrapper, this table spans a few cache lines and is passed
+/// by reference, so a hot recording loop touches only what it calls.
+struct DeviceDispatch {
+    PFN_vkResetCommandBuffer vkResetCommandBuffer = nullptr;
+    PFN_vkBeginCommandBuffer vkBeginCommandBuffer = nullptr;
+    PFN_vkEndCommandBuffer vkEndCommandBuffer = nullptr;
+    PFN_vkCmdBeginRenderPass vkCmdBeginRenderPass = nullptr;
+    PFN_vkCmdEndRenderPass vkCmdEndRenderPass = nullptr;
+    PFN_vkCmdBindPipeline vkCmdBindPipeline = nullptr;
+    PFN_vkCmdBindDescriptorSets vkCmdBindDescriptorSets = nullptr;
+    PFN_vkCmdBindVertexBuffers vkCmdBindVertexBuffers = nullptr;
+    PFN_vkCmdBindIndexBuffer vkCmdBindIndexBuffer = nullptr;
+    PFN_vkCmdPushConstants vkCmdPushConstants = nullptr;
+    PFN_vkCmdSetViewport vkCmdSetViewport = nullptr;
+    PFN_vkCmdSetScissor vkCmdSetScissor = nullptr;
+    PFN_vkCmdSetBlendConstants vkCmdSetBlendConstants = nullptr;
+    PFN_vkCmdClearAttachments vkCmdClearAttachments = nullptr;
+    PFN_vkCmdPipelineBarrier vkCmdPipelineBarrier = nullptr;
+    PFN_vkCmdDraw vkCmdDraw = nullptr;
+    PFN_vkCmdDrawIndexed vkCmdDrawIndexed = nullptr;
+    PFN_vkQueueSubmit vkQueueSubmit = nullptr;
+    PFN_vkQueuePresentKHR vkQueuePresentKHR = nullptr;
+    // Core in Vulkan 1.3, only recorded with shader objects, which require it
+    PFN_vkCmdSetViewportWithCount vkCmdSetViewportWithCount = nullptr;
+    PFN_vkCmdSetScissorWithCount vkCmdSetScissorWithCount = nullptr;
+    PFN_vkCmdBeginRendering vkCmdBeginRendering = nullptr;
+    PFN_vkCmdEndRendering vkCmdEndRendering = nullptr;
+
+    uint32_t getVkHeaderVersion() const { return VK_HEADER_VERSION; }
+
+    static DeviceDispatch load(const vk::raii::Device& device) {
+        DeviceDispatch table{};
+        loadEntry(device, "vkResetCommandBuffer", table.vkResetCommandBuffer);
+        loadEntry(device, "vkBeginCommandBuffer", table.vkBeginCommandBuffer);
+        loadEntry(device, "vkEndCommandBuffer", table.vkEndCommandBuffer);
+        loadEntry(device, "vkCmdBeginRenderPass", table.vkCmdBeginRenderPass);
+        loadEntry(device, "vkCmdEndRenderPass", table.vkCmdEndRenderPass);
+        loadEntry(device, "vkCmdBindPipeline", table.vkCmdBindPipeline);
+        loadEntry(device, "vkCmdBindDescriptorSets",
+                  table.vkCmdBindDescriptorSets);
+        loadEntry(device, "vkCmdBindVertexBuffers",
+                  table.vkCmdBindVertexBuffers);
+        loadEntry(device, "vkCmdBindIndexBuffer", table.vkCmdBindIndexBuffer);
+        loadEntry(device, "vkCmdPushConstants", table.vkCmdPushConstants);
+        loadEntry(device, "vkCmdSetViewport", table.vkCmdSetViewport);
+        loadEntry(device, "vkCmdSetScissor", table.vkCmdSetScissor);
+        loadEntry(device, "vkCmdSetBlendConstants",
+                  table.vkCmdSetBlendConstants);
+        loadEntry(device, "vkCmdClearAttachments",
+                  table.vkCmdClearAttachments);
+        loadEntry(device, "vkCmdPipelineBarrier", table.vkCmdPipelineBarrier);
+        loadEntry(device, "vkCmdDraw", table.vkCmdDraw);
+        loadEntry(device, "vkCmdDrawIndexed", table.vkCmdDrawIndexed);
+        loadEntry(device, "vkQueueSubmit", table.vkQueueSubmit);
+        loadEntry(device, "vkQueuePresentKHR", table.vkQueuePresentKHR);
+
+        table.vkCmdSetViewportWithCount =
+            reinterpret_cast<PFN_vkCmdSetViewportWithCount>(
+                device.getProcAddr("vkCmdSetViewportWithCount"));
+        table.vkCmdSetScissorWithCount =
+            reinterpret_cast<PFN_vkCmdSetScissorWithCount>(
+                device.getProcAddr("vkCmdSetScissorWithCount"));
+        table.vkCmdBeginRendering = reinterpret_cast<PFN_vkCmdBeginRendering>(
+            device.getProcAddr("vkCmdBeginRendering"));
+        table.vkCmdEndRendering = reinterpret_cast<PFN_vkCmdEndRendering>(
+            device.getProcAddr("vkCmdEndRendering"));
+        return table;
+    }
+
+   private:
+    template <typename Entry>
+    static void loadEntry(const vk::raii::Device& device, const char* name,
+                          Entry& entry) {
+        entry = reinterpret_cast<Entry>(device.getProcAddr(name));
+        if (entry == nullptr) {
+            throw std::runtime_error(std::string("failed to load ") + name);
+        }
+    }
+};
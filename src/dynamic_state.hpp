@@ -0,0 +1,250 @@
+#pragma once
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+/// @brief Which parts of RenderState a device can set at record time
+struct DynamicStateSupport {
+    // Cull mode, front face, topology and depth state (extended dynamic state)
+    bool extended = false;
+    // Primitive restart (extended dynamic state 2)
+    bool extended2 = false;
+    // Color blend state (extended dynamic state 3)
+    bool blend_enable = false;
+    bool blend_equation = false;
+    bool write_mask = false;
+
+    // Extensions to enable, state that is core in Vulkan 1.3 needs none
+    std::vector<const char*> extensions;
+
+    vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT eds_features{};
+    vk::PhysicalDeviceExtendedDynamicState2FeaturesEXT eds2_features{};
+    vk::PhysicalDeviceExtendedDynamicState3FeaturesEXT eds3_features{};
+
+    static DynamicStateSupport from(
+        vk::raii::PhysicalDevice& device,
+        const std::unordered_set<std::string>& extension_set) {
+        DynamicStateSupport support{};
+
+        bool core = device.getProperties().apiVersion >= VK_API_VERSION_1_3;
+        support.extended = core;
+        support.extended2 = core;
+
+        if (!core &&
+            extension_set.count(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME)) {
+            auto features = device.getFeatures2<
+                vk::PhysicalDeviceFeatures2,
+                vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>();
+            support.extended =
+                features
+                    .get<vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>()
+                    .extendedDynamicState;
+            if (support.extended) {
+                support.extensions.push_back(
+                    VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+                support.eds_features.setExtendedDynamicState(true);
+            }
+        }
+
+        if (!core && support.extended &&
+            extension_set.count(VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME)) {
+            auto features = device.getFeatures2<
+                vk::PhysicalDeviceFeatures2,
+                vk::PhysicalDeviceExtendedDynamicState2FeaturesEXT>();
+            support.extended2 =
+                features
+                    .get<vk::PhysicalDeviceExtendedDynamicState2FeaturesEXT>()
+                    .extendedDynamicState2;
+            if (support.extended2) {
+                support.extensions.push_back(
+                    VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME);
+                support.eds2_features.setExtendedDynamicState2(true);
+            }
+        }
+
+        if (support.extended &&
+            extension_set.count(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME)) {
+            auto features = device.getFeatures2<
+                vk::PhysicalDeviceFeatures2,
+                vk::PhysicalDeviceExtendedDynamicState3FeaturesEXT>();
+            auto& eds3 =
+                features
+                    .get<vk::PhysicalDeviceExtendedDynamicState3FeaturesEXT>();
+
+            support.blend_enable = eds3.extendedDynamicState3ColorBlendEnable;
+            support.blend_equation =
+                eds3.extendedDynamicState3ColorBlendEquation;
+            support.write_mask = eds3.extendedDynamicState3ColorWriteMask;
+
+            if (support.blend_enable || support.blend_equation ||
+                support.write_mask) {
+                support.extensions.push_back(
+                    VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+                support.eds3_features.setExtendedDynamicState3ColorBlendEnable(
+                    support.blend_enable);
+                support.eds3_features
+                    .setExtendedDynamicState3ColorBlendEquation(
+                        support.blend_equation);
+                support.eds3_features.setExtendedDynamicState3ColorWriteMask(
+                    support.write_mask);
+            }
+        }
+
+        return support;
+    }
+
+    /// @brief Everything settable, as VK_EXT_shader_object provides all of
+    /// the commands regardless of the extended dynamic state features
+    static DynamicStateSupport full() {
+        DynamicStateSupport support{};
+        support.extended = true;
+        support.extended2 = true;
+        support.blend_enable = true;
+        support.blend_equation = true;
+        support.write_mask = true;
+        return support;
+    }
+
+    /// @brief Prepends the feature structs of the enabled extensions to a
+    /// device creation pNext chain
+    void chainFeatures(void*& feature_chain) {
+        for (auto ext : extensions) {
+            std::string name{ext};
+            if (name == VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME) {
+                eds_features.setPNext(feature_chain);
+                feature_chain = &eds_features;
+            } else if (name == VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME) {
+                eds2_features.setPNext(feature_chain);
+                feature_chain = &eds2_features;
+            } else if (name == VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME) {
+                eds3_features.setPNext(feature_chain);
+                feature_chain = &eds3_features;
+            }
+        }
+    }
+};
+
+/// @brief Sets RenderState at record time, emitting only the state that
+/// differs from what was last applied to the command buffer
+class DynamicStateTracker {
+   public:
+    explicit DynamicStateTracker(const DynamicStateSupport& dyn_support)
+        : support(dyn_support) {}
+
+    /// @brief Dynamic states a pipeline must declare to be driven by this
+    /// tracker, on top of viewport and scissor
+    std::vector<vk::DynamicState> dynamicStates() const {
+        std::vector<vk::DynamicState> states{};
+
+        if (support.extended) {
+            states.insert(states.end(),
+                          {vk::DynamicState::eCullMode,
+                           vk::DynamicState::eFrontFace,
+                           vk::DynamicState::ePrimitiveTopology,
+                           vk::DynamicState::eDepthTestEnable,
+                           vk::DynamicState::eDepthWriteEnable,
+                           vk::DynamicState::eDepthCompareOp});
+        }
+        if (support.extended2) {
+            states.push_back(vk::DynamicState::ePrimitiveRestartEnable);
+        }
+        if (support.blend_enable) {
+            states.push_back(vk::DynamicState::eColorBlendEnableEXT);
+        }
+        if (support.blend_equation) {
+            states.push_back(vk::DynamicState::eColorBlendEquationEXT);
+        }
+        if (support.write_mask) {
+            states.push_back(vk::DynamicState::eColorWriteMaskEXT);
+        }
+
+        return states;
+    }
+
+    /// @brief Whether two states can share one pipeline driven by the tracker
+    bool compatible(const RenderState& a, const RenderState& b) const {
+        return (support.extended || (a.cull_mode == b.cull_mode &&
+                                     a.front_face == b.front_face &&
+                                     a.topology == b.topology &&
+                                     a.depth_test == b.depth_test &&
+                                     a.depth_write == b.depth_write &&
+                                     a.depth_compare == b.depth_compare)) &&
+               (support.extended2 ||
+                a.primitive_restart == b.primitive_restart) &&
+               (support.blend_enable || a.blend_enable == b.blend_enable) &&
+               (support.write_mask ||
+                a.color_write_mask == b.color_write_mask);
+    }
+
+    /// @brief Forgets applied state, needed at the start of every command
+    /// buffer and after binding a pipeline with static state
+    void invalidate() { applied.reset(); }
+
+    /// @brief Records the state commands needed to reach `state`
+    /// @return Number of state commands recorded
+    uint32_t apply(const vk::raii::CommandBuffer& cmd_buf,
+                   const RenderState& state) {
+        uint32_t cmd_cnt = 0;
+        bool all = !applied.has_value();
+        const RenderState& last = all ? state : applied.value();
+
+        if (support.extended) {
+            if (all || last.cull_mode != state.cull_mode) {
+                cmd_buf.setCullMode(state.cull_mode);
+                cmd_cnt++;
+            }
+            if (all || last.front_face != state.front_face) {
+                cmd_buf.setFrontFace(state.front_face);
+                cmd_cnt++;
+            }
+            if (all || last.topology != state.topology) {
+                cmd_buf.setPrimitiveTopology(state.topology);
+                cmd_cnt++;
+            }
+            if (all || last.depth_test != state.depth_test) {
+                cmd_buf.setDepthTestEnable(state.depth_test);
+                cmd_cnt++;
+            }
+            if (all || last.depth_write != state.depth_write) {
+                cmd_buf.setDepthWriteEnable(state.depth_write);
+                cmd_cnt++;
+            }
+            if (all || last.depth_compare != state.depth_compare) {
+                cmd_buf.setDepthCompareOp(state.depth_compare);
+                cmd_cnt++;
+            }
+        }
+
+        if (support.extended2 &&
+            (all || last.primitive_restart != state.primitive_restart)) {
+            cmd_buf.setPrimitiveRestartEnable(state.primitive_restart);
+            cmd_cnt++;
+        }
+
+        if (support.blend_enable &&
+            (all || last.blend_enable != state.blend_enable)) {
+            vk::Bool32 blend_enable = state.blend_enable;
+            cmd_buf.setColorBlendEnableEXT(0, blend_enable);
+            cmd_cnt++;
+        }
+
+        if (support.blend_equation && all) {
+            cmd_buf.setColorBlendEquationEXT(0, ALPHA_BLEND_EQUATION);
+            cmd_cnt++;
+        }
+
+        if (support.write_mask &&
+            (all || last.color_write_mask != state.color_write_mask)) {
+            cmd_buf.setColorWriteMaskEXT(0, state.color_write_mask);
+            cmd_cnt++;
+        }
+
+        applied = state;
+        return cmd_cnt;
+    }
+
+   private:
+    DynamicStateSupport support;
+    std::optional<RenderState> applied;
+};
@@ -0,0 +1,110 @@
+#pragma once
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+/// @brief GPU durations of recorded command ranges, measured with timestamp
+/// queries.
+///
+/// Every frame in flight owns `scope_count` scopes of two timestamps each. A
+/// scope is read back with `read` once the fence of its frame slot has
+/// signalled, before the slot records the scope again. With `host_reset`
+/// (Vulkan 1.2 host query reset) `read` also resets the scope's queries, so
+/// recording a scope costs no reset command.
+class GpuTimer {
+   public:
+    GpuTimer(vk::raii::PhysicalDevice& phys_dev, vk::raii::Device& device,
+             uint32_t queue_family_idx, uint32_t frame_count,
+             bool host_reset = false, uint32_t scope_count = 1)
+        : scope_count(scope_count), host_reset(host_reset) {
+        if (!supported(phys_dev, queue_family_idx)) {
+            throw std::runtime_error("timestamps unsupported on queue family");
+        }
+
+        timestamp_period = phys_dev.getProperties().limits.timestampPeriod;
+
+        vk::QueryPoolCreateInfo pool_info({}, vk::QueryType::eTimestamp,
+                                          frame_count * scope_count * 2);
+        pool = device.createQueryPool(pool_info, hostCallbacks());
+        recorded.resize(frame_count * scope_count, false);
+        if (host_reset) {
+            pool.reset(0, pool_info.queryCount);
+        }
+    }
+
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+
+    static bool supported(vk::raii::PhysicalDevice& phys_dev,
+                          uint32_t queue_family_idx) {
+        auto families = phys_dev.getQueueFamilyProperties();
+        return queue_family_idx < families.size() &&
+               families[queue_family_idx].timestampValidBits > 0;
+    }
+
+    /// @brief Records the start of a scope, outside of any render pass
+    void begin(const vk::raii::CommandBuffer& cmd_buf, uint32_t frame_idx,
+               uint32_t scope = 0) {
+        reset(cmd_buf, frame_idx, scope);
+        beginInPass(cmd_buf, frame_idx, scope);
+    }
+
+    /// @brief Records the reset of a scope, outside of any render pass, for
+    /// a scope begun with `beginInPass`. Nothing with `host_reset`.
+    void reset(const vk::raii::CommandBuffer& cmd_buf, uint32_t frame_idx,
+               uint32_t scope = 0) {
+        if (!host_reset) {
+            cmd_buf.resetQueryPool(*pool, firstQuery(frame_idx, scope), 2);
+        }
+    }
+
+    /// @brief Records the start of a scope reset beforehand, which may be
+    /// inside a render pass
+    void beginInPass(const vk::raii::CommandBuffer& cmd_buf,
+                     uint32_t frame_idx, uint32_t scope = 0) {
+        cmd_buf.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, *pool,
+                               firstQuery(frame_idx, scope));
+        recorded[frame_idx * scope_count + scope] = true;
+    }
+
+    void end(const vk::raii::CommandBuffer& cmd_buf, uint32_t frame_idx,
+             uint32_t scope = 0) {
+        cmd_buf.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe,
+                               *pool, firstQuery(frame_idx, scope) + 1);
+    }
+
+    /// @brief Milliseconds the scope took when the frame slot last recorded
+    /// it, nothing if it was not recorded since the previous read
+    std::optional<double> read(uint32_t frame_idx, uint32_t scope = 0) {
+        auto idx = frame_idx * scope_count + scope;
+        if (!recorded[idx]) {
+            return std::nullopt;
+        }
+        recorded[idx] = false;
+
+        auto first = firstQuery(frame_idx, scope);
+        auto [result, stamps] = pool.getResults<uint64_t>(
+            first, 2, 2 * sizeof(uint64_t), sizeof(uint64_t),
+            vk::QueryResultFlagBits::e64);
+        if (host_reset) {
+            pool.reset(first, 2);
+        }
+        if (result != vk::Result::eSuccess) {
+            return std::nullopt;
+        }
+
+        return static_cast<double>(stamps[1] - stamps[0]) * timestamp_period /
+               1e6;
+    }
+
+   private:
+    uint32_t scope_count;
+    bool host_reset;
+    float timestamp_period = 1.0f;
+    vk::raii::QueryPool pool{nullptr};
+    std::vector<bool> recorded;
+
+    uint32_t firstQuery(uint32_t frame_idx, uint32_t scope) const {
+        return (frame_idx * scope_count + scope) * 2;
+    }
+};
@@ -0,0 +1,350 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+/// @brief Host memory handed to the driver through `vk::AllocationCallbacks`,
+/// counted per `vk::SystemAllocationScope`.
+///
+/// Requests up to the largest size class are served from pools of equally
+/// sized blocks carved out of large chunks. Every thread keeps a cache of
+/// free blocks per class and only takes the pool lock to refill or drain it
+/// in batches, so the short-lived allocations drivers make while creating
+/// objects cost a vector push or pop. Larger requests go to malloc. Pooled
+/// memory is reused but never returned to the system.
+///
+/// A block starts with a header recording its class, the request and the
+/// scope, since the free callback is given neither size nor scope. Payloads
+/// are 16-byte aligned, stricter alignments are padded within the block.
+class HostAllocator {
+   public:
+    static constexpr std::array<size_t, 10> SIZE_CLASSES = {
+        64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768};
+    static constexpr size_t CLASS_COUNT = SIZE_CLASSES.size();
+    static constexpr size_t SCOPE_COUNT = 5;
+    // Blocks moved between a thread cache and its pool at once, and the most
+    // a thread cache keeps per class
+    static constexpr size_t BATCH = 32;
+    static constexpr size_t CACHE_LIMIT = 4 * BATCH;
+    static constexpr size_t CHUNK_SIZE = 256 * 1024;
+
+    struct ScopeUsage {
+        uint64_t live_bytes = 0;
+        uint64_t allocations = 0;
+        // Reported by the driver for memory it allocated itself
+        uint64_t internal_bytes = 0;
+    };
+
+    /// @brief The process-wide allocator, never destroyed since drivers and
+    /// exiting threads may free into it during static destruction
+    static HostAllocator& global() {
+        static HostAllocator* allocator = new HostAllocator();
+        return *allocator;
+    }
+
+    HostAllocator(const HostAllocator&) = delete;
+    HostAllocator& operator=(const HostAllocator&) = delete;
+
+    /// @brief Lets `hostCallbacks` hand out the callbacks. Must happen before
+    /// the first Vulkan object is created, objects are destroyed with the
+    /// callbacks they were created with.
+    void enable() { enabled = true; }
+    bool isEnabled() const { return enabled; }
+
+    const vk::AllocationCallbacks& callbacks() const { return vk_callbacks; }
+
+    ScopeUsage usage(vk::SystemAllocationScope scope) const {
+        auto& counters = scopes[static_cast<size_t>(scope)];
+        ScopeUsage result{};
+        result.live_bytes = counters.live_bytes.load(std::memory_order_relaxed);
+        result.allocations =
+            counters.allocations.load(std::memory_order_relaxed);
+        result.internal_bytes =
+            counters.internal_bytes.load(std::memory_order_relaxed);
+        return result;
+    }
+
+    uint64_t liveBytes() const {
+        uint64_t sum = 0;
+        for (auto& counters : scopes) {
+            sum += counters.live_bytes.load(std::memory_order_relaxed) +
+                   counters.internal_bytes.load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+
+    void* allocate(size_t size, size_t alignment,
+                   vk::SystemAllocationScope scope) {
+        alignment = std::max(alignment, ALIGNMENT);
+        // Worst-case padding to align the payload past the header
+        size_t needed = size + HEADER_SIZE + alignment - ALIGNMENT;
+
+        auto size_class = classOf(needed);
+        char* block = nullptr;
+        if (size_class == LARGE_CLASS) {
+            block = static_cast<char*>(std::malloc(needed));
+        } else {
+            block = static_cast<char*>(pop(size_class));
+        }
+        if (block == nullptr) {
+            return nullptr;
+        }
+
+        auto payload = alignUp(block + HEADER_SIZE, alignment);
+        Header header{};
+        header.size = size;
+        header.offset = static_cast<uint32_t>(payload - block);
+        header.size_class = static_cast<uint16_t>(size_class);
+        header.scope = static_cast<uint16_t>(scope);
+        std::memcpy(payload - HEADER_SIZE, &header, HEADER_SIZE);
+
+        auto& counters = scopes[header.scope];
+        counters.live_bytes.fetch_add(size, std::memory_order_relaxed);
+        counters.allocations.fetch_add(1, std::memory_order_relaxed);
+        return payload;
+    }
+
+    void free(void* memory) {
+        if (memory == nullptr) {
+            return;
+        }
+
+        auto payload = static_cast<char*>(memory);
+        auto header = headerOf(payload);
+        scopes[header.scope].live_bytes.fetch_sub(header.size,
+                                                  std::memory_order_relaxed);
+
+        auto block = payload - header.offset;
+        if (header.size_class == LARGE_CLASS) {
+            std::free(block);
+        } else {
+            push(header.size_class, block);
+        }
+    }
+
+    void* reallocate(void* original, size_t size, size_t alignment,
+                     vk::SystemAllocationScope scope) {
+        if (original == nullptr) {
+            return allocate(size, alignment, scope);
+        }
+        if (size == 0) {
+            free(original);
+            return nullptr;
+        }
+
+        auto payload = static_cast<char*>(original);
+        auto header = headerOf(payload);
+
+        // Grows or shrinks in place while the block has room
+        alignment = std::max(alignment, ALIGNMENT);
+        if (header.size_class != LARGE_CLASS &&
+            reinterpret_cast<uintptr_t>(payload) % alignment == 0 &&
+            header.offset + size <= SIZE_CLASSES[header.size_class]) {
+            auto& counters = scopes[header.scope];
+            counters.live_bytes.fetch_sub(header.size,
+                                          std::memory_order_relaxed);
+            counters.live_bytes.fetch_add(size, std::memory_order_relaxed);
+            header.size = size;
+            std::memcpy(payload - HEADER_SIZE, &header, HEADER_SIZE);
+            return payload;
+        }
+
+        auto moved = allocate(size, alignment, scope);
+        if (moved == nullptr) {
+            return nullptr;
+        }
+        std::memcpy(moved, payload, std::min<size_t>(size, header.size));
+        free(original);
+        return moved;
+    }
+
+   private:
+    struct Header {
+        uint64_t size;
+        uint32_t offset;
+        uint16_t size_class;
+        uint16_t scope;
+    };
+
+    static constexpr size_t HEADER_SIZE = sizeof(Header);
+    static constexpr size_t ALIGNMENT = 16;
+    static constexpr uint16_t LARGE_CLASS = CLASS_COUNT;
+    static_assert(HEADER_SIZE == ALIGNMENT);
+
+    struct ScopeCounters {
+        std::atomic<uint64_t> live_bytes{0};
+        std::atomic<uint64_t> allocations{0};
+        std::atomic<uint64_t> internal_bytes{0};
+    };
+
+    struct Pool {
+        std::mutex mutex;
+        std::vector<void*> free_blocks;
+        std::vector<void*> chunks;
+    };
+
+    /// @brief Free blocks of one thread, drained into the pools on exit
+    struct ThreadCache {
+        std::array<std::vector<void*>, CLASS_COUNT> free_blocks;
+
+        ThreadCache() {
+            for (auto& blocks : free_blocks) {
+                blocks.reserve(CACHE_LIMIT);
+            }
+        }
+
+        ~ThreadCache() {
+            auto& allocator = HostAllocator::global();
+            for (size_t c = 0; c < CLASS_COUNT; c++) {
+                allocator.drain(c, free_blocks[c], free_blocks[c].size());
+            }
+        }
+    };
+
+    bool enabled = false;
+    std::array<Pool, CLASS_COUNT> pools;
+    std::array<ScopeCounters, SCOPE_COUNT> scopes;
+    vk::AllocationCallbacks vk_callbacks;
+
+    HostAllocator() {
+        vk_callbacks.setPUserData(this);
+        vk_callbacks.setPfnAllocation(&allocationCallback);
+        vk_callbacks.setPfnReallocation(&reallocationCallback);
+        vk_callbacks.setPfnFree(&freeCallback);
+        vk_callbacks.setPfnInternalAllocation(&internalAllocationCallback);
+        vk_callbacks.setPfnInternalFree(&internalFreeCallback);
+    }
+
+    static ThreadCache& threadCache() {
+        thread_local ThreadCache cache{};
+        return cache;
+    }
+
+    static size_t classOf(size_t size) {
+        auto it = std::lower_bound(SIZE_CLASSES.begin(), SIZE_CLASSES.end(),
+                                   size);
+        return it == SIZE_CLASSES.end()
+                   ? LARGE_CLASS
+                   : static_cast<size_t>(it - SIZE_CLASSES.begin());
+    }
+
+    static char* alignUp(char* pointer, size_t alignment) {
+        auto address = reinterpret_cast<uintptr_t>(pointer);
+        return reinterpret_cast<char*>((address + alignment - 1) &
+                                       ~(alignment - 1));
+    }
+
+    static Header headerOf(char* payload) {
+        Header header{};
+        std::memcpy(&header, payload - HEADER_SIZE, HEADER_SIZE);
+        return header;
+    }
+
+    void* pop(size_t size_class) {
+        auto& blocks = threadCache().free_blocks[size_class];
+        if (blocks.empty()) {
+            refill(size_class, blocks);
+        }
+        if (blocks.empty()) {
+            return nullptr;
+        }
+
+        auto block = blocks.back();
+        blocks.pop_back();
+        return block;
+    }
+
+    void push(size_t size_class, void* block) {
+        auto& blocks = threadCache().free_blocks[size_class];
+        if (blocks.size() == CACHE_LIMIT) {
+            drain(size_class, blocks, CACHE_LIMIT - BATCH);
+        }
+        blocks.push_back(block);
+    }
+
+    /// @brief Moves a batch of blocks from the pool into `blocks`, carving a
+    /// new chunk when the pool has none
+    void refill(size_t size_class, std::vector<void*>& blocks) {
+        auto& pool = pools[size_class];
+        std::lock_guard<std::mutex> lock(pool.mutex);
+
+        if (pool.free_blocks.empty()) {
+            auto block_size = SIZE_CLASSES[size_class];
+            auto chunk_size = std::max(CHUNK_SIZE, BATCH * block_size);
+            auto chunk = static_cast<char*>(std::malloc(chunk_size));
+            if (chunk == nullptr) {
+                return;
+            }
+            pool.chunks.push_back(chunk);
+            for (size_t offset = 0; offset + block_size <= chunk_size;
+                 offset += block_size) {
+                pool.free_blocks.push_back(chunk + offset);
+            }
+        }
+
+        auto count = std::min(BATCH, pool.free_blocks.size());
+        blocks.insert(blocks.end(), pool.free_blocks.end() - count,
+                      pool.free_blocks.end());
+        pool.free_blocks.resize(pool.free_blocks.size() - count);
+    }
+
+    /// @brief Hands the last `count` blocks of `blocks` back to the pool
+    void drain(size_t size_class, std::vector<void*>& blocks, size_t count) {
+        auto& pool = pools[size_class];
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.free_blocks.insert(pool.free_blocks.end(), blocks.end() - count,
+                                blocks.end());
+        blocks.resize(blocks.size() - count);
+    }
+
+    static VKAPI_ATTR void* VKAPI_CALL
+    allocationCallback(void* user_data, size_t size, size_t alignment,
+                       VkSystemAllocationScope scope) {
+        return static_cast<HostAllocator*>(user_data)->allocate(
+            size, alignment, static_cast<vk::SystemAllocationScope>(scope));
+    }
+
+    static VKAPI_ATTR void* VKAPI_CALL
+    reallocationCallback(void* user_data, void* original, size_t size,
+                         size_t alignment, VkSystemAllocationScope scope) {
+        return static_cast<HostAllocator*>(user_data)->reallocate(
+            original, size, alignment,
+            static_cast<vk::SystemAllocationScope>(scope));
+    }
+
+    static VKAPI_ATTR void VKAPI_CALL freeCallback(void* user_data,
+                                                   void* memory) {
+        static_cast<HostAllocator*>(user_data)->free(memory);
+    }
+
+    static VKAPI_ATTR void VKAPI_CALL internalAllocationCallback(
+        void* user_data, size_t size, VkInternalAllocationType,
+        VkSystemAllocationScope scope) {
+        static_cast<HostAllocator*>(user_data)
+            ->scopes[scope]
+            .internal_bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+
+    static VKAPI_ATTR void VKAPI_CALL internalFreeCallback(
+        void* user_data, size_t size, VkInternalAllocationType,
+        VkSystemAllocationScope scope) {
+        static_cast<HostAllocator*>(user_data)
+            ->scopes[scope]
+            .internal_bytes.fetch_sub(size, std::memory_order_relaxed);
+    }
+};
+
+/// @brief Callbacks to create and destroy Vulkan objects with, nothing when
+/// the driver allocates host memory on its own
+vk::Optional<const vk::AllocationCallbacks> hostCallbacks() {
+    auto& allocator = HostAllocator::global();
+    if (!allocator.isEnabled()) {
+        return nullptr;
+    }
+    return allocator.callbacks();
+}
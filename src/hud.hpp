@@ -0,0 +1,210 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <vector>
+
+/// @brief Device-local memory in use and available to the process, in
+/// bytes. Without VK_EXT_memory_budget only the heap sizes are known.
+struct DeviceMemoryUsage {
+    std::optional<vk::DeviceSize> usage;
+    vk::DeviceSize budget = 0;
+
+    static DeviceMemoryUsage query(const vk::raii::PhysicalDevice& phys_dev,
+                                   bool has_memory_budget) {
+        DeviceMemoryUsage result{};
+
+        if (has_memory_budget) {
+            auto props = phys_dev.getMemoryProperties2<
+                vk::PhysicalDeviceMemoryProperties2,
+                vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+            auto& heaps = props.get<vk::PhysicalDeviceMemoryProperties2>()
+                              .memoryProperties;
+            auto& budget =
+                props.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+
+            result.usage = 0;
+            for (uint32_t i = 0; i < heaps.memoryHeapCount; i++) {
+                if (heaps.memoryHeaps[i].flags &
+                    vk::MemoryHeapFlagBits::eDeviceLocal) {
+                    result.usage.value() += budget.heapUsage[i];
+                    result.budget += budget.heapBudget[i];
+                }
+            }
+            return result;
+        }
+
+        auto heaps = phys_dev.getMemoryProperties();
+        for (uint32_t i = 0; i < heaps.memoryHeapCount; i++) {
+            if (heaps.memoryHeaps[i].flags &
+                vk::MemoryHeapFlagBits::eDeviceLocal) {
+                result.budget += heaps.memoryHeaps[i].size;
+            }
+        }
+        return result;
+    }
+};
+
+/// @brief On-screen performance readout: CPU and GPU frame times, a graph of
+/// recent frame times, present mode, swapchain image count, device memory
+/// and draw counts.
+///
+/// Everything is drawn as glyphs and rectangles of a `Renderer2D`, which
+/// keeps glyphs in its atlas and submits them all in one instanced draw.
+/// Samples are pushed by the app as frames complete.
+class PerfHud {
+   public:
+    static constexpr uint32_t HISTORY = 120;
+    // Frames between memory queries, the only part costing a driver call
+    static constexpr uint32_t MEMORY_INTERVAL = 30;
+
+    bool visible = true;
+
+    explicit PerfHud(bool has_memory_budget)
+        : has_memory_budget(has_memory_budget) {}
+
+    /// @brief Records the CPU time spent on a frame, the time since the
+    /// previous frame and the draws it recorded
+    void addFrame(double cpu_ms, double frame_ms, uint32_t draws) {
+        last_cpu_ms = cpu_ms;
+        last_draws = draws;
+        frame_times[next_sample] = static_cast<float>(frame_ms);
+        next_sample = (next_sample + 1) % HISTORY;
+        sample_count = std::min(sample_count + 1, HISTORY);
+    }
+
+    void addGpuTime(double gpu_ms) { last_gpu_ms = gpu_ms; }
+
+    void setSwapchain(vk::PresentModeKHR mode, uint32_t image_count) {
+        present_mode = mode;
+        swapchain_images = image_count;
+    }
+
+    /// @brief Pixels covered by the panel, which changes every frame
+    static vk::Rect2D bounds() {
+        auto size = glm::ceil(panelSize());
+        return vk::Rect2D({static_cast<int32_t>(PANEL_MARGIN),
+                           static_cast<int32_t>(PANEL_MARGIN)},
+                          {static_cast<uint32_t>(size.x),
+                           static_cast<uint32_t>(size.y)});
+    }
+
+    /// @brief Queues the HUD into `overlay` unless hidden
+    void queue(Renderer2D& overlay, const vk::raii::PhysicalDevice& phys_dev) {
+        if (!visible) {
+            return;
+        }
+
+        if (memory_countdown == 0) {
+            memory = DeviceMemoryUsage::query(phys_dev, has_memory_budget);
+            memory_countdown = MEMORY_INTERVAL;
+        }
+        memory_countdown--;
+
+        float average_ms = 0.0f;
+        float worst_ms = 0.0f;
+        for (uint32_t i = 0; i < sample_count; i++) {
+            average_ms += frame_times[i];
+            worst_ms = std::max(worst_ms, frame_times[i]);
+        }
+        average_ms /= std::max(sample_count, 1u);
+
+        glm::vec2 origin(PANEL_MARGIN);
+        overlay.rect(origin, panelSize(), PANEL_COLOR);
+
+        char line[64];
+        glm::vec2 pen = origin + glm::vec2(PADDING);
+        auto print = [&](const glm::vec4& color) {
+            overlay.text(line, pen, TEXT_HEIGHT, color);
+            pen.y += LINE_SPACING;
+        };
+
+        std::snprintf(line, sizeof(line), "frame %6.2f ms %5.0f fps",
+                      average_ms,
+                      average_ms > 0.0f ? 1000.0f / average_ms : 0.0f);
+        print(TEXT_COLOR);
+        std::snprintf(line, sizeof(line), "cpu   %6.2f ms", last_cpu_ms);
+        print(TEXT_COLOR);
+        if (last_gpu_ms.has_value()) {
+            std::snprintf(line, sizeof(line), "gpu   %6.2f ms",
+                          last_gpu_ms.value());
+        } else {
+            std::snprintf(line, sizeof(line), "gpu   n/a");
+        }
+        print(TEXT_COLOR);
+        std::snprintf(line, sizeof(line), "%s x%u",
+                      vk::to_string(present_mode).c_str(), swapchain_images);
+        print(DIM_COLOR);
+        if (memory.usage.has_value()) {
+            std::snprintf(line, sizeof(line), "vram %5llu/%llu mb",
+                          toMegabytes(memory.usage.value()),
+                          toMegabytes(memory.budget));
+        } else {
+            std::snprintf(line, sizeof(line), "vram %llu mb",
+                          toMegabytes(memory.budget));
+        }
+        print(DIM_COLOR);
+        std::snprintf(line, sizeof(line), "draws %u", last_draws);
+        print(DIM_COLOR);
+
+        // Bars scaled to the worst recent frame, oldest on the left, with a
+        // line at the 60 Hz budget when it fits
+        float scale_ms = std::max(worst_ms, 1.0f);
+        glm::vec2 graph = pen + glm::vec2(0.0f, PADDING + GRAPH_HEIGHT);
+        for (uint32_t i = 0; i < sample_count; i++) {
+            uint32_t sample =
+                (next_sample + HISTORY - sample_count + i) % HISTORY;
+            float height = GRAPH_HEIGHT * frame_times[sample] / scale_ms;
+            bool slow = frame_times[sample] > FRAME_BUDGET_MS;
+            overlay.rect(graph + glm::vec2(i * BAR_WIDTH, -height),
+                         glm::vec2(BAR_WIDTH - 1.0f, height),
+                         slow ? SLOW_COLOR : BAR_COLOR);
+        }
+        if (FRAME_BUDGET_MS < scale_ms) {
+            float y = GRAPH_HEIGHT * FRAME_BUDGET_MS / scale_ms;
+            overlay.rect(graph - glm::vec2(0.0f, y),
+                         glm::vec2(HISTORY * BAR_WIDTH, 1.0f), DIM_COLOR);
+        }
+    }
+
+   private:
+    static constexpr uint32_t LINE_COUNT = 6;
+    static constexpr float PANEL_MARGIN = 8.0f;
+    static constexpr float PADDING = 8.0f;
+    static constexpr float TEXT_HEIGHT = 9.0f;
+    static constexpr float LINE_SPACING = 15.0f;
+    static constexpr float BAR_WIDTH = 2.0f;
+    static constexpr float GRAPH_HEIGHT = 40.0f;
+    static constexpr float FRAME_BUDGET_MS = 1000.0f / 60.0f;
+    inline static const glm::vec4 PANEL_COLOR{0.0f, 0.0f, 0.0f, 0.6f};
+    inline static const glm::vec4 TEXT_COLOR{1.0f, 1.0f, 1.0f, 1.0f};
+    inline static const glm::vec4 DIM_COLOR{0.7f, 0.7f, 0.7f, 1.0f};
+    inline static const glm::vec4 BAR_COLOR{0.3f, 0.8f, 0.4f, 1.0f};
+    inline static const glm::vec4 SLOW_COLOR{0.9f, 0.3f, 0.2f, 1.0f};
+
+    static glm::vec2 panelSize() {
+        return glm::vec2(2.0f * PADDING + HISTORY * BAR_WIDTH,
+                         3.0f * PADDING + LINE_COUNT * LINE_SPACING +
+                             GRAPH_HEIGHT);
+    }
+
+    bool has_memory_budget;
+
+    std::array<float, HISTORY> frame_times{};
+    uint32_t next_sample = 0;
+    uint32_t sample_count = 0;
+    double last_cpu_ms = 0.0;
+    std::optional<double> last_gpu_ms;
+    uint32_t last_draws = 0;
+
+    vk::PresentModeKHR present_mode = vk::PresentModeKHR::eFifo;
+    uint32_t swapchain_images = 0;
+    DeviceMemoryUsage memory{};
+    uint32_t memory_countdown = 0;
+
+    static unsigned long long toMegabytes(vk::DeviceSize bytes) {
+        return static_cast<unsigned long long>(bytes >> 20);
+    }
+};
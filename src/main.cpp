@@ -1,6 +1,11 @@
+#include <array>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <optional>
 #include <stdexcept>
+#include <thread>
 #include <unordered_set>
 
 #define GLM_FORCE_RADIANS
@@ -11,13 +16,78 @@
 // Ensure inclusion after Vulkan
 #include <GLFW/glfw3.h>
 
+#include "stats.hpp"
+#include "host_allocator.hpp"
 #include "utils.hpp"
+#include "options.hpp"
+#include "capabilities.hpp"
+#include "pipeline.hpp"
+#include "pipeline_library.hpp"
+#include "pipeline_cache.hpp"
+#include "dynamic_state.hpp"
+#include "shader_object.hpp"
+#include "descriptor_buffer.hpp"
+#include "descriptor_allocator.hpp"
+#include "bvh.hpp"
+#include "scene.hpp"
+#include "mesh_optimizer.hpp"
+#include "mesh_codec.hpp"
+#include "occlusion.hpp"
+#include "vrs.hpp"
+#include "gpu_timer.hpp"
+#include "compute_effect.hpp"
+#include "multiview.hpp"
+#include "window_target.hpp"
+#include "damage.hpp"
+#include "particles.hpp"
+#include "vertex_animation.hpp"
+#include "vector2d.hpp"
+#include "renderer2d.hpp"
+#include "hud.hpp"
+#include "device_lost.hpp"
+#include "dispatch.hpp"
+#include "batch.hpp"
 
 const std::vector<const char*> REQUIRED_DEVICE_EXTENSIONS = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 
 const uint32_t MAX_FRAMES_IN_FLIGHT = 2;
 
+const vk::Format DEPTH_FORMAT = vk::Format::eD32Sfloat;
+// Swapchain images have a single mip level and layer
+const vk::ImageSubresourceRange COLOR_RANGE(vk::ImageAspectFlagBits::eColor, 0,
+                                            1, 0, 1);
+
+// Scene time advanced per frame, fixed so that the BVH can be refit for the
+// next frame ahead of time
+const float ANIMATION_STEP = 1.0f / 60.0f;
+// Panel of the 2D overlay, the only pixels it changes every frame
+const vk::Rect2D OVERLAY_PANEL({16, 16}, {280, 132});
+// Half extent of the area a right click lists objects in, in world units
+const float PICK_RANGE = 0.1f;
+// Frames whose GPU time is averaged per printed timing
+const uint32_t TIMING_INTERVAL = 120;
+// GPU timer scopes: the whole frame, the culling and the scene pass of each
+// culling phase, the effects after the scene pass and the overlay draw
+const uint32_t FRAME_SCOPE = 0;
+const uint32_t CULL_SCOPE = 1;
+const uint32_t SCENE_SCOPE = CULL_SCOPE + OcclusionCuller::PHASE_COUNT;
+const uint32_t EFFECT_SCOPE = SCENE_SCOPE + OcclusionCuller::PHASE_COUNT;
+const uint32_t OVERLAY_SCOPE = EFFECT_SCOPE + 1;
+const uint32_t GPU_SCOPE_COUNT = OVERLAY_SCOPE + 1;
+// Iterations of four commands per recording, and recordings timed, in the
+// dispatch benchmark
+const uint32_t DISPATCH_BENCH_ITERATIONS = 25000;
+const uint32_t DISPATCH_BENCH_ROUNDS = 5;
+// World units between the cameras of neighbouring multiview views
+const float VIEW_SPACING = 0.25f;
+// Device re-creations tried after a loss before giving up, waiting one more
+// backoff step before each retry
+const uint32_t MAX_RECOVERY_ATTEMPTS = 5;
+const std::chrono::milliseconds RECOVERY_BACKOFF{250};
+// Crash markers are appended here, and printed, when the device is lost
+const char* const CRASH_REPORT_PATH = "device_lost.log";
+
 const std::vector<Vertex> VERTICES = {
     {{0.5, 0.5}, {1, 0, 0}},
     {{0, 0}, {0, 0, 1}},
@@ -38,8 +108,14 @@ const std::vector<Vertex> VERTICES = {
 
 class App {
    public:
+    explicit App(AppOptions app_options) : options(app_options) {}
+
     /// @brief Initializes GLFW and Vulkan components in the correct order
     void init() {
+        if (options.host_allocator) {
+            HostAllocator::global().enable();
+        }
+
         initGlfw();
         gatherVkLayers();
         gatherVkExtensions();
@@ -47,72 +123,406 @@ class App {
 #ifndef NDEBUG
         initValidation();
 #endif
-        initWindow();
-        initSurface();
-        initPhysicalDevice();
-        initDevice();
-        initVertexBuffer();
-        createSyncObjects();
-        createRenderPass();
-        createPipeline();
+        initWindows();
+        if (!options.mesh_file.empty()) {
+            loadSceneMesh();
+        } else if (options.optimize_mesh) {
+            optimizeSceneMesh();
+        }
+        // Outlives the device, every swapchain resets it
+        if (options.damage_tracking) {
+            damage.emplace();
+        }
+
+        auto device_start = std::chrono::steady_clock::now();
+        initDeviceResources();
+        if (options.bench) {
+            std::cout << "init: device and resources in "
+                      << millisecondsSince(device_start) << " ms" << std::endl;
+            std::cout << "device: " << capabilities.describe() << std::endl;
+        }
+
+        if (options.hud) {
+            hud.emplace(capabilities.memory_budget);
+        }
+
+        if (options.bench) {
+            benchmarkPipelinePermutations();
+            benchmarkDispatch();
+            printHostAllocations();
+        }
+
+        if (!options.stats_socket.empty()) {
+            stats_server.emplace(StatsRegistry::global(),
+                                 options.stats_socket);
+        }
     }
 
     /// @brief Runs window's event loop
     void runLoop() {
-        while (!glfwWindowShouldClose(window)) {
-            glfwPollEvents();
+        while (!anyWindowClosed()) {
+            // The scene passes render into the main window, nothing is drawn
+            // while it is minimized
+            if (mainWindow().minimized()) {
+                glfwWaitEvents();
+                continue;
+            }
 
-            if (swapchain_rebuild_needed) {
-                rebuildSwapchain();
+            // Idle windows keep showing the last presented image, nothing is
+            // drawn until an event marks the frame dirty
+            if ((options.on_demand || undamaged) && !needsFrame()) {
+                StatsRegistry::global().add(Counter::IdleWaits);
+                glfwWaitEvents();
+                if (!needsFrame()) {
+                    continue;
+                }
+                // The time spent idle is not part of the next frame
+                last_frame_start = std::chrono::steady_clock::now();
+            } else {
+                glfwPollEvents();
             }
 
-            drawFrame();
+            try {
+                rebuildWindowTargets();
+
+                drawFrame();
+            } catch (vk::DeviceLostError& err) {
+                recoverFromDeviceLost(err);
+            }
         }
 
-        vk_device.value().waitIdle();
+        try {
+            vk_device.value().waitIdle();
+            storePipelineCache();
+        } catch (vk::DeviceLostError& err) {
+            // Nothing left to save, the cache file keeps the last good data
+            std::cerr << "device lost on exit: " << err.what() << std::endl;
+        }
     }
 
     ~App() {
-        glfwDestroyWindow(window);
+        window_targets.clear();
         glfwTerminate();
     }
 
    private:
+    /// @brief Creates the device and everything created from it in the
+    /// correct order, on startup and to replace a lost device
+    void initDeviceResources() {
+        initPhysicalDevice();
+        initDevice();
+        if (options.direct_dispatch) {
+            vk_dispatch = DeviceDispatch::load(vk_device.value());
+        }
+        createPipelineCache();
+        initVertexBuffer();
+        initUniformBuffers();
+        createSyncObjects();
+        if (options.views > 1) {
+            createMultiview();
+        }
+        createRenderPass();
+        createDescriptorSetLayout();
+        createPipelineLayout();
+        createDescriptors();
+
+        if (crash_marker_kind.has_value()) {
+            vk_crash_markers.emplace(vk_physical_device.value(),
+                                     vk_device.value(),
+                                     crash_marker_kind.value(),
+                                     MAX_FRAMES_IN_FLIGHT);
+        }
+
+        if (has_occlusion_culling) {
+            createOcclusionCulling();
+        }
+
+        if (shading_rate_support.attachment_rate) {
+            vk_shading_rate_image.emplace(
+                vk_physical_device.value(), vk_device.value(),
+                vk_pipeline_cache, vk_descriptor_cache.value(),
+                shading_rate_support);
+        }
+
+        if (options.compute_effect) {
+            createComputeEffect();
+        }
+
+        if (options.particle_count > 0) {
+            vk_particles.emplace(vk_physical_device.value(), vk_device.value(),
+                                 vk_pipeline_cache, vk_descriptor_cache.value(),
+                                 options.particle_count, VERTICES,
+                                 *vk_render_pass.value(), render_state);
+        }
+
+        if (options.animate_vertices) {
+            createVertexAnimation();
+        }
+
+        if (options.vector_overlay || options.hud) {
+            vk_overlay.emplace(vk_physical_device.value(), vk_device.value(),
+                               vk_pipeline_cache, vk_descriptor_cache.value(),
+                               *vk_render_pass.value(), MAX_FRAMES_IN_FLIGHT);
+        }
+
+        if ((options.bench || options.hud || !options.stats_socket.empty()) &&
+            GpuTimer::supported(vk_physical_device.value(),
+                                vk_q_families_info->graphics_family_idx)) {
+            vk_gpu_timer.emplace(vk_physical_device.value(), vk_device.value(),
+                                 vk_q_families_info->graphics_family_idx,
+                                 MAX_FRAMES_IN_FLIGHT,
+                                 capabilities.host_query_reset,
+                                 GPU_SCOPE_COUNT);
+        }
+
+        if (has_shader_object) {
+            createShaderObjects();
+        } else {
+            createPipeline();
+        }
+
+        storePipelineCache();
+    }
+
+    /// @brief Releases everything created from the device, then the device
+    /// itself. Nothing is waited for, a lost device completes no work.
+    void destroyDeviceResources() {
+        if (scene_index_worker.has_value()) {
+            scene_index_worker->wait();
+        }
+
+        vk_fences.clear();
+        vk_descriptor_buffer.reset();
+        vk_descriptor_cache.reset();
+        vk_descriptor_allocator.reset();
+        vk_uniform_buffers.clear();
+        vk_index_buffer.reset();
+        vk_vb_memory.reset();
+        vk_vertex_buffer.reset();
+        vk_shading_rate_image.reset();
+        vk_depth_view.reset();
+        vk_depth_image.reset();
+        for (auto& target : window_targets) {
+            target->release();
+        }
+        vk_cmd_buffers.reset();
+        vk_pipeline_cache = nullptr;
+        vk_object_pipeline.reset();
+        vk_object_pipeline_layout.reset();
+        vk_overlay.reset();
+        vk_vertex_animator.reset();
+        vk_particles.reset();
+        vk_crash_markers.reset();
+        vk_gpu_timer.reset();
+        vk_effect_base_pipeline.reset();
+        vk_compute_effect.reset();
+        vk_multiview.reset();
+        vk_occlusion_culler.reset();
+        vk_shader_program.reset();
+        vk_pipeline_library.reset();
+        vk_pipeline.reset();
+        vk_pipeline_layout.reset();
+        vk_descriptor_set_layout.reset();
+        vk_render_pass_load.reset();
+        vk_render_pass.reset();
+        vk_cmd_pool.reset();
+        vk_present_queue.reset();
+        vk_graphics_queue.reset();
+        vk_pipeline_cache_object.reset();
+        vk_dispatch.reset();
+        vk_device.reset();
+        vk_surface_info.reset();
+        vk_q_families_info.reset();
+        vk_physical_device.reset();
+
+        // Support is negotiated again with the new device
+        has_pipeline_library = false;
+        has_shader_object = false;
+        has_descriptor_buffer = false;
+        has_occlusion_culling = false;
+        capabilities = {};
+        crash_marker_kind.reset();
+        dynamic_state_support = {};
+        shading_rate_support = {};
+        dynamic_state.reset();
+    }
+
+    /// @brief Reports where the GPU stopped, then replaces the device and
+    /// everything created from it. The instance, windows and surfaces are
+    /// kept, the rest is rebuilt from the options, `VERTICES` and the scene
+    /// description, with pipelines served from the on-disk cache.
+    void recoverFromDeviceLost(const vk::DeviceLostError& err) {
+        std::cerr << "device lost: " << err.what() << std::endl;
+        StatsRegistry::global().add(Counter::DeviceLosses);
+        if (vk_crash_markers.has_value()) {
+            writeCrashReport();
+        }
+
+        for (uint32_t attempt = 1;; attempt++) {
+            destroyDeviceResources();
+            try {
+                initDeviceResources();
+                break;
+            } catch (vk::SystemError& retry_err) {
+                if (attempt == MAX_RECOVERY_ATTEMPTS) {
+                    throw;
+                }
+                std::cerr << "failed to re-create device: "
+                          << retry_err.what() << std::endl;
+                std::this_thread::sleep_for(RECOVERY_BACKOFF * attempt);
+            }
+        }
+
+        current_frame = 0;
+        std::cerr << "device re-created" << std::endl;
+    }
+
+    void writeCrashReport() {
+        auto report = vk_crash_markers->report(vk_graphics_queue.value());
+        std::cerr << report;
+
+        std::ofstream file(CRASH_REPORT_PATH, std::ios::app);
+        file << "device lost after " << frame_counter << " frames\n"
+             << report;
+    }
+
+    /// @brief Creates the cache every pipeline is created with, seeded with
+    /// the data an earlier run or the lost device left on disk
+    void createPipelineCache() {
+        if (options.pipeline_cache.empty()) {
+            return;
+        }
+
+        auto data = loadPipelineCacheData(
+            options.pipeline_cache, vk_physical_device->getProperties());
+        vk::PipelineCacheCreateInfo cache_info({}, data.size(), data.data());
+        vk_pipeline_cache_object =
+            vk_device.value().createPipelineCache(cache_info, hostCallbacks());
+        vk_pipeline_cache = vk::Optional<const vk::raii::PipelineCache>(
+            vk_pipeline_cache_object.value());
+    }
+
+    void storePipelineCache() {
+        if (vk_pipeline_cache_object.has_value()) {
+            storePipelineCacheData(options.pipeline_cache,
+                                   vk_pipeline_cache_object.value());
+        }
+    }
+
     const vk::raii::Context vk_context{};
+    const AppOptions options;
+    bool has_pipeline_library = false;
+    bool has_shader_object = false;
+    bool has_descriptor_buffer = false;
+    bool has_occlusion_culling = false;
+    DeviceCapabilities capabilities{};
+    std::optional<CrashMarkerKind> crash_marker_kind;
+    DynamicStateSupport dynamic_state_support{};
+    ShadingRateSupport shading_rate_support{};
+    std::optional<DynamicStateTracker> dynamic_state;
+    RenderState render_state{};
+    Camera2D camera{};
+    // Lab effect applied by vk_compute_effect instead of the fragment shader
+    bool use_compute_effect = false;
+    // Effect path each frame slot was timed with, and GPU time summed per
+    // path (fragment, compute) since the last print
+    std::array<bool, MAX_FRAMES_IN_FLIGHT> timed_compute_effect{};
+    std::array<double, 2> effect_time_ms{};
+    std::array<uint32_t, 2> effect_time_samples{};
     bool window_changed_size = false;
-    bool swapchain_rebuild_needed = true;
+    // Something visible changed since the last presented frame, only read
+    // in on-demand mode and by damage tracking
+    bool frame_dirty = true;
+    // The last frame had no damage and was not drawn, the loop waits for
+    // events as in on-demand mode
+    bool undamaged = false;
     uint32_t current_frame = 0;
+    uint32_t frame_counter = 0;
+    const std::chrono::steady_clock::time_point start_time =
+        std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point last_frame_start = start_time;
+    // Draw commands in the last recorded command buffer
+    uint32_t recorded_draws = 0;
 
     std::optional<vk::raii::Instance> vk_instance;
-    std::optional<vk::raii::SurfaceKHR> vk_surface;
     std::optional<vk::raii::PhysicalDevice> vk_physical_device;
     std::optional<vk::raii::Device> vk_device;
-    std::optional<vk::raii::SwapchainKHR> vk_swapchain;
+    // Backs vk_pipeline_cache, declared before the pipeline library whose
+    // background link still uses it
+    std::optional<vk::raii::PipelineCache> vk_pipeline_cache_object;
+    // Hot-path entry points, recorded and submitted through instead of the
+    // vk::raii dispatcher
+    std::optional<DeviceDispatch> vk_dispatch;
     std::optional<QueueFamiliesInfo> vk_q_families_info;
     std::optional<vk::raii::Queue> vk_graphics_queue;
     std::optional<vk::raii::Queue> vk_present_queue;
     std::optional<vk::raii::CommandPool> vk_cmd_pool;
     std::optional<SurfaceInfo> vk_surface_info;
     std::optional<vk::raii::RenderPass> vk_render_pass;
+    // Second culling phase or damage repaint, draws over what
+    // vk_render_pass left
+    std::optional<vk::raii::RenderPass> vk_render_pass_load;
+    std::optional<vk::raii::DescriptorSetLayout> vk_descriptor_set_layout;
+    std::optional<vk::raii::PipelineLayout> vk_pipeline_layout;
     std::optional<vk::raii::Pipeline> vk_pipeline;
+    std::optional<PipelineLibrary> vk_pipeline_library;
+    std::optional<ShaderObjectProgram> vk_shader_program;
+    std::optional<OcclusionCuller> vk_occlusion_culler;
+    std::optional<ComputeEffect> vk_compute_effect;
+    // Scene pipeline writing base colors into the compute effect's pass
+    std::optional<vk::raii::Pipeline> vk_effect_base_pipeline;
+    // Layered target of the scene pass when several views are drawn
+    std::optional<MultiviewTarget> vk_multiview;
+    std::optional<GpuTimer> vk_gpu_timer;
+    std::optional<CrashMarkers> vk_crash_markers;
+    std::optional<ParticleSystem> vk_particles;
+    std::optional<VertexAnimator> vk_vertex_animator;
+    std::optional<Renderer2D> vk_overlay;
+    std::optional<PerfHud> hud;
+    std::optional<DamageTracker> damage;
+    std::optional<StatsServer> stats_server;
+    std::optional<vk::raii::PipelineLayout> vk_object_pipeline_layout;
+    std::optional<vk::raii::Pipeline> vk_object_pipeline;
+
+    // VERTICES indexed and reordered once at startup, drawn in its place
+    std::optional<IndexedMesh> scene_mesh;
+    // Compressed scene mesh read from --mesh-file, decoded straight into the
+    // vertex and index buffers in place of scene_mesh
+    std::vector<uint8_t> scene_mesh_asset;
+    uint32_t scene_index_count = 0;
+    std::optional<Scene> scene;
+    MeshBounds scene_mesh_bounds{};
+    SpatialIndex scene_index;
+    std::vector<uint32_t> cull_candidates;
+    // Refits scene_index for the next frame, declared after everything it
+    // touches so that it is stopped first on destruction
+    std::optional<SpatialIndexWorker> scene_index_worker;
 
     vk::Optional<const vk::raii::PipelineCache> vk_pipeline_cache{nullptr};
 
     std::optional<vk::raii::CommandBuffers> vk_cmd_buffers;
-    std::vector<vk::Image> vk_sc_images;
-    std::vector<vk::raii::ImageView> vk_sc_imageviews;
-    std::vector<vk::raii::Framebuffer> vk_sc_framebuffers;
+    std::optional<AllocatedImage> vk_depth_image;
+    std::optional<vk::raii::ImageView> vk_depth_view;
+    std::optional<ShadingRateImage> vk_shading_rate_image;
     std::optional<vk::raii::Buffer> vk_vertex_buffer;
     std::optional<vk::raii::DeviceMemory> vk_vb_memory;
+    // Indices of the scene, only with --optimize-mesh or --mesh-file
+    std::optional<AllocatedBuffer> vk_index_buffer;
+    std::vector<AllocatedBuffer> vk_uniform_buffers;
+
+    std::optional<DescriptorAllocator> vk_descriptor_allocator;
+    std::optional<DescriptorSetCache> vk_descriptor_cache;
+    std::optional<DescriptorBuffer> vk_descriptor_buffer;
 
-    std::vector<vk::raii::Semaphore> vk_image_available_sema;
-    std::vector<vk::raii::Semaphore> vk_render_finished_sema;
     std::vector<vk::raii::Fence> vk_fences;
 
     std::vector<const char*> instance_extensions;
     std::vector<const char*> instance_layers;
 
-    GLFWwindow* window = nullptr;
+    // Every window, drawn in the same frames. The first is the main window,
+    // the one the scene passes and effects render into, the others draw the
+    // scene on its own.
+    std::vector<std::unique_ptr<WindowTarget>> window_targets;
 
 #ifndef NDEBUG
     const bool enable_validation_layers = true;
@@ -132,7 +542,7 @@ class App {
             debugUtilsMessengerCallback};
 
         debug_messenger = vk_instance.value().createDebugUtilsMessengerEXT(
-            debug_messenger_info);
+            debug_messenger_info, hostCallbacks());
     }
 #else
     const bool enable_validation_layers = false;
@@ -183,6 +593,11 @@ class App {
 
             instance_layers.emplace_back(layer);
         }
+
+        if (options.shader_object &&
+            layer_set.count(SHADER_OBJECT_EMULATION_LAYER) != 0) {
+            instance_layers.emplace_back(SHADER_OBJECT_EMULATION_LAYER);
+        }
     }
 
     /// @brief Checks availability of necessary extensions and records them
@@ -235,59 +650,180 @@ class App {
         inst_info.enabledLayerCount = instance_layers.size();
         inst_info.ppEnabledLayerNames = instance_layers.data();
 
-        vk_instance = vk_context.createInstance(inst_info);
+        vk_instance = vk_context.createInstance(inst_info, hostCallbacks());
+    }
+
+    /// @brief Opens the main window and the extra ones with their surfaces,
+    /// all sharing the keyboard and scroll controls. Picking only applies to
+    /// the main window.
+    void initWindows() {
+        for (uint32_t i = 0; i < options.windows; i++) {
+            auto title = i == 0 ? std::string("App")
+                                : "App " + std::to_string(i + 1);
+            auto& target = window_targets.emplace_back(
+                std::make_unique<WindowTarget>(vk_instance.value(), 800, 600,
+                                               title));
+            GLFWwindow* window = target->glfwWindow();
+            glfwSetWindowUserPointer(window, this);
+            glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+            glfwSetKeyCallback(window, keyCallback);
+            glfwSetScrollCallback(window, scrollCallback);
+            glfwSetWindowRefreshCallback(window, refreshCallback);
+            if (i == 0) {
+                glfwSetMouseButtonCallback(window, mouseButtonCallback);
+            }
+        }
+    }
+
+    WindowTarget& mainWindow() { return *window_targets.front(); }
+
+    const WindowTarget& mainWindow() const { return *window_targets.front(); }
+
+    /// @brief Whether any window was asked to close, which ends the run
+    bool anyWindowClosed() const {
+        return std::any_of(window_targets.begin(), window_targets.end(),
+                           [](const std::unique_ptr<WindowTarget>& target) {
+                               return glfwWindowShouldClose(
+                                   target->glfwWindow());
+                           });
+    }
+
+    /// @brief Whether the next loop iteration has to draw: something marked
+    /// the frame dirty or the scene animates on its own
+    bool needsFrame() const {
+        return frame_dirty || mainWindow().rebuild_needed || animating();
+    }
+
+    /// @brief Whether every frame differs from the previous one
+    bool animating() const {
+        return sceneAnimating() || options.vector_overlay;
+    }
+
+    /// @brief Whether the scene itself moves every frame, anywhere in the
+    /// image
+    bool sceneAnimating() const {
+        return scene.has_value() || vk_particles.has_value() ||
+               vk_vertex_animator.has_value();
     }
 
-    /// @brief Creates an empty window
-    void initWindow() {
-        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-        glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
-        window = glfwCreateWindow(800, 600, "App", nullptr, nullptr);
-        glfwSetWindowUserPointer(window, this);
-        glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+    static void refreshCallback(GLFWwindow* window) {
+        auto app = reinterpret_cast<App*>(glfwGetWindowUserPointer(window));
+        app->frame_dirty = true;
     }
 
     static void framebufferResizeCallback(GLFWwindow* window, int width,
                                           int height) {
         auto app = reinterpret_cast<App*>(glfwGetWindowUserPointer(window));
-        app->swapchain_rebuild_needed = true;
+        app->frame_dirty = true;
+        for (auto& target : app->window_targets) {
+            if (target->glfwWindow() == window) {
+                target->rebuild_needed = true;
+            }
+        }
     }
 
-    /// @brief Creates a Vulkan surface on the window
-    void initSurface() {
-        auto& instance = vk_instance.value();
-
-        VkSurfaceKHR* surface = new VkSurfaceKHR();
-
-        if (glfwCreateWindowSurface(*instance, window, nullptr, surface) !=
-            VK_SUCCESS) {
-            throw std::runtime_error("failed to create window surface");
+    static void keyCallback(GLFWwindow* window, int key, int scancode,
+                            int action, int mods) {
+        auto app = reinterpret_cast<App*>(glfwGetWindowUserPointer(window));
+        if (action == GLFW_RELEASE) {
+            return;
+        }
+        app->frame_dirty = true;
+
+        float step = 0.1f / app->camera.zoom;
+        switch (key) {
+            case GLFW_KEY_LEFT:
+                app->camera.center.x -= step;
+                break;
+            case GLFW_KEY_RIGHT:
+                app->camera.center.x += step;
+                break;
+            case GLFW_KEY_UP:
+                app->camera.center.y -= step;
+                break;
+            case GLFW_KEY_DOWN:
+                app->camera.center.y += step;
+                break;
+            case GLFW_KEY_H:
+                if (action == GLFW_PRESS && app->hud.has_value()) {
+                    app->hud->visible = !app->hud->visible;
+                }
+                break;
+            case GLFW_KEY_E:
+                if (action == GLFW_PRESS && app->vk_compute_effect.has_value()) {
+                    app->use_compute_effect = !app->use_compute_effect;
+                    std::cout << "effect: "
+                              << (app->use_compute_effect ? "compute"
+                                                          : "fragment")
+                              << std::endl;
+                }
+                break;
         }
+    }
 
-        vk::raii::SurfaceKHR raii_surface(instance, *surface);
+    static void scrollCallback(GLFWwindow* window, double x_offset,
+                               double y_offset) {
+        auto app = reinterpret_cast<App*>(glfwGetWindowUserPointer(window));
+        app->frame_dirty = true;
+        app->camera.zoom = std::clamp(
+            app->camera.zoom * std::pow(1.1f, static_cast<float>(y_offset)),
+            0.25f, 16.0f);
+    }
 
-        vk_surface = std::move(raii_surface);
+    static void mouseButtonCallback(GLFWwindow* window, int button,
+                                    int action, int mods) {
+        auto app = reinterpret_cast<App*>(glfwGetWindowUserPointer(window));
+        if (action == GLFW_PRESS) {
+            app->pick(button);
+        }
     }
 
-    bool checkDeviceExtensions(vk::raii::PhysicalDevice& phys_dev) {
-        std::unordered_set<std::string> extension_set{};
-        for (auto ext : phys_dev.enumerateDeviceExtensionProperties()) {
-            std::string extname{static_cast<const char*>(ext.extensionName)};
-            extension_set.insert(extname);
+    /// @brief Reports the scene object under the cursor on left click and
+    /// the objects around it on right click
+    void pick(int button) {
+        if (!scene.has_value()) {
+            return;
         }
 
-        for (auto req_ext : REQUIRED_DEVICE_EXTENSIONS) {
-            if (extension_set.count(req_ext) == 0) {
-                return false;
+        double x = 0, y = 0;
+        int width = 0, height = 0;
+        GLFWwindow* window = mainWindow().glfwWindow();
+        glfwGetCursorPos(window, &x, &y);
+        glfwGetWindowSize(window, &width, &height);
+        if (width == 0 || height == 0) {
+            return;
+        }
+
+        glm::vec2 ndc(2.0 * x / width - 1.0, 2.0 * y / height - 1.0);
+        auto world = camera.toWorld(ndc);
+        auto snapshot = scene_index.snapshot();
+
+        if (button == GLFW_MOUSE_BUTTON_LEFT) {
+            // Looking into the screen, the nearest object has the least depth
+            auto hit = snapshot->raycast(
+                Ray{glm::vec3(world, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)});
+            if (hit.has_value()) {
+                std::cout << "picked object " << hit->object << " at depth "
+                          << hit->t << std::endl;
             }
+        } else if (button == GLFW_MOUSE_BUTTON_RIGHT) {
+            std::vector<uint32_t> nearby{};
+            snapshot->queryBox(
+                Aabb{glm::vec3(world - glm::vec2(PICK_RANGE), 0.0f),
+                     glm::vec3(world + glm::vec2(PICK_RANGE), 1.0f)},
+                nearby);
+            std::cout << nearby.size() << " objects near cursor" << std::endl;
         }
+    }
 
-        return true;
+    bool checkDeviceExtensions(vk::raii::PhysicalDevice& phys_dev) {
+        return hasExtensions(getDeviceExtensionSet(phys_dev, instance_layers),
+                             REQUIRED_DEVICE_EXTENSIONS);
     }
 
     void initPhysicalDevice() {
         auto& instance = vk_instance.value();
-        auto& surface = vk_surface.value();
+        auto& surface = mainWindow().windowSurface();
 
         for (auto phys_dev : instance.enumeratePhysicalDevices()) {
             auto queues_info = QueueFamiliesInfo::from(phys_dev, surface);
@@ -333,10 +869,171 @@ class App {
             qc_infos.emplace_back(dqci);
         }
 
+        auto extension_set =
+            getDeviceExtensionSet(physical_device, instance_layers);
+        std::vector<const char*> device_extensions = REQUIRED_DEVICE_EXTENSIONS;
+        // Enabled feature structs are prepended to this pNext chain
+        void* feature_chain = nullptr;
+
+        capabilities =
+            DeviceCapabilities::query(physical_device, extension_set);
+        device_extensions.insert(device_extensions.end(),
+                                 capabilities.extensions.begin(),
+                                 capabilities.extensions.end());
+        capabilities.chainFeatures(feature_chain);
+        PipelineCacheFeedback::global().enable(
+            capabilities.pipeline_creation_feedback);
+
+        // Shader objects draw outside render passes, with dynamic rendering
+        vk::PhysicalDeviceShaderObjectFeaturesEXT so_features{};
+        if (options.shader_object && capabilities.dynamic_rendering &&
+            hasExtensions(extension_set, SHADER_OBJECT_DEVICE_EXTENSIONS)) {
+            auto features = physical_device.getFeatures2<
+                vk::PhysicalDeviceFeatures2,
+                vk::PhysicalDeviceShaderObjectFeaturesEXT>();
+            has_shader_object =
+                features.get<vk::PhysicalDeviceShaderObjectFeaturesEXT>()
+                    .shaderObject;
+        }
+        if (has_shader_object) {
+            device_extensions.insert(device_extensions.end(),
+                                     SHADER_OBJECT_DEVICE_EXTENSIONS.begin(),
+                                     SHADER_OBJECT_DEVICE_EXTENSIONS.end());
+            so_features.setShaderObject(true);
+            so_features.setPNext(feature_chain);
+            feature_chain = &so_features;
+        } else if (options.shader_object) {
+            std::cerr << "shader objects unsupported, drawing with pipelines"
+                      << std::endl;
+        }
+
+        vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT gpl_features{};
+        if (options.pipeline_library && !has_shader_object &&
+            hasExtensions(extension_set, PIPELINE_LIBRARY_DEVICE_EXTENSIONS)) {
+            auto features = physical_device.getFeatures2<
+                vk::PhysicalDeviceFeatures2,
+                vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>();
+            has_pipeline_library =
+                features
+                    .get<vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>()
+                    .graphicsPipelineLibrary;
+        }
+        if (has_pipeline_library) {
+            device_extensions.insert(device_extensions.end(),
+                                     PIPELINE_LIBRARY_DEVICE_EXTENSIONS.begin(),
+                                     PIPELINE_LIBRARY_DEVICE_EXTENSIONS.end());
+            gpl_features.setGraphicsPipelineLibrary(true);
+            gpl_features.setPNext(feature_chain);
+            feature_chain = &gpl_features;
+        }
+
+        // Buffer device addresses are enabled with the capabilities
+        vk::PhysicalDeviceDescriptorBufferFeaturesEXT db_features{};
+        if (options.descriptor_buffer && capabilities.buffer_device_address &&
+            hasExtensions(extension_set, DESCRIPTOR_BUFFER_DEVICE_EXTENSIONS)) {
+            auto features = physical_device.getFeatures2<
+                vk::PhysicalDeviceFeatures2,
+                vk::PhysicalDeviceDescriptorBufferFeaturesEXT>();
+            has_descriptor_buffer =
+                features.get<vk::PhysicalDeviceDescriptorBufferFeaturesEXT>()
+                    .descriptorBuffer;
+        }
+        if (has_descriptor_buffer) {
+            device_extensions.insert(device_extensions.end(),
+                                     DESCRIPTOR_BUFFER_DEVICE_EXTENSIONS.begin(),
+                                     DESCRIPTOR_BUFFER_DEVICE_EXTENSIONS.end());
+            db_features.setDescriptorBuffer(true);
+            db_features.setPNext(feature_chain);
+            feature_chain = &db_features;
+        } else if (options.descriptor_buffer) {
+            std::cerr << "descriptor buffers unsupported, using descriptor "
+                         "sets"
+                      << std::endl;
+        }
+
+        if (options.dynamic_state && !has_shader_object) {
+            dynamic_state_support =
+                DynamicStateSupport::from(physical_device, extension_set);
+
+            if (dynamic_state_support.extended) {
+                device_extensions.insert(
+                    device_extensions.end(),
+                    dynamic_state_support.extensions.begin(),
+                    dynamic_state_support.extensions.end());
+                dynamic_state_support.chainFeatures(feature_chain);
+                dynamic_state.emplace(dynamic_state_support);
+            } else {
+                std::cerr << "extended dynamic state unsupported, baking "
+                             "state into pipelines"
+                          << std::endl;
+            }
+        }
+
+        has_occlusion_culling =
+            options.occlusion_culling && capabilities.draw_indirect_count;
+        if (options.occlusion_culling && !has_occlusion_culling) {
+            std::cerr << "indirect draw count unsupported, drawing without "
+                         "occlusion culling"
+                      << std::endl;
+        }
+
+        bool wants_pipeline_rate = options.shading_rate != 1;
+        if ((wants_pipeline_rate || options.adaptive_shading) &&
+            physical_device.getProperties().apiVersion >= VK_API_VERSION_1_2 &&
+            hasExtensions(extension_set, SHADING_RATE_DEVICE_EXTENSIONS)) {
+            // The rate analysis samples presented images
+            bool samplable = static_cast<bool>(
+                vk_surface_info->supported_usage &
+                vk::ImageUsageFlagBits::eSampled);
+            shading_rate_support = ShadingRateSupport::from(
+                physical_device, wants_pipeline_rate,
+                options.adaptive_shading && samplable);
+        }
+        if (shading_rate_support.any()) {
+            device_extensions.insert(device_extensions.end(),
+                                     SHADING_RATE_DEVICE_EXTENSIONS.begin(),
+                                     SHADING_RATE_DEVICE_EXTENSIONS.end());
+            shading_rate_support.chainFeatures(feature_chain);
+        }
+        if (wants_pipeline_rate && !shading_rate_support.pipeline_rate) {
+            std::cerr << "pipeline shading rate unsupported, shading every "
+                         "pixel"
+                      << std::endl;
+        }
+        if (options.adaptive_shading && !shading_rate_support.attachment_rate) {
+            std::cerr << "shading rate attachments unsupported, shading "
+                         "without adaptive rates"
+                      << std::endl;
+        }
+
+        // Checkpoints name the stage work stopped in, buffer markers only
+        // tell finished from started
+        if (options.crash_markers) {
+            if (hasExtensions(extension_set, CHECKPOINT_DEVICE_EXTENSIONS)) {
+                crash_marker_kind = CrashMarkerKind::Checkpoints;
+                device_extensions.insert(device_extensions.end(),
+                                         CHECKPOINT_DEVICE_EXTENSIONS.begin(),
+                                         CHECKPOINT_DEVICE_EXTENSIONS.end());
+            } else if (hasExtensions(extension_set,
+                                     BUFFER_MARKER_DEVICE_EXTENSIONS)) {
+                crash_marker_kind = CrashMarkerKind::BufferMarkers;
+                device_extensions.insert(
+                    device_extensions.end(),
+                    BUFFER_MARKER_DEVICE_EXTENSIONS.begin(),
+                    BUFFER_MARKER_DEVICE_EXTENSIONS.end());
+            } else {
+                std::cerr << "diagnostic checkpoints and buffer markers "
+                             "unsupported, device loss reports only the error"
+                          << std::endl;
+            }
+        }
+
         vk::DeviceCreateInfo device_create_info({}, qc_infos, instance_layers,
-                                                REQUIRED_DEVICE_EXTENSIONS);
+                                                device_extensions);
+        device_create_info.setPNext(feature_chain);
 
-        vk_device = physical_device.createDevice(device_create_info);
+        vk_device = physical_device.createDevice(device_create_info,
+                                                 hostCallbacks());
 
         auto& device = vk_device.value();
 
@@ -346,7 +1043,7 @@ class App {
         vk::CommandPoolCreateInfo cmd_pool_info(
             vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
             queues_info.graphics_family_idx);
-        vk_cmd_pool = device.createCommandPool(cmd_pool_info);
+        vk_cmd_pool = device.createCommandPool(cmd_pool_info, hostCallbacks());
 
         vk::CommandBufferAllocateInfo cmd_buffer_info{};
         cmd_buffer_info.setCommandPool(vk_cmd_pool.value());
@@ -355,14 +1052,74 @@ class App {
         vk_cmd_buffers = vk::raii::CommandBuffers(device, cmd_buffer_info);
     }
 
+    /// @brief Indexes `VERTICES` and reorders it for the GPU, printing the
+    /// vertex cache statistics before and after
+    void optimizeSceneMesh() {
+        auto start = std::chrono::steady_clock::now();
+        auto indexed = IndexedMesh::fromTriangles(VERTICES);
+        scene_mesh = MeshOptimizer::optimize(indexed);
+        auto elapsed_ms = millisecondsSince(start);
+
+        auto before =
+            VertexCacheStats::measure(indexed, MeshOptimizer::CACHE_SIZE);
+        auto after = VertexCacheStats::measure(scene_mesh.value(),
+                                               MeshOptimizer::CACHE_SIZE);
+        std::cout << "mesh: " << scene_mesh->triangleCount()
+                  << " triangles, " << VERTICES.size() << " -> "
+                  << scene_mesh->vertices.size() << " vertices, optimized in "
+                  << elapsed_ms << " ms" << std::endl;
+        std::cout << "mesh: ACMR " << before.acmr << " -> " << after.acmr
+                  << ", ATVR " << before.atvr << " -> " << after.atvr
+                  << std::endl;
+    }
+
+    /// @brief Reads the scene mesh from --mesh-file. A missing file is
+    /// written from `VERTICES`, optimized first with --optimize-mesh, and
+    /// read on the next run.
+    void loadSceneMesh() {
+        scene_mesh_asset = loadMeshAsset(options.mesh_file);
+        if (!scene_mesh_asset.empty()) {
+            auto header = MeshCodec::header(scene_mesh_asset);
+            std::cout << "mesh: " << header.index_count / 3 << " triangles, "
+                      << header.vertex_count << " vertices from "
+                      << options.mesh_file << std::endl;
+            return;
+        }
+
+        if (options.optimize_mesh) {
+            optimizeSceneMesh();
+        } else {
+            scene_mesh = IndexedMesh::fromTriangles(VERTICES);
+        }
+        auto encoded = MeshCodec::encode(scene_mesh.value());
+        storeMeshAsset(options.mesh_file, encoded);
+        auto raw_size = sizeof(Vertex) * scene_mesh->vertices.size() +
+                        sizeof(uint32_t) * scene_mesh->indices.size();
+        std::cout << "mesh: wrote " << options.mesh_file << ", " << raw_size
+                  << " -> " << encoded.size() << " bytes" << std::endl;
+    }
+
+    /// @brief Vertices in the vertex buffer, those of the optimized mesh
+    /// when there is one
+    const std::vector<Vertex>& sceneVertices() const {
+        return scene_mesh.has_value() ? scene_mesh->vertices : VERTICES;
+    }
+
     void initVertexBuffer() {
         auto& phys_dev = vk_physical_device.value();
         auto& device = vk_device.value();
+        auto& vertices = sceneVertices();
+        std::optional<MeshCodec::Header> asset;
+        if (!scene_mesh_asset.empty()) {
+            asset = MeshCodec::header(scene_mesh_asset);
+        }
+        auto vertex_count = asset.has_value() ? asset->vertex_count
+                                              : vertices.size();
 
-        vk::BufferCreateInfo vb_info({}, sizeof(VERTICES[0]) * VERTICES.size(),
+        vk::BufferCreateInfo vb_info({}, sizeof(Vertex) * vertex_count,
                                      vk::BufferUsageFlagBits::eVertexBuffer,
                                      vk::SharingMode::eExclusive);
-        vk_vertex_buffer = device.createBuffer(vb_info);
+        vk_vertex_buffer = device.createBuffer(vb_info, hostCallbacks());
 
         auto mem_req = vk_vertex_buffer->getMemoryRequirements();
         auto phys_mem_props = phys_dev.getMemoryProperties();
@@ -374,114 +1131,338 @@ class App {
                                vk::MemoryPropertyFlagBits::eHostCoherent,
                            phys_mem_props));
 
-        vk_vb_memory = device.allocateMemory(alloc_info);
+        vk_vb_memory = device.allocateMemory(alloc_info, hostCallbacks());
+        StatsRegistry::global().add(Counter::DeviceAllocations);
+        StatsRegistry::global().add(Counter::DeviceAllocationBytes,
+                                    mem_req.size);
         vk_vertex_buffer->bindMemory(*vk_vb_memory, 0);
-        std::memcpy(vk_vb_memory->mapMemory(0, vb_info.size), VERTICES.data(),
-                    (size_t)vb_info.size);
+        auto* mapped = vk_vb_memory->mapMemory(0, vb_info.size);
+
+        if (asset.has_value()) {
+            vk_index_buffer.emplace(
+                phys_dev, device, sizeof(uint32_t) * asset->index_count,
+                vk::BufferUsageFlagBits::eIndexBuffer,
+                vk::MemoryPropertyFlagBits::eHostVisible |
+                    vk::MemoryPropertyFlagBits::eHostCoherent);
+            // Decoded straight into the mapped buffers, the compressed asset
+            // is all that crosses from disk to the device
+            auto start = std::chrono::steady_clock::now();
+            MeshCodec::decode(scene_mesh_asset, static_cast<Vertex*>(mapped),
+                              static_cast<uint32_t*>(vk_index_buffer->mapped));
+            if (options.bench) {
+                std::cout << "mesh: decoded " << scene_mesh_asset.size()
+                          << " bytes in " << millisecondsSince(start)
+                          << " ms" << std::endl;
+            }
+            scene_index_count = asset->index_count;
+        } else {
+            std::memcpy(mapped, vertices.data(), (size_t)vb_info.size);
+        }
         vk_vb_memory->unmapMemory();
+
+        if (scene_mesh.has_value()) {
+            auto& indices = scene_mesh->indices;
+            auto size = sizeof(indices[0]) * indices.size();
+            vk_index_buffer.emplace(
+                phys_dev, device, size, vk::BufferUsageFlagBits::eIndexBuffer,
+                vk::MemoryPropertyFlagBits::eHostVisible |
+                    vk::MemoryPropertyFlagBits::eHostCoherent);
+            std::memcpy(vk_index_buffer->mapped, indices.data(), size);
+            scene_index_count = static_cast<uint32_t>(indices.size());
+        }
     }
 
-    void rebuildSwapchain() {
+    void initUniformBuffers() {
+        auto& phys_dev = vk_physical_device.value();
         auto& device = vk_device.value();
 
-        device.waitIdle();
-        destroySwapchain();
+        vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eUniformBuffer;
+        if (has_descriptor_buffer) {
+            usage |= vk::BufferUsageFlagBits::eShaderDeviceAddress;
+        }
 
-        int width = 0, height = 0;
-        glfwGetFramebufferSize(window, &width, &height);
-        while (width == 0 || height == 0) {
-            glfwGetFramebufferSize(window, &width, &height);
-            glfwWaitEvents();
+        vk_uniform_buffers.clear();
+        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            vk_uniform_buffers.emplace_back(
+                phys_dev, device, sizeof(FrameUniforms), usage,
+                vk::MemoryPropertyFlagBits::eHostVisible |
+                    vk::MemoryPropertyFlagBits::eHostCoherent);
         }
+    }
 
-        device.waitIdle();
-        initSurface();
+    /// @brief Rebuilds the swapchains of windows that were resized or went
+    /// out of date, all in the format of the main window. Minimized windows
+    /// are left for a later frame without waiting.
+    void rebuildWindowTargets() {
+        auto& device = vk_device.value();
+        bool idle = false;
+        for (auto& target : window_targets) {
+            if (!target->rebuild_needed || target->minimized()) {
+                continue;
+            }
+            if (!idle) {
+                device.waitIdle();
+                idle = true;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            bool is_main = target.get() == &mainWindow();
+            target->rebuild(vk_physical_device.value(), device,
+                            vk_q_families_info.value(),
+                            vk_surface_info.value(),
+                            is_main ? mainImageUsage()
+                                    : vk::ImageUsageFlagBits::eColorAttachment,
+                            MAX_FRAMES_IN_FLIGHT);
+            if (is_main) {
+                resizeMainWindowResources();
+            } else {
+                target->createFramebuffers(device, *vk_render_pass.value(),
+                                           {});
+            }
+            StatsRegistry::global().add(Counter::SwapchainRebuilds);
+            if (options.bench) {
+                std::cout << "swapchain: rebuilt in "
+                          << millisecondsSince(start) << " ms" << std::endl;
+            }
+        }
+    }
 
-        vk_surface_info.value().extent.width = width;
-        vk_surface_info.value().extent.height = height;
+    /// @brief Usage of the main window's images, which the effects and the
+    /// shading rate analysis also sample or write
+    vk::ImageUsageFlags mainImageUsage() const {
+        vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eColorAttachment;
+        if (shading_rate_support.attachment_rate) {
+            usage |= vk::ImageUsageFlagBits::eSampled;
+        }
+        if (vk_compute_effect.has_value() || vk_multiview.has_value()) {
+            usage |= vk::ImageUsageFlagBits::eTransferDst;
+        }
+        return usage;
+    }
 
-        device.waitIdle();
+    /// @brief Brings everything sized after the main window to its new
+    /// swapchain, then creates the main window's framebuffers
+    void resizeMainWindowResources() {
+        auto& main_window = mainWindow();
+        auto& surface_info = vk_surface_info.value();
+        surface_info.extent = main_window.extent();
 
-        createSwapchain();
-        createImageViews();
-        createFrameBuffers();
+        if (hud.has_value()) {
+            hud->setSwapchain(main_window.presentMode(),
+                              main_window.imageCount());
+        }
+        StatsRegistry::global().set(Gauge::SwapchainImages,
+                                    main_window.imageCount());
+        // Nothing of the new swapchain was presented yet
+        if (damage.has_value()) {
+            damage->reset(main_window.imageCount(), surface_info.extent);
+            frame_dirty = true;
+        }
 
-        swapchain_rebuild_needed = false;
+        // Sets referring to views of the old swapchain are stale now
+        if (vk_descriptor_cache.has_value()) {
+            vk_descriptor_cache->clear();
+        }
+        if (has_occlusion_culling) {
+            createDepthResources();
+        }
+        if (vk_shading_rate_image.has_value()) {
+            vk_shading_rate_image->resize(surface_info.extent);
+        }
+        if (vk_compute_effect.has_value()) {
+            vk_compute_effect->resize(surface_info.extent);
+        }
+        if (vk_multiview.has_value()) {
+            vk_multiview->resize(surface_info.extent, *vk_render_pass.value());
+        }
+        createFrameBuffers();
     }
 
-    void createSwapchain() {
-        auto& phys_device = vk_physical_device.value();
+    void createRenderPass() {
         auto& device = vk_device.value();
-        auto& surface = vk_surface.value();
-        auto& queues_info = vk_q_families_info.value();
         auto& surface_info = vk_surface_info.value();
 
-        uint32_t family_idxs[2] = {queues_info.graphics_family_idx,
-                                   queues_info.present_family_idx};
+        if (has_occlusion_culling) {
+            vk_render_pass = createCullingPass(true);
+            vk_render_pass_load = createCullingPass(false);
+            return;
+        }
 
-        auto img_sharing_mode = vk::SharingMode::eExclusive;
-        if (family_idxs[0] != family_idxs[1]) {
-            img_sharing_mode = vk::SharingMode::eConcurrent;
+        if (shading_rate_support.attachment_rate) {
+            vk_render_pass = createShadingRatePass();
+            return;
         }
 
-        auto img_cnt = surface_info.min_image_cnt + 1;
-        if (surface_info.max_image_cnt != 0) {
-            img_cnt = std::min(surface_info.max_image_cnt, img_cnt);
+        if (vk_multiview.has_value()) {
+            vk_render_pass = createMultiviewPass();
+            return;
         }
 
-        vk::SwapchainCreateInfoKHR swapchain_info{
-            {},
-            surface,
-            img_cnt,
-            surface_info.color_format,
-            surface_info.color_space,
-            surface_info.extent,
-            1,
-            vk::ImageUsageFlagBits::eColorAttachment,
-            img_sharing_mode,
-            family_idxs};
+        vk::AttachmentDescription attach_desc{};
+        attach_desc.setFormat(surface_info.color_format);
+        attach_desc.setLoadOp(vk::AttachmentLoadOp::eClear);
+        attach_desc.setStencilLoadOp(vk::AttachmentLoadOp::eDontCare);
+        attach_desc.setStencilStoreOp(vk::AttachmentStoreOp::eDontCare);
+        attach_desc.setFinalLayout(vk::ImageLayout::ePresentSrcKHR);
+
+        vk::AttachmentReference attach_ref(
+            0, vk::ImageLayout::eColorAttachmentOptimal);
 
-        swapchain_info.setPresentMode(surface_info.present_mode);
+        vk::SubpassDescription sp_desc{};
+        sp_desc.setColorAttachments(attach_ref);
+
+        vk::RenderPassCreateInfo rp_info{};
+        rp_info.setAttachments(attach_desc);
+        rp_info.setSubpasses(sp_desc);
 
-        if (vk_swapchain.has_value()) {
-            swapchain_info.setOldSwapchain(vk_swapchain.value());
+        // The repaint pass loads what the image held when last presented,
+        // once the acquire semaphore waited for at color output signals.
+        // Passes with different dependencies are not compatible, the clear
+        // pass gets the same one.
+        vk::SubpassDependency dependency(
+            VK_SUBPASS_EXTERNAL, 0,
+            vk::PipelineStageFlagBits::eColorAttachmentOutput,
+            vk::PipelineStageFlagBits::eColorAttachmentOutput, {},
+            vk::AccessFlagBits::eColorAttachmentRead |
+                vk::AccessFlagBits::eColorAttachmentWrite);
+        if (damage.has_value()) {
+            rp_info.setDependencies(dependency);
         }
 
-        vk_sc_framebuffers.clear();
-        vk_sc_imageviews.clear();
-        vk_swapchain = device.createSwapchainKHR(swapchain_info);
-        vk_sc_images = vk_swapchain->getImages();
-    }
+        vk_render_pass = device.createRenderPass(rp_info, hostCallbacks());
 
-    void destroySwapchain() {
-        vk_sc_framebuffers.clear();
-        vk_sc_imageviews.clear();
-        vk_sc_images.clear();
-        vk_swapchain.reset();
+        if (damage.has_value()) {
+            attach_desc.setLoadOp(vk::AttachmentLoadOp::eLoad);
+            attach_desc.setInitialLayout(vk::ImageLayout::ePresentSrcKHR);
+            rp_info.setAttachments(attach_desc);
+            vk_render_pass_load =
+                device.createRenderPass(rp_info, hostCallbacks());
+        }
     }
 
-    void createImageViews() {
-        auto& srfc_info = vk_surface_info.value();
+    /// @brief Creates a color and depth pass for one culling phase: the first
+    /// phase clears and keeps depth for the pyramid build, the second one
+    /// loads both attachments and leaves color ready for presentation
+    vk::raii::RenderPass createCullingPass(bool first_phase) {
         auto& device = vk_device.value();
+        auto& surface_info = vk_surface_info.value();
+
+        auto load_op = first_phase ? vk::AttachmentLoadOp::eClear
+                                   : vk::AttachmentLoadOp::eLoad;
+
+        std::array<vk::AttachmentDescription, 2> attach_descs{};
+        attach_descs[0].setFormat(surface_info.color_format);
+        attach_descs[0].setLoadOp(load_op);
+        attach_descs[0].setStencilLoadOp(vk::AttachmentLoadOp::eDontCare);
+        attach_descs[0].setStencilStoreOp(vk::AttachmentStoreOp::eDontCare);
+
+        attach_descs[1].setFormat(DEPTH_FORMAT);
+        attach_descs[1].setLoadOp(load_op);
+        attach_descs[1].setStencilLoadOp(vk::AttachmentLoadOp::eDontCare);
+        attach_descs[1].setStencilStoreOp(vk::AttachmentStoreOp::eDontCare);
+        attach_descs[1].setFinalLayout(
+            vk::ImageLayout::eDepthStencilAttachmentOptimal);
+
+        vk::SubpassDependency dependency(
+            VK_SUBPASS_EXTERNAL, 0,
+            vk::PipelineStageFlagBits::eColorAttachmentOutput |
+                vk::PipelineStageFlagBits::eLateFragmentTests,
+            vk::PipelineStageFlagBits::eColorAttachmentOutput |
+                vk::PipelineStageFlagBits::eEarlyFragmentTests |
+                vk::PipelineStageFlagBits::eLateFragmentTests,
+            vk::AccessFlagBits::eColorAttachmentWrite |
+                vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+            vk::AccessFlagBits::eColorAttachmentRead |
+                vk::AccessFlagBits::eColorAttachmentWrite |
+                vk::AccessFlagBits::eDepthStencilAttachmentRead |
+                vk::AccessFlagBits::eDepthStencilAttachmentWrite);
+
+        if (first_phase) {
+            attach_descs[0].setFinalLayout(
+                vk::ImageLayout::eColorAttachmentOptimal);
+        } else {
+            attach_descs[0].setInitialLayout(
+                vk::ImageLayout::eColorAttachmentOptimal);
+            attach_descs[0].setFinalLayout(vk::ImageLayout::ePresentSrcKHR);
+            // Depth was read by the pyramid build in between
+            attach_descs[1].setInitialLayout(
+                vk::ImageLayout::eShaderReadOnlyOptimal);
+            attach_descs[1].setStoreOp(vk::AttachmentStoreOp::eDontCare);
+            dependency.srcStageMask |=
+                vk::PipelineStageFlagBits::eComputeShader;
+        }
+
+        vk::AttachmentReference color_ref(
+            0, vk::ImageLayout::eColorAttachmentOptimal);
+        vk::AttachmentReference depth_ref(
+            1, vk::ImageLayout::eDepthStencilAttachmentOptimal);
+
+        vk::SubpassDescription sp_desc{};
+        sp_desc.setColorAttachments(color_ref);
+        sp_desc.setPDepthStencilAttachment(&depth_ref);
+
+        vk::RenderPassCreateInfo rp_info{};
+        rp_info.setAttachments(attach_descs);
+        rp_info.setSubpasses(sp_desc);
+        rp_info.setDependencies(dependency);
+
+        return device.createRenderPass(rp_info, hostCallbacks());
+    }
 
-        vk::ImageSubresourceRange is_range{};
-        is_range.setAspectMask(vk::ImageAspectFlagBits::eColor);
-        is_range.setLayerCount(1);
-        is_range.setLevelCount(1);
+    /// @brief Creates the scene pass with a shading rate attachment. Color is
+    /// left in eShaderReadOnlyOptimal for the rate analysis, which moves it
+    /// on to presentation.
+    vk::raii::RenderPass createShadingRatePass() {
+        auto& device = vk_device.value();
+        auto& surface_info = vk_surface_info.value();
 
-        vk_sc_imageviews.clear();
+        std::array<vk::AttachmentDescription2, 2> attach_descs{};
+        attach_descs[0].setFormat(surface_info.color_format);
+        attach_descs[0].setLoadOp(vk::AttachmentLoadOp::eClear);
+        attach_descs[0].setStencilLoadOp(vk::AttachmentLoadOp::eDontCare);
+        attach_descs[0].setStencilStoreOp(vk::AttachmentStoreOp::eDontCare);
+        attach_descs[0].setFinalLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+
+        attach_descs[1].setFormat(ShadingRateImage::FORMAT);
+        attach_descs[1].setLoadOp(vk::AttachmentLoadOp::eLoad);
+        attach_descs[1].setStencilLoadOp(vk::AttachmentLoadOp::eDontCare);
+        attach_descs[1].setStencilStoreOp(vk::AttachmentStoreOp::eDontCare);
+        attach_descs[1].setInitialLayout(ShadingRateImage::ATTACHMENT_LAYOUT);
+        attach_descs[1].setFinalLayout(ShadingRateImage::ATTACHMENT_LAYOUT);
+
+        vk::AttachmentReference2 color_ref(
+            0, vk::ImageLayout::eColorAttachmentOptimal,
+            vk::ImageAspectFlagBits::eColor);
+        vk::AttachmentReference2 rate_ref(1,
+                                          ShadingRateImage::ATTACHMENT_LAYOUT);
+
+        vk::FragmentShadingRateAttachmentInfoKHR rate_info(
+            &rate_ref, shading_rate_support.attachmentTexelSize());
+
+        vk::SubpassDescription2 sp_desc{};
+        sp_desc.setColorAttachments(color_ref);
+        sp_desc.setPNext(&rate_info);
+
+        // The rate analysis samples color right after the pass
+        vk::SubpassDependency2 dependency(
+            0, VK_SUBPASS_EXTERNAL,
+            vk::PipelineStageFlagBits::eColorAttachmentOutput,
+            vk::PipelineStageFlagBits::eComputeShader,
+            vk::AccessFlagBits::eColorAttachmentWrite,
+            vk::AccessFlagBits::eShaderRead);
+
+        vk::RenderPassCreateInfo2 rp_info{};
+        rp_info.setAttachments(attach_descs);
+        rp_info.setSubpasses(sp_desc);
+        rp_info.setDependencies(dependency);
 
-        std::transform(
-            vk_sc_images.begin(), vk_sc_images.end(),
-            std::back_inserter(vk_sc_imageviews), [&](vk::Image& img) {
-                vk::ImageViewCreateInfo imv_info(
-                    {}, img, vk::ImageViewType::e2D, srfc_info.color_format);
-                imv_info.setSubresourceRange(is_range);
-                return device.createImageView(imv_info);
-            });
+        return device.createRenderPass2(rp_info, hostCallbacks());
     }
 
-    void createRenderPass() {
+    /// @brief Creates the scene pass rendering every view of vk_multiview
+    /// into its layer with the same draws. Color is left in
+    /// eTransferSrcOptimal for the blits onto the swapchain image.
+    vk::raii::RenderPass createMultiviewPass() {
         auto& device = vk_device.value();
         auto& surface_info = vk_surface_info.value();
 
@@ -490,7 +1471,7 @@ class App {
         attach_desc.setLoadOp(vk::AttachmentLoadOp::eClear);
         attach_desc.setStencilLoadOp(vk::AttachmentLoadOp::eDontCare);
         attach_desc.setStencilStoreOp(vk::AttachmentStoreOp::eDontCare);
-        attach_desc.setFinalLayout(vk::ImageLayout::ePresentSrcKHR);
+        attach_desc.setFinalLayout(vk::ImageLayout::eTransferSrcOptimal);
 
         vk::AttachmentReference attach_ref(
             0, vk::ImageLayout::eColorAttachmentOptimal);
@@ -498,219 +1479,1287 @@ class App {
         vk::SubpassDescription sp_desc{};
         sp_desc.setColorAttachments(attach_ref);
 
+        // The layers are overwritten after the blits of the previous frame
+        // read them, and blitted once drawn
+        std::array<vk::SubpassDependency, 2> dependencies = {
+            vk::SubpassDependency(
+                VK_SUBPASS_EXTERNAL, 0, vk::PipelineStageFlagBits::eTransfer,
+                vk::PipelineStageFlagBits::eColorAttachmentOutput, {},
+                vk::AccessFlagBits::eColorAttachmentWrite),
+            vk::SubpassDependency(
+                0, VK_SUBPASS_EXTERNAL,
+                vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                vk::PipelineStageFlagBits::eTransfer,
+                vk::AccessFlagBits::eColorAttachmentWrite,
+                vk::AccessFlagBits::eTransferRead)};
+
+        // Views see the same geometry, correlating them lets the driver
+        // share vertex work between them
+        uint32_t view_mask = vk_multiview->viewMask();
+        vk::RenderPassMultiviewCreateInfo multiview_info{};
+        multiview_info.setViewMasks(view_mask);
+        multiview_info.setCorrelationMasks(view_mask);
+
         vk::RenderPassCreateInfo rp_info{};
         rp_info.setAttachments(attach_desc);
         rp_info.setSubpasses(sp_desc);
+        rp_info.setDependencies(dependencies);
+        rp_info.setPNext(&multiview_info);
 
-        vk_render_pass = device.createRenderPass(rp_info);
+        return device.createRenderPass(rp_info, hostCallbacks());
     }
 
-    void createPipeline() {
+    /// @brief (Re)creates the depth buffer of the culled scene and the depth
+    /// pyramid built from it
+    void createDepthResources() {
+        auto& phys_dev = vk_physical_device.value();
         auto& device = vk_device.value();
-        auto& render_pass = vk_render_pass.value();
-
-        auto vertex_shader_data = loadShaderBytes("shaders/vert.spv");
-        auto frag_shader_data = loadShaderBytes("shaders/lab.spv");
-
-        vk::ShaderModuleCreateInfo vert_shader(
-            {}, vertex_shader_data.size(),
-            reinterpret_cast<std::uint32_t const*>(vertex_shader_data.data()));
-
-        vk::ShaderModuleCreateInfo frag_shader(
-            {}, frag_shader_data.size(),
-            reinterpret_cast<std::uint32_t const*>(frag_shader_data.data()));
-
-        vk::raii::ShaderModule vert_shader_module =
-            device.createShaderModule(vert_shader);
-
-        vk::raii::ShaderModule frag_shader_module =
-            device.createShaderModule(frag_shader);
-
-        vk::PipelineShaderStageCreateInfo vert_shader_stage(
-            {}, vk::ShaderStageFlagBits::eVertex, vert_shader_module, "main");
-
-        vk::PipelineShaderStageCreateInfo frag_shader_stage(
-            {}, vk::ShaderStageFlagBits::eFragment, frag_shader_module,
-            "fragment_main");
-
-        std::vector<vk::PipelineShaderStageCreateInfo> shader_stages = {
-            vert_shader_stage, frag_shader_stage};
-
-        vk::PipelineVertexInputStateCreateInfo vis_info{};
-        auto v_bind_desc = Vertex::getBindingDescription();
-        auto v_attr_descs = Vertex::getAttributeDescriptions();
-        vis_info.setVertexBindingDescriptions(v_bind_desc);
-        vis_info.setVertexAttributeDescriptions(v_attr_descs);
-
-        vk::PipelineInputAssemblyStateCreateInfo iss_info(
-            {}, vk::PrimitiveTopology::eTriangleList, false);
-        vk::PipelineViewportStateCreateInfo vps_info{};
-        vps_info.setViewportCount(1);
-        vps_info.setScissorCount(1);
-
-        vk::PipelineRasterizationStateCreateInfo raster_info{};
-        raster_info.setLineWidth(1.0f);
-        raster_info.setCullMode(vk::CullModeFlagBits::eBack);
-        raster_info.setFrontFace(vk::FrontFace::eClockwise);
-
-        vk::PipelineMultisampleStateCreateInfo ms_info{};
-        ms_info.setSampleShadingEnable(false);
-        ms_info.setRasterizationSamples(vk::SampleCountFlagBits::e1);
-
-        vk::PipelineColorBlendAttachmentState cbas{};
-        cbas.setColorWriteMask(
-            vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
-            vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA);
-        cbas.setBlendEnable(false);
-
-        vk::PipelineColorBlendStateCreateInfo cbs_info{};
-        cbs_info.setLogicOpEnable(false);
-        cbs_info.setAttachments(cbas);
-        cbs_info.setBlendConstants({0.0f, 0.0f, 0.0f, 0.0f});
-
-        std::vector<vk::DynamicState> dyn_states = {vk::DynamicState::eViewport,
-                                                    vk::DynamicState::eScissor};
-        vk::PipelineDynamicStateCreateInfo dyns_info({}, dyn_states);
-
-        auto layout =
-            device.createPipelineLayout(vk::PipelineLayoutCreateInfo());
-
-        vk::GraphicsPipelineCreateInfo gp_info{};
-        gp_info.setStages(shader_stages);
-        gp_info.setPVertexInputState(&vis_info);
-        gp_info.setPInputAssemblyState(&iss_info);
-        gp_info.setPViewportState(&vps_info);
-        gp_info.setPRasterizationState(&raster_info);
-        gp_info.setPMultisampleState(&ms_info);
-        gp_info.setPColorBlendState(&cbs_info);
-        gp_info.setPDynamicState(&dyns_info);
-        gp_info.setLayout(layout);
-        gp_info.setRenderPass(render_pass);
-        gp_info.setSubpass(0);
-
-        vk_pipeline = device.createGraphicsPipeline(vk_pipeline_cache, gp_info);
+        auto& extent = vk_surface_info.value().extent;
+
+        auto features =
+            phys_dev.getFormatProperties(DEPTH_FORMAT).optimalTilingFeatures;
+        if (!(features & vk::FormatFeatureFlagBits::eDepthStencilAttachment) ||
+            !(features & vk::FormatFeatureFlagBits::eSampledImage)) {
+            throw std::runtime_error("depth format can't be sampled");
+        }
+
+        vk_depth_view.reset();
+        vk_depth_image.reset();
+
+        vk_depth_image.emplace(
+            phys_dev, device,
+            AllocatedImage::info2D(
+                DEPTH_FORMAT, extent,
+                vk::ImageUsageFlagBits::eDepthStencilAttachment |
+                    vk::ImageUsageFlagBits::eSampled));
+        vk_depth_view = vk_depth_image->createView(
+            device, vk::ImageAspectFlagBits::eDepth);
+
+        vk_occlusion_culler->resize(extent, *vk_depth_view.value());
     }
 
-    void createFrameBuffers() {
+    void createDescriptorSetLayout() {
         auto& device = vk_device.value();
-        auto& render_pass = vk_render_pass.value();
+
+        vk::DescriptorSetLayoutBinding frame_binding(
+            0, vk::DescriptorType::eUniformBuffer, 1,
+            vk::ShaderStageFlagBits::eVertex |
+                vk::ShaderStageFlagBits::eFragment);
+
+        vk::DescriptorSetLayoutCreateInfo dsl_info({}, frame_binding);
+        if (has_descriptor_buffer) {
+            dsl_info.setFlags(
+                vk::DescriptorSetLayoutCreateFlagBits::eDescriptorBufferEXT);
+        }
+
+        vk_descriptor_set_layout =
+            device.createDescriptorSetLayout(dsl_info, hostCallbacks());
+    }
+
+    void createPipelineLayout() {
+        auto& device = vk_device.value();
+
+        vk::PipelineLayoutCreateInfo pl_info({},
+                                             *vk_descriptor_set_layout.value());
+        // Per-view transforms of the multiview pass
+        vk::PushConstantRange view_range(vk::ShaderStageFlagBits::eVertex, 0,
+                                         sizeof(ViewTransforms));
+        if (vk_multiview.has_value()) {
+            pl_info.setPushConstantRanges(view_range);
+        }
+        vk_pipeline_layout =
+            device.createPipelineLayout(pl_info, hostCallbacks());
+    }
+
+    /// @brief Sets up descriptor storage: growable pools for transient and
+    /// cached sets, and a descriptor buffer holding the frame set per frame
+    /// in flight when descriptor buffers are used
+    void createDescriptors() {
+        auto& phys_dev = vk_physical_device.value();
+        auto& device = vk_device.value();
+        auto& set_layout = vk_descriptor_set_layout.value();
+
+        if (has_descriptor_buffer) {
+            vk_descriptor_buffer.emplace(phys_dev, device, set_layout,
+                                         MAX_FRAMES_IN_FLIGHT);
+            for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+                vk_descriptor_buffer->writeUniformBuffer(
+                    i, 0, vk_uniform_buffers[i].address(device),
+                    sizeof(FrameUniforms));
+            }
+        }
+
+        // Pools are only created on the first allocation
+        vk_descriptor_allocator.emplace(device, MAX_FRAMES_IN_FLIGHT);
+        vk_descriptor_cache.emplace(device);
+    }
+
+    /// @brief Binds the frame's descriptor set at set 0
+    template <typename Dispatch>
+    void bindDescriptors(const vk::raii::CommandBuffer& cmd_buf,
+                         uint32_t frame_idx, const Dispatch& d) {
+        auto& layout = vk_pipeline_layout.value();
+
+        if (vk_descriptor_buffer.has_value()) {
+            vk_descriptor_buffer->bind(cmd_buf,
+                                       vk::PipelineBindPoint::eGraphics,
+                                       *layout, 0, frame_idx);
+        } else {
+            auto set = vk_descriptor_cache->get(
+                *vk_descriptor_set_layout.value(),
+                {DescriptorBinding::ofBuffer(
+                    0, vk::DescriptorType::eUniformBuffer,
+                    *vk_uniform_buffers[frame_idx].buffer, 0,
+                    sizeof(FrameUniforms))});
+            vk::CommandBuffer(*cmd_buf).bindDescriptorSets(
+                vk::PipelineBindPoint::eGraphics, *layout, 0, set, nullptr, d);
+        }
+    }
+
+    void updateUniforms(uint32_t frame_idx) {
         auto& extent = vk_surface_info.value().extent;
 
-        vk_sc_framebuffers.clear();
+        FrameUniforms uniforms{
+            {static_cast<float>(extent.width),
+             static_cast<float>(extent.height)},
+            static_cast<float>(millisecondsSince(start_time) / 1000.0),
+            frame_counter,
+            camera.center,
+            camera.zoom};
+        std::memcpy(vk_uniform_buffers[frame_idx].mapped, &uniforms,
+                    sizeof(uniforms));
+    }
+
+    /// @brief Creates the culler over a stacked scene and the pipeline
+    /// drawing its objects as instances of `VERTICES`
+    void createOcclusionCulling() {
+        auto& phys_dev = vk_physical_device.value();
+        auto& device = vk_device.value();
+
+        scene = Scene::stacked(options.object_count);
+        scene_mesh_bounds = MeshBounds::from(VERTICES);
+        scene_index.build(scene->boundsAt(0.0f, scene_mesh_bounds));
+        // Started with the first scene, kept across device re-creation
+        if (!scene_index_worker.has_value()) {
+            scene_index_worker.emplace(scene_index);
+        }
+
+        vk_occlusion_culler.emplace(
+            phys_dev, device, vk_pipeline_cache, vk_descriptor_cache.value(),
+            static_cast<uint32_t>(scene->objects.size()), MAX_FRAMES_IN_FLIGHT,
+            scene_mesh_bounds, static_cast<uint32_t>(VERTICES.size()));
+
+        std::vector<vk::DescriptorSetLayout> set_layouts = {
+            *vk_descriptor_set_layout.value(),
+            vk_occlusion_culler->objectSetLayout()};
+        vk::PipelineLayoutCreateInfo pl_info({}, set_layouts);
+        vk_object_pipeline_layout =
+            device.createPipelineLayout(pl_info, hostCallbacks());
+
+        auto desc = GraphicsPipelineDesc::forVertex(
+            *vk_object_pipeline_layout.value(), *vk_render_pass.value());
+        desc.vertex_shader = "shaders/scene.spv";
+        desc.vertex_entry = "vertex_main";
+        desc.set_layouts = set_layouts;
+        desc.state = render_state;
+        desc.state.depth_test = true;
+        desc.state.depth_write = true;
+        applyShadingRate(desc);
+
+        GraphicsPipelineState state(device, desc);
+        vk_object_pipeline =
+            createGraphicsPipeline(device, vk_pipeline_cache,
+                                   state.createInfo());
+    }
+
+    /// @brief Places scene objects for the frame and takes the culling
+    /// candidates from a BVH frustum query. The BVH is refit for the next
+    /// frame on a worker thread while this one is recorded and presented.
+    void updateScene(uint32_t frame_idx) {
+        float time = frame_counter * ANIMATION_STEP;
+
+        scene_index_worker->wait();
+
+        cull_candidates.clear();
+        {
+            auto snapshot = scene_index.snapshot();
+            snapshot->queryFrustum(Frustum::fromBox(camera.viewBounds()),
+                                   cull_candidates);
+        }
+        vk_occlusion_culler->updateFrame(frame_idx, scene->objectsAt(time),
+                                         cull_candidates);
+
+        scene_index_worker->refit([this, time]() {
+            return scene->boundsAt(time + ANIMATION_STEP, scene_mesh_bounds);
+        });
+    }
+
+    /// @brief Description of the pipeline drawing `VERTICES`
+    GraphicsPipelineDesc sceneDesc() {
+        auto desc = GraphicsPipelineDesc::forVertex(
+            *vk_pipeline_layout.value(), *vk_render_pass.value());
+
+        desc.state = render_state;
+        desc.set_layouts = {*vk_descriptor_set_layout.value()};
+        if (vk_multiview.has_value()) {
+            desc.vertex_shader = "shaders/multiview.spv";
+            desc.vertex_entry = "vertex_main";
+        }
+        if (has_descriptor_buffer) {
+            desc.flags |= vk::PipelineCreateFlagBits::eDescriptorBufferEXT;
+        }
+        applyShadingRate(desc);
+
+        return desc;
+    }
+
+    /// @brief Sets the shading rate state of a scene pipeline: the requested
+    /// pipeline rate, combined with the rate attachment when there is one
+    void applyShadingRate(GraphicsPipelineDesc& desc) {
+        if (!shading_rate_support.any()) {
+            return;
+        }
+
+        uint32_t size = 1;
+        if (shading_rate_support.pipeline_rate) {
+            size = shading_rate_support.clampFragmentSize(options.shading_rate);
+        }
+        desc.fragment_size = vk::Extent2D(size, size);
+
+        if (shading_rate_support.attachment_rate) {
+            desc.attachment_combiner =
+                shading_rate_support.attachmentCombiner();
+        }
+    }
+
+    /// @brief Creates the scene pipeline, linked from pipeline library parts
+    /// when available and monolithic otherwise
+    void createPipeline() {
+        auto& device = vk_device.value();
+
+        auto desc = sceneDesc();
+        if (dynamic_state.has_value()) {
+            auto dyn_states = dynamic_state->dynamicStates();
+            desc.dynamic_states.insert(desc.dynamic_states.end(),
+                                       dyn_states.begin(), dyn_states.end());
+        }
+        GraphicsPipelineState state(device, desc);
+
+        auto start = std::chrono::steady_clock::now();
+
+        if (has_pipeline_library) {
+            vk_pipeline_library.emplace(device, vk_pipeline_cache, state);
+        } else {
+            vk_pipeline =
+                createGraphicsPipeline(device, vk_pipeline_cache,
+                                       state.createInfo());
+        }
+
+        if (options.bench) {
+            std::cout << (has_pipeline_library ? "pipeline: fast-linked in "
+                                               : "pipeline: monolithic in ")
+                      << millisecondsSince(start) << " ms" << std::endl;
+        }
+    }
+
+    /// @brief Creates the compute path of the lab effect and the pipeline
+    /// drawing base colors for it
+    void createComputeEffect() {
+        auto& phys_dev = vk_physical_device.value();
+        auto& device = vk_device.value();
+
+        if (!ComputeEffect::supported(phys_dev, vk_surface_info.value())) {
+            std::cerr << "compute effect unsupported, shading the effect in "
+                         "fragments"
+                      << std::endl;
+            return;
+        }
+
+        vk_compute_effect.emplace(phys_dev, device, vk_pipeline_cache,
+                                  vk_descriptor_allocator.value());
+
+        auto desc = sceneDesc();
+        desc.fragment_shader = "shaders/effect.spv";
+        desc.fragment_entry = "base_main";
+        desc.render_pass = vk_compute_effect->basePass();
+        if (dynamic_state.has_value()) {
+            auto dyn_states = dynamic_state->dynamicStates();
+            desc.dynamic_states.insert(desc.dynamic_states.end(),
+                                       dyn_states.begin(), dyn_states.end());
+        }
+
+        GraphicsPipelineState state(device, desc);
+        vk_effect_base_pipeline =
+            createGraphicsPipeline(device, vk_pipeline_cache,
+                                   state.createInfo());
+        use_compute_effect = true;
+    }
+
+    /// @brief Draws `options.views` views in layers of a multiview pass when
+    /// the device supports it, a single view otherwise
+    void createMultiview() {
+        auto& phys_dev = vk_physical_device.value();
+        auto& surface_info = vk_surface_info.value();
+
+        if (!capabilities.multiview ||
+            !MultiviewTarget::supported(phys_dev, surface_info,
+                                        options.views)) {
+            std::cerr << "multiview unsupported, drawing a single view"
+                      << std::endl;
+            return;
+        }
+
+        vk_multiview.emplace(phys_dev, vk_device.value(),
+                             surface_info.color_format, options.views);
+    }
+
+    /// @brief Animates the scene vertices on the GPU, morphing them into
+    /// their mirror image and back
+    void createVertexAnimation() {
+        auto& vertices = sceneVertices();
+        std::vector<glm::vec2> mirrored{};
+        for (auto& vertex : vertices) {
+            mirrored.emplace_back(-vertex.pos.x, vertex.pos.y);
+        }
+
+        vk_vertex_animator.emplace(vk_physical_device.value(),
+                                   vk_device.value(), vk_pipeline_cache,
+                                   vk_descriptor_cache.value(), vertices,
+                                   std::vector<std::vector<glm::vec2>>{mirrored},
+                                   MAX_FRAMES_IN_FLIGHT);
+    }
+
+    /// @brief Creates the scene shaders as shader objects, used in place of
+    /// any pipeline
+    void createShaderObjects() {
+        auto& device = vk_device.value();
+
+        auto desc = sceneDesc();
+
+        auto start = std::chrono::steady_clock::now();
+        vk_shader_program.emplace(device, desc);
+
+        if (options.bench) {
+            std::cout << "shader objects: created and linked in "
+                      << millisecondsSince(start) << " ms" << std::endl;
+
+            start = std::chrono::steady_clock::now();
+            GraphicsPipelineState state(device, desc);
+            createGraphicsPipeline(device, vk_pipeline_cache,
+                                   state.createInfo());
+            std::cout << "shader objects: equivalent pipeline in "
+                      << millisecondsSince(start) << " ms" << std::endl;
+        }
+    }
+
+    /// @brief Times recording the same state commands through the dispatcher
+    /// of vk::raii and through the flat table, best of a few rounds each
+    void benchmarkDispatch() {
+        auto& device = vk_device.value();
+
+        vk::CommandBufferAllocateInfo cmd_buffer_info(
+            *vk_cmd_pool.value(), vk::CommandBufferLevel::ePrimary, 1);
+        vk::raii::CommandBuffers cmd_buffers(device, cmd_buffer_info);
+        vk::CommandBuffer cmd = *cmd_buffers[0];
+        auto table = DeviceDispatch::load(device);
+
+        vk::Viewport viewport(0, 0, 800, 600, 0, 1);
+        vk::Rect2D rect({0, 0}, {800, 600});
+        std::array<float, 4> blend_constants{};
+        auto& vertex_buffer = vk_vertex_buffer.value();
+
+        // Four state commands per iteration, valid outside a render pass
+        auto record = [&](const auto& d) {
+            double best_ms = std::numeric_limits<double>::max();
+            for (uint32_t round = 0; round < DISPATCH_BENCH_ROUNDS; round++) {
+                auto start = std::chrono::steady_clock::now();
+                cmd.reset({}, d);
+                cmd.begin(vk::CommandBufferBeginInfo{}, d);
+                for (uint32_t i = 0; i < DISPATCH_BENCH_ITERATIONS; i++) {
+                    cmd.setViewport(0, viewport, d);
+                    cmd.setScissor(0, rect, d);
+                    cmd.bindVertexBuffers(0, *vertex_buffer, {0}, d);
+                    cmd.setBlendConstants(blend_constants.data(), d);
+                }
+                cmd.end(d);
+                best_ms = std::min(best_ms, millisecondsSince(start));
+            }
+            return best_ms * 1e6 / (4.0 * DISPATCH_BENCH_ITERATIONS);
+        };
 
-        std::transform(vk_sc_imageviews.begin(), vk_sc_imageviews.end(),
-                       std::back_inserter(vk_sc_framebuffers),
-                       [&](vk::raii::ImageView& img) {
-                           vk::FramebufferCreateInfo fb_info{};
-                           fb_info.setRenderPass(render_pass);
-                           fb_info.setAttachments(*img);
-                           fb_info.setHeight(extent.height);
-                           fb_info.setWidth(extent.width);
-                           fb_info.setLayers(1);
+        double raii_ns = record(*cmd_buffers[0].getDispatcher());
+        double table_ns = record(table);
+        std::cout << "dispatch: vk::raii " << raii_ns << " ns, flat table "
+                  << table_ns << " ns per recorded command" << std::endl;
+    }
+
+    /// @brief Prints the host memory the driver holds through the pooled
+    /// allocator, per allocation scope
+    void printHostAllocations() {
+        auto& allocator = HostAllocator::global();
+        if (!allocator.isEnabled()) {
+            return;
+        }
 
-                           return device.createFramebuffer(fb_info);
-                       });
+        for (auto scope : {vk::SystemAllocationScope::eCommand,
+                           vk::SystemAllocationScope::eObject,
+                           vk::SystemAllocationScope::eCache,
+                           vk::SystemAllocationScope::eDevice,
+                           vk::SystemAllocationScope::eInstance}) {
+            auto usage = allocator.usage(scope);
+            std::cout << "host memory: " << vk::to_string(scope) << " "
+                      << usage.live_bytes << " bytes live, "
+                      << usage.allocations << " allocations, "
+                      << usage.internal_bytes << " bytes internal"
+                      << std::endl;
+        }
+    }
+
+    /// @brief Compares compiling every RenderState permutation into its own
+    /// pipeline against the pipelines needed when state is dynamic
+    void benchmarkPipelinePermutations() {
+        auto& device = vk_device.value();
+
+        std::vector<RenderState> permutations{};
+        for (vk::CullModeFlags cull_mode :
+             {vk::CullModeFlags(vk::CullModeFlagBits::eNone),
+              vk::CullModeFlags(vk::CullModeFlagBits::eFront),
+              vk::CullModeFlags(vk::CullModeFlagBits::eBack)}) {
+            for (auto front_face :
+                 {vk::FrontFace::eClockwise, vk::FrontFace::eCounterClockwise}) {
+                for (auto topology : {vk::PrimitiveTopology::eTriangleList,
+                                      vk::PrimitiveTopology::eTriangleStrip}) {
+                    for (bool blend_enable : {false, true}) {
+                        RenderState state = render_state;
+                        state.cull_mode = cull_mode;
+                        state.front_face = front_face;
+                        state.topology = topology;
+                        state.blend_enable = blend_enable;
+                        permutations.push_back(state);
+                    }
+                }
+            }
+        }
+
+        auto desc = sceneDesc();
+
+        auto start = std::chrono::steady_clock::now();
+        for (auto& state : permutations) {
+            desc.state = state;
+            GraphicsPipelineState pipeline_state(device, desc);
+            device.createGraphicsPipeline(nullptr, pipeline_state.createInfo(),
+                                          hostCallbacks());
+        }
+        std::cout << "pipeline permutations: " << permutations.size()
+                  << " monolithic in " << millisecondsSince(start) << " ms"
+                  << std::endl;
+
+        if (!dynamic_state.has_value()) {
+            return;
+        }
+
+        auto dyn_states = dynamic_state->dynamicStates();
+        desc.dynamic_states.insert(desc.dynamic_states.end(),
+                                   dyn_states.begin(), dyn_states.end());
+
+        std::vector<RenderState> compiled{};
+        start = std::chrono::steady_clock::now();
+        for (auto& state : permutations) {
+            bool covered = std::any_of(
+                compiled.begin(), compiled.end(), [&](const RenderState& c) {
+                    return dynamic_state->compatible(c, state);
+                });
+            if (covered) {
+                continue;
+            }
+
+            desc.state = state;
+            GraphicsPipelineState pipeline_state(device, desc);
+            device.createGraphicsPipeline(nullptr, pipeline_state.createInfo(),
+                                          hostCallbacks());
+            compiled.push_back(state);
+        }
+        std::cout << "pipeline permutations: " << compiled.size()
+                  << " dynamic in " << millisecondsSince(start) << " ms"
+                  << std::endl;
+    }
+
+    /// @brief Returns the pipeline to record the scene with
+    vk::Pipeline currentPipeline() {
+        if (vk_pipeline_library.has_value()) {
+            auto& library = vk_pipeline_library.value();
+            bool was_optimized = library.optimizedLinkTime().has_value();
+            auto pipeline = library.get();
+
+            if (options.bench && !was_optimized &&
+                library.optimizedLinkTime().has_value()) {
+                std::cout << "pipeline: optimized link swapped in after "
+                          << std::chrono::duration<double, std::milli>(
+                                 library.optimizedLinkTime().value())
+                                 .count()
+                          << " ms" << std::endl;
+            }
+
+            return pipeline;
+        }
+
+        return *vk_pipeline.value();
+    }
+
+    void createFrameBuffers() {
+        // The multiview pass renders into the layered image instead
+        if (vk_multiview.has_value()) {
+            return;
+        }
+
+        std::vector<vk::ImageView> attachments{};
+        if (vk_depth_view.has_value()) {
+            attachments.push_back(*vk_depth_view.value());
+        }
+        if (vk_shading_rate_image.has_value()) {
+            attachments.push_back(vk_shading_rate_image->view());
+        }
+        mainWindow().createFramebuffers(vk_device.value(),
+                                        *vk_render_pass.value(), attachments);
     }
 
     void createSyncObjects() {
         auto& device = vk_device.value();
 
-        vk_image_available_sema.clear();
-        vk_render_finished_sema.clear();
         vk_fences.clear();
 
+        // Semaphores belong to the swapchain of each window
         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
             vk_fences.push_back(
-                device.createFence({vk::FenceCreateFlagBits::eSignaled}));
-            vk_image_available_sema.push_back(device.createSemaphore({}));
-            vk_render_finished_sema.push_back(device.createSemaphore({}));
+                device.createFence({vk::FenceCreateFlagBits::eSignaled},
+                                   hostCallbacks()));
         }
     }
 
     void overwriteCommandBuffer(uint32_t buffer_idx, uint32_t frame_idx) {
+        if (vk_dispatch.has_value()) {
+            recordCommandBuffer(buffer_idx, frame_idx, vk_dispatch.value());
+        } else {
+            recordCommandBuffer(
+                buffer_idx, frame_idx,
+                *vk_cmd_buffers.value()[buffer_idx].getDispatcher());
+        }
+    }
+
+    /// @brief Records the frame, issuing the commands of this class through
+    /// `d`, either the dispatcher of vk::raii or the flat table. Subsystems
+    /// record through the vk::raii command buffer.
+    template <typename Dispatch>
+    void recordCommandBuffer(uint32_t buffer_idx, uint32_t frame_idx,
+                             const Dispatch& d) {
         auto& extent = vk_surface_info.value().extent;
         auto& cmd_buf = vk_cmd_buffers.value()[buffer_idx];
+        vk::CommandBuffer cmd = *cmd_buf;
         auto& rpass = vk_render_pass.value();
-        auto& fbuf = vk_sc_framebuffers[frame_idx];
-        auto& pipeline = vk_pipeline.value();
         auto& vertex_buffer = vk_vertex_buffer.value();
 
-        vk::Rect2D rect({0, 0}, extent);
+        // The multiview pass draws every view at the size of a column
+        vk::Framebuffer fbuf = vk_multiview.has_value()
+                                   ? vk_multiview->framebuffer()
+                                   : mainWindow().framebuffer();
+        vk::Rect2D rect({0, 0}, vk_multiview.has_value()
+                                    ? vk_multiview->viewExtent()
+                                    : extent);
         vk::ClearColorValue clear_color({0.0f, 0.0f, 0.0f, 1.0f});
         vk::ClearValue clear_value(clear_color);
         vk::RenderPassBeginInfo rpb_info(rpass, fbuf, rect, clear_value);
         vk::Viewport viewport(rect.offset.x, rect.offset.y, rect.extent.width,
                               rect.extent.height, 0, 1);
 
-        cmd_buf.reset();
-        cmd_buf.begin({});
+        // With damage tracking the image repaints only what changed since it
+        // was last drawn, cleared and drawn over what it still holds, and
+        // nothing at all when it is up to date
+        std::optional<vk::Rect2D> repaint = rect;
+        bool partial_repaint = false;
+        if (damage.has_value()) {
+            repaint = damage->repaintBounds(frame_idx);
+            partial_repaint =
+                repaint.has_value() && !damage->isFull(repaint.value());
+        }
+        if (partial_repaint) {
+            rpb_info.setRenderPass(*vk_render_pass_load.value());
+            rpb_info.setRenderArea(repaint.value());
+        }
+        auto scissor = repaint.value_or(rect);
 
-        {
-            cmd_buf.beginRenderPass(rpb_info, vk::SubpassContents::eInline);
-            cmd_buf.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
-            cmd_buf.setViewport(0, viewport);
-            cmd_buf.setScissor(0, rect);
-            cmd_buf.bindVertexBuffers(0, *vertex_buffer, {0});
-            cmd_buf.draw(static_cast<uint32_t>(VERTICES.size()), 1, 0, 0);
-            cmd_buf.endRenderPass();
+        cmd.reset({}, d);
+        cmd.begin(vk::CommandBufferBeginInfo{}, d);
+        recorded_draws = 0;
+
+        if (vk_crash_markers.has_value()) {
+            vk_crash_markers->begin(buffer_idx, frame_counter);
+        }
+        auto mark = [&](const char* label) {
+            if (vk_crash_markers.has_value()) {
+                vk_crash_markers->mark(cmd_buf, buffer_idx, label);
+            }
+        };
+
+        if (vk_occlusion_culler.has_value()) {
+            mark("culled scene");
+            beginGpuScope(cmd_buf, buffer_idx, FRAME_SCOPE);
+            timed_compute_effect[buffer_idx] = false;
+            recordCulledScene(cmd_buf, buffer_idx, d);
+            endGpuScope(cmd_buf, buffer_idx, FRAME_SCOPE);
+        } else {
+            mark("pre-passes");
+            bool compute_effect = use_compute_effect;
+            if (compute_effect) {
+                rpb_info.setRenderPass(vk_compute_effect->basePass());
+                rpb_info.setFramebuffer(vk_compute_effect->baseFramebuffer());
+            }
+
+            if (vk_particles.has_value()) {
+                vk_particles->simulate(cmd_buf, ANIMATION_STEP);
+            }
+            if (vk_vertex_animator.has_value()) {
+                vk_vertex_animator->animate(cmd_buf, buffer_idx,
+                                            frame_counter * ANIMATION_STEP);
+            }
+            beginGpuScope(cmd_buf, buffer_idx, FRAME_SCOPE);
+            timed_compute_effect[buffer_idx] = compute_effect;
+            if (vk_shading_rate_image.has_value()) {
+                vk_shading_rate_image->prepare(cmd_buf);
+            }
+            if (vk_overlay.has_value()) {
+                vk_overlay->prepare(cmd_buf, buffer_idx);
+                resetOverlayScope(cmd_buf, buffer_idx);
+            }
+
+            if (repaint.has_value()) {
+                mark("scene pass");
+                beginGpuScope(cmd_buf, buffer_idx, SCENE_SCOPE);
+                if (vk_shader_program.has_value()) {
+                    beginRendering(cmd, mainWindow().image(),
+                                   mainWindow().imageView(),
+                                   rpb_info.renderArea, partial_repaint, d);
+                } else {
+                    cmd.beginRenderPass(rpb_info,
+                                        vk::SubpassContents::eInline, d);
+                }
+                if (partial_repaint) {
+                    vk::ClearAttachment clear_attachment(
+                        vk::ImageAspectFlagBits::eColor, 0, clear_value);
+                    vk::ClearRect clear_rect(scissor, 0, 1);
+                    cmd.clearAttachments(clear_attachment, clear_rect, d);
+                }
+                if (vk_shader_program.has_value()) {
+                    vk_shader_program->bind(cmd_buf, render_state);
+                    cmd.setViewportWithCount(viewport, d);
+                    cmd.setScissorWithCount(scissor, d);
+                } else {
+                    cmd.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                                     compute_effect
+                                         ? *vk_effect_base_pipeline.value()
+                                         : currentPipeline(),
+                                     d);
+                    if (dynamic_state.has_value()) {
+                        dynamic_state->invalidate();
+                        dynamic_state->apply(cmd_buf, render_state);
+                    }
+                    cmd.setViewport(0, viewport, d);
+                    cmd.setScissor(0, scissor, d);
+                }
+                bindDescriptors(cmd_buf, buffer_idx, d);
+                if (vk_multiview.has_value()) {
+                    cmd.pushConstants<ViewTransforms>(
+                        *vk_pipeline_layout.value(),
+                        vk::ShaderStageFlagBits::eVertex, 0,
+                        vk_multiview->transforms(VIEW_SPACING), d);
+                }
+                if (vk_vertex_animator.has_value()) {
+                    cmd.bindVertexBuffers(
+                        0, vk_vertex_animator->vertexBuffer(buffer_idx), {0},
+                        d);
+                } else {
+                    cmd.bindVertexBuffers(0, *vertex_buffer, {0}, d);
+                }
+                drawSceneMesh(cmd, d);
+                recorded_draws++;
+                if (vk_particles.has_value()) {
+                    vk_particles->draw(cmd_buf, viewport, scissor);
+                    recorded_draws++;
+                }
+                if (vk_overlay.has_value()) {
+                    beginOverlayScope(cmd_buf, buffer_idx);
+                    recorded_draws += vk_overlay->draw(cmd_buf, buffer_idx,
+                                                       viewport, scissor);
+                    endOverlayScope(cmd_buf, buffer_idx);
+                }
+                if (vk_shader_program.has_value()) {
+                    endRendering(cmd, mainWindow().image(), d);
+                } else {
+                    cmd.endRenderPass(d);
+                }
+                endGpuScope(cmd_buf, buffer_idx, SCENE_SCOPE);
+            }
+            mark("post-passes");
+
+            bool post_effects = vk_shading_rate_image.has_value() ||
+                                compute_effect || vk_multiview.has_value();
+            if (post_effects) {
+                beginGpuScope(cmd_buf, buffer_idx, EFFECT_SCOPE);
+            }
+            // Rates for the next frame, from what this one rendered
+            if (vk_shading_rate_image.has_value()) {
+                vk_shading_rate_image->analyze(cmd_buf, mainWindow().image(),
+                                               mainWindow().imageView());
+            }
+            if (compute_effect) {
+                vk_compute_effect->apply(cmd_buf, buffer_idx,
+                                         mainWindow().image());
+            }
+            if (vk_multiview.has_value()) {
+                vk_multiview->present(cmd_buf, mainWindow().image(),
+                                      extent);
+            }
+            if (post_effects) {
+                endGpuScope(cmd_buf, buffer_idx, EFFECT_SCOPE);
+            }
+            if (window_targets.size() > 1) {
+                mark("extra windows");
+                recordWindowTargets(cmd_buf, buffer_idx, d);
+            }
+            endGpuScope(cmd_buf, buffer_idx, FRAME_SCOPE);
+        }
+
+        mark("frame end");
+        cmd.end(d);
+    }
+
+    /// @brief Draws the scene into every extra window with an acquired image,
+    /// one pass each with the pipeline and descriptors of the main window
+    template <typename Dispatch>
+    void recordWindowTargets(const vk::raii::CommandBuffer& cmd_buf,
+                             uint32_t buffer_idx, const Dispatch& d) {
+        vk::CommandBuffer cmd = *cmd_buf;
+        auto& rpass = vk_render_pass.value();
+        auto& vertex_buffer = vk_vertex_buffer.value();
+        vk::ClearColorValue clear_color({0.0f, 0.0f, 0.0f, 1.0f});
+        vk::ClearValue clear_value(clear_color);
+
+        // The main window, first, was drawn by the scene passes
+        for (size_t i = 1; i < window_targets.size(); i++) {
+            auto& target = window_targets[i];
+            if (!target->acquired()) {
+                continue;
+            }
+
+            vk::Rect2D rect({0, 0}, target->extent());
+            vk::Viewport viewport(0, 0, rect.extent.width, rect.extent.height,
+                                  0, 1);
+            vk::RenderPassBeginInfo rpb_info(rpass, target->framebuffer(), rect,
+                                             clear_value);
+
+            if (vk_shader_program.has_value()) {
+                beginRendering(cmd, target->image(), target->imageView(), rect,
+                               false, d);
+                vk_shader_program->bind(cmd_buf, render_state);
+                cmd.setViewportWithCount(viewport, d);
+                cmd.setScissorWithCount(rect, d);
+            } else {
+                cmd.beginRenderPass(rpb_info, vk::SubpassContents::eInline, d);
+                cmd.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                                 currentPipeline(), d);
+                if (dynamic_state.has_value()) {
+                    dynamic_state->apply(cmd_buf, render_state);
+                }
+                cmd.setViewport(0, viewport, d);
+                cmd.setScissor(0, rect, d);
+            }
+            bindDescriptors(cmd_buf, buffer_idx, d);
+            if (vk_vertex_animator.has_value()) {
+                cmd.bindVertexBuffers(
+                    0, vk_vertex_animator->vertexBuffer(buffer_idx), {0}, d);
+            } else {
+                cmd.bindVertexBuffers(0, *vertex_buffer, {0}, d);
+            }
+            drawSceneMesh(cmd, d);
+            recorded_draws++;
+            if (vk_shader_program.has_value()) {
+                endRendering(cmd, target->image(), d);
+            } else {
+                cmd.endRenderPass(d);
+            }
+        }
+    }
+
+    /// @brief Begins drawing into the swapchain image `image` through `view`
+    /// without a render pass, as shader objects do. The image moves to the
+    /// color attachment layout first, keeping what it held when last
+    /// presented if `load`, and is cleared otherwise.
+    template <typename Dispatch>
+    void beginRendering(vk::CommandBuffer cmd, vk::Image image,
+                        vk::ImageView view, const vk::Rect2D& area, bool load,
+                        const Dispatch& d) {
+        // Waits for the acquire semaphore, signalled at color output
+        vk::ImageMemoryBarrier to_attachment(
+            {},
+            vk::AccessFlagBits::eColorAttachmentRead |
+                vk::AccessFlagBits::eColorAttachmentWrite,
+            load ? vk::ImageLayout::ePresentSrcKHR
+                 : vk::ImageLayout::eUndefined,
+            vk::ImageLayout::eColorAttachmentOptimal, VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED, image, COLOR_RANGE);
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                            vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                            {}, nullptr, nullptr, to_attachment, d);
+
+        vk::RenderingAttachmentInfo color_attach{};
+        color_attach.setImageView(view);
+        color_attach.setImageLayout(vk::ImageLayout::eColorAttachmentOptimal);
+        color_attach.setLoadOp(load ? vk::AttachmentLoadOp::eLoad
+                                    : vk::AttachmentLoadOp::eClear);
+        color_attach.setStoreOp(vk::AttachmentStoreOp::eStore);
+        color_attach.setClearValue(
+            vk::ClearColorValue({0.0f, 0.0f, 0.0f, 1.0f}));
+
+        vk::RenderingInfo rendering_info({}, area, 1, 0, color_attach);
+        cmd.beginRendering(rendering_info, d);
+    }
+
+    /// @brief Ends drawing started with `beginRendering` and leaves `image`
+    /// ready for presentation
+    template <typename Dispatch>
+    void endRendering(vk::CommandBuffer cmd, vk::Image image,
+                      const Dispatch& d) {
+        cmd.endRendering(d);
+
+        vk::ImageMemoryBarrier to_present(
+            vk::AccessFlagBits::eColorAttachmentWrite, {},
+            vk::ImageLayout::eColorAttachmentOptimal,
+            vk::ImageLayout::ePresentSrcKHR, VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED, image, COLOR_RANGE);
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                            vk::PipelineStageFlagBits::eBottomOfPipe, {},
+                            nullptr, nullptr, to_present, d);
+    }
+
+    /// @brief Draws the scene vertices bound at binding 0, through the index
+    /// buffer when the mesh was optimized or loaded from an asset
+    template <typename Dispatch>
+    void drawSceneMesh(vk::CommandBuffer cmd, const Dispatch& d) {
+        if (!vk_index_buffer.has_value()) {
+            cmd.draw(static_cast<uint32_t>(VERTICES.size()), 1, 0, 0, d);
+            return;
+        }
+        cmd.bindIndexBuffer(*vk_index_buffer->buffer, 0,
+                            vk::IndexType::eUint32, d);
+        cmd.drawIndexed(scene_index_count, 1, 0, 0, 0, d);
+    }
+
+    /// @brief Records both culling phases with the pyramid rebuild between
+    /// them, each phase drawing the objects it found visible
+    template <typename Dispatch>
+    void recordCulledScene(const vk::raii::CommandBuffer& cmd_buf,
+                           uint32_t buffer_idx, const Dispatch& d) {
+        vk::CommandBuffer cmd = *cmd_buf;
+        auto& extent = vk_surface_info.value().extent;
+        auto& culler = vk_occlusion_culler.value();
+        auto fbuf = mainWindow().framebuffer();
+        auto& vertex_buffer = vk_vertex_buffer.value();
+        auto& object_layout = vk_object_pipeline_layout.value();
+
+        vk::Rect2D rect({0, 0}, extent);
+        std::array<vk::ClearValue, 2> clear_values = {
+            vk::ClearColorValue({0.0f, 0.0f, 0.0f, 1.0f}),
+            vk::ClearDepthStencilValue(1.0f, 0)};
+        vk::Viewport viewport(rect.offset.x, rect.offset.y, rect.extent.width,
+                              rect.extent.height, 0, 1);
+
+        if (vk_overlay.has_value()) {
+            vk_overlay->prepare(cmd_buf, buffer_idx);
+            resetOverlayScope(cmd_buf, buffer_idx);
+        }
+
+        for (uint32_t phase = 0; phase < OcclusionCuller::PHASE_COUNT;
+             phase++) {
+            beginGpuScope(cmd_buf, buffer_idx, CULL_SCOPE + phase);
+            if (phase > 0) {
+                culler.buildPyramid(cmd_buf, *vk_depth_image->image);
+            }
+            culler.cull(cmd_buf, phase, buffer_idx, camera);
+            endGpuScope(cmd_buf, buffer_idx, CULL_SCOPE + phase);
+
+            auto& rpass = phase == 0 ? vk_render_pass.value()
+                                     : vk_render_pass_load.value();
+            vk::RenderPassBeginInfo rpb_info(rpass, fbuf, rect, clear_values);
+
+            beginGpuScope(cmd_buf, buffer_idx, SCENE_SCOPE + phase);
+            cmd.beginRenderPass(rpb_info, vk::SubpassContents::eInline, d);
+            cmd.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                             *vk_object_pipeline.value(), d);
+            cmd.setViewport(0, viewport, d);
+            cmd.setScissor(0, rect, d);
+            bindDescriptors(cmd_buf, buffer_idx, d);
+            cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+                                   *object_layout, 1,
+                                   culler.objectSet(buffer_idx), nullptr, d);
+            cmd.bindVertexBuffers(0, *vertex_buffer, {0}, d);
+            culler.draw(cmd_buf, phase);
+            recorded_draws++;
+            if (vk_overlay.has_value() &&
+                phase + 1 == OcclusionCuller::PHASE_COUNT) {
+                beginOverlayScope(cmd_buf, buffer_idx);
+                recorded_draws +=
+                    vk_overlay->draw(cmd_buf, buffer_idx, viewport, rect);
+                endOverlayScope(cmd_buf, buffer_idx);
+            }
+            cmd.endRenderPass(d);
+            endGpuScope(cmd_buf, buffer_idx, SCENE_SCOPE + phase);
+        }
+    }
+
+    /// @brief Starts a GPU timer scope of the frame slot, when timing
+    void beginGpuScope(const vk::raii::CommandBuffer& cmd_buf,
+                       uint32_t buffer_idx, uint32_t scope) {
+        if (vk_gpu_timer.has_value()) {
+            vk_gpu_timer->begin(cmd_buf, buffer_idx, scope);
+        }
+    }
+
+    void endGpuScope(const vk::raii::CommandBuffer& cmd_buf,
+                     uint32_t buffer_idx, uint32_t scope) {
+        if (vk_gpu_timer.has_value()) {
+            vk_gpu_timer->end(cmd_buf, buffer_idx, scope);
+        }
+    }
+
+    /// @brief Whether the overlay draw is timed. Its timestamps are written
+    /// inside the scene pass, so its scope is reset before the pass begins,
+    /// and not in a multiview pass, where each would take one query per view.
+    bool overlayTimed() const {
+        return vk_gpu_timer.has_value() && !vk_multiview.has_value();
+    }
+
+    void resetOverlayScope(const vk::raii::CommandBuffer& cmd_buf,
+                           uint32_t buffer_idx) {
+        if (overlayTimed()) {
+            vk_gpu_timer->reset(cmd_buf, buffer_idx, OVERLAY_SCOPE);
         }
+    }
+
+    void beginOverlayScope(const vk::raii::CommandBuffer& cmd_buf,
+                           uint32_t buffer_idx) {
+        if (overlayTimed()) {
+            vk_gpu_timer->beginInPass(cmd_buf, buffer_idx, OVERLAY_SCOPE);
+        }
+    }
+
+    void endOverlayScope(const vk::raii::CommandBuffer& cmd_buf,
+                         uint32_t buffer_idx) {
+        if (overlayTimed()) {
+            vk_gpu_timer->end(cmd_buf, buffer_idx, OVERLAY_SCOPE);
+        }
+    }
+
+    /// @brief Publishes totals kept by caches owned by this thread
+    void publishStats() {
+        auto& stats = StatsRegistry::global();
+        if (HostAllocator::global().isEnabled()) {
+            stats.set(Gauge::DriverHostBytes,
+                      HostAllocator::global().liveBytes());
+        }
+        if (vk_descriptor_cache.has_value()) {
+            stats.set(Gauge::DescriptorSetCacheHits,
+                      vk_descriptor_cache->hitCount());
+            stats.set(Gauge::DescriptorSetCacheMisses,
+                      vk_descriptor_cache->missCount());
+        }
+        if (vk_overlay.has_value()) {
+            auto& tessellations = vk_overlay->tessellationCache();
+            stats.set(Gauge::TessellationCacheHits, tessellations.hitCount());
+            stats.set(Gauge::TessellationCacheMisses,
+                      tessellations.missCount());
+            stats.set(Gauge::GlyphAtlasEvictions,
+                      vk_overlay->atlasEvictionCount());
+        }
+    }
+
+    /// @brief Passes the GPU times of a completed frame slot to the stats
+    /// and the HUD and, when benchmarking, adds the frame time to its effect
+    /// path and prints the path's average every `TIMING_INTERVAL` frames
+    void collectGpuTime(uint32_t frame_idx) {
+        auto& stats = StatsRegistry::global();
+        // Passes recorded once per culling phase count as one
+        auto record_pass = [&](Histogram histogram, uint32_t first_scope,
+                               uint32_t scope_count) {
+            std::optional<double> total{};
+            for (uint32_t i = 0; i < scope_count; i++) {
+                auto elapsed = vk_gpu_timer->read(frame_idx, first_scope + i);
+                if (elapsed.has_value()) {
+                    total = total.value_or(0.0) + elapsed.value();
+                }
+            }
+            if (total.has_value()) {
+                stats.record(histogram, total.value());
+            }
+        };
+        record_pass(Histogram::GpuCullTime, CULL_SCOPE,
+                    OcclusionCuller::PHASE_COUNT);
+        record_pass(Histogram::GpuSceneTime, SCENE_SCOPE,
+                    OcclusionCuller::PHASE_COUNT);
+        record_pass(Histogram::GpuEffectTime, EFFECT_SCOPE, 1);
+        record_pass(Histogram::GpuOverlayTime, OVERLAY_SCOPE, 1);
+
+        auto elapsed = vk_gpu_timer->read(frame_idx, FRAME_SCOPE);
+        if (!elapsed.has_value()) {
+            return;
+        }
+
+        stats.record(Histogram::GpuFrameTime, elapsed.value());
+        if (hud.has_value()) {
+            hud->addGpuTime(elapsed.value());
+        }
+        if (!options.bench) {
+            return;
+        }
+
+        size_t path = timed_compute_effect[frame_idx] ? 1 : 0;
+        effect_time_ms[path] += elapsed.value();
+        effect_time_samples[path]++;
+
+        if (effect_time_samples[path] == TIMING_INTERVAL) {
+            auto& extent = vk_surface_info.value().extent;
+            std::cout << "effect: " << (path == 1 ? "compute" : "fragment")
+                      << " at " << extent.width << "x" << extent.height
+                      << " in " << effect_time_ms[path] / TIMING_INTERVAL
+                      << " ms" << std::endl;
+            effect_time_ms[path] = 0.0;
+            effect_time_samples[path] = 0;
+        }
+    }
 
-        cmd_buf.end();
+    /// @brief Queues the 2D overlay: a panel with text, a static filled
+    /// shape and a chart that changes every frame
+    void queueVectorOverlay() {
+        auto& overlay = vk_overlay.value();
+        float time = frame_counter * ANIMATION_STEP;
+
+        glm::vec2 panel(OVERLAY_PANEL.offset.x, OVERLAY_PANEL.offset.y);
+        overlay.rect(panel,
+                     glm::vec2(OVERLAY_PANEL.extent.width,
+                               OVERLAY_PANEL.extent.height),
+                     glm::vec4(0.05f, 0.05f, 0.08f, 0.75f));
+        overlay.text("vk lab 2d", panel + glm::vec2(12.0f, 12.0f), 14.0f,
+                     glm::vec4(1.0f));
+        overlay.text("frame " + std::to_string(frame_counter),
+                     panel + glm::vec2(140.0f, 14.0f), 10.0f,
+                     glm::vec4(0.7f, 0.7f, 0.7f, 1.0f));
+
+        // Same outline every frame, tessellated once
+        Path star{};
+        for (uint32_t i = 0; i < 10; i++) {
+            float angle = i * 0.2f * 3.14159265f;
+            float radius = i % 2 == 0 ? 28.0f : 12.0f;
+            glm::vec2 point(radius * std::sin(angle), -radius * std::cos(angle));
+            if (i == 0) {
+                star.moveTo(point);
+            } else {
+                star.lineTo(point);
+            }
+        }
+        star.close();
+        overlay.fillPath(star, glm::vec4(1.0f, 0.8f, 0.2f, 1.0f),
+                         panel + glm::vec2(44.0f, 82.0f));
+        overlay.strokePath(star, 2.0f, glm::vec4(1.0f, 1.0f, 1.0f, 0.9f),
+                           panel + glm::vec2(44.0f, 82.0f));
+
+        // New outline every frame, tessellated on a worker
+        Path chart{};
+        for (uint32_t i = 0; i <= 48; i++) {
+            float x = i * 3.5f;
+            float y = 24.0f * std::sin(0.25f * i + 3.0f * time);
+            if (i == 0) {
+                chart.moveTo({x, y});
+            } else {
+                chart.lineTo({x, y});
+            }
+        }
+        overlay.strokePath(chart, 2.0f, glm::vec4(0.3f, 0.9f, 0.5f, 1.0f),
+                           panel + glm::vec2(96.0f, 82.0f));
+    }
+
+    /// @brief Marks what changes this frame in the damage tracker and
+    /// returns whether anything does. Camera moves, resizes and an animated
+    /// scene damage the whole image, the HUD and the 2D overlay only their
+    /// panels.
+    bool trackDamage() {
+        if (frame_dirty || sceneAnimating()) {
+            damage->addFull();
+        }
+        if (options.vector_overlay) {
+            damage->add(OVERLAY_PANEL);
+        }
+        if (hud.has_value() && hud->visible) {
+            damage->add(PerfHud::bounds());
+        }
+        return !damage->frameRects().empty();
     }
 
     void drawFrame() {
         auto& phys_device = vk_physical_device.value();
         auto& device = vk_device.value();
-        auto& swapch = vk_swapchain.value();
-        auto& ima_semaphor = vk_image_available_sema[current_frame];
-        auto& rf_semaphor = vk_render_finished_sema[current_frame];
+        auto& main_window = mainWindow();
         auto& cmd_buf = vk_cmd_buffers.value()[current_frame];
         auto& queue = vk_graphics_queue.value();
-        auto& fence_previous =
-            vk_fences[(current_frame + 1) % MAX_FRAMES_IN_FLIGHT];
-        auto& fence_current = vk_fences[current_frame];
-
-        vk::AcquireNextImageInfoKHR ani_info(swapch, UINT32_MAX, ima_semaphor,
-                                             nullptr, 1);
-        uint32_t image_index;
+        auto& fence = vk_fences[current_frame];
 
-        try {
-            auto res_imgidx = device.acquireNextImage2KHR(ani_info);
-            image_index = res_imgidx.second;
-        } catch (vk::OutOfDateKHRError err) {
-            swapchain_rebuild_needed = true;
+        // The image on screen already shows an undamaged frame, nothing is
+        // acquired, submitted or presented for it. An empty list of present
+        // regions would even mark the whole image changed.
+        undamaged = damage.has_value() && !trackDamage();
+        if (undamaged) {
             return;
         }
 
+        auto frame_start = std::chrono::steady_clock::now();
+        double frame_ms = std::chrono::duration<double, std::milli>(
+                              frame_start - last_frame_start)
+                              .count();
+        last_frame_start = frame_start;
+
+        // Wait until the previous submission from this frame slot is done,
+        // everything owned by the slot can be reused afterwards
+        if (device.waitForFences(*fence, true, UINT64_MAX) !=
+            vk::Result::eSuccess) {
+            throw std::runtime_error("failed to wait for frame fence");
+        }
+
+        if (vk_gpu_timer.has_value()) {
+            collectGpuTime(current_frame);
+        }
+
+        // Windows whose image is not ready are skipped this frame, the rest
+        // are drawn, submitted and presented together. The main window comes
+        // first, without its image there is nothing to draw the others from.
+        std::vector<vk::Semaphore> wait_semas{};
+        std::vector<vk::Semaphore> signal_semas{};
+        std::vector<vk::SwapchainKHR> swapchains{};
+        std::vector<uint32_t> image_indices{};
+        for (auto& target : window_targets) {
+            if (!target->acquire(device, current_frame)) {
+                if (target.get() == &main_window) {
+                    return;
+                }
+                continue;
+            }
+            wait_semas.push_back(target->imageAvailable(current_frame));
+            signal_semas.push_back(target->renderFinished(current_frame));
+            swapchains.push_back(target->swapchainHandle());
+            image_indices.push_back(target->imageIndex());
+        }
+        uint32_t image_index = main_window.imageIndex();
+
+        auto cpu_start = std::chrono::steady_clock::now();
+        device.resetFences(*fence);
+        if (vk_descriptor_allocator.has_value()) {
+            vk_descriptor_allocator->resetFrame(current_frame);
+        }
+
+        updateUniforms(current_frame);
+        if (scene.has_value()) {
+            updateScene(current_frame);
+        }
+        if (options.vector_overlay) {
+            queueVectorOverlay();
+        }
+        if (hud.has_value()) {
+            hud->queue(vk_overlay.value(), phys_device);
+        }
         overwriteCommandBuffer(current_frame, image_index);
 
-        vk::PipelineStageFlags stage_flags(
+        // Regions changed since the previous present, for the compositor
+        std::vector<vk::RectLayerKHR> changed_rects;
+        if (damage.has_value()) {
+            for (auto& rect : damage->frameRects()) {
+                changed_rects.emplace_back(rect.offset, rect.extent, 0);
+            }
+            damage->drawn(image_index);
+        }
+
+        std::vector<vk::PipelineStageFlags> stage_flags(
+            wait_semas.size(),
             vk::PipelineStageFlagBits::eColorAttachmentOutput);
-        vk::SubmitInfo submit_info(*ima_semaphor, stage_flags, *cmd_buf,
-                                   *rf_semaphor);
+        vk::SubmitInfo submit_info(wait_semas, stage_flags, *cmd_buf,
+                                   signal_semas);
+
+        if (vk_dispatch.has_value()) {
+            vk::Queue(*queue).submit(submit_info, *fence, vk_dispatch.value());
+        } else {
+            queue.submit(submit_info, *fence);
+        }
+        StatsRegistry::global().add(Counter::QueueSubmits);
 
-        queue.submit(submit_info);
+        // Shown from the next frame on
+        if (hud.has_value()) {
+            hud->addFrame(millisecondsSince(cpu_start), frame_ms,
+                          recorded_draws);
+        }
 
-        vk::PresentInfoKHR present_info(*rf_semaphor, *swapch, image_index);
+        // One present for all swapchains, each reporting its own result
+        std::vector<vk::Result> present_results(swapchains.size(),
+                                                vk::Result::eSuccess);
+        vk::PresentInfoKHR present_info(signal_semas, swapchains,
+                                        image_indices, present_results);
+
+        // Swapchains without rectangles, the extra windows, are updated in
+        // full
+        std::vector<vk::PresentRegionKHR> regions(swapchains.size());
+        regions[0].setRectangles(changed_rects);
+        vk::PresentRegionsKHR present_regions(regions);
+        if (damage.has_value() && capabilities.incremental_present) {
+            present_info.setPNext(&present_regions);
+        }
 
         try {
-            if (queue.presentKHR(present_info) == vk::Result::eSuboptimalKHR) {
-                swapchain_rebuild_needed = true;
+            if (vk_dispatch.has_value()) {
+                vk::Queue(*queue).presentKHR(present_info, vk_dispatch.value());
+            } else {
+                queue.presentKHR(present_info);
             }
-        } catch (vk::OutOfDateKHRError err) {
-            swapchain_rebuild_needed = true;
+        } catch (vk::OutOfDateKHRError&) {
+            // Every swapchain still reports its own result below
         }
 
-        queue.waitIdle();
+        size_t result_idx = 0;
+        for (auto& target : window_targets) {
+            if (target->acquired()) {
+                target->presented(present_results[result_idx++]);
+            }
+        }
+
+        StatsRegistry::global().add(Counter::Frames);
+        StatsRegistry::global().record(Histogram::FrameTime, frame_ms);
+        if (stats_server.has_value()) {
+            publishStats();
+        }
 
+        frame_dirty = false;
         current_frame = (current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+        frame_counter++;
     }
 };
 
-int main() {
-    App app;
-
+int main(int argc, char** argv) {
     try {
+        auto options = AppOptions::from(argc, argv);
+        if (options.batch_frames > 0) {
+            if (options.host_allocator) {
+                HostAllocator::global().enable();
+            }
+            BatchRenderer batch(options.batch_frames, options.batch_devices,
+                                options.batch_output);
+            batch.run(VERTICES, ANIMATION_STEP);
+            return EXIT_SUCCESS;
+        }
+
+        App app(options);
         app.init();
         app.runLoop();
     } catch (vk::SystemError& e) {
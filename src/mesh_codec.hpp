@@ -0,0 +1,667 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define MESH_CODEC_SSE 1
+#else
+#define MESH_CODEC_SSE 0
+#endif
+
+/// @brief Compressed encoding of an IndexedMesh, the format of mesh assets.
+///
+/// Vertex attributes are quantized to 16 bits per channel within the bounds
+/// of the channel. A channel is delta coded against the previous vertex,
+/// zigzag mapped so that small deltas of either sign give small codes, and
+/// split into a low and a high byte plane. Each group of 16 bytes of a plane
+/// is stored with as few bits per byte as hold all of them: 0, 2, 4 or 8.
+/// Vertices come in chunks of CHUNK_VERTICES coded on their own, which
+/// workers decode in parallel, unpacking a group and undoing the deltas of
+/// 16 vertices at once with SSE2.
+///
+/// Triangles are coded against a FIFO of recent edges and one of recent
+/// vertices: a triangle across an edge of a recent one takes a byte, its
+/// third vertex being the next unseen vertex, a recent one or a varint.
+/// Meshes whose vertices are in order of first use, as MeshOptimizer leaves
+/// them, mostly code the next unseen vertex. Decoded triangles may start at
+/// another corner, with the same winding.
+///
+/// Multi-byte fields are little-endian, as on every host this runs on.
+class MeshCodec {
+   public:
+    static constexpr uint32_t VERSION = 1;
+    // Vertices decoded as one task
+    static constexpr uint32_t CHUNK_VERTICES = 4096;
+    // Position x and y, color r, g and b
+    static constexpr uint32_t CHANNELS = 5;
+
+    struct Header {
+        std::array<char, 4> magic;
+        uint32_t version;
+        uint32_t vertex_count;
+        uint32_t index_count;
+        // A channel decodes to min + quantized * scale
+        std::array<float, CHANNELS> channel_min;
+        std::array<float, CHANNELS> channel_scale;
+        // Followed by chunk_count + 1 offsets: those of the vertex chunks
+        // and of the triangle codes, which run to the end
+        uint32_t chunk_count;
+    };
+
+    static std::vector<uint8_t> encode(const IndexedMesh& mesh) {
+        Header header{MAGIC,
+                      VERSION,
+                      static_cast<uint32_t>(mesh.vertices.size()),
+                      static_cast<uint32_t>(mesh.indices.size()),
+                      {},
+                      {},
+                      chunkCount(static_cast<uint32_t>(mesh.vertices.size()))};
+
+        std::vector<std::array<float, CHANNELS>> channels{};
+        for (auto& vertex : mesh.vertices) {
+            channels.push_back({vertex.pos.x, vertex.pos.y, vertex.color.r,
+                                vertex.color.g, vertex.color.b});
+        }
+
+        std::vector<std::array<uint16_t, CHANNELS>> quantized(
+            channels.size());
+        for (uint32_t c = 0; c < CHANNELS; c++) {
+            float min = 0.0f, max = 0.0f;
+            if (!channels.empty()) {
+                min = max = channels[0][c];
+            }
+            for (auto& values : channels) {
+                min = std::min(min, values[c]);
+                max = std::max(max, values[c]);
+            }
+            header.channel_min[c] = min;
+            header.channel_scale[c] = (max - min) / QUANTIZED_MAX;
+
+            for (size_t v = 0; v < channels.size(); v++) {
+                float unit =
+                    max > min ? (channels[v][c] - min) / (max - min) : 0.0f;
+                quantized[v][c] = static_cast<uint16_t>(
+                    std::lround(std::clamp(unit, 0.0f, 1.0f) * QUANTIZED_MAX));
+            }
+        }
+
+        std::vector<uint8_t> out(sizeof(Header) +
+                                 sizeof(uint32_t) * (header.chunk_count + 1));
+        std::memcpy(out.data(), &header, sizeof(Header));
+        auto set_offset = [&](uint32_t i) {
+            auto offset = static_cast<uint32_t>(out.size());
+            std::memcpy(out.data() + sizeof(Header) + sizeof(uint32_t) * i,
+                        &offset, sizeof(offset));
+        };
+
+        for (uint32_t chunk = 0; chunk < header.chunk_count; chunk++) {
+            set_offset(chunk);
+            auto first = chunk * CHUNK_VERTICES;
+            encodeChunk(quantized, first,
+                        std::min(CHUNK_VERTICES, header.vertex_count - first),
+                        out);
+        }
+        set_offset(header.chunk_count);
+        encodeTriangles(mesh.indices, out);
+        return out;
+    }
+
+    /// @brief Header of encoded `data`, throws unless the header and chunk
+    /// offsets are consistent with its size
+    static Header header(const std::vector<uint8_t>& data) {
+        Header header{};
+        if (data.size() < sizeof(Header)) {
+            throw std::runtime_error("mesh asset is truncated");
+        }
+        std::memcpy(&header, data.data(), sizeof(Header));
+        if (header.magic != MAGIC || header.version != VERSION) {
+            throw std::runtime_error("not a mesh asset of this version");
+        }
+        if (header.vertex_count == 0 || header.index_count == 0 ||
+            header.index_count % 3 != 0 ||
+            header.chunk_count != chunkCount(header.vertex_count)) {
+            throw std::runtime_error("mesh asset header is inconsistent");
+        }
+
+        auto offsets = chunkOffsets(data, header);
+        if (offsets[0] != sizeof(Header) + 4 * offsets.size() ||
+            !std::is_sorted(offsets.begin(), offsets.end()) ||
+            offsets.back() > data.size()) {
+            throw std::runtime_error("mesh asset offsets are inconsistent");
+        }
+
+        // Every triangle takes a byte at least, and every chunk its modes,
+        // which bounds what a corrupt header makes the caller allocate
+        for (uint32_t chunk = 0; chunk < header.chunk_count; chunk++) {
+            auto count = std::min(CHUNK_VERTICES,
+                                  header.vertex_count - chunk * CHUNK_VERTICES);
+            if (offsets[chunk + 1] - offsets[chunk] <
+                CHANNELS * modeBytes(count)) {
+                throw std::runtime_error("mesh asset chunk is truncated");
+            }
+        }
+        if (header.index_count / 3 > data.size() - offsets.back()) {
+            throw std::runtime_error("mesh asset is truncated");
+        }
+        return header;
+    }
+
+    /// @brief Decodes `data` into `vertex_count` vertices and `index_count`
+    /// indices as given by its header. Vertices are written in order, whole
+    /// vertices at a time, so that the destination may be write-combined
+    /// memory mapped from the device.
+    static void decode(const std::vector<uint8_t>& data, Vertex* vertices,
+                       uint32_t* indices) {
+        auto head = header(data);
+        auto offsets = chunkOffsets(data, head);
+
+        uint32_t worker_count = std::clamp(std::thread::hardware_concurrency(),
+                                           1u, head.chunk_count);
+        std::vector<std::future<void>> workers{};
+        for (uint32_t w = 0; w < worker_count; w++) {
+            workers.push_back(std::async(std::launch::async, [&, w]() {
+                std::vector<float> scratch{};
+                for (auto chunk = w; chunk < head.chunk_count;
+                     chunk += worker_count) {
+                    auto first = chunk * CHUNK_VERTICES;
+                    Reader reader{data.data(), offsets[chunk],
+                                  offsets[chunk + 1]};
+                    decodeChunk(
+                        reader, head,
+                        std::min(CHUNK_VERTICES, head.vertex_count - first),
+                        vertices + first, scratch);
+                }
+            }));
+        }
+
+        // Triangles are coded sequentially, they are decoded here while the
+        // workers take the vertices
+        Reader reader{data.data(), offsets.back(), data.size()};
+        decodeTriangles(reader, head, indices);
+        for (auto& worker : workers) {
+            worker.get();
+        }
+    }
+
+    static IndexedMesh decode(const std::vector<uint8_t>& data) {
+        auto head = header(data);
+        IndexedMesh mesh{std::vector<Vertex>(head.vertex_count),
+                         std::vector<uint32_t>(head.index_count)};
+        decode(data, mesh.vertices.data(), mesh.indices.data());
+        return mesh;
+    }
+
+   private:
+    static constexpr std::array<char, 4> MAGIC = {'V', 'K', 'M', 'Z'};
+    static constexpr float QUANTIZED_MAX = 65535.0f;
+    static constexpr uint32_t GROUP_SIZE = 16;
+    // Bytes of a group stored with each bit width mode
+    static constexpr std::array<uint32_t, 4> GROUP_BYTES = {0, 4, 8, 16};
+    // Edge codes 0 to 14 pick a recent edge, vertex codes 1 to 14 a recent
+    // vertex. Both are kept in rings of a power of two.
+    static constexpr uint32_t EDGE_FIFO_SIZE = 15;
+    static constexpr uint32_t VERTEX_FIFO_SIZE = 14;
+    static constexpr uint32_t RING_SIZE = 16;
+    static constexpr uint8_t NO_EDGE = 15;
+    static constexpr uint8_t NEXT_VERTEX = 0;
+    static constexpr uint8_t EXPLICIT_VERTEX = 15;
+
+    /// @brief Bounds checked view of [offset, end) of the encoded data
+    struct Reader {
+        const uint8_t* data;
+        size_t offset;
+        size_t end;
+
+        const uint8_t* take(size_t size) {
+            if (end - offset < size) {
+                throw std::runtime_error("mesh asset is truncated");
+            }
+            auto bytes = data + offset;
+            offset += size;
+            return bytes;
+        }
+
+        uint32_t varint() {
+            uint32_t value = 0;
+            for (uint32_t shift = 0; shift < 35; shift += 7) {
+                auto byte = *take(1);
+                value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+                if ((byte & 0x80) == 0) {
+                    return value;
+                }
+            }
+            throw std::runtime_error("mesh asset varint is too long");
+        }
+    };
+
+    /// @brief Recent edges and vertices, the same on both sides
+    struct TriangleFifo {
+        std::array<std::array<uint32_t, 2>, RING_SIZE> edges{};
+        std::array<uint32_t, RING_SIZE> vertices{};
+        uint32_t edges_pushed = 0;
+        uint32_t vertices_pushed = 0;
+        // Vertex predicted for the next new one
+        uint32_t next = 0;
+
+        uint32_t edgeCount() const {
+            return std::min(edges_pushed, EDGE_FIFO_SIZE);
+        }
+
+        uint32_t vertexCount() const {
+            return std::min(vertices_pushed, VERTEX_FIFO_SIZE);
+        }
+
+        /// @brief The edge pushed `age` pushes before the last one
+        const std::array<uint32_t, 2>& edge(uint32_t age) const {
+            return edges[(edges_pushed - 1 - age) % RING_SIZE];
+        }
+
+        uint32_t vertex(uint32_t age) const {
+            return vertices[(vertices_pushed - 1 - age) % RING_SIZE];
+        }
+
+        std::optional<uint32_t> findEdge(uint32_t a, uint32_t b) const {
+            for (uint32_t age = 0; age < edgeCount(); age++) {
+                if (edge(age) == std::array<uint32_t, 2>{a, b}) {
+                    return age;
+                }
+            }
+            return std::nullopt;
+        }
+
+        void pushTriangle(uint32_t a, uint32_t b, uint32_t c) {
+            for (auto edge : {std::array<uint32_t, 2>{a, b}, {b, c}, {c, a}}) {
+                edges[edges_pushed++ % RING_SIZE] = edge;
+            }
+        }
+
+        void pushVertex(uint32_t v) {
+            vertices[vertices_pushed++ % RING_SIZE] = v;
+            next = std::max(next, v + 1);
+        }
+    };
+
+    static uint32_t chunkCount(uint32_t vertex_count) {
+        return (vertex_count + CHUNK_VERTICES - 1) / CHUNK_VERTICES;
+    }
+
+    static std::vector<uint32_t> chunkOffsets(const std::vector<uint8_t>& data,
+                                              const Header& header) {
+        std::vector<uint32_t> offsets(header.chunk_count + 1);
+        auto size = sizeof(uint32_t) * offsets.size();
+        if (data.size() - sizeof(Header) < size) {
+            throw std::runtime_error("mesh asset is truncated");
+        }
+        std::memcpy(offsets.data(), data.data() + sizeof(Header), size);
+        return offsets;
+    }
+
+    /// @brief Bytes of the group modes of one channel of `count` vertices,
+    /// two bits for each plane of each block
+    static uint32_t modeBytes(uint32_t count) {
+        uint32_t group_count = 2 * ((count + GROUP_SIZE - 1) / GROUP_SIZE);
+        return (group_count + 3) / 4;
+    }
+
+    static uint16_t zigzag(uint16_t delta) {
+        return static_cast<uint16_t>((delta << 1) ^
+                                     (static_cast<int16_t>(delta) >> 15));
+    }
+
+    static uint16_t unzigzag(uint16_t code) {
+        return static_cast<uint16_t>((code >> 1) ^ (0u - (code & 1u)));
+    }
+
+    static void encodeChunk(
+        const std::vector<std::array<uint16_t, CHANNELS>>& quantized,
+        uint32_t first, uint32_t count, std::vector<uint8_t>& out) {
+        uint32_t block_count = (count + GROUP_SIZE - 1) / GROUP_SIZE;
+
+        for (uint32_t c = 0; c < CHANNELS; c++) {
+            auto modes_at = out.size();
+            out.resize(out.size() + modeBytes(count), 0);
+
+            uint16_t previous = 0;
+            for (uint32_t block = 0; block < block_count; block++) {
+                std::array<std::array<uint8_t, GROUP_SIZE>, 2> planes{};
+                for (uint32_t i = 0; i < GROUP_SIZE; i++) {
+                    auto v = block * GROUP_SIZE + i;
+                    uint16_t code = 0;
+                    if (v < count) {
+                        auto value = quantized[first + v][c];
+                        code = zigzag(static_cast<uint16_t>(value - previous));
+                        previous = value;
+                    }
+                    planes[0][i] = static_cast<uint8_t>(code);
+                    planes[1][i] = static_cast<uint8_t>(code >> 8);
+                }
+
+                for (uint32_t plane = 0; plane < 2; plane++) {
+                    auto group = 2 * block + plane;
+                    auto mode = encodeGroup(planes[plane], out);
+                    out[modes_at + group / 4] |=
+                        static_cast<uint8_t>(mode << (group % 4 * 2));
+                }
+            }
+        }
+    }
+
+    /// @brief Appends `group` with the fewest bits per byte, returning the
+    /// mode: 0, 2, 4 or 8 bits. Byte i of 2 bit groups is at bit 2 * (i % 4)
+    /// of byte i / 4, of 4 bit groups at bit 4 * (i % 2) of byte i / 2.
+    static uint32_t encodeGroup(const std::array<uint8_t, GROUP_SIZE>& group,
+                                std::vector<uint8_t>& out) {
+        auto max = *std::max_element(group.begin(), group.end());
+        if (max == 0) {
+            return 0;
+        }
+        if (max < 4) {
+            for (uint32_t i = 0; i < GROUP_SIZE; i += 4) {
+                out.push_back(static_cast<uint8_t>(
+                    group[i] | group[i + 1] << 2 | group[i + 2] << 4 |
+                    group[i + 3] << 6));
+            }
+            return 1;
+        }
+        if (max < 16) {
+            for (uint32_t i = 0; i < GROUP_SIZE; i += 2) {
+                out.push_back(
+                    static_cast<uint8_t>(group[i] | group[i + 1] << 4));
+            }
+            return 2;
+        }
+        out.insert(out.end(), group.begin(), group.end());
+        return 3;
+    }
+
+    /// @brief Decodes `count` vertices into `vertices`, channel by channel
+    /// into `scratch` first
+    static void decodeChunk(Reader& reader, const Header& header,
+                            uint32_t count, Vertex* vertices,
+                            std::vector<float>& scratch) {
+        uint32_t block_count = (count + GROUP_SIZE - 1) / GROUP_SIZE;
+        uint32_t stride = block_count * GROUP_SIZE;
+        scratch.resize(CHANNELS * stride);
+
+        for (uint32_t c = 0; c < CHANNELS; c++) {
+            auto modes = reader.take(modeBytes(count));
+            uint16_t previous = 0;
+            for (uint32_t block = 0; block < block_count; block++) {
+                std::array<const uint8_t*, 2> planes{};
+                std::array<uint32_t, 2> group_modes{};
+                for (uint32_t plane = 0; plane < 2; plane++) {
+                    auto group = 2 * block + plane;
+                    auto mode = modes[group / 4] >> (group % 4 * 2) & 3;
+                    group_modes[plane] = mode;
+                    planes[plane] = reader.take(GROUP_BYTES[mode]);
+                }
+                decodeBlock(planes, group_modes, header.channel_min[c],
+                            header.channel_scale[c], previous,
+                            scratch.data() + c * stride + block * GROUP_SIZE);
+            }
+        }
+
+        for (uint32_t v = 0; v < count; v++) {
+            auto value = [&](uint32_t c) { return scratch[c * stride + v]; };
+            vertices[v] = Vertex{{value(0), value(1)},
+                                 {value(2), value(3), value(4)}};
+        }
+    }
+
+#if MESH_CODEC_SSE
+    /// @brief Spreads the low 8 bytes of `bytes` into 16, each field of
+    /// BITS bits of a byte into a byte of its own, low fields first
+    template <int BITS>
+    static __m128i splitFields(__m128i bytes) {
+        auto mask = _mm_set1_epi8(static_cast<char>((1 << BITS) - 1));
+        auto low = _mm_and_si128(bytes, mask);
+        auto high = _mm_and_si128(_mm_srli_epi16(bytes, BITS), mask);
+        return _mm_unpacklo_epi8(low, high);
+    }
+
+    static __m128i decodeGroup(const uint8_t* data, uint32_t mode) {
+        switch (mode) {
+            case 1: {
+                int32_t packed;
+                std::memcpy(&packed, data, sizeof(packed));
+                return splitFields<2>(
+                    splitFields<4>(_mm_cvtsi32_si128(packed)));
+            }
+            case 2:
+                return splitFields<4>(
+                    _mm_loadl_epi64(reinterpret_cast<const __m128i*>(data)));
+            case 3:
+                return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+            default:
+                return _mm_setzero_si128();
+        }
+    }
+
+    /// @brief Joins the byte planes of 16 vertices, undoes the zigzag and
+    /// the deltas with a prefix sum, and dequantizes into `out`
+    static void decodeBlock(const std::array<const uint8_t*, 2>& planes,
+                            const std::array<uint32_t, 2>& modes, float min,
+                            float scale, uint16_t& previous, float* out) {
+        auto low = decodeGroup(planes[0], modes[0]);
+        auto high = decodeGroup(planes[1], modes[1]);
+        auto zero = _mm_setzero_si128();
+        auto one = _mm_set1_epi16(1);
+        auto min4 = _mm_set1_ps(min);
+        auto scale4 = _mm_set1_ps(scale);
+
+        for (auto codes :
+             {_mm_unpacklo_epi8(low, high), _mm_unpackhi_epi8(low, high)}) {
+            auto deltas = _mm_xor_si128(
+                _mm_srli_epi16(codes, 1),
+                _mm_sub_epi16(zero, _mm_and_si128(codes, one)));
+            auto values = _mm_add_epi16(deltas, _mm_slli_si128(deltas, 2));
+            values = _mm_add_epi16(values, _mm_slli_si128(values, 4));
+            values = _mm_add_epi16(values, _mm_slli_si128(values, 8));
+            values = _mm_add_epi16(
+                values, _mm_set1_epi16(static_cast<int16_t>(previous)));
+            previous = static_cast<uint16_t>(_mm_extract_epi16(values, 7));
+
+            auto first = _mm_cvtepi32_ps(_mm_unpacklo_epi16(values, zero));
+            auto second = _mm_cvtepi32_ps(_mm_unpackhi_epi16(values, zero));
+            _mm_storeu_ps(out, _mm_add_ps(min4, _mm_mul_ps(first, scale4)));
+            _mm_storeu_ps(out + 4,
+                          _mm_add_ps(min4, _mm_mul_ps(second, scale4)));
+            out += 8;
+        }
+    }
+#else
+    static std::array<uint8_t, GROUP_SIZE> decodeGroup(const uint8_t* data,
+                                                       uint32_t mode) {
+        std::array<uint8_t, GROUP_SIZE> group{};
+        for (uint32_t i = 0; i < GROUP_SIZE; i++) {
+            switch (mode) {
+                case 1:
+                    group[i] = data[i / 4] >> (i % 4 * 2) & 3;
+                    break;
+                case 2:
+                    group[i] = data[i / 2] >> (i % 2 * 4) & 15;
+                    break;
+                case 3:
+                    group[i] = data[i];
+                    break;
+            }
+        }
+        return group;
+    }
+
+    static void decodeBlock(const std::array<const uint8_t*, 2>& planes,
+                            const std::array<uint32_t, 2>& modes, float min,
+                            float scale, uint16_t& previous, float* out) {
+        auto low = decodeGroup(planes[0], modes[0]);
+        auto high = decodeGroup(planes[1], modes[1]);
+        for (uint32_t i = 0; i < GROUP_SIZE; i++) {
+            auto code = static_cast<uint16_t>(low[i] | high[i] << 8);
+            previous = static_cast<uint16_t>(previous + unzigzag(code));
+            out[i] = min + static_cast<float>(previous) * scale;
+        }
+    }
+#endif
+
+    static void writeVarint(uint32_t value, std::vector<uint8_t>& out) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    /// @brief Appends what follows the code of vertex `v`, returning the code
+    static uint8_t encodeVertex(uint32_t v, TriangleFifo& fifo,
+                                std::vector<uint8_t>& out) {
+        if (v == fifo.next) {
+            fifo.pushVertex(v);
+            return NEXT_VERTEX;
+        }
+        for (uint32_t age = 0; age < fifo.vertexCount(); age++) {
+            if (fifo.vertex(age) == v) {
+                return static_cast<uint8_t>(1 + age);
+            }
+        }
+        // Zigzag mapped difference to the prediction
+        auto delta = v - fifo.next;
+        writeVarint(delta << 1 ^ (0u - (delta >> 31)), out);
+        fifo.pushVertex(v);
+        return EXPLICIT_VERTEX;
+    }
+
+    static uint32_t decodeVertex(uint8_t code, TriangleFifo& fifo,
+                                 Reader& reader, const Header& header) {
+        uint32_t v = 0;
+        if (code == NEXT_VERTEX) {
+            v = fifo.next;
+        } else if (code == EXPLICIT_VERTEX) {
+            auto zigzagged = reader.varint();
+            v = fifo.next + (zigzagged >> 1 ^ (0u - (zigzagged & 1u)));
+        } else {
+            if (code > fifo.vertexCount()) {
+                throw std::runtime_error("mesh asset vertex code is invalid");
+            }
+            return fifo.vertex(code - 1u);
+        }
+        if (v >= header.vertex_count) {
+            throw std::runtime_error("mesh asset index is out of range");
+        }
+        fifo.pushVertex(v);
+        return v;
+    }
+
+    /// @brief Appends a code byte per triangle, high nibble an edge code and
+    /// low nibble a vertex code. A triangle across no recent edge has a
+    /// second byte with the codes of its other two vertices. Varints of
+    /// explicit vertices follow in the order of the corners.
+    static void encodeTriangles(const std::vector<uint32_t>& indices,
+                                std::vector<uint8_t>& out) {
+        TriangleFifo fifo{};
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            std::array<uint32_t, 3> corners = {indices[i], indices[i + 1],
+                                               indices[i + 2]};
+
+            // A neighbour sharing the edge a -> b drew it as b -> a
+            std::optional<uint32_t> edge_age;
+            uint32_t rotation = 0;
+            for (uint32_t r = 0; r < 3 && !edge_age.has_value(); r++) {
+                edge_age = fifo.findEdge(corners[(r + 1) % 3], corners[r]);
+                rotation = r;
+            }
+
+            if (edge_age.has_value()) {
+                auto a = corners[rotation];
+                auto b = corners[(rotation + 1) % 3];
+                auto c = corners[(rotation + 2) % 3];
+                auto code_at = out.size();
+                out.push_back(0);
+                auto c_code = encodeVertex(c, fifo, out);
+                out[code_at] =
+                    static_cast<uint8_t>(edge_age.value() << 4 | c_code);
+                fifo.pushTriangle(a, b, c);
+                continue;
+            }
+
+            auto code_at = out.size();
+            out.resize(out.size() + 2);
+            std::array<uint8_t, 3> codes{};
+            for (uint32_t corner = 0; corner < 3; corner++) {
+                codes[corner] = encodeVertex(corners[corner], fifo, out);
+            }
+            out[code_at] = static_cast<uint8_t>(NO_EDGE << 4 | codes[0]);
+            out[code_at + 1] = static_cast<uint8_t>(codes[1] << 4 | codes[2]);
+            fifo.pushTriangle(corners[0], corners[1], corners[2]);
+        }
+    }
+
+    static void decodeTriangles(Reader& reader, const Header& header,
+                                uint32_t* indices) {
+        TriangleFifo fifo{};
+        for (uint32_t i = 0; i < header.index_count; i += 3) {
+            auto code = *reader.take(1);
+            uint8_t edge_code = code >> 4;
+            uint32_t a = 0, b = 0, c = 0;
+
+            if (edge_code != NO_EDGE) {
+                if (edge_code >= fifo.edgeCount()) {
+                    throw std::runtime_error("mesh asset edge code is invalid");
+                }
+                auto edge = fifo.edge(edge_code);
+                a = edge[1];
+                b = edge[0];
+                c = decodeVertex(code & 15, fifo, reader, header);
+            } else {
+                auto more = *reader.take(1);
+                a = decodeVertex(code & 15, fifo, reader, header);
+                b = decodeVertex(more >> 4, fifo, reader, header);
+                c = decodeVertex(more & 15, fifo, reader, header);
+            }
+
+            indices[i] = a;
+            indices[i + 1] = b;
+            indices[i + 2] = c;
+            fifo.pushTriangle(a, b, c);
+        }
+    }
+};
+
+/// @brief Encoded mesh stored at `path`, nothing when there is no such file
+std::vector<uint8_t> loadMeshAsset(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return {};
+    }
+    return std::vector<uint8_t>((std::istreambuf_iterator<char>(file)),
+                                std::istreambuf_iterator<char>());
+}
+
+/// @brief Writes an encoded mesh to `path`, through a temporary file so that
+/// a crash mid-write leaves no partial asset
+void storeMeshAsset(const std::string& path, const std::vector<uint8_t>& data) {
+    auto temp_path = path + ".tmp";
+
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(data.data()), data.size());
+        if (!file) {
+            throw std::runtime_error("failed to write mesh asset " + path);
+        }
+    }
+
+    if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("failed to write mesh asset " + path);
+    }
+}
@@ -0,0 +1,381 @@
+#pragma once
+#include <algorithm>
+#include <map>
+#include <numeric>
+#include <optional>
+#include <tuple>
+#include <vector>
+
+/// @brief Triangle list of shared vertices, three indices per triangle
+struct IndexedMesh {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+
+    /// @brief Indexes a plain triangle list, merging equal vertices. The
+    /// triangle order is kept.
+    static IndexedMesh fromTriangles(const std::vector<Vertex>& triangles) {
+        using Key = std::tuple<float, float, float, float, float>;
+        std::map<Key, uint32_t> ids;
+
+        IndexedMesh mesh{};
+        for (auto& vertex : triangles) {
+            Key key(vertex.pos.x, vertex.pos.y, vertex.color.r,
+                    vertex.color.g, vertex.color.b);
+            auto id = static_cast<uint32_t>(mesh.vertices.size());
+            auto inserted = ids.emplace(key, id);
+            if (inserted.second) {
+                mesh.vertices.push_back(vertex);
+            }
+            mesh.indices.push_back(inserted.first->second);
+        }
+        return mesh;
+    }
+
+    uint32_t triangleCount() const {
+        return static_cast<uint32_t>(indices.size() / 3);
+    }
+};
+
+/// @brief Post-transform vertex cache efficiency of an index order, measured
+/// with a FIFO cache: ACMR is the average number of vertices transformed per
+/// triangle, at best about 0.5, ATVR per vertex of the mesh, at best 1
+struct VertexCacheStats {
+    float acmr = 0.0f;
+    float atvr = 0.0f;
+
+    static VertexCacheStats measure(const IndexedMesh& mesh,
+                                    uint32_t cache_size) {
+        std::vector<uint32_t> fifo{};
+        uint32_t misses = 0;
+        for (auto index : mesh.indices) {
+            if (std::find(fifo.begin(), fifo.end(), index) != fifo.end()) {
+                continue;
+            }
+            misses++;
+            fifo.push_back(index);
+            if (fifo.size() > cache_size) {
+                fifo.erase(fifo.begin());
+            }
+        }
+
+        VertexCacheStats stats{};
+        if (mesh.triangleCount() > 0) {
+            stats.acmr = static_cast<float>(misses) / mesh.triangleCount();
+            stats.atvr = static_cast<float>(misses) / mesh.vertices.size();
+        }
+        return stats;
+    }
+};
+
+/// @brief Reorders an indexed mesh for the GPU, once at load time.
+///
+/// `optimize` runs three passes. Triangles are ordered for the
+/// post-transform vertex cache with Tipsify (Sander et al., "Fast
+/// Triangle Reordering for Vertex Locality and Reduced Overdraw"), which
+/// fans around vertices still in the cache. The same paper's
+/// view-independent overdraw pass then splits that order into clusters
+/// with a cache efficiency close to the whole, and draws first the
+/// clusters most likely to occlude others: those facing away from the
+/// mesh center. Last, vertices are renumbered in the order triangles first
+/// use them, so that vertex fetch walks the buffer forward.
+///
+/// Triangles are drawn in a different order, so a mesh relying on the
+/// paint order of overlapping triangles may change. Clusters of a flat mesh
+/// all face the viewer and tie, keeping their order.
+class MeshOptimizer {
+   public:
+    // Cache size Tipsify targets, that of common GPUs or smaller
+    static constexpr uint32_t CACHE_SIZE = 16;
+    // A cluster ends once its ACMR is within this factor of the ACMR of the
+    // run of triangles it was split from
+    static constexpr float OVERDRAW_THRESHOLD = 1.05f;
+
+    static IndexedMesh optimize(const IndexedMesh& mesh) {
+        std::vector<uint32_t> clusters{};
+        auto indices = tipsify(mesh, clusters);
+        clusters = splitClusters(mesh, indices, clusters);
+
+        IndexedMesh optimized{mesh.vertices, {}};
+        optimized.indices = sortClusters(mesh, indices, clusters);
+        return optimizeVertexFetch(optimized);
+    }
+
+    /// @brief Renumbers vertices in order of first use, dropping those no
+    /// triangle uses
+    static IndexedMesh optimizeVertexFetch(const IndexedMesh& mesh) {
+        constexpr uint32_t UNUSED = UINT32_MAX;
+        std::vector<uint32_t> remap(mesh.vertices.size(), UNUSED);
+
+        IndexedMesh fetched{};
+        for (auto index : mesh.indices) {
+            if (remap[index] == UNUSED) {
+                remap[index] = static_cast<uint32_t>(fetched.vertices.size());
+                fetched.vertices.push_back(mesh.vertices[index]);
+            }
+            fetched.indices.push_back(remap[index]);
+        }
+        return fetched;
+    }
+
+   private:
+    /// @brief Triangles of each vertex, the list of vertex v spanning
+    /// [offsets[v], offsets[v + 1]) of `triangles`
+    struct Adjacency {
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> triangles;
+
+        explicit Adjacency(const IndexedMesh& mesh)
+            : offsets(mesh.vertices.size() + 1, 0),
+              triangles(mesh.indices.size()) {
+            for (auto index : mesh.indices) {
+                offsets[index + 1]++;
+            }
+            std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+            auto cursor = offsets;
+            for (uint32_t i = 0; i < mesh.indices.size(); i++) {
+                triangles[cursor[mesh.indices[i]]++] = i / 3;
+            }
+        }
+
+        uint32_t count(uint32_t vertex) const {
+            return offsets[vertex + 1] - offsets[vertex];
+        }
+    };
+
+    /// @brief Orders triangles for a cache of CACHE_SIZE vertices. Appends
+    /// to `clusters` the first triangle of each run after which the cache
+    /// was left cold, where Tipsify found no cached vertex to fan around.
+    static std::vector<uint32_t> tipsify(const IndexedMesh& mesh,
+                                         std::vector<uint32_t>& clusters) {
+        auto vertex_count = static_cast<uint32_t>(mesh.vertices.size());
+        Adjacency adjacency(mesh);
+
+        std::vector<uint32_t> live(vertex_count);
+        for (uint32_t v = 0; v < vertex_count; v++) {
+            live[v] = adjacency.count(v);
+        }
+        std::vector<uint32_t> cache_time(vertex_count, 0);
+        std::vector<bool> emitted(mesh.triangleCount(), false);
+        std::vector<uint32_t> dead_ends{};
+        std::vector<uint32_t> candidates{};
+        std::vector<uint32_t> indices{};
+        indices.reserve(mesh.indices.size());
+
+        uint32_t time = CACHE_SIZE + 1;
+        uint32_t cursor = 0;
+        std::optional<uint32_t> fan =
+            vertex_count > 0 ? std::optional<uint32_t>(0) : std::nullopt;
+        bool cold = true;
+
+        while (fan.has_value()) {
+            if (cold) {
+                clusters.push_back(static_cast<uint32_t>(indices.size() / 3));
+            }
+
+            candidates.clear();
+            auto first = adjacency.offsets[fan.value()];
+            auto last = adjacency.offsets[fan.value() + 1];
+            for (auto i = first; i < last; i++) {
+                auto triangle = adjacency.triangles[i];
+                if (emitted[triangle]) {
+                    continue;
+                }
+                for (uint32_t corner = 0; corner < 3; corner++) {
+                    auto v = mesh.indices[triangle * 3 + corner];
+                    indices.push_back(v);
+                    dead_ends.push_back(v);
+                    candidates.push_back(v);
+                    live[v]--;
+                    if (time - cache_time[v] > CACHE_SIZE) {
+                        cache_time[v] = time++;
+                    }
+                }
+                emitted[triangle] = true;
+            }
+
+            fan = nextFan(candidates, live, cache_time, time);
+            cold = !fan.has_value();
+            if (cold) {
+                fan = skipDeadEnd(dead_ends, live, cursor);
+            }
+        }
+
+        // A first fan without triangles records an empty run
+        clusters.erase(std::unique(clusters.begin(), clusters.end()),
+                       clusters.end());
+        return indices;
+    }
+
+    /// @brief Candidate to fan around next: the one that stays in the cache
+    /// the longest once its remaining triangles are emitted
+    static std::optional<uint32_t> nextFan(
+        const std::vector<uint32_t>& candidates,
+        const std::vector<uint32_t>& live,
+        const std::vector<uint32_t>& cache_time, uint32_t time) {
+        std::optional<uint32_t> best;
+        uint32_t best_priority = 0;
+        for (auto v : candidates) {
+            if (live[v] == 0) {
+                continue;
+            }
+            uint32_t priority = 1;
+            uint32_t age = time - cache_time[v];
+            if (age + 2 * live[v] <= CACHE_SIZE) {
+                priority = age;
+            }
+            if (priority > best_priority) {
+                best_priority = priority;
+                best = v;
+            }
+        }
+        return best;
+    }
+
+    /// @brief Most recently used vertex with triangles left, else the next
+    /// one in input order
+    static std::optional<uint32_t> skipDeadEnd(
+        std::vector<uint32_t>& dead_ends, const std::vector<uint32_t>& live,
+        uint32_t& cursor) {
+        while (!dead_ends.empty()) {
+            auto v = dead_ends.back();
+            dead_ends.pop_back();
+            if (live[v] > 0) {
+                return v;
+            }
+        }
+        for (; cursor < live.size(); cursor++) {
+            if (live[cursor] > 0) {
+                return cursor;
+            }
+        }
+        return std::nullopt;
+    }
+
+    /// @brief Cache misses of triangles [first, last) with the cache state
+    /// in `cache_time`, flushed when `time` is advanced past CACHE_SIZE
+    static uint32_t simulate(const std::vector<uint32_t>& indices,
+                             uint32_t first, uint32_t last,
+                             std::vector<uint32_t>& cache_time,
+                             uint32_t& time) {
+        uint32_t misses = 0;
+        for (auto i = first * 3; i < last * 3; i++) {
+            auto v = indices[i];
+            if (time - cache_time[v] > CACHE_SIZE) {
+                cache_time[v] = time++;
+                misses++;
+            }
+        }
+        return misses;
+    }
+
+    /// @brief Splits each cold run of triangles further, wherever the
+    /// triangles so far reach the ACMR of the whole run. A last piece that
+    /// does not reach it joins the one before.
+    static std::vector<uint32_t> splitClusters(
+        const IndexedMesh& mesh, const std::vector<uint32_t>& indices,
+        const std::vector<uint32_t>& runs) {
+        std::vector<uint32_t> cache_time(mesh.vertices.size(), 0);
+        uint32_t time = CACHE_SIZE + 1;
+        auto triangle_count = static_cast<uint32_t>(indices.size() / 3);
+
+        std::vector<uint32_t> clusters{};
+        for (size_t r = 0; r < runs.size(); r++) {
+            auto first = runs[r];
+            auto last = r + 1 < runs.size() ? runs[r + 1] : triangle_count;
+
+            time += CACHE_SIZE + 1;
+            float run_acmr =
+                static_cast<float>(
+                    simulate(indices, first, last, cache_time, time)) /
+                (last - first);
+
+            clusters.push_back(first);
+            time += CACHE_SIZE + 1;
+            uint32_t misses = 0;
+            uint32_t start = first;
+            float acmr = 0.0f;
+            for (auto t = first; t < last; t++) {
+                misses += simulate(indices, t, t + 1, cache_time, time);
+                acmr = static_cast<float>(misses) / (t + 1 - start);
+                if (acmr <= OVERDRAW_THRESHOLD * run_acmr && t + 1 < last) {
+                    clusters.push_back(t + 1);
+                    start = t + 1;
+                    misses = 0;
+                    time += CACHE_SIZE + 1;
+                }
+            }
+            if (start != first && acmr > OVERDRAW_THRESHOLD * run_acmr) {
+                clusters.pop_back();
+            }
+        }
+        return clusters;
+    }
+
+    /// @brief Orders clusters by how much they are likely to occlude, the
+    /// distance of their center from the mesh center along their normal,
+    /// both weighted by triangle area
+    static std::vector<uint32_t> sortClusters(
+        const IndexedMesh& mesh, const std::vector<uint32_t>& indices,
+        const std::vector<uint32_t>& clusters) {
+        auto triangle_count = static_cast<uint32_t>(indices.size() / 3);
+        auto position = [&](uint32_t i) {
+            return glm::vec3(mesh.vertices[indices[i]].pos, 0.0f);
+        };
+
+        struct Cluster {
+            uint32_t first;
+            uint32_t last;
+            glm::vec3 center{0.0f};
+            glm::vec3 normal{0.0f};
+            float area = 0.0f;
+        };
+        std::vector<Cluster> sorted{};
+
+        glm::vec3 mesh_center(0.0f);
+        float mesh_area = 0.0f;
+        for (size_t c = 0; c < clusters.size(); c++) {
+            Cluster cluster{clusters[c], c + 1 < clusters.size()
+                                             ? clusters[c + 1]
+                                             : triangle_count};
+            for (auto t = cluster.first; t < cluster.last; t++) {
+                auto a = position(t * 3);
+                auto b = position(t * 3 + 1);
+                auto d = position(t * 3 + 2);
+                auto normal = glm::cross(b - a, d - a);
+                float area = glm::length(normal);
+                cluster.center += (a + b + d) * (area / 3.0f);
+                cluster.normal += normal;
+                cluster.area += area;
+            }
+            mesh_center += cluster.center;
+            mesh_area += cluster.area;
+            if (cluster.area > 0.0f) {
+                cluster.center /= cluster.area;
+            }
+            sorted.push_back(cluster);
+        }
+        if (mesh_area > 0.0f) {
+            mesh_center /= mesh_area;
+        }
+
+        auto potential = [&](const Cluster& cluster) {
+            auto normal = glm::length(cluster.normal) > 0.0f
+                              ? glm::normalize(cluster.normal)
+                              : glm::vec3(0.0f);
+            return glm::dot(cluster.center - mesh_center, normal);
+        };
+        std::stable_sort(sorted.begin(), sorted.end(),
+                         [&](const Cluster& a, const Cluster& b) {
+                             return potential(a) > potential(b);
+                         });
+
+        std::vector<uint32_t> ordered{};
+        ordered.reserve(indices.size());
+        for (auto& cluster : sorted) {
+            ordered.insert(ordered.end(), indices.begin() + cluster.first * 3,
+                           indices.begin() + cluster.last * 3);
+        }
+        return ordered;
+    }
+};
@@ -0,0 +1,182 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <vector>
+
+/// @brief Push constants of multiview.wgsl: per view, a world offset added
+/// before the camera transform and a clip space scale applied after it
+struct ViewTransforms {
+    static constexpr uint32_t MAX_VIEWS = 4;
+
+    std::array<glm::vec4, MAX_VIEWS> views{};
+};
+
+/// @brief Layered target of the multiview scene pass.
+///
+/// The scene pass renders every view into its own layer of one array image
+/// with a single draw, the vertex shader picking the view transform by
+/// view index. `present` blits the layers side by side onto the swapchain
+/// image. The image is shared by all frames in flight, the pass waits for
+/// the previous blit through its external dependency.
+class MultiviewTarget {
+   public:
+    MultiviewTarget(vk::raii::PhysicalDevice& phys_dev,
+                    vk::raii::Device& device, vk::Format format,
+                    uint32_t view_count)
+        : phys_dev(phys_dev),
+          device(device),
+          format(format),
+          view_count(view_count) {}
+
+    MultiviewTarget(const MultiviewTarget&) = delete;
+    MultiviewTarget& operator=(const MultiviewTarget&) = delete;
+
+    /// @brief Whether `view_count` views can be rendered into layers of the
+    /// swapchain format and blitted onto the swapchain
+    static bool supported(vk::raii::PhysicalDevice& phys_dev,
+                          const SurfaceInfo& surface_info,
+                          uint32_t view_count) {
+        auto props = phys_dev.getProperties2<
+            vk::PhysicalDeviceProperties2,
+            vk::PhysicalDeviceMultiviewProperties>();
+        auto& multiview = props.get<vk::PhysicalDeviceMultiviewProperties>();
+
+        auto needed = vk::FormatFeatureFlagBits::eColorAttachment |
+                      vk::FormatFeatureFlagBits::eBlitSrc |
+                      vk::FormatFeatureFlagBits::eBlitDst;
+        auto features = phys_dev.getFormatProperties(surface_info.color_format)
+                            .optimalTilingFeatures;
+
+        return view_count <= multiview.maxMultiviewViewCount &&
+               view_count <= ViewTransforms::MAX_VIEWS &&
+               (features & needed) == needed &&
+               (surface_info.supported_usage &
+                vk::ImageUsageFlagBits::eTransferDst);
+    }
+
+    uint32_t viewCount() const { return view_count; }
+
+    /// @brief Bit per view, rendered and correlated by the scene pass
+    uint32_t viewMask() const { return (1u << view_count) - 1; }
+
+    /// @brief Size of one view, a column of the swapchain image
+    vk::Extent2D viewExtent() const { return layered->extent; }
+
+    vk::Framebuffer framebuffer() const { return *layered_framebuffer; }
+
+    /// @brief Transforms spreading the views `spacing` world units apart
+    /// along x around the camera. Each view shows a column of the window,
+    /// its x is scaled up to keep the aspect of the full window.
+    ViewTransforms transforms(float spacing) const {
+        ViewTransforms transforms{};
+        float center = static_cast<float>(view_count - 1) / 2.0f;
+        for (uint32_t i = 0; i < view_count; i++) {
+            float offset = (static_cast<float>(i) - center) * spacing;
+            transforms.views[i] =
+                glm::vec4(offset, 0.0f, static_cast<float>(view_count), 1.0f);
+        }
+        return transforms;
+    }
+
+    /// @brief Recreates the layered image for a new swapchain size, the
+    /// framebuffer is created against the multiview `render_pass`
+    void resize(vk::Extent2D extent, vk::RenderPass render_pass) {
+        layered_framebuffer = nullptr;
+        layered_view.reset();
+        layered.reset();
+
+        vk::Extent2D view_extent(std::max(extent.width / view_count, 1u),
+                                 extent.height);
+        auto image_info = AllocatedImage::info2D(
+            format, view_extent,
+            vk::ImageUsageFlagBits::eColorAttachment |
+                vk::ImageUsageFlagBits::eTransferSrc);
+        image_info.setArrayLayers(view_count);
+
+        layered.emplace(phys_dev, device, image_info);
+        layered_view =
+            layered->createView(device, vk::ImageAspectFlagBits::eColor, 0,
+                                VK_REMAINING_MIP_LEVELS,
+                                vk::ImageViewType::e2DArray);
+
+        // A multiview framebuffer has one layer, the view mask picks the
+        // layers rendered
+        vk::ImageView attachment = *layered_view.value();
+        vk::FramebufferCreateInfo fb_info({}, render_pass, attachment,
+                                          view_extent.width,
+                                          view_extent.height, 1);
+        layered_framebuffer =
+            device.createFramebuffer(fb_info, hostCallbacks());
+    }
+
+    /// @brief Records the blits of the layers, left in eTransferSrcOptimal
+    /// by the scene pass, onto columns of `target`, which is left in
+    /// ePresentSrcKHR
+    void present(const vk::raii::CommandBuffer& cmd_buf, vk::Image target,
+                 vk::Extent2D target_extent) {
+        vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor, 0, 1,
+                                        0, 1);
+
+        // The swapchain image is only written once the acquire semaphore,
+        // waited for at color attachment output, has signalled
+        vk::ImageMemoryBarrier to_transfer(
+            {}, vk::AccessFlagBits::eTransferWrite, vk::ImageLayout::eUndefined,
+            vk::ImageLayout::eTransferDstOptimal, VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED, target, range);
+        cmd_buf.pipelineBarrier(
+            vk::PipelineStageFlagBits::eColorAttachmentOutput,
+            vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr,
+            to_transfer);
+
+        // Columns split the width evenly, so that rounding leaves no pixel
+        // of the target unwritten
+        std::vector<vk::ImageBlit> regions{};
+        auto src_extent = layered->extent;
+        for (uint32_t i = 0; i < view_count; i++) {
+            auto column_begin = static_cast<int32_t>(
+                static_cast<uint64_t>(target_extent.width) * i / view_count);
+            auto column_end = static_cast<int32_t>(
+                static_cast<uint64_t>(target_extent.width) * (i + 1) /
+                view_count);
+
+            vk::ImageSubresourceLayers src_layers(
+                vk::ImageAspectFlagBits::eColor, 0, i, 1);
+            vk::ImageSubresourceLayers dst_layers(
+                vk::ImageAspectFlagBits::eColor, 0, 0, 1);
+            std::array<vk::Offset3D, 2> src_bounds = {
+                vk::Offset3D(0, 0, 0),
+                vk::Offset3D(static_cast<int32_t>(src_extent.width),
+                             static_cast<int32_t>(src_extent.height), 1)};
+            std::array<vk::Offset3D, 2> dst_bounds = {
+                vk::Offset3D(column_begin, 0, 0),
+                vk::Offset3D(column_end,
+                             static_cast<int32_t>(target_extent.height), 1)};
+            regions.emplace_back(src_layers, src_bounds, dst_layers,
+                                 dst_bounds);
+        }
+        cmd_buf.blitImage(*layered->image,
+                          vk::ImageLayout::eTransferSrcOptimal, target,
+                          vk::ImageLayout::eTransferDstOptimal, regions,
+                          vk::Filter::eNearest);
+
+        vk::ImageMemoryBarrier to_present(
+            vk::AccessFlagBits::eTransferWrite, {},
+            vk::ImageLayout::eTransferDstOptimal,
+            vk::ImageLayout::ePresentSrcKHR, VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED, target, range);
+        cmd_buf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                vk::PipelineStageFlagBits::eBottomOfPipe, {},
+                                nullptr, nullptr, to_present);
+    }
+
+   private:
+    vk::raii::PhysicalDevice& phys_dev;
+    vk::raii::Device& device;
+    vk::Format format;
+    uint32_t view_count;
+
+    std::optional<AllocatedImage> layered;
+    std::optional<vk::raii::ImageView> layered_view;
+    vk::raii::Framebuffer layered_framebuffer{nullptr};
+};
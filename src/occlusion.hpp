@@ -0,0 +1,421 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+/// @brief Push constants of cull.wgsl
+struct CullParams {
+    glm::vec2 mesh_min;
+    glm::vec2 mesh_max;
+    glm::vec2 camera_center;
+    float camera_zoom;
+    uint32_t candidate_count;
+    uint32_t phase;
+    uint32_t pyramid_levels;
+    glm::uvec2 pyramid_size;
+    uint32_t test_occlusion;
+    uint32_t vertex_count;
+};
+
+// Must match CullParams of cull.wgsl, where vec2u is 8-byte aligned
+static_assert(offsetof(CullParams, pyramid_size) == 40);
+static_assert(sizeof(CullParams) == 56);
+
+/// @brief Push constants of hiz.wgsl
+struct ReduceParams {
+    glm::uvec2 src_size;
+    glm::uvec2 dst_size;
+};
+
+/// @brief Two-phase hierarchical-Z occlusion culling of scene objects.
+///
+/// Phase 0 culls every candidate against the depth pyramid of the previous
+/// frame and draws the survivors. The pyramid is then rebuilt from that depth
+/// and phase 1 re-tests the objects phase 0 rejected, drawing the ones that
+/// became visible. Both phases emit compacted indirect draws, one instance of
+/// the vertex mesh per visible object.
+///
+/// Object placement and the candidates to test are uploaded per frame in
+/// flight, candidates normally come from a CPU frustum query.
+class OcclusionCuller {
+   public:
+    static constexpr uint32_t PHASE_COUNT = 2;
+    static constexpr vk::Format PYRAMID_FORMAT = vk::Format::eR32Sfloat;
+
+    OcclusionCuller(vk::raii::PhysicalDevice& phys_dev,
+                    vk::raii::Device& device,
+                    vk::Optional<const vk::raii::PipelineCache> cache,
+                    DescriptorSetCache& descriptor_cache,
+                    uint32_t object_count, uint32_t frame_count,
+                    const MeshBounds& mesh_bounds, uint32_t vertex_count)
+        : phys_dev(phys_dev),
+          device(device),
+          descriptors(descriptor_cache),
+          object_count(object_count),
+          mesh_bounds(mesh_bounds),
+          vertex_count(vertex_count),
+          visibility(phys_dev, device, sizeof(uint32_t) * object_count,
+                     vk::BufferUsageFlagBits::eStorageBuffer,
+                     vk::MemoryPropertyFlagBits::eDeviceLocal) {
+        for (uint32_t i = 0; i < frame_count; i++) {
+            objects.emplace_back(phys_dev, device,
+                                 sizeof(SceneObject) * object_count,
+                                 vk::BufferUsageFlagBits::eStorageBuffer,
+                                 vk::MemoryPropertyFlagBits::eHostVisible |
+                                     vk::MemoryPropertyFlagBits::eHostCoherent);
+            candidates.emplace_back(
+                phys_dev, device, sizeof(uint32_t) * object_count,
+                vk::BufferUsageFlagBits::eStorageBuffer,
+                vk::MemoryPropertyFlagBits::eHostVisible |
+                    vk::MemoryPropertyFlagBits::eHostCoherent);
+        }
+        candidate_counts.resize(frame_count, 0);
+
+        for (uint32_t i = 0; i < PHASE_COUNT; i++) {
+            draw_buffers.emplace_back(
+                phys_dev, device,
+                sizeof(vk::DrawIndirectCommand) * object_count,
+                vk::BufferUsageFlagBits::eStorageBuffer |
+                    vk::BufferUsageFlagBits::eIndirectBuffer,
+                vk::MemoryPropertyFlagBits::eDeviceLocal);
+            count_buffers.emplace_back(
+                phys_dev, device, sizeof(uint32_t),
+                vk::BufferUsageFlagBits::eStorageBuffer |
+                    vk::BufferUsageFlagBits::eIndirectBuffer |
+                    vk::BufferUsageFlagBits::eTransferDst,
+                vk::MemoryPropertyFlagBits::eDeviceLocal);
+        }
+
+        createLayouts();
+
+        cull_pipeline = createComputePipeline(
+            device, cache, "shaders/cull.spv", "cull_main", *cull_layout);
+        reduce_pipeline = createComputePipeline(
+            device, cache, "shaders/hiz.spv", "reduce_main", *reduce_layout);
+    }
+
+    OcclusionCuller(const OcclusionCuller&) = delete;
+    OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+    /// @brief Layout of the set scene.wgsl reads objects from (set 1)
+    vk::DescriptorSetLayout objectSetLayout() const { return *object_set_layout; }
+
+    vk::DescriptorSet objectSet(uint32_t frame_idx) {
+        auto& frame_objects = objects[frame_idx];
+        return descriptors.get(
+            *object_set_layout,
+            {DescriptorBinding::ofBuffer(0, vk::DescriptorType::eStorageBuffer,
+                                         *frame_objects.buffer, 0,
+                                         frame_objects.size)});
+    }
+
+    /// @brief Uploads object placement and the objects worth testing for a
+    /// frame slot whose previous submission has completed
+    void updateFrame(uint32_t frame_idx,
+                     const std::vector<SceneObject>& frame_objects,
+                     const std::vector<uint32_t>& frame_candidates) {
+        std::memcpy(objects[frame_idx].mapped, frame_objects.data(),
+                    sizeof(SceneObject) * object_count);
+        std::memcpy(candidates[frame_idx].mapped, frame_candidates.data(),
+                    sizeof(uint32_t) * frame_candidates.size());
+        candidate_counts[frame_idx] =
+            static_cast<uint32_t>(frame_candidates.size());
+    }
+
+    /// @brief Recreates the pyramid for a new depth buffer, occlusion is not
+    /// tested until the pyramid was built once
+    void resize(vk::Extent2D extent, vk::ImageView depth) {
+        depth_view = depth;
+        depth_extent = extent;
+
+        // Rounded down to a power of two so that every level halves exactly
+        vk::Extent2D size(floorPow2(extent.width), floorPow2(extent.height));
+        pyramid_levels = static_cast<uint32_t>(std::log2(
+                             std::max(size.width, size.height))) +
+                         1;
+
+        level_views.clear();
+        pyramid_view.reset();
+        pyramid.reset();
+
+        pyramid.emplace(phys_dev, device,
+                        AllocatedImage::info2D(
+                            PYRAMID_FORMAT, size,
+                            vk::ImageUsageFlagBits::eStorage |
+                                vk::ImageUsageFlagBits::eSampled,
+                            pyramid_levels));
+        pyramid_view =
+            pyramid->createView(device, vk::ImageAspectFlagBits::eColor);
+        for (uint32_t level = 0; level < pyramid_levels; level++) {
+            level_views.push_back(pyramid->createView(
+                device, vk::ImageAspectFlagBits::eColor, level, 1));
+        }
+
+        pyramid_initialized = false;
+        pyramid_built = false;
+    }
+
+    /// @brief Records culling of one phase, the draws it emits are ready for
+    /// `draw` afterwards
+    void cull(const vk::raii::CommandBuffer& cmd_buf, uint32_t phase,
+              uint32_t frame_idx, const Camera2D& camera) {
+        if (phase == 0) {
+            resetCounts(cmd_buf);
+        }
+
+        uint32_t candidate_count = candidate_counts[frame_idx];
+        CullParams params{mesh_bounds.min,
+                          mesh_bounds.max,
+                          camera.center,
+                          camera.zoom,
+                          candidate_count,
+                          phase,
+                          pyramid_levels,
+                          {pyramid->extent.width, pyramid->extent.height},
+                          pyramid_built,
+                          vertex_count};
+
+        auto& frame_objects = objects[frame_idx];
+        auto& frame_candidates = candidates[frame_idx];
+        auto set = descriptors.get(
+            *cull_set_layout,
+            {DescriptorBinding::ofBuffer(0, vk::DescriptorType::eStorageBuffer,
+                                         *frame_objects.buffer, 0,
+                                         frame_objects.size),
+             DescriptorBinding::ofBuffer(1, vk::DescriptorType::eStorageBuffer,
+                                         *frame_candidates.buffer, 0,
+                                         frame_candidates.size),
+             DescriptorBinding::ofBuffer(2, vk::DescriptorType::eStorageBuffer,
+                                         *visibility.buffer, 0,
+                                         visibility.size),
+             DescriptorBinding::ofBuffer(3, vk::DescriptorType::eStorageBuffer,
+                                         *draw_buffers[phase].buffer, 0,
+                                         draw_buffers[phase].size),
+             DescriptorBinding::ofBuffer(4, vk::DescriptorType::eStorageBuffer,
+                                         *count_buffers[phase].buffer, 0,
+                                         count_buffers[phase].size),
+             DescriptorBinding::ofImage(5, vk::DescriptorType::eSampledImage,
+                                        *pyramid_view.value(),
+                                        vk::ImageLayout::eGeneral)});
+
+        cmd_buf.bindPipeline(vk::PipelineBindPoint::eCompute, *cull_pipeline);
+        cmd_buf.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                   *cull_layout, 0, set, nullptr);
+        cmd_buf.pushConstants<CullParams>(
+            *cull_layout, vk::ShaderStageFlagBits::eCompute, 0, params);
+        if (candidate_count > 0) {
+            cmd_buf.dispatch(groupCount(candidate_count, CULL_GROUP_SIZE), 1,
+                             1);
+        }
+
+        // Draws are read as indirect commands, visibility by phase 1
+        vk::MemoryBarrier barrier(vk::AccessFlagBits::eShaderWrite,
+                                  vk::AccessFlagBits::eIndirectCommandRead |
+                                      vk::AccessFlagBits::eShaderRead);
+        cmd_buf.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                vk::PipelineStageFlagBits::eDrawIndirect |
+                                    vk::PipelineStageFlagBits::eComputeShader,
+                                {}, barrier, nullptr, nullptr);
+    }
+
+    /// @brief Records the pyramid rebuild from `depth_image`, which must be
+    /// in eDepthStencilAttachmentOptimal and is left in
+    /// eShaderReadOnlyOptimal
+    void buildPyramid(const vk::raii::CommandBuffer& cmd_buf,
+                      vk::Image depth_image) {
+        std::vector<vk::ImageMemoryBarrier> image_barriers{};
+
+        image_barriers.emplace_back(
+            vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+            vk::AccessFlagBits::eShaderRead,
+            vk::ImageLayout::eDepthStencilAttachmentOptimal,
+            vk::ImageLayout::eShaderReadOnlyOptimal, VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED, depth_image,
+            vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eDepth, 0, 1, 0,
+                                      1));
+
+        // Phase 0 culling still reads the old pyramid
+        cmd_buf.pipelineBarrier(
+            vk::PipelineStageFlagBits::eLateFragmentTests |
+                vk::PipelineStageFlagBits::eComputeShader,
+            vk::PipelineStageFlagBits::eComputeShader, {}, nullptr, nullptr,
+            image_barriers);
+
+        cmd_buf.bindPipeline(vk::PipelineBindPoint::eCompute,
+                             *reduce_pipeline);
+
+        glm::uvec2 src_size(depth_extent.width, depth_extent.height);
+        for (uint32_t level = 0; level < pyramid_levels; level++) {
+            glm::uvec2 dst_size(std::max(pyramid->extent.width >> level, 1u),
+                                std::max(pyramid->extent.height >> level, 1u));
+
+            auto src = level == 0
+                           ? DescriptorBinding::ofImage(
+                                 0, vk::DescriptorType::eSampledImage,
+                                 depth_view,
+                                 vk::ImageLayout::eShaderReadOnlyOptimal)
+                           : DescriptorBinding::ofImage(
+                                 0, vk::DescriptorType::eSampledImage,
+                                 *level_views[level - 1],
+                                 vk::ImageLayout::eGeneral);
+            auto set = descriptors.get(
+                *reduce_set_layout,
+                {src, DescriptorBinding::ofImage(
+                          1, vk::DescriptorType::eStorageImage,
+                          *level_views[level], vk::ImageLayout::eGeneral)});
+
+            ReduceParams params{src_size, dst_size};
+            cmd_buf.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                       *reduce_layout, 0, set, nullptr);
+            cmd_buf.pushConstants<ReduceParams>(
+                *reduce_layout, vk::ShaderStageFlagBits::eCompute, 0, params);
+            cmd_buf.dispatch(groupCount(dst_size.x, REDUCE_GROUP_SIZE),
+                             groupCount(dst_size.y, REDUCE_GROUP_SIZE), 1);
+
+            vk::MemoryBarrier barrier(vk::AccessFlagBits::eShaderWrite,
+                                      vk::AccessFlagBits::eShaderRead);
+            cmd_buf.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                    vk::PipelineStageFlagBits::eComputeShader,
+                                    {}, barrier, nullptr, nullptr);
+
+            src_size = dst_size;
+        }
+
+        pyramid_built = true;
+    }
+
+    /// @brief Records the indirect draws emitted by phase `phase`, the scene
+    /// pipeline and its sets must be bound
+    void draw(const vk::raii::CommandBuffer& cmd_buf, uint32_t phase) const {
+        cmd_buf.drawIndirectCount(*draw_buffers[phase].buffer, 0,
+                                  *count_buffers[phase].buffer, 0,
+                                  object_count,
+                                  sizeof(vk::DrawIndirectCommand));
+    }
+
+   private:
+    static constexpr uint32_t CULL_GROUP_SIZE = 64;
+    static constexpr uint32_t REDUCE_GROUP_SIZE = 8;
+
+    vk::raii::PhysicalDevice& phys_dev;
+    vk::raii::Device& device;
+    DescriptorSetCache& descriptors;
+
+    uint32_t object_count;
+    MeshBounds mesh_bounds;
+    uint32_t vertex_count;
+
+    std::vector<AllocatedBuffer> objects;
+    std::vector<AllocatedBuffer> candidates;
+    std::vector<uint32_t> candidate_counts;
+    AllocatedBuffer visibility;
+    std::vector<AllocatedBuffer> draw_buffers;
+    std::vector<AllocatedBuffer> count_buffers;
+
+    vk::ImageView depth_view;
+    vk::Extent2D depth_extent;
+    std::optional<AllocatedImage> pyramid;
+    std::optional<vk::raii::ImageView> pyramid_view;
+    std::vector<vk::raii::ImageView> level_views;
+    uint32_t pyramid_levels = 0;
+    bool pyramid_initialized = false;
+    bool pyramid_built = false;
+
+    vk::raii::DescriptorSetLayout object_set_layout{nullptr};
+    vk::raii::DescriptorSetLayout cull_set_layout{nullptr};
+    vk::raii::DescriptorSetLayout reduce_set_layout{nullptr};
+    vk::raii::PipelineLayout cull_layout{nullptr};
+    vk::raii::PipelineLayout reduce_layout{nullptr};
+    vk::raii::Pipeline cull_pipeline{nullptr};
+    vk::raii::Pipeline reduce_pipeline{nullptr};
+
+    static uint32_t floorPow2(uint32_t value) {
+        uint32_t pow2 = 1;
+        while (pow2 * 2 <= value) {
+            pow2 *= 2;
+        }
+        return pow2;
+    }
+
+    static uint32_t groupCount(uint32_t items, uint32_t group_size) {
+        return (items + group_size - 1) / group_size;
+    }
+
+    void createLayouts() {
+        auto compute = vk::ShaderStageFlagBits::eCompute;
+
+        vk::DescriptorSetLayoutBinding object_binding(
+            0, vk::DescriptorType::eStorageBuffer, 1,
+            vk::ShaderStageFlagBits::eVertex);
+        object_set_layout = device.createDescriptorSetLayout(
+            vk::DescriptorSetLayoutCreateInfo({}, object_binding),
+            hostCallbacks());
+
+        std::vector<vk::DescriptorSetLayoutBinding> cull_bindings = {
+            {0, vk::DescriptorType::eStorageBuffer, 1, compute},
+            {1, vk::DescriptorType::eStorageBuffer, 1, compute},
+            {2, vk::DescriptorType::eStorageBuffer, 1, compute},
+            {3, vk::DescriptorType::eStorageBuffer, 1, compute},
+            {4, vk::DescriptorType::eStorageBuffer, 1, compute},
+            {5, vk::DescriptorType::eSampledImage, 1, compute},
+        };
+        cull_set_layout = device.createDescriptorSetLayout(
+            vk::DescriptorSetLayoutCreateInfo({}, cull_bindings),
+            hostCallbacks());
+
+        std::vector<vk::DescriptorSetLayoutBinding> reduce_bindings = {
+            {0, vk::DescriptorType::eSampledImage, 1, compute},
+            {1, vk::DescriptorType::eStorageImage, 1, compute},
+        };
+        reduce_set_layout = device.createDescriptorSetLayout(
+            vk::DescriptorSetLayoutCreateInfo({}, reduce_bindings),
+            hostCallbacks());
+
+        vk::PushConstantRange cull_range(compute, 0, sizeof(CullParams));
+        cull_layout = device.createPipelineLayout(
+            vk::PipelineLayoutCreateInfo({}, *cull_set_layout, cull_range),
+            hostCallbacks());
+
+        vk::PushConstantRange reduce_range(compute, 0, sizeof(ReduceParams));
+        reduce_layout = device.createPipelineLayout(
+            vk::PipelineLayoutCreateInfo({}, *reduce_set_layout, reduce_range),
+            hostCallbacks());
+    }
+
+    /// @brief Zeroes both draw counts once the previous frame stopped reading
+    /// them, moving the pyramid to eGeneral on its first use
+    void resetCounts(const vk::raii::CommandBuffer& cmd_buf) {
+        std::vector<vk::ImageMemoryBarrier> image_barriers{};
+        if (!pyramid_initialized) {
+            image_barriers.emplace_back(
+                vk::AccessFlags{}, vk::AccessFlagBits::eShaderRead,
+                vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral,
+                VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, *pyramid->image,
+                vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0,
+                                          VK_REMAINING_MIP_LEVELS, 0, 1));
+            pyramid_initialized = true;
+        }
+
+        vk::MemoryBarrier before(vk::AccessFlagBits::eShaderWrite,
+                                 vk::AccessFlagBits::eTransferWrite |
+                                     vk::AccessFlagBits::eShaderRead |
+                                     vk::AccessFlagBits::eShaderWrite);
+        cmd_buf.pipelineBarrier(vk::PipelineStageFlagBits::eDrawIndirect |
+                                    vk::PipelineStageFlagBits::eComputeShader,
+                                vk::PipelineStageFlagBits::eTransfer |
+                                    vk::PipelineStageFlagBits::eComputeShader,
+                                {}, before, nullptr, image_barriers);
+
+        for (auto& counts : count_buffers) {
+            cmd_buf.fillBuffer(*counts.buffer, 0, counts.size, 0);
+        }
+
+        vk::MemoryBarrier after(vk::AccessFlagBits::eTransferWrite,
+                                vk::AccessFlagBits::eShaderRead |
+                                    vk::AccessFlagBits::eShaderWrite);
+        cmd_buf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                vk::PipelineStageFlagBits::eComputeShader, {},
+                                after, nullptr, nullptr);
+    }
+};
@@ -0,0 +1,278 @@
+#pragma once
+#include <stdexcept>
+#include <string>
+
+/// @brief Startup switches parsed from the command line
+struct AppOptions {
+    // Build pipelines from VK_EXT_graphics_pipeline_library parts when the
+    // device supports it
+    bool pipeline_library = true;
+    // Set cull mode, front face, topology, depth and blend state at record
+    // time through extended dynamic state instead of baking it
+    bool dynamic_state = false;
+    // Draw with VK_EXT_shader_object shaders instead of pipelines, through
+    // dynamic rendering instead of render passes
+    bool shader_object = false;
+    // Keep descriptors in VK_EXT_descriptor_buffer buffers instead of sets
+    bool descriptor_buffer = false;
+    // Draw `object_count` mesh instances culled against a hierarchical depth
+    // buffer on the GPU
+    bool occlusion_culling = false;
+    uint32_t object_count = 4096;
+    // Shade NxN pixel blocks with one fragment invocation (1, 2 or 4, 1 keeps
+    // per-pixel shading)
+    uint32_t shading_rate = 1;
+    // Pick the shading rate per screen tile from the contrast of the last
+    // frame
+    bool adaptive_shading = false;
+    // Apply the lab effect in a compute pass over the drawn image instead of
+    // in the fragment shader, E switches between both at runtime
+    bool compute_effect = false;
+    // Simulate and draw this many particles on the GPU, 0 disables them
+    uint32_t particle_count = 0;
+    // Deform the scene vertices in a compute pre-pass every frame
+    bool animate_vertices = false;
+    // Index VERTICES and reorder it for the vertex cache, overdraw and
+    // vertex fetch at load, then draw it indexed
+    bool optimize_mesh = false;
+    // Load the scene mesh from this compressed asset, or write it there when
+    // the file does not exist yet, empty keeps the mesh in memory only
+    std::string mesh_file;
+    // Render this many side-by-side views of the scene with one multiview
+    // draw (1 to 4, 2 gives a stereo pair), 1 draws the plain scene
+    uint32_t views = 1;
+    // Open this many windows sharing the device, the extra ones drawing the
+    // scene without overlays, all presented together
+    uint32_t windows = 1;
+    // Draw 2D paths and text over the scene
+    bool vector_overlay = false;
+    // Show frame times, swapchain, memory and draw counts over the scene, H
+    // hides and shows it
+    bool hud = false;
+    // Serve runtime statistics as JSON or Prometheus text on this Unix
+    // socket, empty disables the server
+    std::string stats_socket;
+    // Load pipeline cache data from this file at startup and after a device
+    // loss, and write it back once pipelines exist and on exit, empty creates
+    // pipelines without a cache
+    std::string pipeline_cache;
+    // Tag frames with diagnostic checkpoints or buffer markers, reported when
+    // the device is lost
+    bool crash_markers = false;
+    // Serve driver host allocations from pooled size classes and count them
+    // per allocation scope
+    bool host_allocator = false;
+    // Record and submit the frame through a flat table of device-level entry
+    // points instead of the vk::raii dispatcher
+    bool direct_dispatch = false;
+    // Render this many frames without a window, spread over every device,
+    // then exit. 0 opens the window as usual
+    uint32_t batch_frames = 0;
+    // Logical devices rendering the batch when there is a single physical
+    // device
+    uint32_t batch_devices = 2;
+    // Batch frames are written to PREFIX_NNNNN.ppm, empty writes nothing
+    std::string batch_output = "frame";
+    // Sleep until input, a resize or an animation needs a new frame instead
+    // of drawing continuously
+    bool on_demand = false;
+    // Repaint only the screen regions that changed, over the previous
+    // contents of the swapchain image, and pass them on to the compositor.
+    // Only the HUD and the 2D overlay change part of the image, camera moves
+    // and an animated scene repaint all of it. Frames without changes are
+    // not drawn.
+    bool damage_tracking = false;
+    // Print timings of pipeline creation and other measured paths
+    bool bench = false;
+
+    static AppOptions from(int argc, char** argv) {
+        AppOptions options{};
+
+        for (int i = 1; i < argc; i++) {
+            std::string arg{argv[i]};
+
+            if (arg == "--no-pipeline-library") {
+                options.pipeline_library = false;
+            } else if (arg == "--dynamic-state") {
+                options.dynamic_state = true;
+            } else if (arg == "--shader-object") {
+                options.shader_object = true;
+            } else if (arg == "--descriptor-buffer") {
+                options.descriptor_buffer = true;
+            } else if (arg == "--occlusion-culling") {
+                options.occlusion_culling = true;
+            } else if (arg == "--objects" && i + 1 < argc) {
+                options.object_count = std::stoul(argv[++i]);
+            } else if (arg == "--shading-rate" && i + 1 < argc) {
+                options.shading_rate = std::stoul(argv[++i]);
+            } else if (arg == "--adaptive-shading") {
+                options.adaptive_shading = true;
+            } else if (arg == "--compute-effect") {
+                options.compute_effect = true;
+            } else if (arg == "--particles" && i + 1 < argc) {
+                options.particle_count = std::stoul(argv[++i]);
+            } else if (arg == "--animate-vertices") {
+                options.animate_vertices = true;
+            } else if (arg == "--optimize-mesh") {
+                options.optimize_mesh = true;
+            } else if (arg == "--mesh-file" && i + 1 < argc) {
+                options.mesh_file = argv[++i];
+            } else if (arg == "--views" && i + 1 < argc) {
+                options.views = std::stoul(argv[++i]);
+            } else if (arg == "--windows" && i + 1 < argc) {
+                options.windows = std::stoul(argv[++i]);
+            } else if (arg == "--vector-overlay") {
+                options.vector_overlay = true;
+            } else if (arg == "--hud") {
+                options.hud = true;
+            } else if (arg == "--stats-socket" && i + 1 < argc) {
+                options.stats_socket = argv[++i];
+            } else if (arg == "--pipeline-cache" && i + 1 < argc) {
+                options.pipeline_cache = argv[++i];
+            } else if (arg == "--crash-markers") {
+                options.crash_markers = true;
+            } else if (arg == "--host-allocator") {
+                options.host_allocator = true;
+            } else if (arg == "--direct-dispatch") {
+                options.direct_dispatch = true;
+            } else if (arg == "--batch" && i + 1 < argc) {
+                options.batch_frames = std::stoul(argv[++i]);
+            } else if (arg == "--batch-devices" && i + 1 < argc) {
+                options.batch_devices = std::stoul(argv[++i]);
+            } else if (arg == "--batch-output" && i + 1 < argc) {
+                options.batch_output = argv[++i];
+            } else if (arg == "--on-demand") {
+                options.on_demand = true;
+            } else if (arg == "--damage-tracking") {
+                options.damage_tracking = true;
+            } else if (arg == "--bench") {
+                options.bench = true;
+            } else {
+                throw std::runtime_error("unknown option: " + arg);
+            }
+        }
+
+        if (options.occlusion_culling &&
+            (options.shader_object || options.descriptor_buffer)) {
+            throw std::runtime_error(
+                "--occlusion-culling draws with pipelines and descriptor sets, "
+                "it cannot be combined with --shader-object or "
+                "--descriptor-buffer");
+        }
+
+        if (options.shader_object &&
+            (options.particle_count > 0 || options.vector_overlay ||
+             options.hud)) {
+            throw std::runtime_error(
+                "--particles, --vector-overlay and --hud draw with pipelines "
+                "made for the scene render pass, they cannot be combined with "
+                "--shader-object");
+        }
+
+        if (options.shading_rate != 1 && options.shading_rate != 2 &&
+            options.shading_rate != 4) {
+            throw std::runtime_error("--shading-rate must be 1, 2 or 4");
+        }
+
+        if ((options.shading_rate != 1 || options.adaptive_shading) &&
+            options.shader_object) {
+            throw std::runtime_error(
+                "variable-rate shading is set through pipelines, it cannot be "
+                "combined with --shader-object");
+        }
+
+        if (options.adaptive_shading && options.occlusion_culling) {
+            throw std::runtime_error(
+                "--adaptive-shading cannot be combined with "
+                "--occlusion-culling");
+        }
+
+        if (options.compute_effect &&
+            (options.shader_object || options.occlusion_culling ||
+             options.adaptive_shading)) {
+            throw std::runtime_error(
+                "--compute-effect cannot be combined with --shader-object, "
+                "--occlusion-culling or --adaptive-shading");
+        }
+
+        if (options.particle_count > 0 &&
+            (options.occlusion_culling || options.compute_effect)) {
+            throw std::runtime_error(
+                "--particles cannot be combined with --occlusion-culling or "
+                "--compute-effect");
+        }
+
+        if (options.animate_vertices && options.occlusion_culling) {
+            throw std::runtime_error(
+                "--animate-vertices cannot be combined with "
+                "--occlusion-culling, which culls against static mesh bounds");
+        }
+
+        if ((options.vector_overlay || options.hud) &&
+            options.compute_effect) {
+            throw std::runtime_error(
+                "--vector-overlay and --hud draw in the scene render pass, "
+                "they cannot be combined with --compute-effect");
+        }
+
+        if ((options.optimize_mesh || !options.mesh_file.empty()) &&
+            (options.occlusion_culling || options.batch_frames > 0)) {
+            throw std::runtime_error(
+                "--optimize-mesh and --mesh-file only feed the scene pass of "
+                "the window, they cannot be combined with --occlusion-culling "
+                "or --batch");
+        }
+
+        if (!options.mesh_file.empty() && options.animate_vertices) {
+            throw std::runtime_error(
+                "--mesh-file decodes the mesh straight into the vertex "
+                "buffer, it cannot be combined with --animate-vertices");
+        }
+
+        if (options.views < 1 || options.views > 4) {
+            throw std::runtime_error("--views must be between 1 and 4");
+        }
+
+        if (options.views > 1 &&
+            (options.shader_object || options.occlusion_culling ||
+             options.shading_rate != 1 || options.adaptive_shading ||
+             options.compute_effect || options.vector_overlay ||
+             options.hud)) {
+            throw std::runtime_error(
+                "--views renders into a layered image through its own render "
+                "pass, it cannot be combined with --shader-object, "
+                "--occlusion-culling, --shading-rate, --adaptive-shading, "
+                "--compute-effect, --vector-overlay or --hud");
+        }
+
+        if (options.batch_devices < 1) {
+            throw std::runtime_error("--batch-devices must be at least 1");
+        }
+
+        if (options.windows < 1 || options.windows > 8) {
+            throw std::runtime_error("--windows must be between 1 and 8");
+        }
+
+        if (options.windows > 1 &&
+            (options.occlusion_culling || options.shading_rate != 1 ||
+             options.adaptive_shading || options.compute_effect ||
+             options.views > 1)) {
+            throw std::runtime_error(
+                "extra windows are drawn with the plain scene pass, --windows "
+                "cannot be combined with --occlusion-culling, --shading-rate, "
+                "--adaptive-shading, --compute-effect or --views");
+        }
+
+        if (options.damage_tracking &&
+            (options.occlusion_culling || options.shading_rate != 1 ||
+             options.adaptive_shading || options.compute_effect ||
+             options.views > 1)) {
+            throw std::runtime_error(
+                "--damage-tracking repaints through the plain scene pass, it "
+                "cannot be combined with --occlusion-culling, --shading-rate, "
+                "--adaptive-shading, --compute-effect or --views");
+        }
+
+        return options;
+    }
+};
@@ -0,0 +1,347 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+/// @brief Push constants of particles.wgsl, shared by all of its passes
+struct ParticleParams {
+    glm::vec2 emitter_position;
+    glm::vec2 emitter_direction;
+    glm::vec3 emitter_color;
+    float emitter_spread;
+    float emitter_speed;
+    float lifetime;
+    float delta_time;
+    float restitution;
+    glm::vec2 gravity;
+    uint32_t emit_count;
+    uint32_t capacity;
+    uint32_t segment_count;
+    uint32_t seed;
+    uint32_t parity;
+    float size;
+};
+
+/// @brief Where and how particles spawn and move, the only particle state
+/// set on the CPU
+struct ParticleEmitter {
+    glm::vec2 position{0.0f, -0.9f};
+    glm::vec2 direction{0.0f, 1.0f};
+    glm::vec3 color{1.0f, 0.6f, 0.2f};
+    // Angle of the emission cone in radians
+    float spread = 0.8f;
+    float speed = 0.4f;
+    // Mean lifetime in seconds, single particles live 0.5x to 1.5x as long
+    float lifetime = 4.0f;
+    // Particles per second, 0 keeps the system at capacity
+    float rate = 0.0f;
+    glm::vec2 gravity{0.0f, 0.5f};
+    // Fraction of speed kept when bouncing off the scene
+    float restitution = 0.5f;
+    // Half extent of the quad drawn per particle, in NDC
+    float size = 0.002f;
+};
+
+/// @brief Particles emitted, simulated, compacted and drawn on the GPU.
+///
+/// Particle attributes live in one storage buffer each. Free slots are kept
+/// on a dead list, live ones on one of two alive lists that simulation
+/// compacts into alternately. Survivors are also written as `Vertex`
+/// instances and drawn through an indirect instanced draw, so the CPU never
+/// learns how many particles are alive.
+class ParticleSystem {
+   public:
+    ParticleEmitter emitter{};
+
+    ParticleSystem(vk::raii::PhysicalDevice& phys_dev,
+                   vk::raii::Device& device,
+                   vk::Optional<const vk::raii::PipelineCache> cache,
+                   DescriptorSetCache& descriptor_cache, uint32_t capacity,
+                   const std::vector<Vertex>& scene_vertices,
+                   vk::RenderPass render_pass, const RenderState& state)
+        : device(device),
+          descriptors(descriptor_cache),
+          capacity(capacity),
+          positions(phys_dev, device, sizeof(glm::vec2) * capacity,
+                    vk::BufferUsageFlagBits::eStorageBuffer,
+                    vk::MemoryPropertyFlagBits::eDeviceLocal),
+          velocities(phys_dev, device, sizeof(glm::vec2) * capacity,
+                     vk::BufferUsageFlagBits::eStorageBuffer,
+                     vk::MemoryPropertyFlagBits::eDeviceLocal),
+          ages(phys_dev, device, sizeof(glm::vec2) * capacity,
+               vk::BufferUsageFlagBits::eStorageBuffer,
+               vk::MemoryPropertyFlagBits::eDeviceLocal),
+          colors(phys_dev, device, sizeof(uint32_t) * capacity,
+                 vk::BufferUsageFlagBits::eStorageBuffer,
+                 vk::MemoryPropertyFlagBits::eDeviceLocal),
+          alive(phys_dev, device, 2 * sizeof(uint32_t) * capacity,
+                vk::BufferUsageFlagBits::eStorageBuffer,
+                vk::MemoryPropertyFlagBits::eDeviceLocal),
+          dead(phys_dev, device, sizeof(uint32_t) * capacity,
+               vk::BufferUsageFlagBits::eStorageBuffer,
+               vk::MemoryPropertyFlagBits::eDeviceLocal),
+          counters(phys_dev, device, 4 * sizeof(uint32_t),
+                   vk::BufferUsageFlagBits::eStorageBuffer,
+                   vk::MemoryPropertyFlagBits::eDeviceLocal),
+          args(phys_dev, device, ARGS_SIZE,
+               vk::BufferUsageFlagBits::eStorageBuffer |
+                   vk::BufferUsageFlagBits::eIndirectBuffer,
+               vk::MemoryPropertyFlagBits::eDeviceLocal),
+          instances(phys_dev, device, sizeof(Vertex) * capacity,
+                    vk::BufferUsageFlagBits::eStorageBuffer |
+                        vk::BufferUsageFlagBits::eVertexBuffer,
+                    vk::MemoryPropertyFlagBits::eDeviceLocal),
+          segments(phys_dev, device,
+                   sizeof(glm::vec4) * std::max<size_t>(
+                                           scene_vertices.size(), 1),
+                   vk::BufferUsageFlagBits::eStorageBuffer,
+                   vk::MemoryPropertyFlagBits::eHostVisible |
+                       vk::MemoryPropertyFlagBits::eHostCoherent) {
+        auto max_groups =
+            phys_dev.getProperties().limits.maxComputeWorkGroupCount[0];
+        if (groupCount(capacity) > max_groups) {
+            throw std::runtime_error("particle count exceeds dispatch limits");
+        }
+
+        uploadSegments(scene_vertices);
+        createLayouts();
+
+        const std::array<std::pair<vk::raii::Pipeline*, const char*>, 5>
+            entries = {{{&init_pipeline, "init_main"},
+                        {&prepare_pipeline, "prepare_main"},
+                        {&emit_pipeline, "emit_main"},
+                        {&simulate_pipeline, "simulate_main"},
+                        {&finalize_pipeline, "finalize_main"}}};
+        for (auto& [pipeline, entry] : entries) {
+            *pipeline = createComputePipeline(device, cache, SHADER, entry,
+                                              *compute_layout);
+        }
+
+        createDrawPipeline(cache, render_pass, state);
+    }
+
+    ParticleSystem(const ParticleSystem&) = delete;
+    ParticleSystem& operator=(const ParticleSystem&) = delete;
+
+    /// @brief Records emission and a simulation step of `delta_time`
+    /// seconds, outside of any render pass
+    void simulate(const vk::raii::CommandBuffer& cmd_buf, float delta_time) {
+        float rate = emitter.rate > 0.0f ? emitter.rate
+                                         : capacity / emitter.lifetime;
+        emit_accumulator += rate * delta_time;
+        auto emit_count = static_cast<uint32_t>(emit_accumulator);
+        emit_accumulator -= emit_count;
+
+        params = ParticleParams{emitter.position,
+                                emitter.direction,
+                                emitter.color,
+                                emitter.spread,
+                                emitter.speed,
+                                emitter.lifetime,
+                                delta_time,
+                                emitter.restitution,
+                                emitter.gravity,
+                                emit_count,
+                                capacity,
+                                segment_count,
+                                step++,
+                                parity,
+                                emitter.size};
+
+        cmd_buf.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                   *compute_layout, 0, descriptorSet(),
+                                   nullptr);
+        cmd_buf.pushConstants<ParticleParams>(
+            *compute_layout, vk::ShaderStageFlagBits::eCompute, 0, params);
+
+        // Last frame's simulation and draw are done with the buffers
+        computeBarrier(cmd_buf,
+                       vk::PipelineStageFlagBits::eComputeShader |
+                           vk::PipelineStageFlagBits::eDrawIndirect |
+                           vk::PipelineStageFlagBits::eVertexInput);
+
+        if (!initialized) {
+            cmd_buf.bindPipeline(vk::PipelineBindPoint::eCompute,
+                                 *init_pipeline);
+            cmd_buf.dispatch(groupCount(capacity), 1, 1);
+            computeBarrier(cmd_buf, vk::PipelineStageFlagBits::eComputeShader);
+            initialized = true;
+        }
+
+        cmd_buf.bindPipeline(vk::PipelineBindPoint::eCompute,
+                             *prepare_pipeline);
+        cmd_buf.dispatch(1, 1, 1);
+        computeBarrier(cmd_buf, vk::PipelineStageFlagBits::eComputeShader);
+
+        cmd_buf.bindPipeline(vk::PipelineBindPoint::eCompute, *emit_pipeline);
+        cmd_buf.dispatchIndirect(*args.buffer, EMIT_ARGS_OFFSET);
+        computeBarrier(cmd_buf, vk::PipelineStageFlagBits::eComputeShader);
+
+        cmd_buf.bindPipeline(vk::PipelineBindPoint::eCompute,
+                             *simulate_pipeline);
+        cmd_buf.dispatchIndirect(*args.buffer, SIMULATE_ARGS_OFFSET);
+        computeBarrier(cmd_buf, vk::PipelineStageFlagBits::eComputeShader);
+
+        cmd_buf.bindPipeline(vk::PipelineBindPoint::eCompute,
+                             *finalize_pipeline);
+        cmd_buf.dispatch(1, 1, 1);
+
+        vk::MemoryBarrier to_draw(vk::AccessFlagBits::eShaderWrite,
+                                  vk::AccessFlagBits::eIndirectCommandRead |
+                                      vk::AccessFlagBits::eVertexAttributeRead);
+        cmd_buf.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                vk::PipelineStageFlagBits::eDrawIndirect |
+                                    vk::PipelineStageFlagBits::eVertexInput,
+                                {}, to_draw, nullptr, nullptr);
+
+        parity = 1 - parity;
+    }
+
+    /// @brief Records the draw of the particles left by the last `simulate`,
+    /// inside the render pass given at construction
+    void draw(const vk::raii::CommandBuffer& cmd_buf,
+              const vk::Viewport& viewport, const vk::Rect2D& scissor) const {
+        cmd_buf.bindPipeline(vk::PipelineBindPoint::eGraphics, *draw_pipeline);
+        cmd_buf.setViewport(0, viewport);
+        cmd_buf.setScissor(0, scissor);
+        cmd_buf.pushConstants<ParticleParams>(
+            *draw_layout, vk::ShaderStageFlagBits::eVertex, 0, params);
+        cmd_buf.bindVertexBuffers(0, *instances.buffer, {0});
+        cmd_buf.drawIndirect(*args.buffer, DRAW_ARGS_OFFSET, 1,
+                             sizeof(vk::DrawIndirectCommand));
+    }
+
+   private:
+    static constexpr const char* SHADER = "shaders/particles.spv";
+    static constexpr uint32_t GROUP_SIZE = 256;
+    // Emit dispatch, simulate dispatch and draw, as laid out in particles.wgsl
+    static constexpr vk::DeviceSize EMIT_ARGS_OFFSET = 0;
+    static constexpr vk::DeviceSize SIMULATE_ARGS_OFFSET =
+        sizeof(vk::DispatchIndirectCommand);
+    static constexpr vk::DeviceSize DRAW_ARGS_OFFSET =
+        2 * sizeof(vk::DispatchIndirectCommand);
+    static constexpr vk::DeviceSize ARGS_SIZE =
+        DRAW_ARGS_OFFSET + sizeof(vk::DrawIndirectCommand);
+
+    vk::raii::Device& device;
+    DescriptorSetCache& descriptors;
+
+    uint32_t capacity;
+    uint32_t segment_count = 0;
+    uint32_t parity = 0;
+    uint32_t step = 0;
+    float emit_accumulator = 0.0f;
+    bool initialized = false;
+    ParticleParams params{};
+
+    AllocatedBuffer positions;
+    AllocatedBuffer velocities;
+    AllocatedBuffer ages;
+    AllocatedBuffer colors;
+    AllocatedBuffer alive;
+    AllocatedBuffer dead;
+    AllocatedBuffer counters;
+    AllocatedBuffer args;
+    AllocatedBuffer instances;
+    AllocatedBuffer segments;
+
+    vk::raii::DescriptorSetLayout set_layout{nullptr};
+    vk::raii::PipelineLayout compute_layout{nullptr};
+    vk::raii::PipelineLayout draw_layout{nullptr};
+    vk::raii::Pipeline init_pipeline{nullptr};
+    vk::raii::Pipeline prepare_pipeline{nullptr};
+    vk::raii::Pipeline emit_pipeline{nullptr};
+    vk::raii::Pipeline simulate_pipeline{nullptr};
+    vk::raii::Pipeline finalize_pipeline{nullptr};
+    vk::raii::Pipeline draw_pipeline{nullptr};
+
+    static uint32_t groupCount(uint32_t items) {
+        return (items + GROUP_SIZE - 1) / GROUP_SIZE;
+    }
+
+    static void computeBarrier(const vk::raii::CommandBuffer& cmd_buf,
+                               vk::PipelineStageFlags src_stages) {
+        vk::MemoryBarrier barrier(vk::AccessFlagBits::eShaderWrite,
+                                  vk::AccessFlagBits::eIndirectCommandRead |
+                                      vk::AccessFlagBits::eShaderRead |
+                                      vk::AccessFlagBits::eShaderWrite);
+        cmd_buf.pipelineBarrier(src_stages,
+                                vk::PipelineStageFlagBits::eDrawIndirect |
+                                    vk::PipelineStageFlagBits::eComputeShader,
+                                {}, barrier, nullptr, nullptr);
+    }
+
+    /// @brief Stores the edges of every scene triangle as segments
+    void uploadSegments(const std::vector<Vertex>& vertices) {
+        std::vector<glm::vec4> edges{};
+        for (size_t i = 0; i + 2 < vertices.size(); i += 3) {
+            for (size_t corner = 0; corner < 3; corner++) {
+                auto a = vertices[i + corner].pos;
+                auto b = vertices[i + (corner + 1) % 3].pos;
+                edges.emplace_back(a.x, a.y, b.x, b.y);
+            }
+        }
+
+        segment_count = static_cast<uint32_t>(edges.size());
+        std::memcpy(segments.mapped, edges.data(),
+                    sizeof(glm::vec4) * edges.size());
+    }
+
+    vk::DescriptorSet descriptorSet() {
+        std::vector<DescriptorBinding> bindings{};
+        uint32_t binding = 0;
+        for (auto* buffer : {&positions, &velocities, &ages, &colors, &alive,
+                             &dead, &counters, &args, &instances, &segments}) {
+            bindings.push_back(DescriptorBinding::ofBuffer(
+                binding++, vk::DescriptorType::eStorageBuffer, *buffer->buffer,
+                0, buffer->size));
+        }
+        return descriptors.get(*set_layout, bindings);
+    }
+
+    void createLayouts() {
+        std::vector<vk::DescriptorSetLayoutBinding> bindings{};
+        for (uint32_t binding = 0; binding < 10; binding++) {
+            bindings.emplace_back(binding, vk::DescriptorType::eStorageBuffer,
+                                  1, vk::ShaderStageFlagBits::eCompute);
+        }
+        set_layout = device.createDescriptorSetLayout(
+            vk::DescriptorSetLayoutCreateInfo({}, bindings), hostCallbacks());
+
+        vk::PushConstantRange compute_range(vk::ShaderStageFlagBits::eCompute,
+                                            0, sizeof(ParticleParams));
+        compute_layout = device.createPipelineLayout(
+            vk::PipelineLayoutCreateInfo({}, *set_layout, compute_range),
+            hostCallbacks());
+
+        vk::PushConstantRange draw_range(vk::ShaderStageFlagBits::eVertex, 0,
+                                         sizeof(ParticleParams));
+        draw_layout = device.createPipelineLayout(
+            vk::PipelineLayoutCreateInfo({}, nullptr, draw_range),
+            hostCallbacks());
+    }
+
+    void createDrawPipeline(vk::Optional<const vk::raii::PipelineCache> cache,
+                            vk::RenderPass render_pass,
+                            const RenderState& state) {
+        auto desc = GraphicsPipelineDesc::forVertex(*draw_layout, render_pass);
+        desc.bindings[0].setInputRate(vk::VertexInputRate::eInstance);
+        desc.vertex_shader = SHADER;
+        desc.vertex_entry = "particle_vertex_main";
+        desc.fragment_shader = SHADER;
+        desc.fragment_entry = "particle_fragment_main";
+        desc.push_constant_ranges = {vk::PushConstantRange(
+            vk::ShaderStageFlagBits::eVertex, 0, sizeof(ParticleParams))};
+        desc.state = state;
+        desc.state.cull_mode = vk::CullModeFlagBits::eNone;
+        desc.state.topology = vk::PrimitiveTopology::eTriangleList;
+        desc.state.primitive_restart = false;
+
+        GraphicsPipelineState pipeline_state(device, desc);
+        draw_pipeline =
+            createGraphicsPipeline(device, cache, pipeline_state.createInfo());
+    }
+};
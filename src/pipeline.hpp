@@ -0,0 +1,287 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <optional>
+#include <string>
+#include <vector>
+
+/// @brief Fixed-function state of a draw, baked into a pipeline or set at
+/// record time through extended dynamic state
+struct RenderState {
+    vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList;
+    vk::CullModeFlags cull_mode = vk::CullModeFlagBits::eBack;
+    vk::FrontFace front_face = vk::FrontFace::eClockwise;
+    bool primitive_restart = false;
+
+    bool depth_test = false;
+    bool depth_write = false;
+    vk::CompareOp depth_compare = vk::CompareOp::eLess;
+
+    bool blend_enable = false;
+    vk::ColorComponentFlags color_write_mask =
+        vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+        vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+};
+
+/// @brief Blend equation used whenever blending is enabled
+const vk::ColorBlendEquationEXT ALPHA_BLEND_EQUATION{
+    vk::BlendFactor::eSrcAlpha, vk::BlendFactor::eOneMinusSrcAlpha,
+    vk::BlendOp::eAdd,          vk::BlendFactor::eOne,
+    vk::BlendFactor::eZero,     vk::BlendOp::eAdd};
+
+/// @brief CPU-side description of a graphics pipeline, enough to (re)create it
+struct GraphicsPipelineDesc {
+    std::string vertex_shader = "shaders/vert.spv";
+    std::string vertex_entry = "main";
+    std::string fragment_shader = "shaders/lab.spv";
+    std::string fragment_entry = "fragment_main";
+
+    std::vector<vk::VertexInputBindingDescription> bindings;
+    std::vector<vk::VertexInputAttributeDescription> attributes;
+
+    RenderState state{};
+
+    std::vector<vk::DynamicState> dynamic_states = {vk::DynamicState::eViewport,
+                                                    vk::DynamicState::eScissor};
+
+    vk::PipelineCreateFlags flags{};
+    vk::PipelineLayout layout;
+    // Shader objects take the contents of the layout instead of the layout
+    std::vector<vk::DescriptorSetLayout> set_layouts;
+    std::vector<vk::PushConstantRange> push_constant_ranges;
+    vk::RenderPass render_pass;
+    uint32_t subpass = 0;
+
+    // Pipeline shading rate (VK_KHR_fragment_shading_rate). When unset no
+    // rate state is chained, shading is per pixel and rate attachments are
+    // ignored
+    std::optional<vk::Extent2D> fragment_size;
+    // How a rate attachment of the render pass combines with the pipeline
+    // rate
+    vk::FragmentShadingRateCombinerOpKHR attachment_combiner =
+        vk::FragmentShadingRateCombinerOpKHR::eKeep;
+
+    /// @brief Description of the pipeline drawing `Vertex` triangles
+    static GraphicsPipelineDesc forVertex(vk::PipelineLayout layout,
+                                          vk::RenderPass render_pass) {
+        GraphicsPipelineDesc desc{};
+
+        auto v_attr_descs = Vertex::getAttributeDescriptions();
+        desc.bindings = {Vertex::getBindingDescription()};
+        desc.attributes.assign(v_attr_descs.begin(), v_attr_descs.end());
+        desc.layout = layout;
+        desc.render_pass = render_pass;
+
+        return desc;
+    }
+};
+
+vk::raii::ShaderModule createShaderModule(vk::raii::Device& device,
+                                          const std::string& path) {
+    auto shader_data = loadShaderBytes(path);
+
+    vk::ShaderModuleCreateInfo shader_info(
+        {}, shader_data.size(),
+        reinterpret_cast<std::uint32_t const*>(shader_data.data()));
+
+    return device.createShaderModule(shader_info, hostCallbacks());
+}
+
+/// @brief Counts pipeline cache hits and misses in the stats from the
+/// creation feedback the driver reports for every pipeline (Vulkan 1.3).
+/// Pipelines created without a cache count as misses. Off until enabled for
+/// a device that supports it, pipelines are then created as given.
+class PipelineCacheFeedback {
+   public:
+    static PipelineCacheFeedback& global() {
+        static PipelineCacheFeedback feedback{};
+        return feedback;
+    }
+
+    void enable(bool supported) {
+        enabled.store(supported, std::memory_order_relaxed);
+    }
+
+    /// @brief Creates a pipeline through `create_pipeline` with feedback
+    /// chained in front of the pNext chain of `info`
+    template <typename CreateInfo, typename Create>
+    vk::raii::Pipeline create(const CreateInfo& info, uint32_t stage_count,
+                              Create&& create_pipeline) {
+        if (!enabled.load(std::memory_order_relaxed)) {
+            return create_pipeline(info);
+        }
+
+        vk::PipelineCreationFeedback feedback{};
+        std::vector<vk::PipelineCreationFeedback> stages(stage_count);
+        vk::PipelineCreationFeedbackCreateInfo feedback_info{};
+        feedback_info.setPPipelineCreationFeedback(&feedback);
+        feedback_info.setPipelineStageCreationFeedbacks(stages);
+        feedback_info.setPNext(info.pNext);
+
+        auto chained = info;
+        chained.setPNext(&feedback_info);
+        auto pipeline = create_pipeline(chained);
+
+        if (feedback.flags & vk::PipelineCreationFeedbackFlagBits::eValid) {
+            bool hit = static_cast<bool>(
+                feedback.flags & vk::PipelineCreationFeedbackFlagBits::
+                                     eApplicationPipelineCacheHit);
+            StatsRegistry::global().add(hit ? Counter::PipelineCacheHits
+                                            : Counter::PipelineCacheMisses);
+        }
+        return pipeline;
+    }
+
+   private:
+    std::atomic<bool> enabled{false};
+};
+
+/// @brief Creates a graphics pipeline, counting whether `cache` served it
+vk::raii::Pipeline createGraphicsPipeline(
+    vk::raii::Device& device, vk::Optional<const vk::raii::PipelineCache> cache,
+    const vk::GraphicsPipelineCreateInfo& gp_info) {
+    return PipelineCacheFeedback::global().create(
+        gp_info, gp_info.stageCount,
+        [&](const vk::GraphicsPipelineCreateInfo& info) {
+            return device.createGraphicsPipeline(cache, info, hostCallbacks());
+        });
+}
+
+vk::raii::Pipeline createComputePipeline(
+    vk::raii::Device& device, vk::Optional<const vk::raii::PipelineCache> cache,
+    const std::string& path, const std::string& entry,
+    vk::PipelineLayout layout) {
+    auto module = createShaderModule(device, path);
+
+    vk::PipelineShaderStageCreateInfo stage(
+        {}, vk::ShaderStageFlagBits::eCompute, *module, entry.c_str());
+    vk::ComputePipelineCreateInfo cp_info({}, stage, layout);
+
+    return PipelineCacheFeedback::global().create(
+        cp_info, 1, [&](const vk::ComputePipelineCreateInfo& info) {
+            return device.createComputePipeline(cache, info, hostCallbacks());
+        });
+}
+
+/// @brief Shader modules and create-info structs of a graphics pipeline.
+///
+/// Create-info structs point into each other, so the state is neither
+/// copyable nor movable. It can be fed to a single monolithic create call or
+/// split into pipeline library parts.
+struct GraphicsPipelineState {
+    vk::raii::ShaderModule vert_module;
+    vk::raii::ShaderModule frag_module;
+
+    std::array<vk::PipelineShaderStageCreateInfo, 2> stages;
+    vk::PipelineVertexInputStateCreateInfo vertex_input{};
+    vk::PipelineInputAssemblyStateCreateInfo input_assembly{};
+    vk::PipelineViewportStateCreateInfo viewport{};
+    vk::PipelineRasterizationStateCreateInfo rasterization{};
+    vk::PipelineMultisampleStateCreateInfo multisample{};
+    vk::PipelineDepthStencilStateCreateInfo depth_stencil{};
+    vk::PipelineColorBlendAttachmentState blend_attachment{};
+    vk::PipelineColorBlendStateCreateInfo color_blend{};
+    vk::PipelineDynamicStateCreateInfo dynamic{};
+    vk::PipelineFragmentShadingRateStateCreateInfoKHR shading_rate{};
+
+    GraphicsPipelineDesc desc;
+
+    GraphicsPipelineState(vk::raii::Device& device,
+                          const GraphicsPipelineDesc& description)
+        : vert_module(createShaderModule(device, description.vertex_shader)),
+          frag_module(createShaderModule(device, description.fragment_shader)),
+          desc(description) {
+        stages[0] = vk::PipelineShaderStageCreateInfo(
+            {}, vk::ShaderStageFlagBits::eVertex, vert_module,
+            desc.vertex_entry.c_str());
+        stages[1] = vk::PipelineShaderStageCreateInfo(
+            {}, vk::ShaderStageFlagBits::eFragment, frag_module,
+            desc.fragment_entry.c_str());
+
+        vertex_input.setVertexBindingDescriptions(desc.bindings);
+        vertex_input.setVertexAttributeDescriptions(desc.attributes);
+
+        input_assembly.setTopology(desc.state.topology);
+        input_assembly.setPrimitiveRestartEnable(desc.state.primitive_restart);
+
+        viewport.setViewportCount(1);
+        viewport.setScissorCount(1);
+
+        rasterization.setLineWidth(1.0f);
+        rasterization.setCullMode(desc.state.cull_mode);
+        rasterization.setFrontFace(desc.state.front_face);
+
+        multisample.setSampleShadingEnable(false);
+        multisample.setRasterizationSamples(vk::SampleCountFlagBits::e1);
+
+        depth_stencil.setDepthTestEnable(desc.state.depth_test);
+        depth_stencil.setDepthWriteEnable(desc.state.depth_write);
+        depth_stencil.setDepthCompareOp(desc.state.depth_compare);
+
+        blend_attachment.setColorWriteMask(desc.state.color_write_mask);
+        blend_attachment.setBlendEnable(desc.state.blend_enable);
+        blend_attachment.setSrcColorBlendFactor(
+            ALPHA_BLEND_EQUATION.srcColorBlendFactor);
+        blend_attachment.setDstColorBlendFactor(
+            ALPHA_BLEND_EQUATION.dstColorBlendFactor);
+        blend_attachment.setColorBlendOp(ALPHA_BLEND_EQUATION.colorBlendOp);
+        blend_attachment.setSrcAlphaBlendFactor(
+            ALPHA_BLEND_EQUATION.srcAlphaBlendFactor);
+        blend_attachment.setDstAlphaBlendFactor(
+            ALPHA_BLEND_EQUATION.dstAlphaBlendFactor);
+        blend_attachment.setAlphaBlendOp(ALPHA_BLEND_EQUATION.alphaBlendOp);
+
+        color_blend.setLogicOpEnable(false);
+        color_blend.setAttachments(blend_attachment);
+        color_blend.setBlendConstants({0.0f, 0.0f, 0.0f, 0.0f});
+
+        dynamic.setDynamicStates(desc.dynamic_states);
+
+        if (desc.fragment_size.has_value()) {
+            shading_rate.setFragmentSize(desc.fragment_size.value());
+            shading_rate.setCombinerOps(
+                {vk::FragmentShadingRateCombinerOpKHR::eKeep,
+                 desc.attachment_combiner});
+        }
+    }
+
+    GraphicsPipelineState(const GraphicsPipelineState&) = delete;
+    GraphicsPipelineState& operator=(const GraphicsPipelineState&) = delete;
+
+    /// @brief Puts the shading rate state, if any, in front of the pNext
+    /// chain `next` of a create-info holding pre-rasterization or fragment
+    /// shader state. `link` must outlive the create-info.
+    const void* chainShadingRate(
+        vk::PipelineFragmentShadingRateStateCreateInfoKHR& link,
+        const void* next) const {
+        if (!desc.fragment_size.has_value()) {
+            return next;
+        }
+
+        link = shading_rate;
+        link.setPNext(next);
+        return &link;
+    }
+
+    /// @brief Create-info of the complete, monolithic pipeline
+    vk::GraphicsPipelineCreateInfo createInfo() const {
+        vk::GraphicsPipelineCreateInfo gp_info{};
+        if (desc.fragment_size.has_value()) {
+            gp_info.setPNext(&shading_rate);
+        }
+        gp_info.setFlags(desc.flags);
+        gp_info.setStages(stages);
+        gp_info.setPVertexInputState(&vertex_input);
+        gp_info.setPInputAssemblyState(&input_assembly);
+        gp_info.setPViewportState(&viewport);
+        gp_info.setPRasterizationState(&rasterization);
+        gp_info.setPMultisampleState(&multisample);
+        gp_info.setPDepthStencilState(&depth_stencil);
+        gp_info.setPColorBlendState(&color_blend);
+        gp_info.setPDynamicState(&dynamic);
+        gp_info.setLayout(desc.layout);
+        gp_info.setRenderPass(desc.render_pass);
+        gp_info.setSubpass(desc.subpass);
+        return gp_info;
+    }
+};
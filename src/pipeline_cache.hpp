@@ -0,0 +1,64 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+/// @brief Pipeline cache contents stored at `path` by an earlier run, or
+/// nothing when the file is missing or was written for another device or
+/// driver, whose data the driver would reject anyway
+std::vector<uint8_t> loadPipelineCacheData(
+    const std::string& path, const vk::PhysicalDeviceProperties& props) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return {};
+    }
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                              std::istreambuf_iterator<char>());
+
+    // Header version one: header size, version, vendor id, device id and
+    // the cache UUID
+    constexpr size_t HEADER_SIZE = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+    if (data.size() < HEADER_SIZE) {
+        return {};
+    }
+
+    std::array<uint32_t, 4> header{};
+    std::memcpy(header.data(), data.data(), sizeof(header));
+    if (header[0] < HEADER_SIZE ||
+        header[1] != static_cast<uint32_t>(
+                         vk::PipelineCacheHeaderVersion::eOne) ||
+        header[2] != props.vendorID || header[3] != props.deviceID ||
+        std::memcmp(data.data() + sizeof(header), props.pipelineCacheUUID,
+                    VK_UUID_SIZE) != 0) {
+        return {};
+    }
+
+    return data;
+}
+
+/// @brief Writes the cache contents to `path`, through a temporary file so
+/// that a crash mid-write leaves the previous contents
+void storePipelineCacheData(const std::string& path,
+                            const vk::raii::PipelineCache& cache) {
+    auto data = cache.getData();
+    auto temp_path = path + ".tmp";
+
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            return;
+        }
+        file.write(reinterpret_cast<const char*>(data.data()), data.size());
+        if (!file) {
+            return;
+        }
+    }
+
+    std::rename(temp_path.c_str(), path.c_str());
+}
@@ -0,0 +1,167 @@
+#pragma once
+#include <chrono>
+#include <future>
+#include <optional>
+#include <vector>
+
+const std::vector<const char*> PIPELINE_LIBRARY_DEVICE_EXTENSIONS = {
+    VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME,
+    VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME};
+
+/// @brief Graphics pipeline linked from VK_EXT_graphics_pipeline_library parts.
+///
+/// The vertex input, pre-rasterization, fragment shader and fragment output
+/// parts are compiled separately and fast-linked without optimization, so the
+/// pipeline is usable immediately. An optimized link runs in the background
+/// and replaces the fast one once it is ready.
+class PipelineLibrary {
+   public:
+    PipelineLibrary(vk::raii::Device& device,
+                    vk::Optional<const vk::raii::PipelineCache> cache,
+                    const GraphicsPipelineState& state) {
+        auto part_flags = state.desc.flags |
+                          vk::PipelineCreateFlagBits::eLibraryKHR |
+                          vk::PipelineCreateFlagBits::
+                              eRetainLinkTimeOptimizationInfoEXT;
+
+        {
+            vk::GraphicsPipelineLibraryCreateInfoEXT lib_info(
+                vk::GraphicsPipelineLibraryFlagBitsEXT::eVertexInputInterface);
+            vk::GraphicsPipelineCreateInfo gp_info{};
+            gp_info.setPNext(&lib_info);
+            gp_info.setFlags(part_flags);
+            gp_info.setPVertexInputState(&state.vertex_input);
+            gp_info.setPInputAssemblyState(&state.input_assembly);
+            gp_info.setPDynamicState(&state.dynamic);
+            parts.push_back(createGraphicsPipeline(device, cache, gp_info));
+        }
+
+        {
+            vk::GraphicsPipelineLibraryCreateInfoEXT lib_info(
+                vk::GraphicsPipelineLibraryFlagBitsEXT::
+                    ePreRasterizationShaders);
+            vk::PipelineFragmentShadingRateStateCreateInfoKHR shading_rate{};
+            vk::GraphicsPipelineCreateInfo gp_info{};
+            gp_info.setPNext(state.chainShadingRate(shading_rate, &lib_info));
+            gp_info.setFlags(part_flags);
+            gp_info.setStageCount(1);
+            gp_info.setPStages(&state.stages[0]);
+            gp_info.setPViewportState(&state.viewport);
+            gp_info.setPRasterizationState(&state.rasterization);
+            gp_info.setPDynamicState(&state.dynamic);
+            gp_info.setLayout(state.desc.layout);
+            gp_info.setRenderPass(state.desc.render_pass);
+            gp_info.setSubpass(state.desc.subpass);
+            parts.push_back(createGraphicsPipeline(device, cache, gp_info));
+        }
+
+        {
+            vk::GraphicsPipelineLibraryCreateInfoEXT lib_info(
+                vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentShader);
+            vk::PipelineFragmentShadingRateStateCreateInfoKHR shading_rate{};
+            vk::GraphicsPipelineCreateInfo gp_info{};
+            gp_info.setPNext(state.chainShadingRate(shading_rate, &lib_info));
+            gp_info.setFlags(part_flags);
+            gp_info.setStageCount(1);
+            gp_info.setPStages(&state.stages[1]);
+            gp_info.setPMultisampleState(&state.multisample);
+            gp_info.setPDepthStencilState(&state.depth_stencil);
+            gp_info.setPDynamicState(&state.dynamic);
+            gp_info.setLayout(state.desc.layout);
+            gp_info.setRenderPass(state.desc.render_pass);
+            gp_info.setSubpass(state.desc.subpass);
+            parts.push_back(createGraphicsPipeline(device, cache, gp_info));
+        }
+
+        {
+            vk::GraphicsPipelineLibraryCreateInfoEXT lib_info(
+                vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentOutputInterface);
+            vk::GraphicsPipelineCreateInfo gp_info{};
+            gp_info.setPNext(&lib_info);
+            gp_info.setFlags(part_flags);
+            gp_info.setPMultisampleState(&state.multisample);
+            gp_info.setPColorBlendState(&state.color_blend);
+            gp_info.setPDynamicState(&state.dynamic);
+            gp_info.setRenderPass(state.desc.render_pass);
+            gp_info.setSubpass(state.desc.subpass);
+            parts.push_back(createGraphicsPipeline(device, cache, gp_info));
+        }
+
+        for (auto& part : parts) {
+            part_handles.push_back(*part);
+        }
+
+        fast_linked = link(device, cache, part_handles, state.desc.layout,
+                           state.desc.flags);
+
+        // Parts stay alive as long as this object, so the background link
+        // only needs their handles
+        link_started = std::chrono::steady_clock::now();
+        optimized_future = std::async(
+            std::launch::async,
+            [&device, cache, handles = part_handles,
+             layout = state.desc.layout, flags = state.desc.flags]() {
+                return link(device, cache, handles, layout,
+                            flags | vk::PipelineCreateFlagBits::
+                                        eLinkTimeOptimizationEXT);
+            });
+    }
+
+    PipelineLibrary(const PipelineLibrary&) = delete;
+    PipelineLibrary& operator=(const PipelineLibrary&) = delete;
+
+    /// @brief Returns the best pipeline available, swapping in the optimized
+    /// one as soon as its background link has finished
+    vk::Pipeline get() {
+        if (!optimized.has_value() && optimized_future.valid() &&
+            optimized_future.wait_for(std::chrono::seconds(0)) ==
+                std::future_status::ready) {
+            optimized = optimized_future.get();
+            optimized_after = std::chrono::steady_clock::now() - link_started;
+        }
+
+        if (optimized.has_value()) {
+            return *optimized.value();
+        }
+
+        return *fast_linked.value();
+    }
+
+    /// @brief Time the optimized link took, once it has been swapped in
+    std::optional<std::chrono::steady_clock::duration> optimizedLinkTime()
+        const {
+        if (!optimized.has_value()) {
+            return std::nullopt;
+        }
+        return optimized_after;
+    }
+
+   private:
+    std::vector<vk::raii::Pipeline> parts;
+    std::vector<vk::Pipeline> part_handles;
+    // The fast-linked pipeline is kept after the swap, since command buffers
+    // recorded before it may still be in flight
+    std::optional<vk::raii::Pipeline> fast_linked;
+    std::optional<vk::raii::Pipeline> optimized;
+
+    std::chrono::steady_clock::time_point link_started;
+    std::chrono::steady_clock::duration optimized_after{};
+    // Declared last so that its destructor waits for the background link
+    // before the parts it references are destroyed
+    std::future<vk::raii::Pipeline> optimized_future;
+
+    static vk::raii::Pipeline link(
+        vk::raii::Device& device,
+        vk::Optional<const vk::raii::PipelineCache> cache,
+        const std::vector<vk::Pipeline>& libraries, vk::PipelineLayout layout,
+        vk::PipelineCreateFlags flags) {
+        vk::PipelineLibraryCreateInfoKHR link_info(libraries);
+
+        vk::GraphicsPipelineCreateInfo gp_info{};
+        gp_info.setPNext(&link_info);
+        gp_info.setFlags(flags);
+        gp_info.setLayout(layout);
+
+        return createGraphicsPipeline(device, cache, gp_info);
+    }
+};
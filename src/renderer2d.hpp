@@ -0,0 +1,488 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <future>
+#include <optional>
+#include <string>
+#include <vector>
+
+/// @brief Vertex of a tessellated path triangle, in pixels
+struct OverlayVertex {
+    glm::vec2 pos;
+    glm::vec4 color;
+};
+
+/// @brief Screen rectangle textured with an atlas region, in pixels and
+/// normalized atlas coordinates
+struct QuadInstance {
+    glm::vec4 rect;
+    glm::vec4 uv;
+    glm::vec4 color;
+};
+
+/// @brief Push constants of overlay.wgsl
+struct OverlayParams {
+    glm::vec2 screen_size;
+};
+
+/// @brief Batched 2D drawing of filled and stroked paths and distance field
+/// text, on top of whatever the render pass drew before.
+///
+/// Draw calls only queue work for the frame. `prepare` gathers path
+/// triangles into the frame slot's vertex buffer, quad instances into a
+/// persistently mapped ring buffer shared by all frame slots, and uploads new
+/// glyphs. `draw` then records one draw for all path triangles and one
+/// instanced draw for all glyphs and rectangles. Coordinates are in pixels
+/// from the top left.
+class Renderer2D {
+   public:
+    static constexpr vk::Format ATLAS_FORMAT = vk::Format::eR8Unorm;
+    static constexpr uint32_t ATLAS_SIZE = 512;
+    // Quad instances in the ring, quads beyond what fits in a frame are
+    // dropped
+    static constexpr uint32_t RING_CAPACITY = 16384;
+
+    Renderer2D(vk::raii::PhysicalDevice& phys_dev, vk::raii::Device& device,
+               vk::Optional<const vk::raii::PipelineCache> cache,
+               DescriptorSetCache& descriptor_cache, vk::RenderPass render_pass,
+               uint32_t frame_count)
+        : phys_dev(phys_dev),
+          device(device),
+          descriptors(descriptor_cache),
+          atlas(ATLAS_SIZE, ATLAS_SIZE),
+          atlas_image(phys_dev, device,
+                      AllocatedImage::info2D(
+                          ATLAS_FORMAT, {ATLAS_SIZE, ATLAS_SIZE},
+                          vk::ImageUsageFlagBits::eSampled |
+                              vk::ImageUsageFlagBits::eTransferDst)),
+          atlas_view(atlas_image.createView(device,
+                                            vk::ImageAspectFlagBits::eColor)),
+          sampler(device.createSampler(vk::SamplerCreateInfo(
+              {}, vk::Filter::eLinear, vk::Filter::eLinear,
+              vk::SamplerMipmapMode::eNearest,
+              vk::SamplerAddressMode::eClampToEdge,
+              vk::SamplerAddressMode::eClampToEdge,
+              vk::SamplerAddressMode::eClampToEdge),
+                                       hostCallbacks())),
+          quad_ring(phys_dev, device, sizeof(QuadInstance) * RING_CAPACITY,
+                    vk::BufferUsageFlagBits::eVertexBuffer,
+                    vk::MemoryPropertyFlagBits::eHostVisible |
+                        vk::MemoryPropertyFlagBits::eHostCoherent),
+          frames(frame_count) {
+        for (auto& frame : frames) {
+            frame.staging.emplace(phys_dev, device,
+                                  vk::DeviceSize{ATLAS_SIZE} * ATLAS_SIZE,
+                                  vk::BufferUsageFlagBits::eTransferSrc,
+                                  vk::MemoryPropertyFlagBits::eHostVisible |
+                                      vk::MemoryPropertyFlagBits::eHostCoherent);
+        }
+
+        createLayouts();
+        createPipelines(cache, render_pass);
+    }
+
+    Renderer2D(const Renderer2D&) = delete;
+    Renderer2D& operator=(const Renderer2D&) = delete;
+
+    void fillPath(const Path& path, const glm::vec4& color,
+                  glm::vec2 offset = {}) {
+        queuePath(path, 0.0f, color, offset);
+    }
+
+    void strokePath(const Path& path, float width, const glm::vec4& color,
+                    glm::vec2 offset = {}) {
+        queuePath(path, width, color, offset);
+    }
+
+    void rect(glm::vec2 position, glm::vec2 size, const glm::vec4& color) {
+        quads.push_back({glm::vec4(position.x, position.y, size.x, size.y),
+                         uvOf(atlas.solid()), color});
+    }
+
+    /// @brief Queues `content` with its cap line at `position` and capitals
+    /// `height` pixels tall. Returns the pen advance.
+    float text(const std::string& content, glm::vec2 position, float height,
+               const glm::vec4& color) {
+        float unit = height / StrokeFont::CAP_HEIGHT;
+        float padding = static_cast<float>(StrokeFont::PADDING) /
+                        StrokeFont::UNIT_PIXELS * unit;
+        glm::vec2 cell_size(
+            static_cast<float>(StrokeFont::CELL_WIDTH) /
+                StrokeFont::UNIT_PIXELS * unit,
+            static_cast<float>(StrokeFont::CELL_HEIGHT) /
+                StrokeFont::UNIT_PIXELS * unit);
+
+        glm::vec2 pen = position;
+        float widest = 0.0f;
+        for (char c : content) {
+            if (c == '\n') {
+                widest = std::max(widest, pen.x - position.x);
+                pen = glm::vec2(position.x,
+                                pen.y + StrokeFont::LINE_HEIGHT * unit);
+                continue;
+            }
+
+            if (c != ' ') {
+                auto region = glyph(c);
+                if (region.has_value()) {
+                    quads.push_back({glm::vec4(pen.x - padding,
+                                               pen.y - padding, cell_size.x,
+                                               cell_size.y),
+                                     uvOf(region.value()), color});
+                }
+            }
+            pen.x += StrokeFont::ADVANCE * unit;
+        }
+        return std::max(widest, pen.x - position.x);
+    }
+
+    /// @brief Records the upload of new glyphs and writes everything queued
+    /// since the last call into the frame slot's buffers, outside of any
+    /// render pass. Waits for outstanding tessellation.
+    void prepare(const vk::raii::CommandBuffer& cmd_buf, uint32_t frame_idx) {
+        auto& frame = frames[frame_idx];
+
+        std::vector<OverlayVertex> vertices{};
+        for (auto& pending : paths) {
+            for (auto& pos : pending.triangles.get()) {
+                vertices.push_back({pos + pending.offset, pending.color});
+            }
+        }
+
+        frame.vertex_count = static_cast<uint32_t>(vertices.size());
+        writeGrowing(frame.vertices, vertices.data(),
+                     sizeof(OverlayVertex) * vertices.size());
+
+        auto quad_count = static_cast<uint32_t>(quads.size());
+        frame.first_quad = allocateQuads(frame_idx, quad_count);
+        frame.quad_count = quad_count;
+        dropped_quads += quads.size() - quad_count;
+        std::memcpy(static_cast<QuadInstance*>(quad_ring.mapped) +
+                        frame.first_quad,
+                    quads.data(), sizeof(QuadInstance) * quad_count);
+
+        uploadAtlas(cmd_buf, frame);
+
+        paths.clear();
+        quads.clear();
+        tessellations.trim(frame_number);
+        frame_number++;
+    }
+
+    /// @brief Records the draws of what the last `prepare` wrote for the
+    /// frame slot, inside the render pass given at construction. Returns the
+    /// number of draws recorded.
+    uint32_t draw(const vk::raii::CommandBuffer& cmd_buf, uint32_t frame_idx,
+                  const vk::Viewport& viewport, const vk::Rect2D& scissor) {
+        auto& frame = frames[frame_idx];
+        uint32_t draws = 0;
+        if (frame.vertex_count == 0 && frame.quad_count == 0) {
+            return draws;
+        }
+
+        OverlayParams params{glm::vec2(viewport.width, viewport.height)};
+
+        auto set = descriptors.get(
+            *set_layout,
+            {DescriptorBinding::ofImage(
+                 0, vk::DescriptorType::eSampledImage, *atlas_view,
+                 vk::ImageLayout::eShaderReadOnlyOptimal),
+             DescriptorBinding::ofImage(1, vk::DescriptorType::eSampler,
+                                        nullptr, vk::ImageLayout::eUndefined,
+                                        *sampler)});
+
+        if (frame.vertex_count > 0) {
+            cmd_buf.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                                 *path_pipeline);
+            cmd_buf.setViewport(0, viewport);
+            cmd_buf.setScissor(0, scissor);
+            cmd_buf.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+                                       *layout, 0, set, nullptr);
+            cmd_buf.pushConstants<OverlayParams>(
+                *layout, vk::ShaderStageFlagBits::eVertex, 0, params);
+            cmd_buf.bindVertexBuffers(0, *frame.vertices->buffer, {0});
+            cmd_buf.draw(frame.vertex_count, 1, 0, 0);
+            draws++;
+        }
+
+        if (frame.quad_count > 0) {
+            cmd_buf.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                                 *quad_pipeline);
+            cmd_buf.setViewport(0, viewport);
+            cmd_buf.setScissor(0, scissor);
+            cmd_buf.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+                                       *layout, 0, set, nullptr);
+            cmd_buf.pushConstants<OverlayParams>(
+                *layout, vk::ShaderStageFlagBits::eVertex, 0, params);
+            cmd_buf.bindVertexBuffers(0, *quad_ring.buffer, {0});
+            cmd_buf.draw(6, frame.quad_count, 0, frame.first_quad);
+            draws++;
+        }
+        return draws;
+    }
+
+    const TessellationCache& tessellationCache() const {
+        return tessellations;
+    }
+
+    uint64_t droppedQuadCount() const { return dropped_quads; }
+    uint64_t atlasEvictionCount() const { return atlas.evictionCount(); }
+
+   private:
+    static constexpr const char* SHADER = "shaders/overlay.spv";
+
+    struct PendingPath {
+        std::shared_future<std::vector<glm::vec2>> triangles;
+        glm::vec2 offset;
+        glm::vec4 color;
+    };
+
+    struct FrameResources {
+        std::optional<AllocatedBuffer> vertices;
+        std::optional<AllocatedBuffer> staging;
+        uint32_t vertex_count = 0;
+        // Ring region holding the slot's quads
+        uint32_t first_quad = 0;
+        uint32_t quad_count = 0;
+    };
+
+    vk::raii::PhysicalDevice& phys_dev;
+    vk::raii::Device& device;
+    DescriptorSetCache& descriptors;
+
+    TessellationCache tessellations{};
+    GlyphAtlas atlas;
+    AllocatedImage atlas_image;
+    vk::raii::ImageView atlas_view;
+    vk::raii::Sampler sampler;
+    bool atlas_initialized = false;
+    uint64_t frame_number = 1;
+
+    std::vector<PendingPath> paths;
+    std::vector<QuadInstance> quads;
+    AllocatedBuffer quad_ring;
+    uint32_t ring_head = 0;
+    uint64_t dropped_quads = 0;
+    std::vector<FrameResources> frames;
+
+    vk::raii::DescriptorSetLayout set_layout{nullptr};
+    vk::raii::PipelineLayout layout{nullptr};
+    vk::raii::Pipeline path_pipeline{nullptr};
+    vk::raii::Pipeline quad_pipeline{nullptr};
+
+    void queuePath(const Path& path, float stroke_width,
+                   const glm::vec4& color, glm::vec2 offset) {
+        if (path.empty()) {
+            return;
+        }
+        paths.push_back(
+            {tessellations.request(path, stroke_width, frame_number), offset,
+             color});
+    }
+
+    glm::vec4 uvOf(const AtlasRegion& region) const {
+        float scale = 1.0f / ATLAS_SIZE;
+        return glm::vec4(region.x * scale, region.y * scale,
+                         region.width * scale, region.height * scale);
+    }
+
+    /// @brief First ring instance of `count` contiguous quads, clear of the
+    /// regions other frame slots may still read. Takes the space after the
+    /// last allocation or else wraps to the start, shrinking `count` when
+    /// neither has room.
+    uint32_t allocateQuads(uint32_t frame_idx, uint32_t& count) {
+        uint32_t best_start = 0;
+        uint32_t best_room = 0;
+        for (uint32_t start : {ring_head, 0u}) {
+            uint32_t limit = RING_CAPACITY;
+            bool blocked = false;
+            for (size_t i = 0; i < frames.size(); i++) {
+                auto& other = frames[i];
+                if (i == frame_idx || other.quad_count == 0) {
+                    continue;
+                }
+                if (other.first_quad >= start) {
+                    limit = std::min(limit, other.first_quad);
+                } else if (other.first_quad + other.quad_count > start) {
+                    blocked = true;
+                }
+            }
+
+            uint32_t room = blocked ? 0 : limit - start;
+            if (room >= count) {
+                best_start = start;
+                best_room = room;
+                break;
+            }
+            if (room > best_room) {
+                best_start = start;
+                best_room = room;
+            }
+        }
+
+        count = std::min(count, best_room);
+        ring_head = best_start + count;
+        return best_start;
+    }
+
+    /// @brief Atlas region of `c`, rasterized on first use
+    std::optional<AtlasRegion> glyph(char c) {
+        auto key = static_cast<uint32_t>(static_cast<unsigned char>(c));
+        auto region = atlas.find(key, frame_number);
+        if (region.has_value()) {
+            return region;
+        }
+
+        auto field = StrokeFont::rasterize(c);
+        return atlas.insert(key, StrokeFont::CELL_WIDTH,
+                            StrokeFont::CELL_HEIGHT, field.data(),
+                            frame_number);
+    }
+
+    /// @brief Copies `size` bytes into `buffer`, recreating it at least
+    /// twice as large when too small. The frame slot's previous submission
+    /// has completed, so the old buffer is no longer in use.
+    void writeGrowing(std::optional<AllocatedBuffer>& buffer, const void* data,
+                      vk::DeviceSize size) {
+        if (size == 0) {
+            return;
+        }
+        if (!buffer.has_value() || buffer->size < size) {
+            vk::DeviceSize capacity =
+                std::max<vk::DeviceSize>(size, buffer.has_value()
+                                                   ? 2 * buffer->size
+                                                   : MIN_BUFFER_SIZE);
+            buffer.reset();
+            buffer.emplace(phys_dev, device, capacity,
+                           vk::BufferUsageFlagBits::eVertexBuffer,
+                           vk::MemoryPropertyFlagBits::eHostVisible |
+                               vk::MemoryPropertyFlagBits::eHostCoherent);
+        }
+        std::memcpy(buffer->mapped, data, size);
+    }
+
+    static constexpr vk::DeviceSize MIN_BUFFER_SIZE = 16 * 1024;
+
+    void uploadAtlas(const vk::raii::CommandBuffer& cmd_buf,
+                     FrameResources& frame) {
+        auto dirty = atlas.takeDirty();
+        if (dirty.empty()) {
+            return;
+        }
+
+        auto staging = static_cast<uint8_t*>(frame.staging->mapped);
+        std::vector<vk::BufferImageCopy> copies{};
+        for (auto& region : dirty) {
+            for (uint32_t row = 0; row < region.height; row++) {
+                size_t offset =
+                    size_t{region.y + row} * ATLAS_SIZE + region.x;
+                std::memcpy(staging + offset, atlas.data() + offset,
+                            region.width);
+            }
+
+            vk::BufferImageCopy copy{};
+            copy.setBufferOffset(vk::DeviceSize{region.y} * ATLAS_SIZE +
+                                 region.x);
+            copy.setBufferRowLength(ATLAS_SIZE);
+            copy.setImageSubresource(
+                {vk::ImageAspectFlagBits::eColor, 0, 0, 1});
+            copy.setImageOffset(vk::Offset3D(static_cast<int32_t>(region.x),
+                                             static_cast<int32_t>(region.y),
+                                             0));
+            copy.setImageExtent({region.width, region.height, 1});
+            copies.push_back(copy);
+        }
+
+        vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor, 0, 1,
+                                        0, 1);
+        auto old_layout = atlas_initialized
+                              ? vk::ImageLayout::eShaderReadOnlyOptimal
+                              : vk::ImageLayout::eUndefined;
+        vk::ImageMemoryBarrier to_transfer(
+            {}, vk::AccessFlagBits::eTransferWrite, old_layout,
+            vk::ImageLayout::eTransferDstOptimal, VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED, *atlas_image.image, range);
+        cmd_buf.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader,
+                                vk::PipelineStageFlagBits::eTransfer, {},
+                                nullptr, nullptr, to_transfer);
+
+        cmd_buf.copyBufferToImage(*frame.staging->buffer, *atlas_image.image,
+                                  vk::ImageLayout::eTransferDstOptimal, copies);
+
+        vk::ImageMemoryBarrier to_shader(
+            vk::AccessFlagBits::eTransferWrite,
+            vk::AccessFlagBits::eShaderRead,
+            vk::ImageLayout::eTransferDstOptimal,
+            vk::ImageLayout::eShaderReadOnlyOptimal, VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED, *atlas_image.image, range);
+        cmd_buf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                vk::PipelineStageFlagBits::eFragmentShader, {},
+                                nullptr, nullptr, to_shader);
+
+        atlas_initialized = true;
+    }
+
+    void createLayouts() {
+        std::vector<vk::DescriptorSetLayoutBinding> bindings = {
+            {0, vk::DescriptorType::eSampledImage, 1,
+             vk::ShaderStageFlagBits::eFragment},
+            {1, vk::DescriptorType::eSampler, 1,
+             vk::ShaderStageFlagBits::eFragment},
+        };
+        set_layout = device.createDescriptorSetLayout(
+            vk::DescriptorSetLayoutCreateInfo({}, bindings), hostCallbacks());
+
+        vk::PushConstantRange range(vk::ShaderStageFlagBits::eVertex, 0,
+                                    sizeof(OverlayParams));
+        layout = device.createPipelineLayout(
+            vk::PipelineLayoutCreateInfo({}, *set_layout, range),
+            hostCallbacks());
+    }
+
+    void createPipelines(vk::Optional<const vk::raii::PipelineCache> cache,
+                         vk::RenderPass render_pass) {
+        GraphicsPipelineDesc desc{};
+        desc.vertex_shader = SHADER;
+        desc.fragment_shader = SHADER;
+        desc.layout = *layout;
+        desc.render_pass = render_pass;
+        desc.set_layouts = {*set_layout};
+        desc.push_constant_ranges = {vk::PushConstantRange(
+            vk::ShaderStageFlagBits::eVertex, 0, sizeof(OverlayParams))};
+        desc.state.cull_mode = vk::CullModeFlagBits::eNone;
+        desc.state.blend_enable = true;
+
+        desc.vertex_entry = "path_vertex_main";
+        desc.fragment_entry = "path_fragment_main";
+        desc.bindings = {vk::VertexInputBindingDescription(
+            0, sizeof(OverlayVertex), vk::VertexInputRate::eVertex)};
+        desc.attributes = {
+            {0, 0, vk::Format::eR32G32Sfloat, offsetof(OverlayVertex, pos)},
+            {1, 0, vk::Format::eR32G32B32A32Sfloat,
+             offsetof(OverlayVertex, color)}};
+        {
+            GraphicsPipelineState pipeline_state(device, desc);
+            path_pipeline = createGraphicsPipeline(
+                device, cache, pipeline_state.createInfo());
+        }
+
+        desc.vertex_entry = "quad_vertex_main";
+        desc.fragment_entry = "quad_fragment_main";
+        desc.bindings = {vk::VertexInputBindingDescription(
+            0, sizeof(QuadInstance), vk::VertexInputRate::eInstance)};
+        desc.attributes = {
+            {0, 0, vk::Format::eR32G32B32A32Sfloat,
+             offsetof(QuadInstance, rect)},
+            {1, 0, vk::Format::eR32G32B32A32Sfloat,
+             offsetof(QuadInstance, uv)},
+            {2, 0, vk::Format::eR32G32B32A32Sfloat,
+             offsetof(QuadInstance, color)}};
+        {
+            GraphicsPipelineState pipeline_state(device, desc);
+            quad_pipeline = createGraphicsPipeline(
+                device, cache, pipeline_state.createInfo());
+        }
+    }
+};
@@ -0,0 +1,104 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/// @brief One instance of the vertex mesh, matches `SceneObject` in
+/// scene.wgsl and cull.wgsl (std430)
+struct SceneObject {
+    glm::vec2 offset;
+    float scale;
+    float depth;
+};
+
+/// @brief 2D bounds of a mesh in its own coordinates
+struct MeshBounds {
+    glm::vec2 min;
+    glm::vec2 max;
+
+    static MeshBounds from(const std::vector<Vertex>& vertices) {
+        MeshBounds bounds{vertices[0].pos, vertices[0].pos};
+        for (auto& vertex : vertices) {
+            bounds.min = glm::min(bounds.min, vertex.pos);
+            bounds.max = glm::max(bounds.max, vertex.pos);
+        }
+        return bounds;
+    }
+};
+
+/// @brief Orthographic 2D camera, ndc = (world - center) * zoom
+struct Camera2D {
+    glm::vec2 center{0.0f, 0.0f};
+    float zoom = 1.0f;
+
+    glm::vec2 toWorld(glm::vec2 ndc) const { return ndc / zoom + center; }
+
+    /// @brief Visible part of the scene over the whole depth range
+    Aabb viewBounds() const {
+        return {glm::vec3(toWorld({-1.0f, -1.0f}), 0.0f),
+                glm::vec3(toWorld({1.0f, 1.0f}), 1.0f)};
+    }
+};
+
+/// @brief Objects drawn by the culled scene path, stacks of objects sway
+/// sideways over time
+struct Scene {
+    std::vector<SceneObject> objects;
+    uint32_t layers = 1;
+    float sway = 0.0f;
+
+    /// @brief `count` objects spread over a grid of stacks, each stack holds
+    /// `layers` copies where nearer copies are larger and hide the ones
+    /// behind them
+    static Scene stacked(uint32_t count, uint32_t layers = 8) {
+        Scene scene{};
+        scene.layers = layers;
+
+        uint32_t stacks = (count + layers - 1) / layers;
+        auto grid = static_cast<uint32_t>(
+            std::ceil(std::sqrt(static_cast<float>(stacks))));
+        float cell = 2.0f / static_cast<float>(grid);
+        scene.sway = 0.1f * cell;
+
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t stack = i / layers;
+            uint32_t layer = i % layers;
+
+            glm::vec2 center(-1.0f + cell * (stack % grid + 0.5f),
+                             -1.0f + cell * (stack / grid + 0.5f));
+            float scale = cell * (1.0f - 0.05f * layer);
+            float depth = 0.1f + 0.8f * layer / layers;
+
+            scene.objects.push_back({center, scale, depth});
+        }
+
+        return scene;
+    }
+
+    /// @brief Object placement at `time` seconds, safe to call from any
+    /// thread
+    std::vector<SceneObject> objectsAt(float time) const {
+        auto moved = objects;
+        for (uint32_t i = 0; i < moved.size(); i++) {
+            moved[i].offset.x += sway * std::sin(time + i / layers);
+        }
+        return moved;
+    }
+
+    std::vector<Aabb> boundsAt(float time, const MeshBounds& mesh) const {
+        std::vector<Aabb> bounds{};
+        bounds.reserve(objects.size());
+        for (auto& object : objectsAt(time)) {
+            bounds.push_back(objectBounds(object, mesh));
+        }
+        return bounds;
+    }
+
+    static Aabb objectBounds(const SceneObject& object,
+                             const MeshBounds& mesh) {
+        return {glm::vec3(object.offset + mesh.min * object.scale,
+                          object.depth),
+                glm::vec3(object.offset + mesh.max * object.scale,
+                          object.depth)};
+    }
+};
@@ -0,0 +1,101 @@
+#pragma once
+#include <array>
+#include <vector>
+
+const std::vector<const char*> SHADER_OBJECT_DEVICE_EXTENSIONS = {
+    VK_EXT_SHADER_OBJECT_EXTENSION_NAME};
+
+// Khronos layer emulating VK_EXT_shader_object on top of pipelines, it stays
+// inactive on drivers with native support
+const char* const SHADER_OBJECT_EMULATION_LAYER =
+    "VK_LAYER_KHRONOS_shader_object";
+
+/// @brief Linked vertex and fragment shader objects (VK_EXT_shader_object).
+///
+/// No VkPipeline is involved: shaders are created straight from SPIR-V and
+/// every piece of state a pipeline would bake is set at record time.
+class ShaderObjectProgram {
+   public:
+    ShaderObjectProgram(vk::raii::Device& device,
+                        const GraphicsPipelineDesc& description)
+        : desc(description), state_tracker(DynamicStateSupport::full()) {
+        auto vert_bytes = loadShaderBytes(desc.vertex_shader);
+        auto frag_bytes = loadShaderBytes(desc.fragment_shader);
+
+        std::array<vk::ShaderCreateInfoEXT, 2> shader_infos{};
+
+        shader_infos[0].setFlags(vk::ShaderCreateFlagBitsEXT::eLinkStage);
+        shader_infos[0].setStage(vk::ShaderStageFlagBits::eVertex);
+        shader_infos[0].setNextStage(vk::ShaderStageFlagBits::eFragment);
+        shader_infos[0].setCodeType(vk::ShaderCodeTypeEXT::eSpirv);
+        shader_infos[0].setCodeSize(vert_bytes.size());
+        shader_infos[0].setPCode(vert_bytes.data());
+        shader_infos[0].setPName(desc.vertex_entry.c_str());
+        shader_infos[0].setSetLayouts(desc.set_layouts);
+        shader_infos[0].setPushConstantRanges(desc.push_constant_ranges);
+
+        shader_infos[1].setFlags(vk::ShaderCreateFlagBitsEXT::eLinkStage);
+        shader_infos[1].setStage(vk::ShaderStageFlagBits::eFragment);
+        shader_infos[1].setCodeType(vk::ShaderCodeTypeEXT::eSpirv);
+        shader_infos[1].setCodeSize(frag_bytes.size());
+        shader_infos[1].setPCode(frag_bytes.data());
+        shader_infos[1].setPName(desc.fragment_entry.c_str());
+        shader_infos[1].setSetLayouts(desc.set_layouts);
+        shader_infos[1].setPushConstantRanges(desc.push_constant_ranges);
+
+        shaders = device.createShadersEXT(shader_infos, hostCallbacks());
+
+        for (auto& shader : shaders) {
+            shader_handles.push_back(*shader);
+        }
+
+        for (auto& binding : desc.bindings) {
+            vertex_bindings.emplace_back(binding.binding, binding.stride,
+                                         binding.inputRate, 1);
+        }
+        for (auto& attribute : desc.attributes) {
+            vertex_attributes.emplace_back(attribute.location,
+                                           attribute.binding, attribute.format,
+                                           attribute.offset);
+        }
+    }
+
+    /// @brief Binds the shaders and records every piece of state needed
+    /// before a draw, `state` is tracked so later calls to `setState` only
+    /// emit changes
+    void bind(const vk::raii::CommandBuffer& cmd_buf, const RenderState& state) {
+        cmd_buf.bindShadersEXT(SHADER_STAGES, shader_handles);
+
+        cmd_buf.setVertexInputEXT(vertex_bindings, vertex_attributes);
+        cmd_buf.setRasterizerDiscardEnable(false);
+        cmd_buf.setPolygonModeEXT(vk::PolygonMode::eFill);
+        cmd_buf.setDepthBiasEnable(false);
+        cmd_buf.setStencilTestEnable(false);
+
+        vk::SampleMask sample_mask = UINT32_MAX;
+        cmd_buf.setRasterizationSamplesEXT(vk::SampleCountFlagBits::e1);
+        cmd_buf.setSampleMaskEXT(vk::SampleCountFlagBits::e1, sample_mask);
+        cmd_buf.setAlphaToCoverageEnableEXT(false);
+
+        state_tracker.invalidate();
+        state_tracker.apply(cmd_buf, state);
+    }
+
+    /// @brief Changes render state between draws of the bound shaders
+    void setState(const vk::raii::CommandBuffer& cmd_buf,
+                  const RenderState& state) {
+        state_tracker.apply(cmd_buf, state);
+    }
+
+   private:
+    static constexpr std::array<vk::ShaderStageFlagBits, 2> SHADER_STAGES = {
+        vk::ShaderStageFlagBits::eVertex, vk::ShaderStageFlagBits::eFragment};
+
+    GraphicsPipelineDesc desc;
+    DynamicStateTracker state_tracker;
+
+    std::vector<vk::raii::ShaderEXT> shaders;
+    std::vector<vk::ShaderEXT> shader_handles;
+    std::vector<vk::VertexInputBindingDescription2EXT> vertex_bindings;
+    std::vector<vk::VertexInputAttributeDescription2EXT> vertex_attributes;
+};
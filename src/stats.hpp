@@ -0,0 +1,498 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define HAS_UNIX_SOCKETS 1
+#endif
+
+/// @brief Monotonic event counts
+enum class Counter : uint32_t {
+    Frames,
+    QueueSubmits,
+    SwapchainRebuilds,
+    DeviceAllocations,
+    DeviceAllocationBytes,
+    DeviceLosses,
+    IdleWaits,
+    PipelineCacheHits,
+    PipelineCacheMisses,
+    COUNT
+};
+
+/// @brief Distributions of durations in milliseconds, GPU times per pass
+enum class Histogram : uint32_t {
+    FrameTime,
+    GpuFrameTime,
+    GpuCullTime,
+    GpuSceneTime,
+    GpuEffectTime,
+    GpuOverlayTime,
+    COUNT
+};
+
+/// @brief Last published values, set by whoever owns the measured object
+enum class Gauge : uint32_t {
+    SwapchainImages,
+    DescriptorSetCacheHits,
+    DescriptorSetCacheMisses,
+    TessellationCacheHits,
+    TessellationCacheMisses,
+    GlyphAtlasEvictions,
+    DriverHostBytes,
+    COUNT
+};
+
+/// @brief Process-wide runtime statistics.
+///
+/// Every thread writes counters and histograms into a block of its own, so
+/// recording is a relaxed atomic add with no contention. Blocks are linked
+/// into a lock-free list when a thread first records and handed to later
+/// threads once their owner exits, so short-lived workers do not grow the
+/// list. Readers sum all blocks, racing with writers only by a few events.
+class StatsRegistry {
+   public:
+    // Upper bounds of the histogram buckets, the last bucket takes the rest
+    static constexpr std::array<double, 11> BUCKET_BOUNDS_MS = {
+        1.0, 2.0, 4.0, 8.0, 12.0, 16.7, 20.0, 25.0, 33.4, 50.0, 100.0};
+    static constexpr size_t BUCKET_COUNT = BUCKET_BOUNDS_MS.size() + 1;
+
+    struct HistogramSnapshot {
+        std::array<uint64_t, BUCKET_COUNT> buckets{};
+        uint64_t count = 0;
+        double sum_ms = 0.0;
+    };
+
+    static StatsRegistry& global() {
+        static StatsRegistry registry{};
+        return registry;
+    }
+
+    StatsRegistry() = default;
+    StatsRegistry(const StatsRegistry&) = delete;
+    StatsRegistry& operator=(const StatsRegistry&) = delete;
+
+    ~StatsRegistry() {
+        auto* block = head.load(std::memory_order_acquire);
+        while (block != nullptr) {
+            auto* next = block->next;
+            delete block;
+            block = next;
+        }
+    }
+
+    void add(Counter counter, uint64_t amount = 1) {
+        local().counters[index(counter)].fetch_add(amount,
+                                                   std::memory_order_relaxed);
+    }
+
+    void record(Histogram histogram, double ms) {
+        auto& block = local();
+        size_t bucket = 0;
+        while (bucket < BUCKET_BOUNDS_MS.size() &&
+               ms > BUCKET_BOUNDS_MS[bucket]) {
+            bucket++;
+        }
+        block.buckets[index(histogram)][bucket].fetch_add(
+            1, std::memory_order_relaxed);
+        block.sums_us[index(histogram)].fetch_add(
+            static_cast<uint64_t>(ms * 1000.0), std::memory_order_relaxed);
+    }
+
+    void set(Gauge gauge, uint64_t value) {
+        gauges[index(gauge)].store(value, std::memory_order_relaxed);
+    }
+
+    uint64_t total(Counter counter) const {
+        uint64_t sum = 0;
+        forEachBlock([&](const Block& block) {
+            sum += block.counters[index(counter)].load(
+                std::memory_order_relaxed);
+        });
+        return sum;
+    }
+
+    HistogramSnapshot snapshot(Histogram histogram) const {
+        HistogramSnapshot result{};
+        uint64_t sum_us = 0;
+        forEachBlock([&](const Block& block) {
+            for (size_t i = 0; i < BUCKET_COUNT; i++) {
+                auto n = block.buckets[index(histogram)][i].load(
+                    std::memory_order_relaxed);
+                result.buckets[i] += n;
+                result.count += n;
+            }
+            sum_us +=
+                block.sums_us[index(histogram)].load(std::memory_order_relaxed);
+        });
+        result.sum_ms = sum_us / 1000.0;
+        return result;
+    }
+
+    uint64_t value(Gauge gauge) const {
+        return gauges[index(gauge)].load(std::memory_order_relaxed);
+    }
+
+    /// @brief Everything as one JSON object
+    std::string json() const {
+        std::string out = "{\"counters\":{";
+        for (uint32_t i = 0; i < index(Counter::COUNT); i++) {
+            auto counter = static_cast<Counter>(i);
+            out += (i > 0 ? ",\"" : "\"") + std::string(name(counter)) +
+                   "\":" + std::to_string(total(counter));
+        }
+
+        out += "},\"gauges\":{";
+        for (uint32_t i = 0; i < index(Gauge::COUNT); i++) {
+            auto gauge = static_cast<Gauge>(i);
+            out += (i > 0 ? ",\"" : "\"") + std::string(name(gauge)) +
+                   "\":" + std::to_string(value(gauge));
+        }
+
+        out += "},\"cache_hit_rates\":{\"descriptor_set_cache\":" +
+               formatRate(value(Gauge::DescriptorSetCacheHits),
+                          value(Gauge::DescriptorSetCacheMisses)) +
+               ",\"tessellation_cache\":" +
+               formatRate(value(Gauge::TessellationCacheHits),
+                          value(Gauge::TessellationCacheMisses)) +
+               ",\"pipeline_cache\":" +
+               formatRate(total(Counter::PipelineCacheHits),
+                          total(Counter::PipelineCacheMisses));
+
+        out += "},\"histograms\":{";
+        for (uint32_t i = 0; i < index(Histogram::COUNT); i++) {
+            auto histogram = static_cast<Histogram>(i);
+            auto snap = snapshot(histogram);
+            out += (i > 0 ? ",\"" : "\"") + std::string(name(histogram)) +
+                   "\":{\"count\":" + std::to_string(snap.count) +
+                   ",\"sum_ms\":" + formatDouble(snap.sum_ms) +
+                   ",\"buckets\":[";
+            for (size_t b = 0; b < BUCKET_COUNT; b++) {
+                out += (b > 0 ? ",{\"le\":" : "{\"le\":") +
+                       (b < BUCKET_BOUNDS_MS.size()
+                            ? formatDouble(BUCKET_BOUNDS_MS[b])
+                            : std::string("null")) +
+                       ",\"count\":" + std::to_string(snap.buckets[b]) + "}";
+            }
+            out += "]}";
+        }
+        out += "}}\n";
+        return out;
+    }
+
+    /// @brief Everything in the Prometheus text exposition format
+    std::string prometheus() const {
+        std::string out{};
+        for (uint32_t i = 0; i < index(Counter::COUNT); i++) {
+            auto counter = static_cast<Counter>(i);
+            auto metric = "vklab_" + std::string(name(counter)) + "_total";
+            out += "# TYPE " + metric + " counter\n" + metric + " " +
+                   std::to_string(total(counter)) + "\n";
+        }
+
+        for (uint32_t i = 0; i < index(Gauge::COUNT); i++) {
+            auto gauge = static_cast<Gauge>(i);
+            auto metric = "vklab_" + std::string(name(gauge));
+            out += "# TYPE " + metric + " gauge\n" + metric + " " +
+                   std::to_string(value(gauge)) + "\n";
+        }
+
+        for (uint32_t i = 0; i < index(Histogram::COUNT); i++) {
+            auto histogram = static_cast<Histogram>(i);
+            auto snap = snapshot(histogram);
+            auto metric = "vklab_" + std::string(name(histogram)) + "_ms";
+            out += "# TYPE " + metric + " histogram\n";
+
+            uint64_t cumulative = 0;
+            for (size_t b = 0; b < BUCKET_COUNT; b++) {
+                cumulative += snap.buckets[b];
+                out += metric + "_bucket{le=\"" +
+                       (b < BUCKET_BOUNDS_MS.size()
+                            ? formatDouble(BUCKET_BOUNDS_MS[b])
+                            : std::string("+Inf")) +
+                       "\"} " + std::to_string(cumulative) + "\n";
+            }
+            out += metric + "_sum " + formatDouble(snap.sum_ms) + "\n" +
+                   metric + "_count " + std::to_string(snap.count) + "\n";
+        }
+        return out;
+    }
+
+   private:
+    struct Block {
+        std::array<std::atomic<uint64_t>, static_cast<size_t>(Counter::COUNT)>
+            counters{};
+        std::array<std::array<std::atomic<uint64_t>, BUCKET_COUNT>,
+                   static_cast<size_t>(Histogram::COUNT)>
+            buckets{};
+        std::array<std::atomic<uint64_t>,
+                   static_cast<size_t>(Histogram::COUNT)>
+            sums_us{};
+        std::atomic<bool> owned{true};
+        Block* next = nullptr;
+    };
+
+    /// @brief Gives the calling thread's block back when the thread exits
+    struct ThreadSlot {
+        Block* block = nullptr;
+
+        ~ThreadSlot() {
+            if (block != nullptr) {
+                block->owned.store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    std::atomic<Block*> head{nullptr};
+    std::array<std::atomic<uint64_t>, static_cast<size_t>(Gauge::COUNT)>
+        gauges{};
+
+    template <typename E>
+    static constexpr size_t index(E value) {
+        return static_cast<size_t>(value);
+    }
+
+    Block& local() {
+        // One registry per process in practice, blocks of others are claimed
+        // anew
+        thread_local ThreadSlot slot{};
+        thread_local const StatsRegistry* owner = nullptr;
+        if (slot.block == nullptr || owner != this) {
+            slot.block = claim();
+            owner = this;
+        }
+        return *slot.block;
+    }
+
+    Block* claim() {
+        for (auto* block = head.load(std::memory_order_acquire);
+             block != nullptr; block = block->next) {
+            bool owned = false;
+            if (block->owned.compare_exchange_strong(
+                    owned, true, std::memory_order_acquire)) {
+                return block;
+            }
+        }
+
+        auto* block = new Block();
+        block->next = head.load(std::memory_order_relaxed);
+        while (!head.compare_exchange_weak(block->next, block,
+                                           std::memory_order_release,
+                                           std::memory_order_relaxed)) {
+        }
+        return block;
+    }
+
+    template <typename F>
+    void forEachBlock(F&& visit) const {
+        for (auto* block = head.load(std::memory_order_acquire);
+             block != nullptr; block = block->next) {
+            visit(*block);
+        }
+    }
+
+    static std::string formatRate(uint64_t hits, uint64_t misses) {
+        if (hits + misses == 0) {
+            return "null";
+        }
+        return formatDouble(static_cast<double>(hits) / (hits + misses));
+    }
+
+    static std::string formatDouble(double value) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.6g", value);
+        return text;
+    }
+
+    static const char* name(Counter counter) {
+        switch (counter) {
+            case Counter::Frames: return "frames";
+            case Counter::QueueSubmits: return "queue_submits";
+            case Counter::SwapchainRebuilds: return "swapchain_rebuilds";
+            case Counter::DeviceAllocations: return "device_allocations";
+            case Counter::DeviceAllocationBytes:
+                return "device_allocation_bytes";
+            case Counter::DeviceLosses: return "device_losses";
+            case Counter::IdleWaits: return "idle_waits";
+            case Counter::PipelineCacheHits: return "pipeline_cache_hits";
+            case Counter::PipelineCacheMisses: return "pipeline_cache_misses";
+            default: return "unknown";
+        }
+    }
+
+    static const char* name(Gauge gauge) {
+        switch (gauge) {
+            case Gauge::SwapchainImages: return "swapchain_images";
+            case Gauge::DescriptorSetCacheHits:
+                return "descriptor_set_cache_hits";
+            case Gauge::DescriptorSetCacheMisses:
+                return "descriptor_set_cache_misses";
+            case Gauge::TessellationCacheHits:
+                return "tessellation_cache_hits";
+            case Gauge::TessellationCacheMisses:
+                return "tessellation_cache_misses";
+            case Gauge::GlyphAtlasEvictions: return "glyph_atlas_evictions";
+            case Gauge::DriverHostBytes: return "driver_host_bytes";
+            default: return "unknown";
+        }
+    }
+
+    static const char* name(Histogram histogram) {
+        switch (histogram) {
+            case Histogram::FrameTime: return "frame_time";
+            case Histogram::GpuFrameTime: return "gpu_frame_time";
+            case Histogram::GpuCullTime: return "gpu_cull_time";
+            case Histogram::GpuSceneTime: return "gpu_scene_time";
+            case Histogram::GpuEffectTime: return "gpu_effect_time";
+            case Histogram::GpuOverlayTime: return "gpu_overlay_time";
+            default: return "unknown";
+        }
+    }
+};
+
+/// @brief Thread answering statistics requests on a Unix domain socket.
+///
+/// Each connection sends one request and gets one reply before the socket
+/// is closed. "prometheus" or an HTTP GET of /metrics is answered in the
+/// Prometheus text format, anything else in JSON. HTTP requests get an HTTP
+/// reply, so that `curl --unix-socket` works as a scraper.
+class StatsServer {
+   public:
+    StatsServer(const StatsRegistry& registry, std::string socket_path)
+        : registry(registry), path(std::move(socket_path)) {
+#ifdef HAS_UNIX_SOCKETS
+        sockaddr_un address{};
+        if (path.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error("stats socket path too long: " + path);
+        }
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+        listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listen_fd < 0) {
+            throw std::runtime_error("failed to create stats socket");
+        }
+
+        // A socket file left by an earlier run would make bind fail
+        unlink(path.c_str());
+        if (bind(listen_fd, reinterpret_cast<sockaddr*>(&address),
+                 sizeof(address)) != 0 ||
+            listen(listen_fd, BACKLOG) != 0) {
+            int error = errno;
+            close(listen_fd);
+            throw std::runtime_error("failed to listen on " + path + ": " +
+                                     std::strerror(error));
+        }
+
+        worker = std::thread([this]() { serve(); });
+#else
+        throw std::runtime_error(
+            "stats socket requires Unix domain sockets, unavailable here");
+#endif
+    }
+
+    StatsServer(const StatsServer&) = delete;
+    StatsServer& operator=(const StatsServer&) = delete;
+
+    ~StatsServer() {
+#ifdef HAS_UNIX_SOCKETS
+        stopping.store(true);
+        if (worker.joinable()) {
+            worker.join();
+        }
+        close(listen_fd);
+        unlink(path.c_str());
+#endif
+    }
+
+   private:
+    static constexpr int BACKLOG = 8;
+    // How often the worker checks for shutdown, and how long a client may
+    // take to send its request
+    static constexpr int POLL_TIMEOUT_MS = 100;
+    static constexpr size_t MAX_REQUEST = 1024;
+
+    const StatsRegistry& registry;
+    std::string path;
+    int listen_fd = -1;
+    std::atomic<bool> stopping{false};
+    std::thread worker;
+
+#ifdef HAS_UNIX_SOCKETS
+    void serve() {
+        while (!stopping.load()) {
+            pollfd listener{listen_fd, POLLIN, 0};
+            if (poll(&listener, 1, POLL_TIMEOUT_MS) <= 0) {
+                continue;
+            }
+
+            int client = accept(listen_fd, nullptr, nullptr);
+            if (client < 0) {
+                continue;
+            }
+            answer(client);
+            close(client);
+        }
+    }
+
+    void answer(int client) {
+        std::string request{};
+        char chunk[256];
+        while (request.size() < MAX_REQUEST &&
+               request.find('\n') == std::string::npos) {
+            pollfd readable{client, POLLIN, 0};
+            if (poll(&readable, 1, POLL_TIMEOUT_MS) <= 0) {
+                break;
+            }
+            auto received = recv(client, chunk, sizeof(chunk), 0);
+            if (received <= 0) {
+                break;
+            }
+            request.append(chunk, static_cast<size_t>(received));
+        }
+
+        bool http = request.rfind("GET ", 0) == 0;
+        bool prometheus = http ? request.rfind("GET /metrics", 0) == 0
+                               : request.rfind("prometheus", 0) == 0;
+
+        auto body = prometheus ? registry.prometheus() : registry.json();
+        std::string reply{};
+        if (http) {
+            reply = std::string("HTTP/1.0 200 OK\r\nContent-Type: ") +
+                    (prometheus ? "text/plain; version=0.0.4"
+                                : "application/json") +
+                    "\r\nContent-Length: " + std::to_string(body.size()) +
+                    "\r\nConnection: close\r\n\r\n";
+        }
+        reply += body;
+
+        size_t sent = 0;
+        while (sent < reply.size()) {
+            auto written = send(client, reply.data() + sent,
+                                reply.size() - sent, MSG_NOSIGNAL_FLAG);
+            if (written <= 0) {
+                break;
+            }
+            sent += static_cast<size_t>(written);
+        }
+    }
+
+#ifdef MSG_NOSIGNAL
+    static constexpr int MSG_NOSIGNAL_FLAG = MSG_NOSIGNAL;
+#else
+    static constexpr int MSG_NOSIGNAL_FLAG = 0;
+#endif
+#endif
+};
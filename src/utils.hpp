@@ -1,5 +1,9 @@
 #pragma once
+#include <chrono>
 #include <fstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
 
 struct Vertex {
     glm::vec2 pos;
@@ -24,6 +28,21 @@ struct Vertex {
     }
 };
 
+/// @brief Per-frame shader inputs, bound at set 0, binding 0 (std140)
+struct FrameUniforms {
+    glm::vec2 resolution;
+    float time;
+    uint32_t frame;
+    // 2D view of the culled scene: ndc = (world - center) * zoom
+    glm::vec2 camera_center;
+    float camera_zoom;
+    float padding;
+};
+
+// Must match FrameUniforms of scene.wgsl, which the build compiles
+static_assert(offsetof(FrameUniforms, camera_center) == 16);
+static_assert(sizeof(FrameUniforms) == 32);
+
 struct SurfaceInfo {
     // vk::SurfaceCapabilitiesKHR capabilities;
     vk::Format color_format;
@@ -32,6 +51,7 @@ struct SurfaceInfo {
     vk::Extent2D extent;
     uint32_t min_image_cnt;
     uint32_t max_image_cnt;
+    vk::ImageUsageFlags supported_usage;
 
     static SurfaceInfo from(vk::raii::PhysicalDevice &device,
                             vk::raii::SurfaceKHR &surface) {
@@ -60,7 +80,8 @@ struct SurfaceInfo {
                 selected_mode,
                 capabilities.currentExtent,
                 capabilities.minImageCount,
-                capabilities.maxImageCount};
+                capabilities.maxImageCount,
+                capabilities.supportedUsageFlags};
     }
 };
 
@@ -152,6 +173,9 @@ VKAPI_ATTR VkBool32 VKAPI_CALL debugUtilsMessengerCallback(
 
 std::vector<char> loadShaderBytes(const std::string &path) {
     std::ifstream shader_file(path, std::ios::binary);
+    if (!shader_file.is_open()) {
+        throw std::runtime_error("failed to open shader " + path);
+    }
 
     shader_file.seekg(0, std::ios_base::end);
     std::size_t const shader_file_size = shader_file.tellg();
@@ -175,4 +199,142 @@ uint32_t findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties,
     }
 
     throw std::runtime_error("failed to find suitable memory type!");
-}
\ No newline at end of file
+}
+
+/// @brief Gathers device extensions of the driver and of the given layers,
+/// which may implement device extensions themselves
+std::unordered_set<std::string> getDeviceExtensionSet(
+    vk::raii::PhysicalDevice &device,
+    const std::vector<const char *> &layers = {}) {
+    std::unordered_set<std::string> extension_set{};
+    for (auto ext : device.enumerateDeviceExtensionProperties()) {
+        std::string extname{static_cast<const char *>(ext.extensionName)};
+        extension_set.insert(extname);
+    }
+    for (auto layer : layers) {
+        for (auto ext : device.enumerateDeviceExtensionProperties(
+                 std::string(layer))) {
+            std::string extname{static_cast<const char *>(ext.extensionName)};
+            extension_set.insert(extname);
+        }
+    }
+    return extension_set;
+}
+
+bool hasExtensions(const std::unordered_set<std::string> &extension_set,
+                   const std::vector<const char *> &extensions) {
+    for (auto ext : extensions) {
+        if (extension_set.count(ext) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// @brief Buffer bound to a dedicated memory allocation, host-visible memory
+/// stays mapped for the lifetime of the buffer
+struct AllocatedBuffer {
+    vk::raii::Buffer buffer;
+    vk::raii::DeviceMemory memory;
+    vk::DeviceSize size;
+    void *mapped = nullptr;
+
+    AllocatedBuffer(vk::raii::PhysicalDevice &phys_dev,
+                    vk::raii::Device &device, vk::DeviceSize buffer_size,
+                    vk::BufferUsageFlags usage,
+                    vk::MemoryPropertyFlags properties)
+        : buffer(device.createBuffer(
+              vk::BufferCreateInfo({}, buffer_size, usage,
+                                   vk::SharingMode::eExclusive),
+              hostCallbacks())),
+          memory(nullptr),
+          size(buffer_size) {
+        auto mem_req = buffer.getMemoryRequirements();
+
+        vk::MemoryAllocateInfo alloc_info(
+            mem_req.size,
+            findMemoryType(mem_req.memoryTypeBits, properties,
+                           phys_dev.getMemoryProperties()));
+
+        vk::MemoryAllocateFlagsInfo flags_info(
+            vk::MemoryAllocateFlagBits::eDeviceAddress);
+        if (usage & vk::BufferUsageFlagBits::eShaderDeviceAddress) {
+            alloc_info.setPNext(&flags_info);
+        }
+
+        memory = device.allocateMemory(alloc_info, hostCallbacks());
+        buffer.bindMemory(*memory, 0);
+        StatsRegistry::global().add(Counter::DeviceAllocations);
+        StatsRegistry::global().add(Counter::DeviceAllocationBytes,
+                                    mem_req.size);
+
+        if (properties & vk::MemoryPropertyFlagBits::eHostVisible) {
+            mapped = memory.mapMemory(0, size);
+        }
+    }
+
+    vk::DeviceAddress address(vk::raii::Device &device) const {
+        return device.getBufferAddress(vk::BufferDeviceAddressInfo(*buffer));
+    }
+};
+
+/// @brief Image bound to a dedicated memory allocation
+struct AllocatedImage {
+    vk::raii::Image image;
+    vk::raii::DeviceMemory memory;
+    vk::Format format;
+    vk::Extent2D extent;
+    uint32_t mip_levels;
+    uint32_t layers;
+
+    AllocatedImage(vk::raii::PhysicalDevice &phys_dev,
+                   vk::raii::Device &device,
+                   const vk::ImageCreateInfo &image_info,
+                   vk::MemoryPropertyFlags properties =
+                       vk::MemoryPropertyFlagBits::eDeviceLocal)
+        : image(device.createImage(image_info, hostCallbacks())),
+          memory(nullptr),
+          format(image_info.format),
+          extent(image_info.extent.width, image_info.extent.height),
+          mip_levels(image_info.mipLevels),
+          layers(image_info.arrayLayers) {
+        auto mem_req = image.getMemoryRequirements();
+
+        vk::MemoryAllocateInfo alloc_info(
+            mem_req.size,
+            findMemoryType(mem_req.memoryTypeBits, properties,
+                           phys_dev.getMemoryProperties()));
+
+        memory = device.allocateMemory(alloc_info, hostCallbacks());
+        image.bindMemory(*memory, 0);
+        StatsRegistry::global().add(Counter::DeviceAllocations);
+        StatsRegistry::global().add(Counter::DeviceAllocationBytes,
+                                    mem_req.size);
+    }
+
+    /// @brief Creates a 2D image info with a single layer and mip level
+    static vk::ImageCreateInfo info2D(vk::Format format, vk::Extent2D extent,
+                                      vk::ImageUsageFlags usage,
+                                      uint32_t mip_levels = 1) {
+        return vk::ImageCreateInfo(
+            {}, vk::ImageType::e2D, format, {extent.width, extent.height, 1},
+            mip_levels, 1, vk::SampleCountFlagBits::e1,
+            vk::ImageTiling::eOptimal, usage, vk::SharingMode::eExclusive);
+    }
+
+    vk::raii::ImageView createView(
+        vk::raii::Device &device, vk::ImageAspectFlags aspect,
+        uint32_t base_mip = 0, uint32_t mip_count = VK_REMAINING_MIP_LEVELS,
+        vk::ImageViewType view_type = vk::ImageViewType::e2D) const {
+        vk::ImageViewCreateInfo view_info({}, *image, view_type, format);
+        view_info.setSubresourceRange(vk::ImageSubresourceRange(
+            aspect, base_mip, mip_count, 0, VK_REMAINING_ARRAY_LAYERS));
+        return device.createImageView(view_info, hostCallbacks());
+    }
+};
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
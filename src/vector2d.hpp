@@ -0,0 +1,619 @@
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <future>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/// @brief Polyline approximating one contour of a `Path`
+struct Contour {
+    std::vector<glm::vec2> points;
+    bool closed = false;
+};
+
+/// @brief Outline made of lines and quadratic curves, in pixels
+class Path {
+   public:
+    Path& moveTo(glm::vec2 point) {
+        verbs.push_back(Verb::Move);
+        points.push_back(point);
+        return *this;
+    }
+
+    Path& lineTo(glm::vec2 point) {
+        verbs.push_back(Verb::Line);
+        points.push_back(point);
+        return *this;
+    }
+
+    Path& quadTo(glm::vec2 control, glm::vec2 point) {
+        verbs.push_back(Verb::Quad);
+        points.push_back(control);
+        points.push_back(point);
+        return *this;
+    }
+
+    Path& close() {
+        verbs.push_back(Verb::Close);
+        return *this;
+    }
+
+    bool empty() const { return verbs.empty(); }
+
+    /// @brief FNV-1a hash of the outline, equal outlines hash equally
+    uint64_t hash() const {
+        uint64_t value = 0xcbf29ce484222325ULL;
+        auto mix = [&](const void* data, size_t size) {
+            auto bytes = static_cast<const uint8_t*>(data);
+            for (size_t i = 0; i < size; i++) {
+                value = (value ^ bytes[i]) * 0x100000001b3ULL;
+            }
+        };
+        mix(verbs.data(), verbs.size() * sizeof(Verb));
+        mix(points.data(), points.size() * sizeof(glm::vec2));
+        return value;
+    }
+
+    /// @brief Contours with curves split into lines no further than
+    /// `tolerance` pixels from the curve
+    std::vector<Contour> flatten(float tolerance) const {
+        std::vector<Contour> contours{};
+        glm::vec2 pen{};
+        size_t point_idx = 0;
+
+        auto current = [&]() -> Contour& {
+            if (contours.empty() || contours.back().closed) {
+                contours.push_back({{pen}, false});
+            }
+            return contours.back();
+        };
+
+        for (auto verb : verbs) {
+            switch (verb) {
+                case Verb::Move:
+                    pen = points[point_idx++];
+                    contours.push_back({{pen}, false});
+                    break;
+                case Verb::Line:
+                    pen = points[point_idx++];
+                    current().points.push_back(pen);
+                    break;
+                case Verb::Quad: {
+                    auto control = points[point_idx++];
+                    auto end = points[point_idx++];
+                    auto& contour = current();
+
+                    // Chord error of n uniform steps is |p0 - 2c + p1| / 4n²
+                    float deviation = glm::length(pen - 2.0f * control + end);
+                    auto steps = static_cast<uint32_t>(std::clamp(
+                        std::ceil(std::sqrt(deviation / (4.0f * tolerance))),
+                        1.0f, 64.0f));
+                    for (uint32_t i = 1; i <= steps; i++) {
+                        float t = static_cast<float>(i) / steps;
+                        float s = 1.0f - t;
+                        contour.points.push_back(s * s * pen +
+                                                 2.0f * s * t * control +
+                                                 t * t * end);
+                    }
+                    pen = end;
+                    break;
+                }
+                case Verb::Close:
+                    if (!contours.empty() && !contours.back().closed) {
+                        contours.back().closed = true;
+                        pen = contours.back().points.front();
+                    }
+                    break;
+            }
+        }
+
+        return contours;
+    }
+
+   private:
+    enum class Verb : uint8_t { Move, Line, Quad, Close };
+
+    std::vector<Verb> verbs;
+    std::vector<glm::vec2> points;
+};
+
+/// @brief Triangle list covering the inside of every closed contour.
+///
+/// Contours are ear-clipped one by one and do not cut holes into each other;
+/// self-intersecting contours come out partially covered.
+std::vector<glm::vec2> tessellateFill(const std::vector<Contour>& contours) {
+    std::vector<glm::vec2> triangles{};
+
+    auto cross = [](glm::vec2 a, glm::vec2 b, glm::vec2 c) {
+        return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    };
+
+    for (auto& contour : contours) {
+        auto polygon = contour.points;
+        if (polygon.size() > 1 &&
+            glm::length(polygon.front() - polygon.back()) < 1e-6f) {
+            polygon.pop_back();
+        }
+        if (polygon.size() < 3) {
+            continue;
+        }
+
+        float area = 0.0f;
+        for (size_t i = 0; i < polygon.size(); i++) {
+            auto& a = polygon[i];
+            auto& b = polygon[(i + 1) % polygon.size()];
+            area += a.x * b.y - b.x * a.y;
+        }
+        float winding = area < 0.0f ? -1.0f : 1.0f;
+
+        std::vector<size_t> remaining(polygon.size());
+        for (size_t i = 0; i < remaining.size(); i++) {
+            remaining[i] = i;
+        }
+
+        size_t misses = 0;
+        size_t i = 0;
+        while (remaining.size() > 3 && misses < remaining.size()) {
+            size_t n = remaining.size();
+            auto& a = polygon[remaining[(i + n - 1) % n]];
+            auto& b = polygon[remaining[i % n]];
+            auto& c = polygon[remaining[(i + 1) % n]];
+
+            bool ear = winding * cross(a, b, c) > 0.0f;
+            for (size_t j = 0; ear && j < n; j++) {
+                auto& p = polygon[remaining[j]];
+                if (&p == &a || &p == &b || &p == &c) {
+                    continue;
+                }
+                ear = !(winding * cross(a, b, p) >= 0.0f &&
+                        winding * cross(b, c, p) >= 0.0f &&
+                        winding * cross(c, a, p) >= 0.0f);
+            }
+
+            if (ear) {
+                triangles.insert(triangles.end(), {a, b, c});
+                remaining.erase(remaining.begin() + i % n);
+                misses = 0;
+            } else {
+                i++;
+                misses++;
+            }
+        }
+
+        // Whatever is left when no ear is found is degenerate, fan it out
+        for (size_t j = 1; j + 1 < remaining.size(); j++) {
+            triangles.insert(triangles.end(), {polygon[remaining[0]],
+                                               polygon[remaining[j]],
+                                               polygon[remaining[j + 1]]});
+        }
+    }
+
+    return triangles;
+}
+
+/// @brief Triangle list of lines `width` pixels wide along every contour,
+/// with bevel joins
+std::vector<glm::vec2> tessellateStroke(const std::vector<Contour>& contours,
+                                        float width) {
+    std::vector<glm::vec2> triangles{};
+    float half_width = 0.5f * width;
+
+    for (auto& contour : contours) {
+        auto& points = contour.points;
+        if (points.size() < 2) {
+            continue;
+        }
+        size_t segment_count =
+            contour.closed ? points.size() : points.size() - 1;
+
+        std::vector<glm::vec2> normals{};
+        std::vector<size_t> starts{};
+        for (size_t i = 0; i < segment_count; i++) {
+            auto a = points[i];
+            auto b = points[(i + 1) % points.size()];
+            float length = glm::length(b - a);
+            if (length < 1e-6f) {
+                continue;
+            }
+
+            auto normal = glm::vec2(a.y - b.y, b.x - a.x) * (half_width / length);
+            triangles.insert(triangles.end(), {a + normal, b + normal,
+                                               b - normal, a + normal,
+                                               b - normal, a - normal});
+            normals.push_back(normal);
+            starts.push_back(i);
+        }
+
+        // Bevels between consecutive segments, over the outer side of the
+        // turn and harmlessly inside the segments on the inner side
+        size_t join_count = contour.closed || normals.empty()
+                                ? normals.size()
+                                : normals.size() - 1;
+        for (size_t i = 0; i < join_count; i++) {
+            size_t next_idx = (i + 1) % normals.size();
+            auto& prev = normals[i];
+            auto& next = normals[next_idx];
+            auto corner = points[starts[next_idx]];
+            triangles.insert(triangles.end(),
+                             {corner, corner + prev, corner + next, corner,
+                              corner - next, corner - prev});
+        }
+    }
+
+    return triangles;
+}
+
+/// @brief Tessellations of recently drawn paths, keyed by outline hash and
+/// stroke width.
+///
+/// Misses are tessellated on worker threads, the caller only blocks once it
+/// needs the triangles. Entries unused for the most frames are dropped when
+/// the cache grows past its capacity.
+class TessellationCache {
+   public:
+    // Maximum distance of flattened curves from the true curve, in pixels
+    static constexpr float TOLERANCE = 0.25f;
+
+    explicit TessellationCache(size_t capacity = 256) : capacity(capacity) {}
+
+    /// @brief Triangles of `path`, filled when `stroke_width` is 0
+    std::shared_future<std::vector<glm::vec2>> request(const Path& path,
+                                                       float stroke_width,
+                                                       uint64_t frame) {
+        uint32_t width_bits;
+        std::memcpy(&width_bits, &stroke_width, sizeof(width_bits));
+        uint64_t key = path.hash() ^ (width_bits * 0x9e3779b97f4a7c15ULL);
+
+        auto found = entries.find(key);
+        if (found != entries.end()) {
+            hits++;
+            found->second.last_used = frame;
+            return found->second.triangles;
+        }
+
+        misses++;
+        auto triangles =
+            std::async(std::launch::async, [path, stroke_width]() {
+                auto contours = path.flatten(TOLERANCE);
+                return stroke_width > 0.0f
+                           ? tessellateStroke(contours, stroke_width)
+                           : tessellateFill(contours);
+            }).share();
+        entries.emplace(key, Entry{triangles, frame});
+        return triangles;
+    }
+
+    /// @brief Drops least recently requested entries beyond the capacity,
+    /// never those requested in `frame`
+    void trim(uint64_t frame) {
+        while (entries.size() > capacity) {
+            auto oldest = std::min_element(
+                entries.begin(), entries.end(), [](auto& a, auto& b) {
+                    return a.second.last_used < b.second.last_used;
+                });
+            if (oldest->second.last_used >= frame) {
+                break;
+            }
+            entries.erase(oldest);
+        }
+    }
+
+    uint64_t hitCount() const { return hits; }
+    uint64_t missCount() const { return misses; }
+
+   private:
+    struct Entry {
+        std::shared_future<std::vector<glm::vec2>> triangles;
+        uint64_t last_used;
+    };
+
+    size_t capacity;
+    std::unordered_map<uint64_t, Entry> entries;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+};
+
+/// @brief Built-in single-stroke font, so that text needs no font files.
+///
+/// Glyphs are polylines on a grid 4 units wide with the cap line at y = 0,
+/// the baseline at y = 6 and descenders reaching y = 7. They are turned
+/// into signed distance fields, which stay sharp when scaled.
+class StrokeFont {
+   public:
+    // Distance field cell of one glyph
+    static constexpr uint32_t UNIT_PIXELS = 6;
+    static constexpr uint32_t PADDING = 7;
+    static constexpr uint32_t CELL_WIDTH = 4 * UNIT_PIXELS + 2 * PADDING;
+    static constexpr uint32_t CELL_HEIGHT = 7 * UNIT_PIXELS + 2 * PADDING;
+    // Distance in pixels over which the field goes from 0.5 to 0 or 1
+    static constexpr float SPREAD = 4.0f;
+    static constexpr float STROKE_HALF_WIDTH = 0.5f;
+    // Pen advance and line height, in units
+    static constexpr float ADVANCE = 5.5f;
+    static constexpr float LINE_HEIGHT = 9.0f;
+    static constexpr float CAP_HEIGHT = 6.0f;
+
+    /// @brief Polylines of `c`, lowercase letters are drawn as capitals and
+    /// unknown characters as a box
+    static std::vector<std::vector<glm::vec2>> strokes(char c) {
+        std::vector<std::vector<glm::vec2>> polylines(1);
+        for (const char* code = outline(c); *code != '\0'; code++) {
+            if (*code == '|') {
+                polylines.emplace_back();
+            } else if (*code != ' ') {
+                polylines.back().emplace_back(code[0] - '0', code[1] - '0');
+                code++;
+            }
+        }
+        return polylines;
+    }
+
+    /// @brief `CELL_WIDTH` x `CELL_HEIGHT` distance field of `c`, inside at
+    /// values over 0.5
+    static std::vector<uint8_t> rasterize(char c) {
+        std::vector<std::pair<glm::vec2, glm::vec2>> segments{};
+        for (auto& polyline : strokes(c)) {
+            for (size_t i = 0; i < polyline.size(); i++) {
+                auto a = glm::vec2(PADDING) +
+                         polyline[i] * static_cast<float>(UNIT_PIXELS);
+                auto b = i + 1 < polyline.size()
+                             ? glm::vec2(PADDING) +
+                                   polyline[i + 1] *
+                                       static_cast<float>(UNIT_PIXELS)
+                             : a;
+                // Single points stay in as dots
+                if (i + 1 < polyline.size() || polyline.size() == 1) {
+                    segments.emplace_back(a, b);
+                }
+            }
+        }
+
+        float half_width = STROKE_HALF_WIDTH * UNIT_PIXELS;
+        std::vector<uint8_t> field(CELL_WIDTH * CELL_HEIGHT);
+        for (uint32_t y = 0; y < CELL_HEIGHT; y++) {
+            for (uint32_t x = 0; x < CELL_WIDTH; x++) {
+                glm::vec2 p(x + 0.5f, y + 0.5f);
+                float nearest = SPREAD + half_width;
+                for (auto& [a, b] : segments) {
+                    auto ab = b - a;
+                    float len_sq = glm::dot(ab, ab);
+                    float t = len_sq > 0.0f
+                                  ? std::clamp(glm::dot(p - a, ab) / len_sq,
+                                               0.0f, 1.0f)
+                                  : 0.0f;
+                    nearest = std::min(nearest, glm::length(p - a - ab * t));
+                }
+
+                float distance = nearest - half_width;
+                float value =
+                    std::clamp(0.5f - 0.5f * distance / SPREAD, 0.0f, 1.0f);
+                field[y * CELL_WIDTH + x] =
+                    static_cast<uint8_t>(std::lround(value * 255.0f));
+            }
+        }
+        return field;
+    }
+
+   private:
+    /// @brief Polylines as digit pairs "xy", separated by '|'
+    static const char* outline(char c) {
+        switch (std::toupper(static_cast<unsigned char>(c))) {
+            case ' ': return "";
+            case 'A': return "06 02 20 42 46|04 44";
+            case 'B': return "00 30 41 42 33 03|33 44 45 36 06 00";
+            case 'C': return "40 10 01 05 16 46";
+            case 'D': return "00 30 41 45 36 06 00";
+            case 'E': return "40 00 06 46|03 33";
+            case 'F': return "40 00 06|03 33";
+            case 'G': return "40 10 01 05 16 36 45 43 23";
+            case 'H': return "00 06|40 46|03 43";
+            case 'I': return "10 30|20 26|16 36";
+            case 'J': return "40 45 36 16 05";
+            case 'K': return "00 06|40 03 46";
+            case 'L': return "00 06 46";
+            case 'M': return "06 00 23 40 46";
+            case 'N': return "06 00 46 40";
+            case 'O': return "10 30 41 45 36 16 05 01 10";
+            case 'P': return "06 00 30 41 42 33 03";
+            case 'Q': return "10 30 41 45 36 16 05 01 10|24 46";
+            case 'R': return "06 00 30 41 42 33 03|23 46";
+            case 'S': return "40 10 01 02 13 33 44 45 36 06";
+            case 'T': return "00 40|20 26";
+            case 'U': return "00 05 16 36 45 40";
+            case 'V': return "00 26 40";
+            case 'W': return "00 16 23 36 40";
+            case 'X': return "00 46|40 06";
+            case 'Y': return "00 23 40|23 26";
+            case 'Z': return "00 40 06 46";
+            case '0': return "10 30 41 45 36 16 05 01 10|41 05";
+            case '1': return "11 20 26|16 36";
+            case '2': return "01 10 30 41 42 06 46";
+            case '3': return "01 10 30 41 42 33 13|33 44 45 36 16 05";
+            case '4': return "36 30 03 43";
+            case '5': return "40 00 02 32 43 45 36 06";
+            case '6': return "30 10 01 05 16 36 45 44 33 03";
+            case '7': return "00 40 26";
+            case '8': return "10 30 41 42 33 13 02 01 10|13 04 05 16 36 45 44 33";
+            case '9': return "43 13 02 01 10 30 41 45 36 16";
+            case '.': return "26";
+            case ',': return "25 17";
+            case ':': return "22|25";
+            case ';': return "22|25 17";
+            case '-': return "03 43";
+            case '+': return "03 43|21 25";
+            case '=': return "02 42|04 44";
+            case '/': return "06 40";
+            case '\\': return "00 46";
+            case '(': return "30 21 25 36";
+            case ')': return "10 21 25 16";
+            case '[': return "30 10 16 36";
+            case ']': return "10 30 36 16";
+            case '%': return "00|46|40 06";
+            case '!': return "20 24|26";
+            case '?': return "01 10 30 41 42 23 24|26";
+            case '_': return "07 47";
+            case '\'': return "20 21";
+            case '"': return "10 11|30 31";
+            case '#': return "11 15|31 35|02 42|04 44";
+            case '*': return "03 43|11 35|31 15";
+            case '<': return "41 03 45";
+            case '>': return "01 43 05";
+            case '|': return "20 27";
+            case '^': return "12 20 32";
+            default: return "00 40 46 06 00";
+        }
+    }
+};
+
+/// @brief Area of a `GlyphAtlas`, in texels
+struct AtlasRegion {
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+};
+
+/// @brief Single-channel texture atlas packed in shelves.
+///
+/// Entries are placed left to right on horizontal shelves. When no shelf
+/// fits a new entry, the shelf used least recently, not in the current frame,
+/// is emptied for it. The CPU copy of the texels is kept, regions written
+/// since the last upload are reported by `takeDirty`.
+class GlyphAtlas {
+   public:
+    // Fully inside texels reserved at the origin, for untextured quads
+    static constexpr uint32_t SOLID_SIZE = 4;
+
+    GlyphAtlas(uint32_t width, uint32_t height)
+        : atlas_width(width),
+          atlas_height(height),
+          texels(size_t{width} * height, 0),
+          next_shelf_y(SOLID_SIZE) {
+        for (uint32_t y = 0; y < SOLID_SIZE; y++) {
+            std::memset(&texels[size_t{y} * width], 0xff, SOLID_SIZE);
+        }
+        dirty.push_back({0, 0, width, height});
+    }
+
+    uint32_t width() const { return atlas_width; }
+    uint32_t height() const { return atlas_height; }
+    const uint8_t* data() const { return texels.data(); }
+
+    AtlasRegion solid() const { return {1, 1, 2, 2}; }
+
+    /// @brief Region of `key`, marked as used in `frame`
+    std::optional<AtlasRegion> find(uint32_t key, uint64_t frame) {
+        auto found = entries.find(key);
+        if (found == entries.end()) {
+            return std::nullopt;
+        }
+        shelves[found->second.shelf].last_used = frame;
+        return found->second.region;
+    }
+
+    /// @brief Stores `width` x `height` texels for `key`, evicting a shelf
+    /// if needed. Fails if nothing can be evicted in `frame`.
+    std::optional<AtlasRegion> insert(uint32_t key, uint32_t width,
+                                      uint32_t height, const uint8_t* data,
+                                      uint64_t frame) {
+        auto shelf = findShelf(width, height, frame);
+        if (!shelf.has_value()) {
+            return std::nullopt;
+        }
+
+        auto& target = shelves[shelf.value()];
+        AtlasRegion region{target.cursor, target.y, width, height};
+        target.cursor += width;
+        target.last_used = frame;
+        target.keys.push_back(key);
+        entries[key] = {region, shelf.value()};
+
+        for (uint32_t row = 0; row < height; row++) {
+            std::memcpy(&texels[size_t{region.y + row} * atlas_width + region.x],
+                        data + size_t{row} * width, width);
+        }
+        dirty.push_back(region);
+        return region;
+    }
+
+    /// @brief Regions written since the last call
+    std::vector<AtlasRegion> takeDirty() { return std::exchange(dirty, {}); }
+
+    uint64_t evictionCount() const { return evictions; }
+
+   private:
+    struct Shelf {
+        uint32_t y;
+        uint32_t height;
+        uint32_t cursor = 0;
+        uint64_t last_used = 0;
+        std::vector<uint32_t> keys{};
+    };
+
+    struct Entry {
+        AtlasRegion region;
+        size_t shelf;
+    };
+
+    uint32_t atlas_width;
+    uint32_t atlas_height;
+    std::vector<uint8_t> texels;
+    std::vector<Shelf> shelves;
+    std::unordered_map<uint32_t, Entry> entries;
+    std::vector<AtlasRegion> dirty;
+    uint32_t next_shelf_y;
+    uint64_t evictions = 0;
+
+    std::optional<size_t> findShelf(uint32_t width, uint32_t height,
+                                    uint64_t frame) {
+        if (width > atlas_width) {
+            return std::nullopt;
+        }
+
+        // Tightest shelf with room left
+        std::optional<size_t> best{};
+        for (size_t i = 0; i < shelves.size(); i++) {
+            auto& shelf = shelves[i];
+            if (shelf.height >= height &&
+                shelf.cursor + width <= atlas_width &&
+                (!best.has_value() ||
+                 shelf.height < shelves[best.value()].height)) {
+                best = i;
+            }
+        }
+        if (best.has_value()) {
+            return best;
+        }
+
+        if (next_shelf_y + height <= atlas_height) {
+            shelves.push_back({next_shelf_y, height});
+            next_shelf_y += height;
+            return shelves.size() - 1;
+        }
+
+        std::optional<size_t> oldest{};
+        for (size_t i = 0; i < shelves.size(); i++) {
+            auto& shelf = shelves[i];
+            if (shelf.height >= height && shelf.last_used < frame &&
+                (!oldest.has_value() ||
+                 shelf.last_used < shelves[oldest.value()].last_used)) {
+                oldest = i;
+            }
+        }
+        if (oldest.has_value()) {
+            auto& shelf = shelves[oldest.value()];
+            for (auto key : shelf.keys) {
+                entries.erase(key);
+            }
+            shelf.keys.clear();
+            shelf.cursor = 0;
+            evictions++;
+        }
+        return oldest;
+    }
+};
@@ -0,0 +1,177 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+/// @brief Push constants of vertex_anim.wgsl
+struct AnimationParams {
+    float time;
+    float wave_amplitude;
+    float wave_frequency;
+    float wave_speed;
+    glm::vec4 weights;
+    uint32_t vertex_count;
+    uint32_t target_count;
+    glm::vec2 padding;
+};
+
+/// @brief Deforms a mesh on the GPU every frame.
+///
+/// A compute pre-pass blends base positions with morph targets and adds a
+/// wave, writing `Vertex` records into one vertex buffer per frame in flight.
+/// A frame slot's buffer is only rewritten once its previous submission has
+/// completed, so the pass never waits on the draws of other frames.
+class VertexAnimator {
+   public:
+    static constexpr uint32_t MAX_MORPH_TARGETS = 4;
+
+    // Wave displacing y by amplitude * sin(frequency * x + speed * time)
+    float wave_amplitude = 0.05f;
+    float wave_frequency = 8.0f;
+    float wave_speed = 3.0f;
+    // Seconds per full blend into the morph targets and back
+    float morph_period = 4.0f;
+
+    /// @brief `targets` hold one position per vertex each
+    VertexAnimator(vk::raii::PhysicalDevice& phys_dev, vk::raii::Device& device,
+                   vk::Optional<const vk::raii::PipelineCache> cache,
+                   DescriptorSetCache& descriptor_cache,
+                   const std::vector<Vertex>& vertices,
+                   const std::vector<std::vector<glm::vec2>>& targets,
+                   uint32_t frame_count)
+        : device(device),
+          descriptors(descriptor_cache),
+          vertex_count(static_cast<uint32_t>(vertices.size())),
+          target_count(static_cast<uint32_t>(targets.size())),
+          base(phys_dev, device, sizeof(Vertex) * vertices.size(),
+               vk::BufferUsageFlagBits::eStorageBuffer,
+               vk::MemoryPropertyFlagBits::eHostVisible |
+                   vk::MemoryPropertyFlagBits::eHostCoherent),
+          deltas(phys_dev, device,
+                 sizeof(glm::vec2) * vertices.size() *
+                     std::max<size_t>(targets.size(), 1),
+                 vk::BufferUsageFlagBits::eStorageBuffer,
+                 vk::MemoryPropertyFlagBits::eHostVisible |
+                     vk::MemoryPropertyFlagBits::eHostCoherent) {
+        if (target_count > MAX_MORPH_TARGETS) {
+            throw std::runtime_error("too many morph targets");
+        }
+
+        std::memcpy(base.mapped, vertices.data(),
+                    sizeof(Vertex) * vertices.size());
+
+        std::vector<glm::vec2> target_deltas{};
+        for (auto& target : targets) {
+            if (target.size() != vertices.size()) {
+                throw std::runtime_error(
+                    "morph target vertex count differs from mesh");
+            }
+            for (size_t i = 0; i < target.size(); i++) {
+                target_deltas.push_back(target[i] - vertices[i].pos);
+            }
+        }
+        std::memcpy(deltas.mapped, target_deltas.data(),
+                    sizeof(glm::vec2) * target_deltas.size());
+
+        for (uint32_t i = 0; i < frame_count; i++) {
+            outputs.emplace_back(phys_dev, device,
+                                 sizeof(Vertex) * vertices.size(),
+                                 vk::BufferUsageFlagBits::eStorageBuffer |
+                                     vk::BufferUsageFlagBits::eVertexBuffer,
+                                 vk::MemoryPropertyFlagBits::eDeviceLocal);
+        }
+
+        createLayouts();
+        animate_pipeline =
+            createComputePipeline(device, cache, "shaders/vertex_anim.spv",
+                                  "animate_main", *animate_layout);
+    }
+
+    VertexAnimator(const VertexAnimator&) = delete;
+    VertexAnimator& operator=(const VertexAnimator&) = delete;
+
+    /// @brief Vertex buffer holding the frame slot's animated vertices
+    vk::Buffer vertexBuffer(uint32_t frame_idx) const {
+        return *outputs[frame_idx].buffer;
+    }
+
+    /// @brief Records the deformation at `time` seconds into the frame
+    /// slot's buffer, outside of any render pass
+    void animate(const vk::raii::CommandBuffer& cmd_buf, uint32_t frame_idx,
+                 float time) {
+        // All targets are blended in together, back and forth
+        float weight =
+            0.5f - 0.5f * std::cos(TWO_PI * time / morph_period);
+        AnimationParams params{time,
+                               wave_amplitude,
+                               wave_frequency,
+                               wave_speed,
+                               glm::vec4(weight),
+                               vertex_count,
+                               target_count,
+                               {}};
+
+        auto& output = outputs[frame_idx];
+        auto set = descriptors.get(
+            *set_layout,
+            {DescriptorBinding::ofBuffer(0, vk::DescriptorType::eStorageBuffer,
+                                         *base.buffer, 0, base.size),
+             DescriptorBinding::ofBuffer(1, vk::DescriptorType::eStorageBuffer,
+                                         *deltas.buffer, 0, deltas.size),
+             DescriptorBinding::ofBuffer(2, vk::DescriptorType::eStorageBuffer,
+                                         *output.buffer, 0, output.size)});
+
+        cmd_buf.bindPipeline(vk::PipelineBindPoint::eCompute,
+                             *animate_pipeline);
+        cmd_buf.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                   *animate_layout, 0, set, nullptr);
+        cmd_buf.pushConstants<AnimationParams>(
+            *animate_layout, vk::ShaderStageFlagBits::eCompute, 0, params);
+        cmd_buf.dispatch((vertex_count + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+
+        vk::BufferMemoryBarrier barrier(
+            vk::AccessFlagBits::eShaderWrite,
+            vk::AccessFlagBits::eVertexAttributeRead, VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED, *output.buffer, 0, output.size);
+        cmd_buf.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                vk::PipelineStageFlagBits::eVertexInput, {},
+                                nullptr, barrier, nullptr);
+    }
+
+   private:
+    static constexpr uint32_t GROUP_SIZE = 64;
+    static constexpr float TWO_PI = 6.28318531f;
+
+    vk::raii::Device& device;
+    DescriptorSetCache& descriptors;
+
+    uint32_t vertex_count;
+    uint32_t target_count;
+
+    AllocatedBuffer base;
+    AllocatedBuffer deltas;
+    std::vector<AllocatedBuffer> outputs;
+
+    vk::raii::DescriptorSetLayout set_layout{nullptr};
+    vk::raii::PipelineLayout animate_layout{nullptr};
+    vk::raii::Pipeline animate_pipeline{nullptr};
+
+    void createLayouts() {
+        auto compute = vk::ShaderStageFlagBits::eCompute;
+
+        std::vector<vk::DescriptorSetLayoutBinding> bindings = {
+            {0, vk::DescriptorType::eStorageBuffer, 1, compute},
+            {1, vk::DescriptorType::eStorageBuffer, 1, compute},
+            {2, vk::DescriptorType::eStorageBuffer, 1, compute},
+        };
+        set_layout = device.createDescriptorSetLayout(
+            vk::DescriptorSetLayoutCreateInfo({}, bindings), hostCallbacks());
+
+        vk::PushConstantRange range(compute, 0, sizeof(AnimationParams));
+        animate_layout = device.createPipelineLayout(
+            vk::PipelineLayoutCreateInfo({}, *set_layout, range),
+            hostCallbacks());
+    }
+};
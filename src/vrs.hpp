@@ -0,0 +1,308 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+const std::vector<const char*> SHADING_RATE_DEVICE_EXTENSIONS = {
+    VK_KHR_FRAGMENT_SHADING_RATE_EXTENSION_NAME};
+
+/// @brief Push constants of vrs.wgsl
+struct ShadingRateParams {
+    glm::uvec2 image_size;
+    glm::uvec2 texel_size;
+    uint32_t max_rate_log2;
+};
+
+/// @brief What VK_KHR_fragment_shading_rate offers on a device, limited to
+/// the rate sources that were asked for
+struct ShadingRateSupport {
+    // One rate per draw, set in the pipeline
+    bool pipeline_rate = false;
+    // One rate per screen tile, read from a rate attachment
+    bool attachment_rate = false;
+    // Combiner ops beyond keep and replace
+    bool non_trivial_combiners = false;
+
+    vk::Extent2D min_texel_size;
+    vk::Extent2D max_texel_size;
+    vk::Extent2D max_fragment_size;
+
+    vk::PhysicalDeviceFragmentShadingRateFeaturesKHR features{};
+
+    static ShadingRateSupport from(vk::raii::PhysicalDevice& device,
+                                   bool want_pipeline, bool want_attachment) {
+        ShadingRateSupport support{};
+
+        auto features = device.getFeatures2<
+            vk::PhysicalDeviceFeatures2,
+            vk::PhysicalDeviceFragmentShadingRateFeaturesKHR>();
+        auto& fsr =
+            features.get<vk::PhysicalDeviceFragmentShadingRateFeaturesKHR>();
+
+        auto properties = device.getProperties2<
+            vk::PhysicalDeviceProperties2,
+            vk::PhysicalDeviceFragmentShadingRatePropertiesKHR>();
+        auto& fsr_props =
+            properties.get<vk::PhysicalDeviceFragmentShadingRatePropertiesKHR>();
+
+        // The analysis pass writes rates as a storage image
+        auto format_features =
+            device.getFormatProperties(vk::Format::eR8Uint)
+                .optimalTilingFeatures;
+        bool storable =
+            static_cast<bool>(format_features &
+                              vk::FormatFeatureFlagBits::eStorageImage);
+
+        support.pipeline_rate = want_pipeline && fsr.pipelineFragmentShadingRate;
+        support.attachment_rate =
+            want_attachment && fsr.attachmentFragmentShadingRate && storable;
+        support.non_trivial_combiners =
+            fsr_props.fragmentShadingRateNonTrivialCombinerOps;
+
+        support.min_texel_size =
+            fsr_props.minFragmentShadingRateAttachmentTexelSize;
+        support.max_texel_size =
+            fsr_props.maxFragmentShadingRateAttachmentTexelSize;
+        support.max_fragment_size = fsr_props.maxFragmentSize;
+
+        support.features.setPipelineFragmentShadingRate(support.pipeline_rate);
+        support.features.setAttachmentFragmentShadingRate(
+            support.attachment_rate);
+
+        return support;
+    }
+
+    bool any() const { return pipeline_rate || attachment_rate; }
+
+    /// @brief Screen pixels covered by one rate attachment texel
+    vk::Extent2D attachmentTexelSize() const {
+        return vk::Extent2D(std::clamp(PREFERRED_TEXEL_SIZE,
+                                       min_texel_size.width,
+                                       max_texel_size.width),
+                            std::clamp(PREFERRED_TEXEL_SIZE,
+                                       min_texel_size.height,
+                                       max_texel_size.height));
+    }
+
+    /// @brief Largest square fragment size up to `size` the device shades
+    uint32_t clampFragmentSize(uint32_t size) const {
+        return std::max(1u, std::min({size, max_fragment_size.width,
+                                      max_fragment_size.height}));
+    }
+
+    /// @brief How the attachment rate combines with the pipeline rate:
+    /// coarser of both when supported, the attachment rate alone otherwise
+    vk::FragmentShadingRateCombinerOpKHR attachmentCombiner() const {
+        return non_trivial_combiners
+                   ? vk::FragmentShadingRateCombinerOpKHR::eMax
+                   : vk::FragmentShadingRateCombinerOpKHR::eReplace;
+    }
+
+    /// @brief Prepends the shading rate feature struct to a device creation
+    /// pNext chain
+    void chainFeatures(void*& feature_chain) {
+        features.setPNext(feature_chain);
+        feature_chain = &features;
+    }
+
+   private:
+    static constexpr uint32_t PREFERRED_TEXEL_SIZE = 16;
+};
+
+/// @brief Shading rate attachment filled from the contrast of a rendered
+/// frame.
+///
+/// Each texel covers a screen tile and holds the fragment size used there.
+/// `analyze` derives the rates from the color a frame rendered, so a frame is
+/// shaded with the rates of the one before it: flat tiles get coarse rates,
+/// edges and detail stay at one invocation per pixel.
+class ShadingRateImage {
+   public:
+    static constexpr vk::Format FORMAT = vk::Format::eR8Uint;
+    static constexpr vk::ImageLayout ATTACHMENT_LAYOUT =
+        vk::ImageLayout::eFragmentShadingRateAttachmentOptimalKHR;
+
+    ShadingRateImage(vk::raii::PhysicalDevice& phys_dev,
+                     vk::raii::Device& device,
+                     vk::Optional<const vk::raii::PipelineCache> cache,
+                     DescriptorSetCache& descriptor_cache,
+                     const ShadingRateSupport& support)
+        : phys_dev(phys_dev),
+          device(device),
+          descriptors(descriptor_cache),
+          texel_size(support.attachmentTexelSize()) {
+        uint32_t max_size = support.clampFragmentSize(MAX_FRAGMENT_SIZE);
+        max_rate_log2 = static_cast<uint32_t>(std::log2(max_size));
+
+        createLayouts();
+        analyze_pipeline = createComputePipeline(
+            device, cache, "shaders/vrs.spv", "analyze_main", *analyze_layout);
+    }
+
+    ShadingRateImage(const ShadingRateImage&) = delete;
+    ShadingRateImage& operator=(const ShadingRateImage&) = delete;
+
+    vk::ImageView view() const { return *rate_view.value(); }
+
+    /// @brief Recreates the rate image for a new framebuffer size, it shades
+    /// at full rate until a frame has been analyzed
+    void resize(vk::Extent2D extent) {
+        rate_view.reset();
+        rate_image.reset();
+
+        vk::Extent2D size(groupCount(extent.width, texel_size.width),
+                          groupCount(extent.height, texel_size.height));
+        rate_image.emplace(
+            phys_dev, device,
+            AllocatedImage::info2D(
+                FORMAT, size,
+                vk::ImageUsageFlagBits::eFragmentShadingRateAttachmentKHR |
+                    vk::ImageUsageFlagBits::eStorage |
+                    vk::ImageUsageFlagBits::eTransferDst));
+        rate_view =
+            rate_image->createView(device, vk::ImageAspectFlagBits::eColor);
+
+        initialized = false;
+    }
+
+    /// @brief Records what is needed before the rate image is first read as
+    /// an attachment: a clear to 1x1 and the layout change
+    void prepare(const vk::raii::CommandBuffer& cmd_buf) {
+        if (initialized) {
+            return;
+        }
+
+        auto range = colorRange();
+        vk::ImageMemoryBarrier to_transfer(
+            {}, vk::AccessFlagBits::eTransferWrite,
+            vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+            VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+            *rate_image->image, range);
+        cmd_buf.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+                                vk::PipelineStageFlagBits::eTransfer, {},
+                                nullptr, nullptr, to_transfer);
+
+        cmd_buf.clearColorImage(*rate_image->image,
+                                vk::ImageLayout::eTransferDstOptimal,
+                                vk::ClearColorValue(std::array<uint32_t, 4>{
+                                    0, 0, 0, 0}),
+                                range);
+
+        vk::ImageMemoryBarrier to_attachment(
+            vk::AccessFlagBits::eTransferWrite,
+            vk::AccessFlagBits::eFragmentShadingRateAttachmentReadKHR,
+            vk::ImageLayout::eTransferDstOptimal, ATTACHMENT_LAYOUT,
+            VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+            *rate_image->image, range);
+        cmd_buf.pipelineBarrier(
+            vk::PipelineStageFlagBits::eTransfer,
+            vk::PipelineStageFlagBits::eFragmentShadingRateAttachmentKHR, {},
+            nullptr, nullptr, to_attachment);
+
+        initialized = true;
+    }
+
+    /// @brief Records the rate analysis of a rendered frame. `color_image`
+    /// must be in eShaderReadOnlyOptimal and is left in ePresentSrcKHR, the
+    /// rates are ready for the next render pass afterwards.
+    void analyze(const vk::raii::CommandBuffer& cmd_buf,
+                 vk::Image color_image, vk::ImageView color_view) {
+        auto range = colorRange();
+
+        // The render pass that just ended read the previous rates
+        vk::ImageMemoryBarrier to_general(
+            vk::AccessFlagBits::eFragmentShadingRateAttachmentReadKHR,
+            vk::AccessFlagBits::eShaderWrite, ATTACHMENT_LAYOUT,
+            vk::ImageLayout::eGeneral, VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED, *rate_image->image, range);
+        cmd_buf.pipelineBarrier(
+            vk::PipelineStageFlagBits::eFragmentShadingRateAttachmentKHR,
+            vk::PipelineStageFlagBits::eComputeShader, {}, nullptr, nullptr,
+            to_general);
+
+        auto set = descriptors.get(
+            *analyze_set_layout,
+            {DescriptorBinding::ofImage(0, vk::DescriptorType::eSampledImage,
+                                        color_view,
+                                        vk::ImageLayout::eShaderReadOnlyOptimal),
+             DescriptorBinding::ofImage(1, vk::DescriptorType::eStorageImage,
+                                        *rate_view.value(),
+                                        vk::ImageLayout::eGeneral)});
+
+        ShadingRateParams params{
+            {rate_image->extent.width, rate_image->extent.height},
+            {texel_size.width, texel_size.height},
+            max_rate_log2};
+
+        cmd_buf.bindPipeline(vk::PipelineBindPoint::eCompute,
+                             *analyze_pipeline);
+        cmd_buf.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                   *analyze_layout, 0, set, nullptr);
+        cmd_buf.pushConstants<ShadingRateParams>(
+            *analyze_layout, vk::ShaderStageFlagBits::eCompute, 0, params);
+        cmd_buf.dispatch(groupCount(rate_image->extent.width, GROUP_SIZE),
+                         groupCount(rate_image->extent.height, GROUP_SIZE), 1);
+
+        std::array<vk::ImageMemoryBarrier, 2> image_barriers = {
+            vk::ImageMemoryBarrier(
+                vk::AccessFlagBits::eShaderWrite,
+                vk::AccessFlagBits::eFragmentShadingRateAttachmentReadKHR,
+                vk::ImageLayout::eGeneral, ATTACHMENT_LAYOUT,
+                VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+                *rate_image->image, range),
+            vk::ImageMemoryBarrier(
+                vk::AccessFlagBits::eShaderRead, {},
+                vk::ImageLayout::eShaderReadOnlyOptimal,
+                vk::ImageLayout::ePresentSrcKHR, VK_QUEUE_FAMILY_IGNORED,
+                VK_QUEUE_FAMILY_IGNORED, color_image, range)};
+        cmd_buf.pipelineBarrier(
+            vk::PipelineStageFlagBits::eComputeShader,
+            vk::PipelineStageFlagBits::eFragmentShadingRateAttachmentKHR |
+                vk::PipelineStageFlagBits::eBottomOfPipe,
+            {}, nullptr, nullptr, image_barriers);
+    }
+
+   private:
+    static constexpr uint32_t MAX_FRAGMENT_SIZE = 4;
+    static constexpr uint32_t GROUP_SIZE = 8;
+
+    vk::raii::PhysicalDevice& phys_dev;
+    vk::raii::Device& device;
+    DescriptorSetCache& descriptors;
+
+    vk::Extent2D texel_size;
+    uint32_t max_rate_log2 = 0;
+
+    std::optional<AllocatedImage> rate_image;
+    std::optional<vk::raii::ImageView> rate_view;
+    bool initialized = false;
+
+    vk::raii::DescriptorSetLayout analyze_set_layout{nullptr};
+    vk::raii::PipelineLayout analyze_layout{nullptr};
+    vk::raii::Pipeline analyze_pipeline{nullptr};
+
+    static uint32_t groupCount(uint32_t items, uint32_t group_size) {
+        return (items + group_size - 1) / group_size;
+    }
+
+    static vk::ImageSubresourceRange colorRange() {
+        return vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1,
+                                         0, 1);
+    }
+
+    void createLayouts() {
+        auto compute = vk::ShaderStageFlagBits::eCompute;
+
+        std::vector<vk::DescriptorSetLayoutBinding> bindings = {
+            {0, vk::DescriptorType::eSampledImage, 1, compute},
+            {1, vk::DescriptorType::eStorageImage, 1, compute},
+        };
+        analyze_set_layout = device.createDescriptorSetLayout(
+            vk::DescriptorSetLayoutCreateInfo({}, bindings), hostCallbacks());
+
+        vk::PushConstantRange range(compute, 0, sizeof(ShadingRateParams));
+        analyze_layout = device.createPipelineLayout(
+            vk::PipelineLayoutCreateInfo({}, *analyze_set_layout, range),
+            hostCallbacks());
+    }
+};
@@ -0,0 +1,266 @@
+#pragma once
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/// @brief Presentation state of a window: its surface, swapchain,
+/// framebuffers and the semaphores of every frame in flight.
+///
+/// Every window shares the device, queues, pipelines and descriptors. A
+/// frame draws every window from the same command buffer, submits once and
+/// presents all swapchains with a single call. The surface lives as long as
+/// the window, the rest is released along with the device.
+class WindowTarget {
+   public:
+    // Set when the swapchain is missing or no longer matches the window
+    bool rebuild_needed = true;
+
+    WindowTarget(vk::raii::Instance& instance, int width, int height,
+                 const std::string& title) {
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+        glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+        window =
+            glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
+        if (window == nullptr) {
+            throw std::runtime_error("failed to create window " + title);
+        }
+
+        VkSurfaceKHR raw_surface = VK_NULL_HANDLE;
+        const vk::AllocationCallbacks* callbacks = hostCallbacks();
+        if (glfwCreateWindowSurface(
+                *instance, window,
+                reinterpret_cast<const VkAllocationCallbacks*>(callbacks),
+                &raw_surface) != VK_SUCCESS) {
+            glfwDestroyWindow(window);
+            throw std::runtime_error("failed to create window surface");
+        }
+        surface.emplace(instance, raw_surface, hostCallbacks());
+    }
+
+    ~WindowTarget() {
+        release();
+        surface.reset();
+        glfwDestroyWindow(window);
+    }
+
+    WindowTarget(const WindowTarget&) = delete;
+    WindowTarget& operator=(const WindowTarget&) = delete;
+
+    GLFWwindow* glfwWindow() const { return window; }
+
+    vk::raii::SurfaceKHR& windowSurface() { return surface.value(); }
+
+    vk::Extent2D extent() const { return window_extent; }
+
+    /// @brief Whether the window has no area to present to, its swapchain is
+    /// not rebuilt until it is restored
+    bool minimized() const {
+        int width = 0, height = 0;
+        glfwGetFramebufferSize(window, &width, &height);
+        return width == 0 || height == 0;
+    }
+
+    /// @brief Whether an image was acquired for the current frame
+    bool acquired() const { return acquired_image.has_value(); }
+
+    vk::SwapchainKHR swapchainHandle() const { return *swapchain.value(); }
+
+    uint32_t imageIndex() const { return acquired_image.value(); }
+
+    uint32_t imageCount() const {
+        return static_cast<uint32_t>(images.size());
+    }
+
+    vk::PresentModeKHR presentMode() const { return present_mode; }
+
+    vk::Image image() const { return images[acquired_image.value()]; }
+
+    vk::ImageView imageView() const { return *views[acquired_image.value()]; }
+
+    vk::Framebuffer framebuffer() const {
+        return *framebuffers[acquired_image.value()];
+    }
+
+    vk::Semaphore imageAvailable(uint32_t frame_idx) const {
+        return *image_available[frame_idx];
+    }
+
+    vk::Semaphore renderFinished(uint32_t frame_idx) const {
+        return *render_finished[frame_idx];
+    }
+
+    /// @brief (Re)creates the swapchain and its image views at the window
+    /// size. Images use the color format of `main_info`, that of the main
+    /// window, so that the same render passes draw into every window.
+    /// Framebuffers are left to createFramebuffers(). Nothing is created
+    /// while the window is minimized, callers check minimized() to skip it
+    /// without waiting.
+    void rebuild(vk::raii::PhysicalDevice& phys_dev, vk::raii::Device& device,
+                 const QueueFamiliesInfo& queues_info,
+                 const SurfaceInfo& main_info, vk::ImageUsageFlags usage,
+                 uint32_t frame_count) {
+        int width = 0, height = 0;
+        glfwGetFramebufferSize(window, &width, &height);
+        if (width == 0 || height == 0) {
+            return;
+        }
+
+        auto& srfc = surface.value();
+        if (!phys_dev.getSurfaceSupportKHR(queues_info.present_family_idx,
+                                           *srfc)) {
+            throw std::runtime_error(
+                "window cannot be presented from the present queue");
+        }
+
+        auto surface_info = SurfaceInfo::from(phys_dev, srfc);
+        auto formats = phys_dev.getSurfaceFormatsKHR(*srfc);
+        auto format = std::find_if(
+            formats.begin(), formats.end(),
+            [&](const vk::SurfaceFormatKHR& f) {
+                return f.format == main_info.color_format &&
+                       f.colorSpace == main_info.color_space;
+            });
+        if (format == formats.end()) {
+            throw std::runtime_error(
+                "window does not support the main window format");
+        }
+
+        uint32_t family_idxs[2] = {queues_info.graphics_family_idx,
+                                   queues_info.present_family_idx};
+        auto img_sharing_mode = family_idxs[0] != family_idxs[1]
+                                    ? vk::SharingMode::eConcurrent
+                                    : vk::SharingMode::eExclusive;
+
+        auto img_cnt = surface_info.min_image_cnt + 1;
+        if (surface_info.max_image_cnt != 0) {
+            img_cnt = std::min(surface_info.max_image_cnt, img_cnt);
+        }
+
+        window_extent = vk::Extent2D(static_cast<uint32_t>(width),
+                                     static_cast<uint32_t>(height));
+        present_mode = surface_info.present_mode;
+
+        vk::SwapchainCreateInfoKHR swapchain_info{
+            {},
+            *srfc,
+            img_cnt,
+            main_info.color_format,
+            format->colorSpace,
+            window_extent,
+            1,
+            usage,
+            img_sharing_mode,
+            family_idxs};
+        swapchain_info.setPresentMode(present_mode);
+        if (swapchain.has_value()) {
+            swapchain_info.setOldSwapchain(*swapchain.value());
+        }
+
+        framebuffers.clear();
+        views.clear();
+        swapchain =
+            device.createSwapchainKHR(swapchain_info, hostCallbacks());
+        images = swapchain->getImages();
+
+        vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor, 0, 1,
+                                        0, 1);
+        for (auto image : images) {
+            vk::ImageViewCreateInfo view_info({}, image,
+                                              vk::ImageViewType::e2D,
+                                              main_info.color_format, {},
+                                              range);
+            views.push_back(
+                device.createImageView(view_info, hostCallbacks()));
+        }
+
+        if (image_available.empty()) {
+            for (uint32_t i = 0; i < frame_count; i++) {
+                image_available.push_back(
+                    device.createSemaphore({}, hostCallbacks()));
+                render_finished.push_back(
+                    device.createSemaphore({}, hostCallbacks()));
+            }
+        }
+
+        rebuild_needed = false;
+    }
+
+    /// @brief Creates a framebuffer of `render_pass` per swapchain image,
+    /// the image view first, followed by `shared_attachments`
+    void createFramebuffers(
+        vk::raii::Device& device, vk::RenderPass render_pass,
+        const std::vector<vk::ImageView>& shared_attachments) {
+        framebuffers.clear();
+        for (auto& view : views) {
+            std::vector<vk::ImageView> attachments = {*view};
+            attachments.insert(attachments.end(), shared_attachments.begin(),
+                               shared_attachments.end());
+
+            vk::FramebufferCreateInfo fb_info({}, render_pass, attachments,
+                                              window_extent.width,
+                                              window_extent.height, 1);
+            framebuffers.push_back(
+                device.createFramebuffer(fb_info, hostCallbacks()));
+        }
+    }
+
+    /// @brief Acquires the next image, signalling the image available
+    /// semaphore of `frame_idx`. Returns false when the window is skipped
+    /// this frame, either minimized or with an out of date swapchain.
+    bool acquire(vk::raii::Device& device, uint32_t frame_idx) {
+        acquired_image.reset();
+        if (rebuild_needed || !swapchain.has_value()) {
+            return false;
+        }
+
+        vk::AcquireNextImageInfoKHR ani_info(*swapchain.value(), UINT64_MAX,
+                                             *image_available[frame_idx],
+                                             nullptr, 1);
+        try {
+            acquired_image = device.acquireNextImage2KHR(ani_info).second;
+        } catch (vk::OutOfDateKHRError&) {
+            rebuild_needed = true;
+            return false;
+        }
+        return true;
+    }
+
+    /// @brief Takes the result of presenting the acquired image
+    void presented(vk::Result result) {
+        acquired_image.reset();
+        if (result == vk::Result::eSuboptimalKHR ||
+            result == vk::Result::eErrorOutOfDateKHR) {
+            rebuild_needed = true;
+        }
+    }
+
+    /// @brief Drops everything created from the device, the next rebuild
+    /// creates it again
+    void release() {
+        acquired_image.reset();
+        framebuffers.clear();
+        views.clear();
+        images.clear();
+        swapchain.reset();
+        render_finished.clear();
+        image_available.clear();
+        rebuild_needed = true;
+    }
+
+   private:
+    GLFWwindow* window = nullptr;
+    std::optional<vk::raii::SurfaceKHR> surface;
+
+    vk::Extent2D window_extent{};
+    vk::PresentModeKHR present_mode = vk::PresentModeKHR::eFifo;
+    std::optional<vk::raii::SwapchainKHR> swapchain;
+    std::vector<vk::Image> images;
+    std::vector<vk::raii::ImageView> views;
+    std::vector<vk::raii::Framebuffer> framebuffers;
+    std::optional<uint32_t> acquired_image;
+
+    std::vector<vk::raii::Semaphore> image_available;
+    std::vector<vk::raii::Semaphore> render_finished;
+};